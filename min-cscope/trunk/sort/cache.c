@@ -16,16 +16,121 @@
  ******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "internal.h"
 
+/*
+ * The cache keeps mapped pages, so that pages used repeatedly are not mapped
+ * and unmapped on every access.
+ * The cache is set-associative: a page can be held by any of the CACHE_WAYS
+ * entries of its set. Victims are chosen within the set by the CLOCK
+ * algorithm, which skips entries that are in use and gives recently used ones
+ * a second chance.
+ * The number of entries is determined when the cache is initialised, from the
+ * amount of physical memory.
+ */
+
+/* Fraction of the physical memory used for cached pages. */
+#define CACHE_MEMORY_SHIFT 3
+
+/* Limits on the address space used for cached pages. */
+#define CACHE_MAX_MEMORY_32 (512ULL << 20)
+#define CACHE_MAX_MEMORY_64 (8ULL << 30)
+
+static inline cache_entry_t* cache_get_set(cache_t* cache, page_id_t pageid)
+{
+    return &cache->entries[(pageid & (cache->nsets - 1)) * CACHE_WAYS];
+}
+
+static cache_entry_t* cache_find(cache_t* cache, page_id_t pageid)
+{
+    cache_entry_t* entry = cache_get_set(cache, pageid);
+    u32 i;
+
+    for (i = 0; i < CACHE_WAYS; i++, entry++) {
+        if ((entry->ptr != NULL) && (entry->pageid == pageid))
+            return entry;
+    }
+
+    return NULL;
+}
+
+/**
+ * Computes the default number of cache entries for the amount of physical
+ * memory.
+ */
+u32 cache_default_size()
+{
+    u64 mem;
+    u64 max;
+    u32 nentries;
+
+    mem = os_get_memory_size() >> CACHE_MEMORY_SHIFT;
+    max = (sizeof(void*) > 4) ? CACHE_MAX_MEMORY_64 : CACHE_MAX_MEMORY_32;
+    if (mem > max)
+        mem = max;
+
+    nentries = (u32)(mem / PAGE_SIZE);
+    if (nentries < CACHE_MIN_SIZE)
+        nentries = CACHE_MIN_SIZE;
+
+    return nentries;
+}
+
+/**
+ * Allocates the cache entries.
+ * @param  cache     The cache to initialise
+ * @param  nentries  Requested number of entries, rounded down to a power of 2
+ *                   number of sets
+ * @return 0 if successful, -1 on error
+ */
+int cache_init(cache_t* cache, u32 nentries)
+{
+    u32 nsets;
+
+    memset(cache, 0, sizeof(cache_t));
+
+    for (nsets = 1; (nsets << 1) * CACHE_WAYS <= nentries; nsets <<= 1)
+        ;
+
+    cache->entries = (cache_entry_t*)calloc(nsets * CACHE_WAYS,
+                                            sizeof(cache_entry_t));
+    cache->hands = (u8*)calloc(nsets, sizeof(u8));
+    if ((cache->entries == NULL) || (cache->hands == NULL)) {
+        fprintf(stderr, "cache_init: failed to allocate %u entries\n",
+                nsets * CACHE_WAYS);
+        cache_destroy(cache);
+        return -1;
+    }
+
+    cache->nsets = nsets;
+    cache->nentries = nsets * CACHE_WAYS;
+    return 0;
+}
+
+/**
+ * Frees the cache entries.
+ * Mapped pages need to be released by the caller first.
+ */
+void cache_destroy(cache_t* cache)
+{
+    free(cache->entries);
+    free(cache->hands);
+    cache->entries = NULL;
+    cache->hands = NULL;
+    cache->nsets = 0;
+    cache->nentries = 0;
+}
+
 void* cache_get_page(cache_t* cache, page_id_t pageid)
 {
-    cache_entry_t* entry = &cache->entries[pageid & (CACHE_SIZE - 1)];
+    cache_entry_t* entry = cache_find(cache, pageid);
 
-    if (entry->pageid == pageid) {
+    if (entry != NULL) {
         cache->hits++;
         entry->ref++;
+        entry->used = 1;
         return entry->ptr;
     }
 
@@ -33,52 +138,99 @@ void* cache_get_page(cache_t* cache, page_id_t pageid)
     return NULL;
 }
 
+/**
+ * Places a page in the cache.
+ * The page is placed in an empty entry of its set if one exists, otherwise
+ * it replaces the first page not in use found by the set's clock hand.
+ * @return 0 if successful (oldptr is the replaced page, if any), -1 if all
+ *         pages in the set are in use
+ */
 int cache_replace(cache_t* cache, page_id_t pageid, void* ptr, page_id_t* oldid,
                   void** oldptr)
 {
-    cache_entry_t* entry = &cache->entries[pageid & (CACHE_SIZE - 1)];
+    cache_entry_t* set = cache_get_set(cache, pageid);
+    cache_entry_t* entry = NULL;
+    u8* hand = &cache->hands[(pageid & (cache->nsets - 1))];
+    u32 i;
+
+    /* Look for an empty entry. */
+    for (i = 0; i < CACHE_WAYS; i++) {
+        if (set[i].ptr == NULL) {
+            entry = &set[i];
+            break;
+        }
+    }
 
-    if (entry->ref > 0)
+    /*
+     * Run the clock: the first sweep clears the used bits, so two sweeps are
+     * enough to find a victim, if any page in the set is not in use.
+     */
+    for (i = 0; (entry == NULL) && (i < CACHE_WAYS * 2); i++) {
+        cache_entry_t* cand = &set[*hand];
+
+        *hand = (*hand + 1) & (CACHE_WAYS - 1);
+        if (cand->ref > 0)
+            continue;
+
+        if (cand->used) {
+            cand->used = 0;
+            continue;
+        }
+
+        entry = cand;
+    }
+
+    if (entry == NULL) {
+        cache->failures++;
         return -1;
+    }
+
+    if (entry->ptr != NULL)
+        cache->evictions++;
 
     *oldid = entry->pageid;
     *oldptr = entry->ptr;
     entry->pageid = pageid;
     entry->ptr = ptr;
     entry->ref = 1;
-    
+    entry->used = 1;
+
     return 0;
 }
 
 int cache_remove(cache_t* cache, page_id_t pageid)
 {
-    cache_entry_t* entry = &cache->entries[pageid & (CACHE_SIZE - 1)];
+    cache_entry_t* entry = cache_find(cache, pageid);
 
-    if (entry->ref > 0)
+    if ((entry == NULL) || (entry->ref > 0))
         return -1;
 
     entry->pageid = 0;
     entry->ptr = NULL;
-    entry->ref = 0;
-    
+    entry->used = 0;
+
     return 0;
 }
 
 int cache_dec_ref(cache_t* cache, page_id_t pageid)
 {
-    cache_entry_t* entry = &cache->entries[pageid & (CACHE_SIZE - 1)];
+    cache_entry_t* entry = cache_find(cache, pageid);
 
-    if (entry->pageid != pageid)
+    if (entry == NULL)
         return -1;
-    
+
     entry->ref--;
     return 0;
 }
 
 void cache_invalidate(cache_t* cache, int reset)
 {
-    if (reset)
-        memset(cache, 0, sizeof(cache_t));
-    else
-        memset(cache->entries, 0, sizeof(cache_entry_t) << CACHE_SIZE_ORDER);
+    memset(cache->entries, 0, sizeof(cache_entry_t) * cache->nentries);
+    memset(cache->hands, 0, sizeof(u8) * cache->nsets);
+    if (reset) {
+        cache->hits = 0;
+        cache->misses = 0;
+        cache->evictions = 0;
+        cache->failures = 0;
+    }
 }
@@ -20,6 +20,26 @@
 #include <stdlib.h>
 #include "internal.h"
 
+/*
+ * The file is sorted in two phases:
+ * 1. Run generation: the pages of the file are divided into groups, which fit
+ *    in the memory budget of a single thread. Each group is turned into a
+ *    sorted run by sorting its pages and merging them.
+ * 2. Merging: runs are merged, up to the fan-in at a time, until a single run
+ *    remains. With the default parameters the runs created by the first phase
+ *    are merged in a single pass.
+ * Groups are handed to a pool of threads. Each merge reads its input runs
+ * sequentially, one page at a time, and selects the next record through a
+ * tournament (loser) tree, so a k-way merge costs log2(k) comparisons per
+ * record.
+ * All accesses to the file object (page mapping, allocation and release) are
+ * serialised by a lock. Sorting and merging records, which dominate the
+ * running time, do not require it.
+ */
+
+#define DEFAULT_MEMSIZE 256
+#define MAX_THREADS     64
+
 typedef struct
 {
     page_id_t head;
@@ -35,37 +55,114 @@ typedef struct
     page_id_t   npages;
 } run_itr_t;
 
+typedef struct
+{
+    file_t*     file;
+    os_lock_t   lock;
+    /** Runs to merge. */
+    run_info_t* runs;
+    u32         nruns;
+    /** Merged runs, one per group. */
+    run_info_t* outruns;
+    /** Maximal number of runs in a group. */
+    u32         groupsize;
+    u32         ngroups;
+    /** Next group to merge. */
+    u32         nextgroup;
+    /** Whether the pages of the input runs need to be sorted first. */
+    int         sortpages;
+    int         result;
+} sort_ctx_t;
+
+typedef struct
+{
+    u32         nruns;
+    run_itr_t*  itrs;
+    record_t*   recs;
+    int*        haverec;
+    /** tree[0] is the winner, other nodes hold the losers of matches. */
+    u32*        tree;
+} merge_tree_t;
+
+/* Sort parameters, 0 for defaults. */
+static u32 sort_nthreads = 0;
+static u32 sort_fanin = 0;
+static u32 sort_memsize = 0;
+
+/**
+ * Sets the parameters used by file_sort().
+ * @param  nthreads  Maximal number of threads (0 for the number of processors)
+ * @param  fanin     Maximal number of runs merged together (0 to derive from
+ *                   the memory budget)
+ * @param  memsize   Memory budget, in MB, for pages mapped at the same time
+ *                   (0 for the default)
+ */
+void file_sort_params(u32 nthreads, u32 fanin, u32 memsize)
+{
+    sort_nthreads = nthreads;
+    sort_fanin = fanin;
+    sort_memsize = memsize;
+}
+
+static page_hdr_t* sort_get_page(sort_ctx_t* ctx, page_id_t pageid)
+{
+    page_hdr_t* page;
+
+    os_lock(&ctx->lock);
+    page = file_get_page(ctx->file, pageid);
+    os_unlock(&ctx->lock);
+    return page;
+}
+
+static page_hdr_t* sort_get_new_page(sort_ctx_t* ctx, page_id_t* pageidp)
+{
+    page_hdr_t* page;
+
+    os_lock(&ctx->lock);
+    page = file_get_new_page(ctx->file, pageidp);
+    os_unlock(&ctx->lock);
+    return page;
+}
+
+static void sort_put_page(sort_ctx_t* ctx, page_id_t pageid, page_hdr_t* page)
+{
+    os_lock(&ctx->lock);
+    file_put_page(ctx->file, pageid, page);
+    os_unlock(&ctx->lock);
+}
+
+static void sort_free_page(sort_ctx_t* ctx, page_id_t pageid, page_hdr_t* page)
+{
+    os_lock(&ctx->lock);
+    file_free_page(ctx->file, pageid, page);
+    os_unlock(&ctx->lock);
+}
+
 static int comp_records(record_t* rec1, record_t* rec2)
 {
     u32 len;
     int cmp;
-    int shorter;
-
-    if (rec1->len <= rec2->len) {
-        len = rec1->len;
-        shorter = -1;
-    }
-    else {
-        len = rec2->len;
-        shorter = 1;
-    }
 
+    len = (rec1->len <= rec2->len) ? rec1->len : rec2->len;
     cmp = memcmp(rec1->data, rec2->data, len);
     if (cmp == 0)
-        return shorter;
+        return (int)rec1->len - (int)rec2->len;
 
     return cmp;
 }
 
-static int run_itr_init(file_t* file, run_info_t* info, run_itr_t* itr)
+static int run_itr_init(sort_ctx_t* ctx, run_info_t* info, run_itr_t* itr)
 {
     /* Load the first page in the run. */
-    itr->page = file_get_page(file, info->head);
+    itr->page = sort_get_page(ctx, info->head);
     if (itr->page == NULL)
         return -1;
 
+    if (info->size > 1)
+        file_advise_sequential(ctx->file, itr->page);
+
     /* Fill-in the iterator structure. */
-    itr->file = file;
+    itr->file = ctx->file;
     itr->recid = 0;
     itr->pageid = info->head;
     itr->npages = info->size;
@@ -73,10 +170,13 @@ static int run_itr_init(file_t* file, run_info_t* info, run_itr_t* itr)
     return 0;
 }
 
-static int run_itr_next(run_itr_t* itr, record_t* rec)
+static int run_itr_next(sort_ctx_t* ctx, run_itr_t* itr, record_t* rec)
 {
     page_id_t pageid;
-    
+
+    if (itr->page == NULL)
+        return 0;
+
     /* Get a record from the current page. */
     if (itr->recid < itr->page->nrecs) {
         if (page_get_record(itr->page, itr->recid++, rec) < 0)
@@ -87,7 +187,7 @@ static int run_itr_next(run_itr_t* itr, record_t* rec)
 
     /* Done with this page, free it. */
     pageid = itr->page->next;
-    file_free_page(itr->file, itr->pageid, itr->page);
+    sort_free_page(ctx, itr->pageid, itr->page);
     itr->npages--;
     if (itr->npages == 0) {
         itr->page = NULL;
@@ -95,10 +195,13 @@ static int run_itr_next(run_itr_t* itr, record_t* rec)
     }
 
     /* Get the next page in the run. */
-    itr->page = file_get_page(itr->file, pageid);
+    itr->page = sort_get_page(ctx, pageid);
     if (itr->page == NULL)
         return -1;
 
+    if (itr->npages > 1)
+        file_advise_sequential(ctx->file, itr->page);
+
     /* Get the first record from the page. */
     if (page_get_record(itr->page, 0, rec) < 0)
         return -1;
@@ -108,95 +211,137 @@ static int run_itr_next(run_itr_t* itr, record_t* rec)
     return 1;
 }
 
-static void run_itr_finish(run_itr_t* itr)
+static void run_itr_finish(sort_ctx_t* ctx, run_itr_t* itr)
 {
     if (itr->page)
-        file_put_page(itr->file, itr->pageid, itr->page);
+        sort_put_page(ctx, itr->pageid, itr->page);
+}
+
+/**
+ * Determines whether the current record of one run precedes that of another.
+ * Exhausted runs follow all others, and ties are broken by the run index, to
+ * keep the merge stable.
+ */
+static inline int merge_less(merge_tree_t* mt, u32 run1, u32 run2)
+{
+    int cmp;
+
+    if (!mt->haverec[run1])
+        return 0;
+
+    if (!mt->haverec[run2])
+        return 1;
+
+    cmp = comp_records(&mt->recs[run1], &mt->recs[run2]);
+    return (cmp < 0) || ((cmp == 0) && (run1 < run2));
+}
+
+/**
+ * Plays the matches of a sub-tree, storing the losers in the internal nodes.
+ * The tree has nruns leaves, where leaf i is node nruns + i.
+ * @return The winning run
+ */
+static u32 merge_tree_build(merge_tree_t* mt, u32 node)
+{
+    u32 winner1;
+    u32 winner2;
+
+    if (node >= mt->nruns)
+        return node - mt->nruns;
+
+    winner1 = merge_tree_build(mt, node << 1);
+    winner2 = merge_tree_build(mt, (node << 1) + 1);
+    if (merge_less(mt, winner2, winner1)) {
+        mt->tree[node] = winner1;
+        return winner2;
+    }
+
+    mt->tree[node] = winner2;
+    return winner1;
 }
 
-static int merge_runs(file_t* file, run_info_t* run1, run_info_t* run2,
+/**
+ * Replays the matches on the path from a leaf to the root, after the current
+ * record of its run has changed.
+ */
+static inline void merge_tree_replay(merge_tree_t* mt, u32 run)
+{
+    u32 node;
+    u32 temp;
+
+    for (node = (run + mt->nruns) >> 1; node > 0; node >>= 1) {
+        if (merge_less(mt, mt->tree[node], run)) {
+            temp = mt->tree[node];
+            mt->tree[node] = run;
+            run = temp;
+        }
+    }
+
+    mt->tree[0] = run;
+}
+
+static int merge_runs(sort_ctx_t* ctx, run_info_t* runs, u32 nruns,
                       run_info_t* outrun)
 {
-    run_itr_t itr1;
-    run_itr_t itr2;
-    record_t rec1;
-    record_t rec2;
-    int needrec1 = 1;
-    int needrec2 = 1;
-    int haverec1 = 0;
-    int haverec2 = 0;
+    merge_tree_t mt;
     page_hdr_t* outpage = NULL;
     page_id_t outpageid;
     record_t* outrec;
+    u32 i;
+    u32 winner;
     int result = -1;
 
-    DPRINT("merge_runs: {%u,%u} with {%u,%u}\n", run1->head, run1->size,
-           run2->head, run2->size);
-    
-    /* Initialize the run iterators. */
-    itr1.page = NULL;
-    itr2.page = NULL;
-    if ((run_itr_init(file, run1, &itr1) < 0)
-        || (run_itr_init(file, run2, &itr2) < 0)) {
+    DPRINT("merge_runs: %u runs from {%u,%u}\n", nruns, runs[0].head,
+           runs[0].size);
+
+    /* A single run is already merged. */
+    if (nruns == 1) {
+        *outrun = runs[0];
+        return 0;
+    }
+
+    /* Allocate the merge tree. */
+    mt.nruns = nruns;
+    mt.itrs = (run_itr_t*)calloc(nruns, sizeof(run_itr_t));
+    mt.recs = (record_t*)calloc(nruns, sizeof(record_t));
+    mt.haverec = (int*)calloc(nruns, sizeof(int));
+    mt.tree = (u32*)calloc(nruns, sizeof(u32));
+    if ((mt.itrs == NULL) || (mt.recs == NULL) || (mt.haverec == NULL)
+        || (mt.tree == NULL)) {
+        fprintf(stderr, "merge_runs: failed to allocate the merge tree\n");
         goto done;
     }
-    
+
+    /* Initialize the run iterators with the first record of each run. */
+    for (i = 0; i < nruns; i++) {
+        if (run_itr_init(ctx, &runs[i], &mt.itrs[i]) < 0)
+            goto done;
+
+        mt.haverec[i] = run_itr_next(ctx, &mt.itrs[i], &mt.recs[i]);
+        if (mt.haverec[i] < 0)
+            goto done;
+    }
+
+    mt.tree[0] = merge_tree_build(&mt, 1);
+
     /* Get an initial output page. */
-    outpage = file_get_new_page(file, &outpageid);
+    outpage = sort_get_new_page(ctx, &outpageid);
     if (outpage == NULL)
         goto done;
 
     outrun->head = outpageid;
     outrun->size = 1;
-    
-    for (;;) {
-        /* Get records as required. */
-        if (needrec1) {
-            haverec1 = run_itr_next(&itr1, &rec1);
-            if (haverec1 < 0) {
-                result = -1;
-                goto done;
-            }
-
-            needrec1 = 0;
-        }
-        
-        if (needrec2) {
-            haverec2 = run_itr_next(&itr2, &rec2);
-            if (haverec2 < 0) {
-                result = -1;
-                goto done;
-            }
 
-            needrec2 = 0;
-        }
-
-        /* Determine which record to output. */
-        if (haverec1 && haverec2) {
-            /* Compare the two records. */
-            if (comp_records(&rec1, &rec2) < 0) {
-                outrec = &rec1;
-                needrec1 = 1;
-            }
-            else {
-                outrec = &rec2;
-                needrec2 = 2;
-            }
-        }
-        else if (haverec1) {
-            outrec = &rec1;
-            needrec1 = 1;
-        }
-        else if (haverec2) {
-            outrec = &rec2;
-            needrec2 = 1;
-        }
-        else {
+    for (;;) {
+        /* The winner is exhausted only when all runs are. */
+        winner = mt.tree[0];
+        if (!mt.haverec[winner]) {
             result = 0;
             goto done;
         }
 
         /* Write the selected record to the output page. */
+        outrec = &mt.recs[winner];
         result = page_add_record(outpage, outrec);
         if (result < 0)
             goto done;
@@ -204,17 +349,18 @@ static int merge_runs(file_t* file, run_info_t* run1, run_info_t* run2,
         if (result > 0) {
             page_hdr_t* newpage;
             page_id_t newpageid;
-            
+
             /* Output page is full, get a new one */
-            newpage = file_get_new_page(file, &newpageid);
+            newpage = sort_get_new_page(ctx, &newpageid);
             if (newpage == NULL) {
                 result = -1;
                 goto done;
             }
 
-            DPRINT("merge_runs: adding page to run %u->%u\n", outpageid, newpageid);
+            DPRINT("merge_runs: adding page to run %u->%u\n", outpageid,
+                   newpageid);
             outpage->next = newpageid;
-            file_put_page(file, outpageid, outpage);
+            sort_put_page(ctx, outpageid, outpage);
             outpage = newpage;
             outpageid = newpageid;
             outrun->size++;
@@ -225,139 +371,238 @@ static int merge_runs(file_t* file, run_info_t* run1, run_info_t* run2,
                 goto done;
             }
         }
+
+        /* Advance the winning run. */
+        mt.haverec[winner] = run_itr_next(ctx, &mt.itrs[winner],
+                                          &mt.recs[winner]);
+        if (mt.haverec[winner] < 0) {
+            result = -1;
+            goto done;
+        }
+
+        merge_tree_replay(&mt, winner);
     }
 
 done:
-    run_itr_finish(&itr1);
-    run_itr_finish(&itr2);
+    if (mt.itrs != NULL) {
+        for (i = 0; i < nruns; i++)
+            run_itr_finish(ctx, &mt.itrs[i]);
+    }
     if (outpage)
-        file_put_page(file, outpageid, outpage);
+        sort_put_page(ctx, outpageid, outpage);
+
+    free(mt.itrs);
+    free(mt.recs);
+    free(mt.haverec);
+    free(mt.tree);
 
     DPRINT("merge_runs: finished with result=%d\n", result);
     return result;
 }
 
-static inline int ilog2(uint number)
+/**
+ * Sorts the records of each page in a list of single-page runs.
+ */
+static int sort_pages(sort_ctx_t* ctx, run_info_t* runs, u32 nruns)
+{
+    page_hdr_t* page;
+    u32 i;
+
+    for (i = 0; i < nruns; i++) {
+        page = sort_get_page(ctx, runs[i].head);
+        if (page == NULL)
+            return -1;
+
+        page_sort(page);
+        sort_put_page(ctx, runs[i].head, page);
+    }
+
+    return 0;
+}
+
+/**
+ * Thread function: takes groups of runs off the context and merges each into
+ * a single run, until there are no more groups or an error has occurred.
+ */
+static void merge_worker(void* arg)
 {
-    int i;
+    sort_ctx_t* ctx = (sort_ctx_t*)arg;
+    u32 group;
+    u32 first;
+    u32 nruns;
 
-    for (i = -1; number > 0; number >>= 1, i++)
-        ;
+    for (;;) {
+        /* Get the next group. */
+        os_lock(&ctx->lock);
+        if ((ctx->result < 0) || (ctx->nextgroup == ctx->ngroups)) {
+            os_unlock(&ctx->lock);
+            return;
+        }
 
-    return i;
+        group = ctx->nextgroup++;
+        os_unlock(&ctx->lock);
+
+        first = group * ctx->groupsize;
+        nruns = ctx->nruns - first;
+        if (nruns > ctx->groupsize)
+            nruns = ctx->groupsize;
+
+        if ((ctx->sortpages && (sort_pages(ctx, &ctx->runs[first], nruns) < 0))
+            || (merge_runs(ctx, &ctx->runs[first], nruns,
+                           &ctx->outruns[group]) < 0)) {
+            os_lock(&ctx->lock);
+            ctx->result = -1;
+            os_unlock(&ctx->lock);
+            return;
+        }
+    }
+}
+
+/**
+ * Merges the runs of the context in groups of the given size, replacing them
+ * with the merged runs.
+ */
+static int merge_pass(sort_ctx_t* ctx, u32 groupsize, u32 nthreads)
+{
+    run_info_t* temp;
+
+    ctx->groupsize = groupsize;
+    ctx->ngroups = (ctx->nruns + groupsize - 1) / groupsize;
+    ctx->nextgroup = 0;
+    if (nthreads > ctx->ngroups)
+        nthreads = ctx->ngroups;
+
+    DPRINT("merge_pass: %u runs in groups of %u on %u threads\n", ctx->nruns,
+           groupsize, nthreads);
+    os_run_threads(nthreads, merge_worker, ctx);
+    if (ctx->result < 0)
+        return -1;
+
+    /* The merged runs are the input of the next pass. */
+    temp = ctx->runs;
+    ctx->runs = ctx->outruns;
+    ctx->outruns = temp;
+    ctx->nruns = ctx->ngroups;
+    ctx->sortpages = 0;
+    return 0;
 }
 
 int file_sort(file_t* file, progress_func_t progfunc)
 {
-    run_info_t* runqueue;
-    uint itrnum;
-    uint curitr;
-    uint rqnum;
-    uint rqtail;
-    page_id_t runsize;
+    sort_ctx_t ctx;
     page_hdr_t* page;
     page_id_t pageid;
-    page_hdr_t* nextpage;
-    page_id_t nextpageid;
+    u32 npages;
+    u32 nthreads;
+    u32 mempages;
+    u32 fanin;
+    u32 runpages;
+    u32 mergethreads;
+    u32 npasses;
+    u32 curpass;
+    u32 n;
     int result = -1;
 
     /* Do nothing for an empty file. */
-    if (file->header->npages == 0)
+    npages = file->header->npages;
+    if (npages == 0)
         return 0;
 
-    /* Estimate the number of iterations as ceil(log2(npages)). */
-    itrnum = (uint)(ilog2(file->header->npages - 1) + 1);
-    
+    /* Determine the sort parameters. */
+    nthreads = sort_nthreads ? sort_nthreads : os_get_cpu_count();
+#if !defined(HAVE_QSORT_R) && !defined(HAVE_QSORT_S)
+    /* page_sort() is not reentrant without qsort_r() */
+    nthreads = 1;
+#endif
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+
+    mempages = (u32)(((unsigned long long)(sort_memsize ? sort_memsize
+                                           : DEFAULT_MEMSIZE) << 20)
+                     / PAGE_SIZE);
+    if (mempages < 3)
+        mempages = 3;
+
+    fanin = sort_fanin ? sort_fanin : mempages - 1;
+    if (fanin < 2)
+        fanin = 2;
+
     /*
-     * Allocate the run queue with enough slots for half the number of pages in
-     * the file (as the first iteration generates these many runs).
+     * Each run generation thread maps its group's pages and an output page.
+     * Groups are made small enough for all threads to get one.
      */
-    runqueue = (run_info_t*)malloc(sizeof(run_info_t)
-                                   * ((file->header->npages + 1) << 1));
-    rqnum = 0;
-    
-    /* First iteration: page-sort and merge for single-page runs. */
-    DPRINT("file_sort: run size=1\n");
+    runpages = mempages / nthreads;
+    runpages = (runpages > 2) ? runpages - 1 : 1;
+    n = (npages + nthreads - 1) / nthreads;
+    if (runpages > n)
+        runpages = n;
+    if (runpages > fanin)
+        runpages = fanin;
+
+    /* Merge passes run in parallel as long as the memory budget allows. */
+    mergethreads = mempages / (fanin + 1);
+    if (mergethreads > nthreads)
+        mergethreads = nthreads;
+    if (mergethreads == 0)
+        mergethreads = 1;
+
+    /* Count the passes, for progress reports. */
+    n = (npages + runpages - 1) / runpages;
+    for (npasses = 1; n > 1; npasses++)
+        n = (n + fanin - 1) / fanin;
+
+    DPRINT("file_sort: %u pages, %u threads, %u pages per run, fan-in %u\n",
+           npages, nthreads, runpages, fanin);
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.file = file;
+    if (os_lock_init(&ctx.lock) < 0)
+        return -1;
+
+    ctx.runs = (run_info_t*)malloc(sizeof(run_info_t) * npages);
+    ctx.outruns = (run_info_t*)malloc(sizeof(run_info_t) * npages);
+    if ((ctx.runs == NULL) || (ctx.outruns == NULL)) {
+        fprintf(stderr, "file_sort: failed to allocate the run queue\n");
+        goto done;
+    }
+
+    /* Each page starts as a run of its own. */
     pageid = file->header->head;
-    while (pageid != 0) {
-        run_info_t run1;
-        run_info_t run2;
-        
-        /* Get and sort the first page of two consecutive ones. */
+    while ((pageid != 0) && (ctx.nruns < npages)) {
         page = file_get_page(file, pageid);
         if (page == NULL)
             goto done;
-        
-        page_sort(page);
-        
-        /* Check if the next page exists. */
-        nextpageid = page->next;
-        file_put_page(file, pageid, page);
-        if (nextpageid == 0) {
-            runqueue[rqnum].head = pageid;
-            runqueue[rqnum].size = 1;
-            rqnum++;
-            break;
-        }
-
-        /* Get and sort the next page. */
-        nextpage = file_get_page(file, nextpageid);
-        if (nextpage == NULL)
-            goto done;
-
-        page_sort(nextpage);
-
-        /* Prepare the run information. */
-        run1.head = pageid;
-        run1.size = 1;
-        run2.head = nextpageid;
-        run2.size = 1;
-        
-        /* Get the next page ID. */
-        pageid = nextpage->next;
-        file_put_page(file, nextpageid, nextpage);
-
-        /* Merge the two pages. */
-        if (merge_runs(file, &run1, &run2, &runqueue[rqnum]) < 0)
-            goto done;
 
-        rqnum++;
+        ctx.runs[ctx.nruns].head = pageid;
+        ctx.runs[ctx.nruns].size = 1;
+        ctx.nruns++;
+        pageid = page->next;
+        file_put_page(file, ctx.runs[ctx.nruns - 1].head, page);
     }
 
-    if (progfunc)
-        progfunc(1, itrnum);
-    
-    /* Perform iterations until a single run is obtained. */
-    runsize = 2;
-    curitr = 2;
-    while (runsize < file->header->npages) {
-        DPRINT("file_sort: run size=%u run queue size=%u\n", runsize, rqnum);
-        rqtail = 0;
-        /* Merge runs. */
-        while (rqnum > 1) {
-            if (merge_runs(file, &runqueue[rqtail], &runqueue[rqtail + 1],
-                           &runqueue[rqtail >> 1]) < 0) {
-                goto done;
-            }
-            rqtail += 2;
-            rqnum -= 2;
-        }
+    /* First phase: generate sorted runs. */
+    ctx.sortpages = 1;
+    if (merge_pass(&ctx, runpages, nthreads) < 0)
+        goto done;
 
-        /* Check for a left-over run. */
-        if (rqnum == 1)
-            runqueue[rqtail >> 1] = runqueue[rqtail];
+    if (progfunc)
+        progfunc(1, npasses);
 
-        rqnum = (rqtail >> 1) + rqnum;
-        runsize <<= 1;
+    /* Second phase: merge the runs. */
+    for (curpass = 2; ctx.nruns > 1; curpass++) {
+        if (merge_pass(&ctx, fanin, ctx.nruns > fanin ? mergethreads : 1) < 0)
+            goto done;
 
         if (progfunc)
-            progfunc(curitr++, itrnum);
+            progfunc(curpass, npasses);
     }
 
-    file->header->head = runqueue[0].head;
+    file->header->head = ctx.runs[0].head;
     result = 0;
-    
+
 done:
-    free(runqueue);
+    free(ctx.runs);
+    free(ctx.outruns);
+    os_lock_destroy(&ctx.lock);
     return result;
 }
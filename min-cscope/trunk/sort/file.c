@@ -22,7 +22,8 @@
 #include "internal.h"
 
 #define MIN_FILE_SIZE (16 << PAGE_SIZE_ORDER)
-#define FILE_COOKIE 0x40da892f
+#define FILE_COOKIE 0x40da8930
+#define FILE_VERSION 2
 
 u32 system_page_size = 0;
 #if defined(USE_SYSTEM_PAGE_SIZE)
@@ -80,7 +81,7 @@ file_t* file_open(const char* path, int forcenew)
     file_hdr_t* hdr = NULL;
     file_t* file;
     int result;
-    u32 size;
+    u64 size;
     
     if (system_page_size == 0) {
         if (get_system_page_size() < 0)
@@ -101,8 +102,8 @@ file_t* file_open(const char* path, int forcenew)
             goto error;
 
         if (size < MIN_FILE_SIZE) {
-            fprintf(stderr, "file_open: file with size %u is smaller than the"
-                    " minimum size (%u)\n", size, MIN_FILE_SIZE);
+            fprintf(stderr, "file_open: file with size %llu is smaller than"
+                    " the minimum size (%u)\n", size, MIN_FILE_SIZE);
             goto error;
         }
     }
@@ -121,12 +122,20 @@ file_t* file_open(const char* path, int forcenew)
                     hdr->cookie, path);
             goto error;
         }
+
+        /* Files written with 32-bit sizes are not readable. */
+        if (hdr->version != FILE_VERSION) {
+            fprintf(stderr, "Found an unsupported file version (%u) while"
+                    " opening %s", hdr->version, path);
+            goto error;
+        }
     }
     else {
         DPRINT("Creating a new file\n");
         
         /* New file. Initialize the header. */
         hdr->cookie = FILE_COOKIE;
+        hdr->version = FILE_VERSION;
         hdr->head = 0;
         hdr->tail = 0;
         hdr->free = 0;
@@ -144,8 +153,11 @@ file_t* file_open(const char* path, int forcenew)
     /* Fill the B-Tree structure. */
     file->handle = handle;
     file->header = hdr;
-    file->size = size >> PAGE_SIZE_ORDER;
-    cache_invalidate(&file->cache, 1);
+    file->size = (page_id_t)(size >> PAGE_SIZE_ORDER);
+    if (cache_init(&file->cache, cache_default_size()) < 0) {
+        free(file);
+        goto error;
+    }
     memset(&file->stats, 0, sizeof(stats_t));
     
     DPRINT("file_open successful\n");
@@ -173,7 +185,7 @@ int file_insert(file_t* file, const char* data, u32 len)
     int result;
 
     /* Validate the data length. */
-    if (len >= 0xff) {
+    if (len > MAX_RECORD_SIZE) {
         fprintf(stderr, "file_insert: data is too long (%u)\n", len);
         return -1;
     }
@@ -181,7 +193,7 @@ int file_insert(file_t* file, const char* data, u32 len)
     DPRINT("file_insert: adding data=%s len=%d\n", data, len);
     
     rec.data = (char*)data;
-    rec.len = (u8)len;
+    rec.len = (u16)len;
     
     /* Check for an available tail page. */
     if (file->header->tail == 0) {
@@ -286,7 +298,7 @@ page_hdr_t* file_get_new_page(file_t* file, page_id_t* pageidp)
 {
     page_id_t id;
     page_hdr_t* page;
-    u32 size;
+    u64 size;
 
     /* Use a free page, if available. */
     if (file->header->free != 0) {
@@ -303,11 +315,11 @@ page_hdr_t* file_get_new_page(file_t* file, page_id_t* pageidp)
     id = file->header->npages + 1;
     if (id == file->size) {
         /* Double the size of the file. */
-        size = file->size << (PAGE_SIZE_ORDER + 1);
+        size = (u64)file->size << (PAGE_SIZE_ORDER + 1);
         if (os_set_file_size(file->handle, size, &size) < 0)
             return NULL;
 
-        file->size = size >> PAGE_SIZE_ORDER;
+        file->size = (page_id_t)(size >> PAGE_SIZE_ORDER);
     }
 
     page = file_get_page(file, id);
@@ -342,19 +354,43 @@ void file_free_page(file_t* file, page_id_t pageid, page_hdr_t* page)
     file_put_page(file, pageid, page);
 }
 
+/**
+ * Hints that a page is read sequentially, and that the page following it in
+ * its list will be read next.
+ */
+void file_advise_sequential(file_t* file, page_hdr_t* page)
+{
+    os_advise_page(file->handle, 0, page, OS_ADVISE_SEQUENTIAL);
+    if (page->next != 0)
+        os_advise_page(file->handle, page->next, NULL, OS_ADVISE_WILLNEED);
+}
+
+void file_get_stats(file_t* file, file_stats_t* stats)
+{
+    stats->cache_entries = file->cache.nentries;
+    stats->cache_hits = file->cache.hits;
+    stats->cache_misses = file->cache.misses;
+    stats->cache_evictions = file->cache.evictions;
+    stats->uncached = file->stats.ncmapped;
+    stats->mapped = file->stats.mapped;
+    stats->unmapped = file->stats.unmapped;
+}
+
 void file_dump_info(file_t* file)
 {
     fprintf(stderr, "=== File Information ===\n");
     fprintf(stderr, "Total pages:             %u\n", file->size);
     fprintf(stderr, "Used pages:              %u\n", file->header->npages);
-    fprintf(stderr, "Records:                 %u\n", file->header->nrecs);
+    fprintf(stderr, "Records:                 %llu\n", file->header->nrecs);
     fprintf(stderr, "First page:              %u\n", file->header->head);
     fprintf(stderr, "=== File Statistics ===\n");
     fprintf(stderr, "Mapped pages:            %u\n", file->stats.mapped);
     fprintf(stderr, "Unmapped pages:          %u\n", file->stats.unmapped);
     fprintf(stderr, "Non-cached mapped pages: %u\n", file->stats.ncmapped);
+    fprintf(stderr, "Cache entries:           %u\n", file->cache.nentries);
     fprintf(stderr, "Cache hits:              %u\n", file->cache.hits);
     fprintf(stderr, "Cache misses:            %u\n", file->cache.misses);
+    fprintf(stderr, "Cache evictions:         %u\n", file->cache.evictions);
 }
 
 void file_close(file_t* file)
@@ -363,7 +399,7 @@ void file_close(file_t* file)
     cache_entry_t* entry;
     
     /* Unmap cached pages. */
-    for (i = 0; i < CACHE_SIZE; i++) {
+    for (i = 0; i < file->cache.nentries; i++) {
         entry = &file->cache.entries[i];
         if (entry->ptr != NULL) {
             if (entry->ref > 0) {
@@ -382,6 +418,8 @@ void file_close(file_t* file)
     file_dump_info(file);
 #endif /* !defined(NSTATS) */
 
+    cache_destroy(&file->cache);
+
     /* Unmap the header page. */
     os_put_page(file->handle, file->header);
 
@@ -393,6 +431,11 @@ void file_close(file_t* file)
     free(file);
 }
 
+int file_delete(const char* path)
+{
+    return os_delete_file(path);
+}
+
 file_itr_t* file_itr_init(file_t* file)
 {
     file_itr_t* itr;
@@ -403,7 +446,16 @@ file_itr_t* file_itr_init(file_t* file)
         fprintf(stderr, "file_itr_init: failed to allocate iterator object\n");
         return NULL;
     }
-    
+
+    /* An empty file has no first page, so the iterator starts finished. */
+    if (file->header->npages == 0) {
+        itr->file = file;
+        itr->page = NULL;
+        itr->pageid = 0;
+        itr->recid = 0;
+        return itr;
+    }
+
     /* Get the first page. */
     itr->page = file_get_page(file, file->header->head);
     if (itr->page == NULL) {
@@ -411,6 +463,8 @@ file_itr_t* file_itr_init(file_t* file)
         return NULL;
     }
     
+    file_advise_sequential(file, itr->page);
+
     /* Initialize the rest of the structure. */
     itr->file = file;
     itr->pageid = file->header->head;
@@ -444,6 +498,7 @@ int file_itr_next(file_itr_t* itr, char** datap, u32* lenp)
 
         itr->pageid = nextid;
         itr->recid = 0;
+        file_advise_sequential(itr->file, itr->page);
     }
 
     *datap = rec.data;
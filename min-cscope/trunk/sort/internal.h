@@ -19,20 +19,23 @@
 #define __INTERNAL_H__
 
 #include "config.h"
+#include "stats.h"
 
 /* Basic integral types. */ 
 typedef unsigned int uint;
 typedef unsigned int u32;
 typedef unsigned short u16;
 typedef unsigned char u8;
+typedef unsigned long long u64;
 
 #if defined(PAGE_SIZE_ORDER)
 #define PAGE_SIZE (1 << PAGE_SIZE_ORDER)
-#define PAGE_OFFSET(page) (page << PAGE_SIZE_ORDER)
+#define PAGE_OFFSET(page) ((u64)(page) << PAGE_SIZE_ORDER)
 /*
  * Page size rules:
  * 4K-64K - 2 byte record ID/offset, 256 byte maximum record size
  * 128K-64M - 4 byte record ID/offset, 1024 byte maximum record size
+ * Record lengths are stored in one byte if smaller than 128, two otherwise.
  * <4K or >64M - Not supported
  */
 #if PAGE_SIZE_ORDER > 26
@@ -51,7 +54,7 @@ typedef u16 rec_id_t;
 #define USE_SYSTEM_PAGE_SIZE
 #define PAGE_SIZE system_page_size
 #define PAGE_SIZE_ORDER system_page_size_order
-#define PAGE_OFFSET(page) (page << system_page_size_order)
+#define PAGE_OFFSET(page) ((u64)(page) << system_page_size_order)
 typedef u32 rec_id_t;
 #define MAX_RECORD_SIZE 256
 #endif // defined(PAGE_SIZE_ORDER)
@@ -59,7 +62,7 @@ typedef u32 rec_id_t;
 /*
  * Each record takes at least 8 bytes in a page:
  * 4 bytes data
- * 1 byte key length
+ * 1 byte (at least) key length
  * 1 byte (at least) key
  * 2 bytes (at least) header
  * The page header accounts for at least one extra record 
@@ -83,23 +86,44 @@ extern u32 system_page_size_order;
 #define DASSERT(x)
 #endif /* !defined(NDEBUG) */
 
-#define CACHE_SIZE_ORDER 6
-#define CACHE_SIZE       (1 << CACHE_SIZE_ORDER)
+/* Number of entries in a cache set (a power of 2). */
+#define CACHE_WAYS     8
+/* Minimal number of cache entries. */
+#define CACHE_MIN_SIZE (CACHE_WAYS * 2)
 
 typedef struct
 {
     page_id_t pageid;
     void*     ptr;
     u32       ref;
+    /** Reference bit for the clock algorithm. */
+    u32       used;
 } cache_entry_t;
 
 typedef struct
 {
-    cache_entry_t entries[CACHE_SIZE];
-    u32           hits;
-    u32           misses;
+    /** nsets * CACHE_WAYS entries, set by set. */
+    cache_entry_t* entries;
+    /** Clock hand of each set. */
+    u8*            hands;
+    u32            nsets;
+    u32            nentries;
+    u32            hits;
+    u32            misses;
+    /** Pages replaced by other pages. */
+    u32            evictions;
+    /** Pages that could not be placed in the cache. */
+    u32            failures;
 } cache_t;
 
+typedef enum
+{
+    /** The page is read sequentially. */
+    OS_ADVISE_SEQUENTIAL,
+    /** The page will be read soon. */
+    OS_ADVISE_WILLNEED
+} os_advice_t;
+
 #if defined(WIN32)
 #include <windows.h>
 typedef struct
@@ -113,6 +137,15 @@ typedef int file_handle_t;
 #define INVALID_FILE_HANDLE -1
 #endif /* defined(WIN32) */
 
+#if defined(WIN32)
+typedef CRITICAL_SECTION os_lock_t;
+#else
+#include <pthread.h>
+typedef pthread_mutex_t os_lock_t;
+#endif /* defined(WIN32) */
+
+typedef void (*os_thread_func_t)(void*);
+
 typedef struct
 {
     page_id_t next;
@@ -123,13 +156,15 @@ typedef struct
 
 typedef struct
 {
-    u8    len;
+    u16   len;
     char* data;
 } record_t;
 
 typedef struct
 {
     u32 cookie;
+    /** Version of the file layout. */
+    u32 version;
     /** First used page. */
     page_id_t head;
     /** Last used page. */
@@ -139,7 +174,7 @@ typedef struct
     /** Total number of used pages in the file. */
     page_id_t npages;
     /** Total number of records in the B-Tree. */
-    u32 nrecs;
+    u64 nrecs;
 } file_hdr_t;
 
 typedef struct
@@ -153,7 +188,8 @@ typedef struct
 {
     file_handle_t handle;
     file_hdr_t*   header;
-    u32           size;
+    /** Size of the file, in pages. */
+    page_id_t     size;
     cache_t       cache;
     stats_t       stats;
 } file_t;
@@ -161,8 +197,8 @@ typedef struct
 typedef void (*progress_func_t)(unsigned int, unsigned int);
 
 int os_open_file(const char* path, file_handle_t* handlep);
-int os_get_file_size(file_handle_t handle, u32* sizep);
-int os_set_file_size(file_handle_t handle, u32 newsize, u32* sizep);
+int os_get_file_size(file_handle_t handle, u64* sizep);
+int os_set_file_size(file_handle_t handle, u64 newsize, u64* sizep);
 void os_close_file(file_handle_t handle);
 int os_delete_file(const char* path);
 void* os_get_page(file_handle_t handle, page_id_t pageid);
@@ -170,6 +206,15 @@ int os_put_page(file_handle_t handle, void* ptr);
 void* os_get_anon_page();
 int os_put_anon_page(void*);
 u32 os_get_page_size();
+u64 os_get_memory_size();
+void os_advise_page(file_handle_t handle, page_id_t pageid, void* ptr,
+                    os_advice_t advice);
+u32 os_get_cpu_count();
+int os_lock_init(os_lock_t* lock);
+void os_lock(os_lock_t* lock);
+void os_unlock(os_lock_t* lock);
+void os_lock_destroy(os_lock_t* lock);
+u32 os_run_threads(u32 nthreads, os_thread_func_t func, void* arg);
 
 int page_add_record(page_hdr_t* page, record_t* rec);
 void page_sort(page_hdr_t* page);
@@ -179,6 +224,9 @@ void page_dump(file_handle_t handle, page_id_t pageid);
 void page_dump_header(page_hdr_t* page);
 void page_dump_records(page_hdr_t* page, rec_id_t nrecs);
 
+u32 cache_default_size();
+int cache_init(cache_t* cache, u32 nentries);
+void cache_destroy(cache_t* cache);
 void* cache_get_page(cache_t* cache, page_id_t pageid);
 int cache_dec_ref(cache_t* cache, page_id_t pageid);
 int cache_replace(cache_t* cache, page_id_t pageid, void* ptr, page_id_t* oldid,
@@ -190,10 +238,52 @@ page_hdr_t* file_get_page(file_t* file, page_id_t pageid);
 page_hdr_t* file_get_new_page(file_t* file, page_id_t* pageidp);
 void file_put_page(file_t* file, page_id_t pageid, page_hdr_t* page);
 void file_free_page(file_t* file, page_id_t pageid, page_hdr_t* page);
+void file_advise_sequential(file_t* file, page_hdr_t* page);
 
 static inline rec_off_t* get_rec_header(page_hdr_t* page, rec_id_t id)
 {
     return (rec_off_t*)((char*)page + PAGE_SIZE) - id - 1;
 }
 
+/**
+ * @return The number of bytes used to store a record length
+ */
+static inline u32 rec_len_size(u32 len)
+{
+    return (len < 0x80) ? 1 : 2;
+}
+
+/**
+ * Stores a record length at the given position.
+ * @return A pointer to the record data
+ */
+static inline char* rec_put_len(char* ptr, u32 len)
+{
+    if (len < 0x80) {
+        *ptr = (char)len;
+        return ptr + 1;
+    }
+
+    ptr[0] = (char)(0x80 | (len >> 8));
+    ptr[1] = (char)(len & 0xff);
+    return ptr + 2;
+}
+
+/**
+ * Reads a record length from the given position.
+ * @return A pointer to the record data
+ */
+static inline char* rec_get_len(char* ptr, u32* lenp)
+{
+    u8 b = (u8)ptr[0];
+
+    if (b < 0x80) {
+        *lenp = b;
+        return ptr + 1;
+    }
+
+    *lenp = ((u32)(b & 0x7f) << 8) | (u8)ptr[1];
+    return ptr + 2;
+}
+
 #endif /* __INTERNAL_H__ */
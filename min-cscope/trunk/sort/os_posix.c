@@ -16,6 +16,7 @@
  ******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -52,7 +53,7 @@ int os_open_file(const char* path, file_handle_t* handlep)
     return result;
 }
 
-int os_get_file_size(file_handle_t handle, u32* sizep)
+int os_get_file_size(file_handle_t handle, u64* sizep)
 {
     struct stat st;
 
@@ -61,13 +62,13 @@ int os_get_file_size(file_handle_t handle, u32* sizep)
         return -1;
     }
 
-    *sizep = st.st_size;
+    *sizep = (u64)st.st_size;
     return 0;
 }
 
-int os_set_file_size(file_handle_t handle, u32 newsize, u32* sizep)
+int os_set_file_size(file_handle_t handle, u64 newsize, u64* sizep)
 {
-    if (ftruncate(handle, newsize) < 0) {
+    if (ftruncate(handle, (off_t)newsize) < 0) {
         perror("ftruncate");
         return -1;
     }
@@ -97,7 +98,7 @@ void* os_get_page(file_handle_t handle, page_id_t pageid)
     void* result;
 
     result = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, handle,
-                  PAGE_OFFSET(pageid));
+                  (off_t)PAGE_OFFSET(pageid));
     if (result == MAP_FAILED) {
         perror("mmap");
         return NULL;
@@ -145,3 +146,133 @@ u32 os_get_page_size()
 {
     return (u32)sysconf(_SC_PAGESIZE);
 }
+
+u64 os_get_memory_size()
+{
+    long pages;
+    long pagesize;
+
+    pages = sysconf(_SC_PHYS_PAGES);
+    pagesize = sysconf(_SC_PAGESIZE);
+    if ((pages < 1) || (pagesize < 1))
+        return 0;
+
+    return (u64)pages * (u64)pagesize;
+}
+
+/**
+ * Passes an access pattern hint to the kernel.
+ * @param  handle  The file
+ * @param  pageid  The page, for hints on pages that are not mapped
+ * @param  ptr     The mapped page, for hints on mapped pages
+ * @param  advice  The hint
+ */
+void os_advise_page(file_handle_t handle, page_id_t pageid, void* ptr,
+                    os_advice_t advice)
+{
+    switch (advice) {
+    case OS_ADVISE_SEQUENTIAL:
+#if defined(HAVE_MADVISE)
+        (void)madvise(ptr, PAGE_SIZE, MADV_SEQUENTIAL);
+#endif
+        break;
+
+    case OS_ADVISE_WILLNEED:
+#if defined(HAVE_POSIX_FADVISE)
+        (void)posix_fadvise(handle, (off_t)PAGE_OFFSET(pageid),
+                            PAGE_SIZE, POSIX_FADV_WILLNEED);
+#endif
+        break;
+    }
+
+    (void)handle;
+    (void)pageid;
+    (void)ptr;
+}
+
+u32 os_get_cpu_count()
+{
+    long count;
+
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1)
+        return 1;
+
+    return (u32)count;
+}
+
+int os_lock_init(os_lock_t* lock)
+{
+    if (pthread_mutex_init(lock, NULL) != 0) {
+        perror("pthread_mutex_init");
+        return -1;
+    }
+
+    return 0;
+}
+
+void os_lock(os_lock_t* lock)
+{
+    pthread_mutex_lock(lock);
+}
+
+void os_unlock(os_lock_t* lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+void os_lock_destroy(os_lock_t* lock)
+{
+    pthread_mutex_destroy(lock);
+}
+
+typedef struct
+{
+    os_thread_func_t func;
+    void*            arg;
+} thread_start_t;
+
+static void* thread_start(void* arg)
+{
+    thread_start_t* start = (thread_start_t*)arg;
+
+    start->func(start->arg);
+    return NULL;
+}
+
+/**
+ * Runs a function on the calling thread and on nthreads - 1 additional
+ * threads, and waits for all of them to return.
+ * @return The number of threads that ran the function
+ */
+u32 os_run_threads(u32 nthreads, os_thread_func_t func, void* arg)
+{
+    pthread_t* threads;
+    thread_start_t start;
+    u32 i;
+    u32 n = 0;
+
+    threads = NULL;
+    if (nthreads > 1)
+        threads = (pthread_t*)malloc(sizeof(pthread_t) * (nthreads - 1));
+
+    /* Threads that cannot be created are simply not used. */
+    start.func = func;
+    start.arg = arg;
+    if (threads != NULL) {
+        for (i = 0; i < nthreads - 1; i++) {
+            if (pthread_create(&threads[n], NULL, thread_start, &start) != 0)
+                break;
+
+            n++;
+        }
+    }
+
+    func(arg);
+
+    for (i = 0; i < n; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    return n + 1;
+}
@@ -43,7 +43,7 @@ int os_open_file(const char* path, file_handle_t* handlep)
 {
     file_handle_t handle;
     int result = 0;
-    u32 size;
+    u64 size;
 
     handle = (file_handle_t)LocalAlloc(LMEM_FIXED, sizeof(*handle));
     if (handle == NULL) {
@@ -71,8 +71,9 @@ int os_open_file(const char* path, file_handle_t* handlep)
     
     /* Create a mapping object. */
     if (size != 0) {
-        handle->hmap = CreateFileMapping(handle->hfile, NULL, PAGE_READWRITE, 0,
-                                         size, NULL);
+        handle->hmap = CreateFileMapping(handle->hfile, NULL, PAGE_READWRITE,
+                                         (DWORD)(size >> 32), (DWORD)size,
+                                         NULL);
         if (handle->hmap == NULL) {
             my_perror("CreateFileMapping");
             goto error;
@@ -98,7 +99,7 @@ error:
 
 extern WINBASEAPI BOOL WINAPI GetFileSizeEx(HANDLE,PLARGE_INTEGER);
 
-int os_get_file_size(file_handle_t handle, u32* sizep)
+int os_get_file_size(file_handle_t handle, u64* sizep)
 {
     LARGE_INTEGER size;
     
@@ -107,23 +108,17 @@ int os_get_file_size(file_handle_t handle, u32* sizep)
         return -1;
     }
 
-    if (size.HighPart > 1) {
-        fprintf(stderr, "os_get_file_size: file is too big (over 4GB)\n");
-        return -1;
-    }
-    
-    *sizep = size.LowPart;
+    *sizep = (u64)size.QuadPart;
     return 0;
 }
 
-int os_set_file_size(file_handle_t handle, u32 newsize, u32* sizep)
+int os_set_file_size(file_handle_t handle, u64 newsize, u64* sizep)
 {
     LARGE_INTEGER newsize64;
-    u32 size;
+    u64 size;
     
     /* Move the file pointer to the requested location. */
-    newsize64.LowPart = newsize;
-    newsize64.HighPart = 0;
+    newsize64.QuadPart = (LONGLONG)newsize;
     if (SetFilePointerEx(handle->hfile, newsize64, NULL, FILE_BEGIN)
         == INVALID_SET_FILE_POINTER) {
         my_perror("SetFilePointer");
@@ -149,8 +144,8 @@ int os_set_file_size(file_handle_t handle, u32 newsize, u32* sizep)
         return -1;
     
     /* Recreate the file mapping object. */
-    handle->hmap = CreateFileMapping(handle->hfile, NULL, PAGE_READWRITE, 0,
-                                     size, NULL);
+    handle->hmap = CreateFileMapping(handle->hfile, NULL, PAGE_READWRITE,
+                                     (DWORD)(size >> 32), (DWORD)size, NULL);
     if (handle->hmap == NULL) {
         my_perror("CreateFileMapping");
         return -1;
@@ -188,8 +183,9 @@ void* os_get_page(file_handle_t handle, page_id_t pageid)
     void* result;
 
     /* Map the page using the file mapping object. */
-    result = MapViewOfFile(handle->hmap, FILE_MAP_READ | FILE_MAP_WRITE, 0,
-                           PAGE_OFFSET(pageid), PAGE_SIZE);
+    result = MapViewOfFile(handle->hmap, FILE_MAP_READ | FILE_MAP_WRITE,
+                           (DWORD)(PAGE_OFFSET(pageid) >> 32),
+                           (DWORD)PAGE_OFFSET(pageid), PAGE_SIZE);
     if (result == NULL) {
         my_perror("MapViewOfFile");
         fprintf(stderr, "while mapping page %u with size %u\n", pageid,
@@ -252,3 +248,113 @@ u32 os_get_page_size()
     GetSystemInfo(&info);
     return info.dwAllocationGranularity;
 }
+
+u64 os_get_memory_size()
+{
+    MEMORYSTATUSEX status;
+
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status) == 0)
+        return 0;
+
+    return (u64)status.ullTotalPhys;
+}
+
+void os_advise_page(file_handle_t handle, page_id_t pageid, void* ptr,
+                    os_advice_t advice)
+{
+    /* No access pattern hints for mapped files. */
+    (void)handle;
+    (void)pageid;
+    (void)ptr;
+    (void)advice;
+}
+
+u32 os_get_cpu_count()
+{
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    if (info.dwNumberOfProcessors < 1)
+        return 1;
+
+    return (u32)info.dwNumberOfProcessors;
+}
+
+int os_lock_init(os_lock_t* lock)
+{
+    InitializeCriticalSection(lock);
+    return 0;
+}
+
+void os_lock(os_lock_t* lock)
+{
+    EnterCriticalSection(lock);
+}
+
+void os_unlock(os_lock_t* lock)
+{
+    LeaveCriticalSection(lock);
+}
+
+void os_lock_destroy(os_lock_t* lock)
+{
+    DeleteCriticalSection(lock);
+}
+
+typedef struct
+{
+    os_thread_func_t func;
+    void*            arg;
+} thread_start_t;
+
+static DWORD WINAPI thread_start(LPVOID arg)
+{
+    thread_start_t* start = (thread_start_t*)arg;
+
+    start->func(start->arg);
+    return 0;
+}
+
+/**
+ * Runs a function on the calling thread and on nthreads - 1 additional
+ * threads, and waits for all of them to return.
+ * @return The number of threads that ran the function
+ */
+u32 os_run_threads(u32 nthreads, os_thread_func_t func, void* arg)
+{
+    HANDLE* threads;
+    thread_start_t start;
+    u32 i;
+    u32 n = 0;
+
+    threads = NULL;
+    if (nthreads > 1)
+        threads = (HANDLE*)LocalAlloc(LMEM_FIXED,
+                                      sizeof(HANDLE) * (nthreads - 1));
+
+    /* Threads that cannot be created are simply not used. */
+    start.func = func;
+    start.arg = arg;
+    if (threads != NULL) {
+        for (i = 0; i < nthreads - 1; i++) {
+            threads[n] = CreateThread(NULL, 0, thread_start, &start, 0, NULL);
+            if (threads[n] == NULL)
+                break;
+
+            n++;
+        }
+    }
+
+    func(arg);
+
+    for (i = 0; i < n; i++) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+
+    if (threads != NULL)
+        LocalFree(threads);
+
+    return n + 1;
+}
@@ -32,9 +32,9 @@ int page_add_record(page_hdr_t* page, record_t* rec)
     
     /*
      * Compute the total record size:
-     * 1-byte length + length of data. 
+     * 1 or 2-byte length + length of data. 
      */
-    reclen = rec->len + 1;
+    reclen = rec_len_size(rec->len) + rec->len;
 #if defined(ALIGN_RECS)
     reclen = ((reclen + ALIGN_RECS - 1) & ~(ALIGN_RECS - 1));
 #endif
@@ -47,9 +47,8 @@ int page_add_record(page_hdr_t* page, record_t* rec)
         return 1;
 
     /* Copy the record into the page. */
-    ptr = (char*)page + page->nextoff;
-    *ptr = rec->len;
-    memcpy(ptr + 1, rec->data, rec->len);
+    ptr = rec_put_len((char*)page + page->nextoff, rec->len);
+    memcpy(ptr, rec->data, rec->len);
 
     /* Set the record header. */
     id = page->nrecs;
@@ -80,10 +79,8 @@ static int comp_recs_r(const void* offp1, const void* offp2, void* page)
     off2 = *(rec_off_t*)offp2;
     
     /* Get the records and their lengths. */
-    len1 = (u8)*((char*)page + off1);
-    data1 = (char*)page + off1 + 1;
-    len2 = (u8)*((char*)page + off2);
-    data2 = (char*)page + off2 + 1;
+    data1 = rec_get_len((char*)page + off1, &len1);
+    data2 = rec_get_len((char*)page + off2, &len2);
 
     /* Determine the shorter key for memcmp. */
     if (len1 < len2) {
@@ -132,6 +129,7 @@ int page_get_record(page_hdr_t* page, rec_id_t id, record_t* rec)
 {
     char* ptr;
     rec_off_t off;
+    u32 len;
 
     /* Make sure the record exists. */
     if (id >= page->nrecs)
@@ -141,8 +139,8 @@ int page_get_record(page_hdr_t* page, rec_id_t id, record_t* rec)
     off = *get_rec_header(page, id);
     ptr = (char*)page + off;
 
-    rec->len = (u8)*ptr;
-    rec->data = (ptr + 1);
+    rec->data = rec_get_len(ptr, &len);
+    rec->len = (u16)len;
     return 0;
 }
 
@@ -18,6 +18,8 @@
 #ifndef __SORTLIB_H__
 #define __SORTLIB_H__
 
+#include "stats.h"
+
 typedef unsigned int u32;
 typedef void* file_t;
 typedef void* file_itr_t;
@@ -26,6 +28,7 @@ typedef void (*progress_func_t)(unsigned int, unsigned int);
 file_t file_open(const char* path, int forcenew);
 int file_insert(file_t* file, const char* data, u32 len);
 int file_sort(file_t file, progress_func_t func);
+void file_sort_params(u32 nthreads, u32 fanin, u32 memsize);
 void file_close(file_t btree);
 
 file_itr_t file_itr_init(file_t file);
@@ -33,6 +36,7 @@ int file_itr_next(file_itr_t itr, char** datap, u32* lenp);
 void file_itr_finish(file_itr_t itr);
 
 void file_dump_info(file_t* file);
+void file_get_stats(file_t file, file_stats_t* stats);
 
 int file_delete(const char* path);
 
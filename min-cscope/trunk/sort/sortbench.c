@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * Copyright (C) 2009 Elad Lahav
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/*
+ * Sort throughput benchmark.
+ * Fills a sort file with records resembling inverted index postings (a term,
+ * a line offset and a type), sorts it, and verifies the order of the result.
+ * Usage: sortbench [-n records] [-t threads] [-f fanin] [-m memsize(MB)]
+ *                  [-l maxterm] [-s seed] [file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif /* defined(WIN32) */
+#include "sort.h"
+
+static double now()
+{
+#if defined(WIN32)
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif /* defined(WIN32) */
+}
+
+static void progress(unsigned int cur, unsigned int total)
+{
+    fprintf(stderr, "Sort pass %u/%u\n", cur, total);
+}
+
+static unsigned int make_record(char* buf, unsigned int n,
+                                unsigned int maxterm)
+{
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+    unsigned int len;
+    unsigned int i;
+
+    /* Term: skewed towards short identifiers, unless a maximum is given. */
+    if (maxterm > 2)
+        len = 2 + rand() % (maxterm - 1);
+    else
+        len = 2 + rand() % 6 + ((rand() % 4 == 0) ? rand() % 24 : 0);
+    for (i = 0; i < len; i++)
+        buf[i] = chars[rand() % (sizeof(chars) - 1)];
+
+    /* Line offset and type. */
+    len += sprintf(buf + len, " %08x%c", n * 37, "$`~=#@"[rand() % 6]);
+    buf[len++] = 0;
+    return len;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = "sortbench.file";
+    unsigned int nrecs = 1000000;
+    unsigned int nthreads = 0;
+    unsigned int fanin = 0;
+    unsigned int memsize = 0;
+    unsigned int seed = 1;
+    unsigned int maxterm = 0;
+    unsigned int i;
+    unsigned int len;
+    unsigned int plen;
+    unsigned long long bytes = 0;
+    char buf[1024];
+    char prev[1024];
+    char* data;
+    file_t file;
+    file_itr_t itr;
+    file_stats_t stats;
+    double start;
+    double sorttime;
+    int result = 1;
+    int cmp;
+
+    for (i = 1; i < (unsigned int)argc; i++) {
+        if ((argv[i][0] == '-') && (i + 1 < (unsigned int)argc)) {
+            switch (argv[i][1]) {
+            case 'n':
+                nrecs = strtoul(argv[++i], NULL, 10);
+                continue;
+            case 't':
+                nthreads = strtoul(argv[++i], NULL, 10);
+                continue;
+            case 'f':
+                fanin = strtoul(argv[++i], NULL, 10);
+                continue;
+            case 'm':
+                memsize = strtoul(argv[++i], NULL, 10);
+                continue;
+            case 'l':
+                maxterm = strtoul(argv[++i], NULL, 10);
+                if (maxterm > 1000)
+                    maxterm = 1000;
+                continue;
+            case 's':
+                seed = strtoul(argv[++i], NULL, 10);
+                continue;
+            }
+        }
+        path = argv[i];
+    }
+
+    fprintf(stderr, "%s\n", sortlib_info());
+    if ((file = file_open(path, 1)) == NULL) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+
+    /* Fill the file. */
+    srand(seed);
+    start = now();
+    for (i = 0; i < nrecs; i++) {
+        len = make_record(buf, i, maxterm);
+        if (file_insert(file, buf, len) < 0) {
+            fprintf(stderr, "file_insert failed on record %u\n", i);
+            goto done;
+        }
+        bytes += len;
+    }
+    fprintf(stderr, "Inserted %u records (%llu bytes) in %.3fs\n", nrecs,
+            bytes, now() - start);
+
+    /* Sort. */
+    file_sort_params(nthreads, fanin, memsize);
+    start = now();
+    if (file_sort(file, progress) < 0) {
+        fprintf(stderr, "file_sort failed\n");
+        goto done;
+    }
+    sorttime = now() - start;
+
+    /* Verify. */
+    if ((itr = file_itr_init(file)) == NULL) {
+        fprintf(stderr, "file_itr_init failed\n");
+        goto done;
+    }
+
+    plen = 0;
+    for (i = 0; (cmp = file_itr_next(itr, &data, &len)) == 0; i++) {
+        if (i > 0) {
+            cmp = memcmp(prev, data, (plen < len) ? plen : len);
+            if ((cmp > 0) || ((cmp == 0) && (plen > len))) {
+                fprintf(stderr, "Record %u is out of order\n", i);
+                break;
+            }
+        }
+        memcpy(prev, data, len);
+        plen = len;
+    }
+    file_itr_finish(itr);
+
+    if (i != nrecs) {
+        fprintf(stderr, "Found %u records, expected %u\n", i, nrecs);
+        goto done;
+    }
+
+    printf("records=%u bytes=%llu time=%.3fs records/s=%.0f MB/s=%.2f\n",
+           nrecs, bytes, sorttime, nrecs / sorttime,
+           bytes / sorttime / (1024 * 1024));
+
+    file_get_stats(file, &stats);
+    printf("cache: entries=%u hits=%u misses=%u evictions=%u uncached=%u"
+           " mapped=%u\n", stats.cache_entries, stats.cache_hits,
+           stats.cache_misses, stats.cache_evictions, stats.uncached,
+           stats.mapped);
+    result = 0;
+
+done:
+    file_close(file);
+    file_delete(path);
+    return result;
+}
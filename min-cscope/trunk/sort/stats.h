@@ -0,0 +1,38 @@
+/*******************************************************************************
+ * Copyright (C) 2009 Elad Lahav
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+/**
+ * Page mapping and cache statistics of a file (see file_get_stats()).
+ */
+typedef struct
+{
+    /** Number of entries in the page cache. */
+    unsigned int cache_entries;
+    unsigned int cache_hits;
+    unsigned int cache_misses;
+    /** Cached pages replaced by other pages. */
+    unsigned int cache_evictions;
+    /** Pages mapped outside the cache, as their cache set was in use. */
+    unsigned int uncached;
+    unsigned int mapped;
+    unsigned int unmapped;
+} file_stats_t;
+
+#endif /* __STATS_H__ */
@@ -60,14 +60,19 @@
 BOOL	buildonly = NO;		/* only build the database */
 BOOL	unconditional = NO;	/* unconditionally build database */
 BOOL	fileschanged;		/* assume some files changed */
+BOOL	listchanges = NO;	/* only list the changed files */
 
 /* variable copies of the master strings... */
 char	invname_buf[] = INVNAME;
 char	invpost_buf[] = INVPOST;
 char	reffile_buf[] = REFFILE;
+char	triname_buf[] = TRINAME;
+char	fpname_buf[] = FPNAME;
 char	*invname = invname_buf;	/* inverted index to the database */
 char	*invpost = invpost_buf;	/* inverted index postings */
 char	*reffile = reffile_buf;	/* cross-reference file path name */
+char	*triname = triname_buf;	/* trigram index of the source files */
+char	*fpname = fpname_buf;	/* content fingerprints of the source files */
 
 char	*newreffile;		/* new cross-reference file name */
 FILE	*newrefs;		/* new cross-reference */
@@ -84,23 +89,56 @@ INVCONTROL invcontrol;		/* inverted file control structure */
 /* Local variables: */
 static char *newinvname;	/* new inverted index file name */
 static char *newinvpost;	/* new inverted index postings file name */
+static char *newtriname;	/* new trigram index file name */
+static char *newfpname;		/* new fingerprint file name */
 static long traileroffset;	/* file trailer offset */
 
+/* An incremental build copies the data of the old cross-reference to the new
+ * one, leaving the data of the unchanged files where it is, blanks out the
+ * data of the changed and removed files, and adds the data of the changed and
+ * new files at the end. The old cross-reference is not written, so that it
+ * can be searched until the new one replaces it. The
+ * trailer lists where each file's data is, and how much dead data there is,
+ * so that the cross-reference can be compacted by a full build once the
+ * dead data is more than the live data.
+ */
+static struct oldsegment {	/* file data in the old cross-reference */
+    long    offset;		/* file mark offset */
+    long    length;		/* data length */
+    long    nameend;		/* offset of the newline after the name */
+    char    *file;		/* source file name */
+    BOOL    kept;		/* the data stays in the cross-reference */
+} *oldsegments;
+static unsigned long noldsegments; /* number of old segments */
+static long oldendoffset;	/* offset of the old end of file data */
+static long olddeadbytes;	/* old number of bytes of dead data */
+
 
 /* Internal prototypes: */
 static	void	cannotindex(void);
 static	int	compare(const void *s1, const void *s2);
-static	void	copydata(void);
-static	void	copyinverted(void);
-static	char	*getoldfile(void);
+static	int	compareoffsets(const void *s1, const void *s2);
+static	int	comparesegments(const void *s1, const void *s2);
+static	int	compareindexes(const void *s1, const void *s2);
+static	void	copydata(FILE *oldrefs, long len);
+static	struct oldsegment *findsegment(char *file);
+static	void	freesegments(void);
+static	BOOL	getsegments(FILE *oldrefs);
+static	void	indexsegments(void);
+static	void	keepdata(struct oldsegment *sp, char *file);
+static	int	keepposting(POSTING *p);
+static	BOOL	keptfile(char *file);
+static	long	killsegments(BOOL blank);
 static	void	movefile(char *new, char *old);
-static	void	fetch_include_from_dbase(char *, size_t);
 static	BOOL	samelist(FILE *oldrefs, char **names, int count);
+static	void	savefingerprints(void);
 
 /* Defined in crossref.c */
 int dbputc(char c);
+int dbflush(void);
 void dbputheader(char *dir, long traileroffset);
 void dbputlist(char **names, int count);
+void dbputsegments(long endoffset, long deadbytes);
 
 /* Error handling routine if inverted index creation fails */
 static void
@@ -161,6 +199,10 @@ void setup_build_filenames(char *reffile)
     newinvname = my_strdup(path);
     strcpy(s, mybasename(invpost));
     newinvpost = my_strdup(path);
+    strcpy(s, mybasename(triname));
+    newtriname = my_strdup(path);
+    strcpy(s, mybasename(fpname));
+    newfpname = my_strdup(path);
     free(path);
 }
 
@@ -173,6 +215,7 @@ opendatabase(void)
 	cannotopen(reffile);
 	myexit(1);
     }
+    dbmap();
     blocknumber = -1;	/* force next seek to read the first block */
 	
     /* open any inverted index */
@@ -188,7 +231,9 @@ opendatabase(void)
 void
 rebuild(void)
 {
+    dbunmap();
     close(symrefs);
+    symrefs = -1;
     if (invertedindex == YES) {
 	invclose(&invcontrol);
 	nsrcoffset = 0;
@@ -218,17 +263,24 @@ build(void)
     FILE    *oldrefs;		/* old cross-reference file */
     time_t  reftime;		/* old crossref modification time */
     char    *file;		/* current file */
-    char    *oldfile;		/* file in old cross-reference */
     char    newdir[PATHLEN + 1]; /* directory in new cross-reference */
     char    olddir[PATHLEN + 1]; /* directory in old cross-reference */
     char    oldname[PATHLEN + 1]; /* name in old cross-reference */
     unsigned long oldnum;	/* number in old cross-ref */
-    struct  stat statstruct;	/* file status */
+    struct  stat oldstat;	/* old cross-reference file status */
     unsigned long firstfile;	/* first source file in pass */
     unsigned long lastfile;	/* last source file in pass */
     int     built = 0;		/* built crossref for these files */
-    int     copied = 0;		/* copied crossref for these files */
+    int     kept = 0;		/* kept crossref for these files */
+    int     touched = 0;	/* kept though modified, by fingerprint */
     unsigned long fileindex;		/* source file name index */
+    struct  oldsegment *sp;	/* old data of the current file */
+    BOOL    incremental = NO;	/* update the old cross-reference */
+    INVCONTROL oldinv;		/* old inverted index */
+    BOOL    mergeindex = NO;	/* merge with the old inverted index */
+    BOOL    oldinvertedindex = NO; /* old cross-reference has an index */
+    long    endoffset;		/* end of the file data */
+    long    deadbytes = 0;	/* dead data in the cross-reference */
     BOOL    interactive = YES;	/* output progress messages */
 #if !defined(NSTATS)
     time_t  curtime, oldtime;
@@ -244,6 +296,14 @@ build(void)
     }
     /* sort the source file names (needed for rebuilding) */
     qsort(srcfiles, nsrcfiles, sizeof(char *), compare);
+    freefilestats();
+    nsegments = 0;
+    newrefs = NULL;
+
+    /* get the fingerprints of the source files in the old cross-reference */
+    if (fingerprints == YES) {
+	fingerprintload();
+    }
 
     /* if there is an old cross-reference and its current directory matches */
     /* or this is an unconditional build */
@@ -253,11 +313,10 @@ build(void)
 	&& (strcmp(olddir, currentdir) == 0 /* remain compatible */
 	    || strcmp(olddir, newdir) == 0)) {
 	/* get the cross-reference file's modification time */
-	fstat(fileno(oldrefs), &statstruct);
-	reftime = statstruct.st_mtime;
+	fstat(fileno(oldrefs), &oldstat);
+	reftime = oldstat.st_mtime;
 	if (fileversion >= 8) {
 	    BOOL	oldcompress = YES;
-	    BOOL	oldinvertedindex = NO;
 	    BOOL	oldtruncate = NO;
 	    int	c;
 
@@ -306,6 +365,10 @@ cscope: -q option mismatch between command line and old symbol database\n");
 		goto force;
 	    }
 	}
+	/* build the trigram index if it is missing */
+	if (trigramindex == YES && access(triname, READ) != 0) {
+	    goto outofdate;
+	}
 	/* if assuming that some files have changed */
 	if (fileschanged == YES) {
 	    goto outofdate;
@@ -319,16 +382,31 @@ cscope: -q option mismatch between command line and old symbol database\n");
 	    || (fileversion >= 9 && fscanf(oldrefs, "%*s") != 0)) {
 	    goto outofdate;
 	}
-	/* see if the list of source files is the same and
-	   none have been changed up to the included files */
+	/* see if the list of source files is the same up to the included
+	   files */
 	for (i = 0; i < nsrcfiles; ++i) {
 	    if ((1 != fscanf(oldrefs," %[^\n]",oldname))
-		|| strnotequal(oldname, srcfiles[i])
-		|| (lstat(srcfiles[i], &statstruct) != 0)
-		|| (statstruct.st_mtime > reftime)
-		) {
+		|| strnotequal(oldname, srcfiles[i])) {
+		goto outofdate;
+	    }
+	}
+	/* see if none of them have been changed, in their contents if
+	   there are fingerprints; the status of all the files is read at
+	   once, and used again by an update */
+	statfiles(0, nsrcfiles);
+	if (fingerprints == YES) {
+	    fingerprintscan(0, nsrcfiles);
+	}
+	for (i = 0; i < nsrcfiles; ++i) {
+	    if (filestats[i].exists == NO) {
 		goto outofdate;
 	    }
+	    if (filestats[i].mtime > reftime) {
+		if (fingerprints == NO || fingerprintsame(i) == NO) {
+		    goto outofdate;
+		}
+		++touched;
+	    }
 	}
 	/* the old cross-reference is up-to-date */
 	/* so get the list of included files */
@@ -336,30 +414,87 @@ cscope: -q option mismatch between command line and old symbol database\n");
 	    addsrcfile(oldname);
 	}
 	fclose(oldrefs);
+
+	/* record the new times of the files whose contents are the same,
+	   so that they are not read again */
+	if (fingerprints == YES) {
+	    fingerprintscan(0, nsrcfiles);
+	    if (verbosemode == YES) {
+		fprintf(stderr, "\
+cscope: %d files modified with the same contents, %lu read\n",
+			touched, fingerprintshashed());
+	    }
+	    if (fingerprintschanged() == YES) {
+		savefingerprints();
+	    }
+	    fingerprintfree();
+	}
+	freefilestats();
 	return;
 		
     outofdate:
+	/* the files kept by their fingerprints are counted again below */
+	touched = 0;
+
 	/* if the database format has changed, rebuild it all */
 	if (fileversion != FILEVERSION) {
 	    fprintf(stderr, "\
 cscope: converting to new symbol database file format\n");
 	    goto force;
 	}
+	/* the header is written over the copied one, so it must keep its
+	   length */
+	if (strcmp(olddir, newdir) != 0) {
+	    goto force;
+	}
 	/* reopen the old cross-reference file for fast scanning */
 	if ((symrefs = vpopen(reffile, O_BINARY | O_RDONLY)) == -1) {
 	    postfatal("cscope: cannot open file %s\n", reffile);
 	    /* NOTREACHED */
 	}
-	/* get the first file name in the old cross-reference */
+	dbmap();
 	blocknumber = -1;
-	read_block();	/* read the first cross-ref block */
-	scanpast('\t');	/* skip the header */
-	oldfile = getoldfile();
+	if (getsegments(oldrefs) == NO) {
+	    posterr("cscope: incorrect symbol database file format\n");
+	    goto cannotupdate;
+	}
+	/* compact the cross-reference when most of its data is dead */
+	if (olddeadbytes > oldendoffset / 2) {
+	    if (verbosemode == YES) {
+		fprintf(stderr, "cscope: compacting the symbol database\n");
+	    }
+	    goto cannotupdate;
+	}
+	/* the postings of the kept data come from the old inverted index */
+	if (invertedindex == YES) {
+	    if (oldinvertedindex == NO ||
+		invopen(&oldinv, invname, invpost, INVAVAIL) == -1) {
+		goto cannotupdate;
+	    }
+	    mergeindex = YES;
+	}
+	incremental = YES;
+	deadbytes = olddeadbytes;
     } else {	/* force cross-referencing of all the source files */
+    cannotupdate:
+	if (symrefs >= 0) {
+	    dbunmap();
+	    close(symrefs);
+	    symrefs = -1;
+	}
+	freesegments();
     force:	
 	reftime = 0;
-	oldfile = NULL;
     }
+    /* the old trigram index still has the trigrams of the files whose data
+       is kept */
+    if (trigramindex == YES && incremental == YES) {
+	trigramload();
+    } else {
+	unlink(triname);
+    }
+    /* the fingerprints are written again once the cross-reference is */
+    (void) unlink(fpname);
     /* open the new cross-reference file */
     if ((newrefs = myfopen(newreffile, "wb")) == NULL) {
 	postfatal("cscope: cannot open file %s\n", reffile);
@@ -376,23 +511,30 @@ cscope: converting to new symbol database file format\n");
 	cannotindex();
     }
 #endif /* defined(USE_SORTLIB) */
-    dbputheader(newdir, traileroffset);
+    if (incremental == YES) {
+	/* the new data is added after a copy of the old */
+	copydata(oldrefs, oldendoffset);
+	dboffset = oldendoffset;
+    } else {
+	dbputheader(newdir, traileroffset);
+
+	/* output the leading tab expected by crossref() */
+	dbputc('\t');
+    }
     fileversion = FILEVERSION;
     if (buildonly == YES && verbosemode != YES && !isatty(0)) {
 	interactive = NO;
     } else {
 	searchcount = 0;
     }
-    /* output the leading tab expected by crossref() */
-    dbputc('\t');
 
     /* make passes through the source file list until the last level of
        included files is processed */
     firstfile = 0;
     lastfile = nsrcfiles;
-    if (invertedindex == YES) {
-	srcoffset = mymalloc((nsrcfiles + 1) * sizeof(long));
-    }
+
+    /* start the parallel cross-referencing processes */
+    (void) xrefstart(buildjobs);
 
 #if !defined(NSTATS)
     curtime = time(NULL);
@@ -406,6 +548,11 @@ cscope: converting to new symbol database file format\n");
 	    refresh();
 #endif /* defined(WITH_CURSES) */
         
+	/* get the status of the files of this pass, and their fingerprints */
+	statfiles(firstfile, lastfile);
+	if (fingerprints == YES) {
+	    fingerprintscan(firstfile, lastfile);
+	}
 	/* get the next source file name */
 	for (fileindex = firstfile; fileindex < lastfile; ++fileindex) {
 			
@@ -413,69 +560,66 @@ cscope: converting to new symbol database file format\n");
 	    if (interactive == YES && fileindex % 10 == 0) {
 		progress("Building symbol database", fileindex, lastfile);
 	    }
-	    /* if the old file has been deleted get the next one */
+	    /* keep the old data of a file that has not been modified, or
+	       whose contents are the same */
 	    file = srcfiles[fileindex];
-	    while (oldfile != NULL && strcmp(file, oldfile) > 0) {
-		oldfile = getoldfile();
-	    }
-	    /* if there isn't an old database or this is a new file */
-	    if (oldfile == NULL || strcmp(file, oldfile) < 0) {
-		crossref(file);
-		++built;
-	    } else if (lstat(file, &statstruct) == 0
-		       && statstruct.st_mtime > reftime) {
-		/* if this file was modified */
-		crossref(file);
-		++built;
-				
-		/* skip its old crossref so modifying the last source
-		 * file does not cause all included files to be built.
-		 * Unfortunately a new file that is alphabetically
-		 * last will cause all included files to be build, but
-		 * this is less likely */
-		oldfile = getoldfile();
-	    } else {	
-		/* copy its cross-reference */
-		putfilename(file);
-		if (invertedindex == YES) {
-		    copyinverted();
-		} else {
-		    copydata();
+	    if ((sp = findsegment(file)) != NULL
+		&& filestats[fileindex].exists == YES
+		&& (filestats[fileindex].mtime <= reftime
+		    || (fingerprints == YES
+			&& fingerprintsame(fileindex) == YES))) {
+		if (filestats[fileindex].mtime > reftime) {
+		    ++touched;
 		}
-		++copied;
-		oldfile = getoldfile();
+		keepdata(sp, file);
+		++kept;
+	    } else {
+		xrefsubmit(file);
+		++built;
 	    }
 	}
+	/* wait for the included files found in this pass */
+	xrefflush();
+
 	/* see if any included files were found */
 	if (lastfile == nsrcfiles) {
 	    break;
 	}
 	firstfile = lastfile;
 	lastfile = nsrcfiles;
-	if (invertedindex == YES) {
-	    srcoffset = myrealloc(srcoffset,
-				  (nsrcfiles + 1) * sizeof(long));
-	}
+
 	/* sort the included file names */
 	qsort(&srcfiles[firstfile], (lastfile - firstfile), 
 	      sizeof(char *), compare);
     }
+    xrefstop();
+
     /* add a null file name to the trailing tab */
+    endoffset = dboffset;
     putfilename("");
     dbputc('\n');
 	
     /* get the file trailer offset */
     traileroffset = dboffset;
 	
-    /* output the source and include directory and file lists */
+    /* output the source and include directory and file lists, and where
+       each file's data is */
+    indexsegments();
+    if (incremental == YES) {
+	deadbytes += killsegments(NO);
+    }
     dbputlist(srcdirs, nsrcdirs);
     dbputlist(incdirs, nincdirs);
     dbputlist(srcfiles, nsrcfiles);
+    dbputsegments(endoffset, deadbytes);
     if (fflush(newrefs) == EOF) {
 	/* rewind doesn't check for write failure */
 	cannotwrite(newreffile);
 	/* NOTREACHED */
     }
+    if (incremental == YES) {
+	(void) killsegments(YES);
+    }
 
 #if !defined(NSTATS)
     oldtime = curtime;
@@ -483,18 +627,32 @@ cscope: converting to new symbol database file format\n");
     fprintf(stderr, "# Building the database took %ld:%02ld\n",
             (curtime - oldtime) / 60, (curtime - oldtime) % 60);
 #endif /* !defined(NSTATS) */
+    if (verbosemode == YES) {
+	fprintf(stderr, "cscope: %d files cross-referenced, %d kept\n",
+		built, kept);
+	if (fingerprints == YES) {
+	    fprintf(stderr, "\
+cscope: %d files modified with the same contents, %lu read\n",
+		    touched, fingerprintshashed());
+	}
+    }
     
     /* create the inverted index if requested */
     if (invertedindex == YES) {
 	if (linemode == NO || verbosemode == YES)
             postmsg("Sorting symbols...");
 #if defined(USE_SORTLIB)
+	/* -j also limits the number of sorting threads */
+	if (buildjobs > 1) {
+	    file_sort_params(buildjobs, 0, 0);
+	}
         if (file_sort(postings, sortprogress) < 0) {
 	    fprintf(stderr, "cscope: failed to sort file\n");
 	    cannotindex();
         }
 #else
 	char	sortcommand[PATHLEN + 1];
+	struct	stat statstruct;
 
 	if (fflush(postings) == EOF) {
 	    cannotwrite(temp1);
@@ -509,6 +667,18 @@ cscope: converting to new symbol database file format\n");
 	}
 #endif /* defined(USE_SORTLIB) */
         else {
+#if defined(USE_SORTLIB)
+	    if (verbosemode == YES) {
+		file_stats_t sortstats;
+
+		file_get_stats(postings, &sortstats);
+		fprintf(stderr, "cscope: sort cache: %u entries, %u hits, "
+			"%u misses, %u evictions, %u uncached\n",
+			sortstats.cache_entries, sortstats.cache_hits,
+			sortstats.cache_misses, sortstats.cache_evictions,
+			sortstats.uncached);
+	    }
+#endif /* defined(USE_SORTLIB) */
 #if !defined(NSTATS)
             oldtime = curtime;
             curtime = time(NULL);
@@ -517,7 +687,14 @@ cscope: converting to new symbol database file format\n");
 #endif /* !defined(NSTATS) */
             if (linemode == NO || verbosemode == YES)
                 postmsg("Building inverted index...");
-	    if ((totalterms = invmake(newinvname, newinvpost, postings)) > 0) {
+	    /* merge the new postings with those of the kept data */
+	    if (mergeindex == YES) {
+		totalterms = invmerge(newinvname, newinvpost, postings,
+				      &oldinv, keepposting);
+	    } else {
+		totalterms = invmake(newinvname, newinvpost, postings);
+	    }
+	    if (totalterms > 0) {
 		movefile(newinvname, invname);
 		movefile(newinvpost, invpost);
 	    } else {
@@ -531,7 +708,9 @@ cscope: converting to new symbol database file format\n");
 	}
         unlink(temp1);
 	free(srcoffset);
-
+	free(srcfileindex);
+	srcoffset = NULL;
+	srcfileindex = NULL;
 #if !defined(NSTATS)
         oldtime = curtime;
         curtime = time(NULL);
@@ -539,21 +718,147 @@ cscope: converting to new symbol database file format\n");
                 (curtime - oldtime) / 60, (curtime - oldtime) % 60);
 #endif /* !defined(NSTATS) */
     }
+    if (mergeindex == YES) {
+	invclose(&oldinv);
+    }
     /* rewrite the header with the trailer offset and final option list */
     dbflush();
     rewind(newrefs);
     dbputheader(newdir, traileroffset);
-    fclose(newrefs);
+    if (fclose(newrefs) == EOF) {
+	cannotwrite(newreffile);
+	/* NOTREACHED */
+    }
+    newrefs = NULL;
 	
     /* close the old database file */
     if (symrefs >= 0) {
+	dbunmap();
 	close(symrefs);
+	symrefs = -1;
     }
     if (oldrefs != NULL) {
 	fclose(oldrefs);
     }
+    /* create the trigram index */
+    if (trigramindex == YES) {
+	if (linemode == NO || verbosemode == YES)
+	    postmsg("Building trigram index...");
+	if (trigrammake(newtriname, keptfile) == YES) {
+	    movefile(newtriname, triname);
+	} else {
+	    posterr("cscope: cannot create trigram index %s\n", triname);
+	}
+    }
+    freesegments();
+
     /* replace it with the new database file */
     movefile(newreffile, reffile);
+    /* the fingerprints now describe the cross-reference */
+    if (fingerprints == YES) {
+	savefingerprints();
+	fingerprintfree();
+    }
+    freefilestats();
+}
+
+/* list the source files that a build would cross-reference again, without
+   building: "A" for a file new to the cross-reference, "M" for a modified
+   file, with different contents if there are fingerprints, and "D" for a
+   file that no longer exists; all the files are new if the cross-reference
+   cannot be updated */
+
+void
+listchanged(void)
+{
+    unsigned long i;
+    FILE    *oldrefs;		/* old cross-reference file */
+    time_t  reftime;		/* old crossref modification time */
+    char    oldname[PATHLEN + 1]; /* name in old cross-reference */
+    char    **oldfiles;		/* sorted names in old cross-reference */
+    unsigned long oldnum = 0;	/* number in old cross-ref */
+    unsigned long nsources;	/* number of source files given */
+    struct  stat oldstat;	/* old cross-reference file status */
+    int     c;
+
+    qsort(srcfiles, nsrcfiles, sizeof(char *), compare);
+    freefilestats();
+    if ((oldrefs = vpfopen(reffile, "rb")) == NULL
+	|| fscanf(oldrefs, "cscope %d %*s", &fileversion) != 1) {
+	postfatal("cscope: cannot read file %s\n", reffile);
+	/* NOTREACHED */
+    }
+    fstat(fileno(oldrefs), &oldstat);
+    reftime = oldstat.st_mtime;
+    if (fileversion >= 8) {
+	/* skip the options */
+	for (;;) {
+	    while((c = getc(oldrefs)) == ' ')
+		; 		/* do nothing */
+	    if (c != '-') {
+		ungetc(c, oldrefs);
+		break;
+	    }
+	    if (getc(oldrefs) == 'q') {
+		fscanf(oldrefs, "%*d");
+	    }
+	}
+	seek_to_trailer(oldrefs);
+    }
+    /* get the old file names if the directory lists are the same */
+    oldfiles = NULL;
+    if (samelist(oldrefs, srcdirs, nsrcdirs) == YES
+	&& samelist(oldrefs, incdirs, nincdirs) == YES
+	&& fscanf(oldrefs, "%lu", &oldnum) == 1
+	&& (fileversion < 9 || fscanf(oldrefs, "%*s") == 0)) {
+	oldfiles = mymalloc((oldnum + 1) * sizeof(char *));
+	for (i = 0; i < oldnum; ++i) {
+	    if (fscanf(oldrefs, " %[^\n]", oldname) != 1) {
+		break;
+	    }
+	    oldfiles[i] = my_strdup(oldname);
+	}
+	oldnum = i;
+	qsort(oldfiles, oldnum, sizeof(char *), compare);
+    } else {
+	oldnum = 0;
+    }
+    fclose(oldrefs);
+
+    /* the old files that are not given, mostly included files, are
+       checked as well */
+    nsources = nsrcfiles;
+    for (i = 0; i < oldnum; ++i) {
+	if (infilelist(oldfiles[i]) == NO) {
+	    addsrcfile(oldfiles[i]);
+	}
+    }
+    statfiles(0, nsrcfiles);
+    if (fingerprints == YES) {
+	fingerprintload();
+	fingerprintscan(0, nsrcfiles);
+    }
+    for (i = 0; i < nsrcfiles; ++i) {
+	if (i < nsources
+	    && (oldnum == 0
+		|| bsearch(&srcfiles[i], oldfiles, oldnum, sizeof(char *),
+			   compare) == NULL)) {
+	    printf("A %s\n", srcfiles[i]);
+	} else if (filestats[i].exists == NO) {
+	    printf("D %s\n", srcfiles[i]);
+	} else if (filestats[i].mtime > reftime
+		   && (fingerprints == NO || fingerprintsame(i) == NO)) {
+	    printf("M %s\n", srcfiles[i]);
+	}
+    }
+    for (i = 0; i < oldnum; ++i) {
+	free(oldfiles[i]);
+    }
+    free(oldfiles);
+    if (fingerprints == YES) {
+	fingerprintfree();
+    }
+    freefilestats();
 }
 	
 
@@ -583,168 +888,333 @@ seek_to_trailer(FILE *f)
 }
 
 
-/* get the next file name in the old cross-reference */
-static char *
-getoldfile(void)
-{
-    static char	file[PATHLEN + 1];	/* file name in old crossref */
-
-    if (blockp != NULL) {
-	do {
-	    if (*blockp == NEWFILE) {
-		skiprefchar();
-		fetch_string_from_dbase(file, sizeof(file));
-		if (file[0] != '\0') {	/* if not end-of-crossref */
-		    return(file);
-		}
-		return(NULL);
-	    }
-	} while (scanpast('\t') != NULL);
-    }
-    return(NULL);
-}
-
-
 /* Free all storage allocated for filenames: */
 void free_newbuildfiles(void)
 {
     free(newinvname);
     free(newinvpost);
+    free(newtriname);
+    free(newfpname);
     free(newreffile);
 }	
 
-/* copy this file's symbol data */
+/* write the fingerprint file of the source files */
 static void
-copydata(void)
+savefingerprints(void)
 {
-    char symbol[PATLEN + 1];
-    char *cp;
+    if (fingerprintsave(newfpname) == YES) {
+	movefile(newfpname, fpname);
+    } else {
+	posterr("cscope: cannot write fingerprint file %s\n", fpname);
+    }
+}
 
-    setmark('\t');
-    cp = blockp;
-    for (;;) {
-	/* copy up to the next \t */
-	do {	/* innermost loop optimized to only one test */
-	    while (*cp != '\t') {
-		dbputc(*cp++);
+/* replace the old file with the new file */
+static void
+movefile(char *new, char *old)
+{
+    unlink(old);
+    if (rename(new, old) == -1) {
+	myperror("cscope");
+	postfatal("cscope: cannot rename file %s to file %s\n",
+		  new, old);
+	/* NOTREACHED */
+    }
+}
+
+
+
+
+/* offset comparison function for sorting segments */
+static int
+compareoffsets(const void *arg_s1, const void *arg_s2)
+{
+    const SEGMENT *s1 = (const SEGMENT *) arg_s1;
+    const SEGMENT *s2 = (const SEGMENT *) arg_s2;
+
+    return((s1->offset > s2->offset) - (s1->offset < s2->offset));
+}
+
+
+/* file name comparison function for sorting old segments */
+static int
+comparesegments(const void *arg_s1, const void *arg_s2)
+{
+    const struct oldsegment *s1 = (const struct oldsegment *) arg_s1;
+    const struct oldsegment *s2 = (const struct oldsegment *) arg_s2;
+
+    return(strcmp(s1->file, s2->file));
+}
+
+
+/* source file name comparison function for sorting source file indexes */
+static int
+compareindexes(const void *arg_s1, const void *arg_s2)
+{
+    const unsigned long *s1 = (const unsigned long *) arg_s1;
+    const unsigned long *s2 = (const unsigned long *) arg_s2;
+
+    return(strcmp(srcfiles[*s1], srcfiles[*s2]));
+}
+
+
+/* read where each file's data is from the old cross-reference trailer */
+static BOOL
+getsegments(FILE *oldrefs)
+{
+    char    name[PATHLEN + 1];	/* file name in the data */
+    struct  oldsegment *sp;
+    unsigned long count;
+    unsigned long i;
+    long    lastend;
+    int     list;
+
+    /* skip the source and include directory and file lists */
+    if (fseek(oldrefs, traileroffset, SEEK_SET) == -1) {
+	return(NO);
+    }
+    for (list = 0; list < 3; ++list) {
+	if (fscanf(oldrefs, "%lu", &count) != 1 ||
+	    (list == 2 && fscanf(oldrefs, "%*s") != 0)) {
+	    return(NO);
+	}
+	for (i = 0; i < count; ++i) {
+	    if (fscanf(oldrefs, " %*[^\n]") != 0) {
+		return(NO);
 	    }
-	} while (*++cp == '\0' && (cp = read_block()) != NULL);
-	dbputc('\t');	/* copy the tab */
-		
-	/* get the next character */
-	if (*(cp + 1) == '\0') {
-	    cp = read_block();
 	}
-	/* exit if at the end of this file's data */
-	if (cp == NULL || *cp == NEWFILE) {
-	    break;
+    }
+    if (fscanf(oldrefs, "%lu %ld %ld", &count, &oldendoffset,
+	       &olddeadbytes) != 3 ||
+	oldendoffset > traileroffset || olddeadbytes < 0) {
+	return(NO);
+    }
+    oldsegments = mymalloc((count + 1) * sizeof(struct oldsegment));
+    lastend = 0;
+    for (sp = oldsegments; noldsegments < count; ++sp) {
+	if (fscanf(oldrefs, "%ld %ld", &sp->offset, &sp->length) != 2 ||
+	    sp->offset < lastend || sp->length <= 0 ||
+	    sp->offset + sp->length > oldendoffset) {
+	    return(NO);
 	}
-	/* look for an #included file */
-	if (*cp == INCLUDE) {
-	    blockp = cp;
-	    fetch_include_from_dbase(symbol, sizeof(symbol));
-	    writestring(symbol);
-	    setmark('\t');
-	    cp = blockp;
+	lastend = sp->offset + sp->length;
+
+	/* get the file name after the file mark */
+	dbseek(sp->offset);
+	if (blockp == NULL || *blockp != NEWFILE) {
+	    return(NO);
 	}
+	skiprefchar();
+	fetch_string_from_dbase(name, sizeof(name));
+	sp->nameend = dbtell();
+
+	/* the name is followed by at least an empty line and a tab */
+	if (name[0] == '\0' || sp->nameend + 3 > lastend) {
+	    return(NO);
+	}
+	sp->file = my_strdup(name);
+	sp->kept = NO;
+	++noldsegments;
     }
-    blockp = cp;
+    qsort(oldsegments, noldsegments, sizeof(struct oldsegment),
+	  comparesegments);
+    return(YES);
 }
 
-/* copy this file's symbol data and output the inverted index postings */
 
+/* copy the data at the start of the old cross-reference to the new one */
 static void
-copyinverted(void)
+copydata(FILE *oldrefs, long len)
 {
-    char    *cp;
-    char    c;
-    int     type;   /* reference type (mark character) */
-    char    symbol[PATLEN + 1];
+    char    buf[BUFSIZ];
+    long    n;
 
-    /* note: this code was expanded in-line for speed */
-    /* while (scanpast('\n') != NULL) { */
-    /* other macros were replaced by code using cp instead of blockp */
-    cp = blockp;
-    for (;;) {
-	setmark('\n');
-	do {	/* innermost loop optimized to only one test */
-	    while (*cp != '\n') {
-		dbputc(*cp++);
-	    }
-	} while (*++cp == '\0' && (cp = read_block()) != NULL);
-	dbputc('\n');	/* copy the newline */
-		
-	/* get the next character */
-	if (*(cp + 1) == '\0') {
-	    cp = read_block();
+    if (fseek(oldrefs, 0L, SEEK_SET) == -1) {
+	postfatal("cscope: cannot read file %s\n", reffile);
+	/* NOTREACHED */
+    }
+    for (; len > 0; len -= n) {
+	n = (len < (long) sizeof(buf)) ? len : (long) sizeof(buf);
+	if (fread(buf, n, 1, oldrefs) != 1) {
+	    postfatal("cscope: cannot read file %s\n", reffile);
+	    /* NOTREACHED */
 	}
-	/* exit if at the end of this file's data */
-	if (cp == NULL) {
-	    break;
+	if (fwrite(buf, n, 1, newrefs) != 1) {
+	    cannotwrite(newreffile);
+	    /* NOTREACHED */
 	}
-	switch (*cp) {
-	case '\n':
-	    lineoffset = dboffset + 1;
-	    continue;
-	case '\t':
-	    dbputc('\t');
-	    blockp = cp;
-	    type = getrefchar();
-	    switch (type) {
-	    case NEWFILE:		/* file name */
-		return;
-	    case INCLUDE:		/* #included file */
-		fetch_include_from_dbase(symbol, sizeof(symbol));
-		goto output;
-	    }
-	    dbputc(type);
+    }
+}
+
+
+/* find a file's data in the old cross-reference */
+static struct oldsegment *
+findsegment(char *file)
+{
+    struct  oldsegment key;
+
+    if (noldsegments == 0) {
+	return(NULL);
+    }
+    key.file = file;
+    return(bsearch(&key, oldsegments, noldsegments,
+		   sizeof(struct oldsegment), comparesegments));
+}
+
+
+/* free the old segment list */
+static void
+freesegments(void)
+{
+    unsigned long i;
+
+    for (i = 0; i < noldsegments; ++i) {
+	free(oldsegments[i].file);
+    }
+    free(oldsegments);
+    oldsegments = NULL;
+    noldsegments = 0;
+}
+
+
+/* keep a file's data where it is in the old cross-reference, and look for
+   its #included files as if it had been cross-referenced again */
+static void
+keepdata(struct oldsegment *sp, char *file)
+{
+    char    symbol[PATLEN + 1];
+
+    sp->kept = YES;
+    (void) addsegment(sp->offset, sp->length, file);
+    dbseek(sp->offset);
+    while (scanpast('\t') != NULL && *blockp != NEWFILE) {
+	if (*blockp == INCLUDE) {
 	    skiprefchar();
 	    fetch_string_from_dbase(symbol, sizeof(symbol));
-	    goto output;
+	    incfile(symbol + 1, symbol);
+	}
+    }
+}
+
+
+/* get the number of bytes of the old file data that was not kept, and if
+   requested blank it out so that it reads as the data of an empty file */
+static long
+killsegments(BOOL blank)
+{
+    static char blanks[BUFSIZ];
+    struct  oldsegment *sp;
+    long    deadbytes = 0;
+    long    len, n;
+
+    memset(blanks, ' ', sizeof(blanks));
+    for (sp = oldsegments; sp < oldsegments + noldsegments; ++sp) {
+	if (sp->kept == YES) {
+	    continue;
 	}
-	c = *cp;
-	if (c & 0200) {	/* digraph char? */
-	    c = dichar1[(c & 0177) / 8];
+	deadbytes += sp->length;
+	if (blank == NO) {
+	    continue;
 	}
-	/* if this is a symbol */
-	if (isalpha((unsigned char)c) || c == '_') {
-	    blockp = cp;
-	    fetch_string_from_dbase(symbol, sizeof(symbol));
-	    type = ' ';
-	output:
-	    putposting(symbol, type);
-	    writestring(symbol);
-	    if (blockp == NULL) {
-		return;
+	/* keep the file mark and name, and the final newline and tab */
+	len = sp->offset + sp->length - 2 - (sp->nameend + 1);
+	if (fseek(newrefs, sp->nameend + 1, SEEK_SET) == -1) {
+	    cannotwrite(newreffile);
+	    /* NOTREACHED */
+	}
+	for (; len > 0; len -= n) {
+	    n = (len < (long) sizeof(blanks)) ? len : (long) sizeof(blanks);
+	    if (fwrite(blanks, n, 1, newrefs) != 1) {
+		cannotwrite(newreffile);
+		/* NOTREACHED */
 	    }
-	    cp = blockp;
 	}
+	if (fputs("\n\t", newrefs) == EOF) {
+	    cannotwrite(newreffile);
+	    /* NOTREACHED */
+	}
+    }
+    if (fflush(newrefs) == EOF) {
+	cannotwrite(newreffile);
+	/* NOTREACHED */
     }
-    blockp = cp;
+    return(deadbytes);
 }
 
 
-/* replace the old file with the new file */
+/* sort the segments into database order and, for the inverted index, make
+   the table of the source file name offsets and their file indexes */
 static void
-movefile(char *new, char *old)
+indexsegments(void)
 {
-    unlink(old);
-    if (rename(new, old) == -1) {
-	myperror("cscope");
-	postfatal("cscope: cannot rename file %s to file %s\n",
-		  new, old);
-	/* NOTREACHED */
+    unsigned long *order;	/* source file indexes in name order */
+    unsigned long i;
+    long    low, high, mid;
+    int     c;
+
+    qsort(segments, nsegments, sizeof(SEGMENT), compareoffsets);
+    if (invertedindex == NO) {
+	return;
+    }
+    srcoffset = mymalloc((nsegments + 1) * sizeof(long));
+    srcfileindex = mymalloc((nsegments + 1) * sizeof(unsigned long));
+
+    /* the file index is the position in the source file list, which is
+       not the database order after an incremental build */
+    order = mymalloc((nsrcfiles + 1) * sizeof(unsigned long));
+    for (i = 0; i < nsrcfiles; ++i) {
+	order[i] = i;
     }
+    qsort(order, nsrcfiles, sizeof(unsigned long), compareindexes);
+    nsrcoffset = 0;
+    for (i = 0; i < nsegments; ++i) {
+	low = 0;
+	high = (long) nsrcfiles - 1;
+	while (low <= high) {
+	    mid = (low + high) / 2;
+	    if ((c = strcmp(segments[i].file, srcfiles[order[mid]])) == 0) {
+		srcoffset[nsrcoffset] = segments[i].offset + 1;
+		srcfileindex[nsrcoffset++] = order[mid];
+		break;
+	    }
+	    if (c < 0) {
+		high = mid - 1;
+	    } else {
+		low = mid + 1;
+	    }
+	}
+    }
+    free(order);
 }
 
 
-/* process the #included file in the old database */
-static void
-fetch_include_from_dbase(char *s, size_t length)
+/* see if a file's data was kept in the cross-reference */
+static BOOL
+keptfile(char *file)
 {
-    dbputc(INCLUDE);
-    skiprefchar();
-    fetch_string_from_dbase(s, length);
-    incfile(s + 1, s);
+    struct  oldsegment *sp;
+
+    return((sp = findsegment(file)) != NULL && sp->kept == YES);
 }
 
+
+/* see if an old inverted index posting is in file data that was kept */
+static int
+keepposting(POSTING *p)
+{
+    long    low, high, mid;
+
+    /* find the last segment starting at or before the posting */
+    low = 0;
+    high = (long) nsegments - 1;
+    while (low < high) {
+	mid = (low + high + 1) / 2;
+	if (segments[mid].offset <= p->lineoffset) {
+	    low = mid;
+	} else {
+	    high = mid - 1;
+	}
+    }
+    return(nsegments > 0 && segments[low].offset <= p->lineoffset &&
+	   p->lineoffset < segments[low].offset + segments[low].length);
+}
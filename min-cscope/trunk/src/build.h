@@ -46,10 +46,13 @@
 extern	BOOL	buildonly;	/* only build the database */
 extern	BOOL	unconditional;	/* unconditionally build database */
 extern	BOOL	fileschanged;	/* assume some files changed */
+extern	BOOL	listchanges;	/* only list the changed files */
 
 extern	char	*reffile;	/* cross-reference file path name */
 extern	char	*invname; 	/* inverted index to the database */
 extern	char	*invpost;	/* inverted index postings */
+extern	char	*triname;	/* trigram index of the source files */
+extern	char	*fpname;	/* content fingerprints of the source files */
 extern	char	*newreffile;	/* new cross-reference file name */
 extern	FILE	*newrefs;	/* new cross-reference */
 extern	int	symrefs;	/* cross-reference file */
@@ -59,6 +62,7 @@ extern	INVCONTROL invcontrol;	/* inverted file control structure */
 /* Prototypes of external functions defined by build.c */
 
 void	build(void);
+void	listchanged(void);
 void	free_newbuildfiles(void);
 void	opendatabase(void);
 void	rebuild(void);
@@ -51,6 +51,11 @@
 /* set the mark character for searching the cross-reference file */
 #define	setmark(c)	(blockmark = c, block[blocklen] = blockmark)
 
+/* find the mark character at or after cp, which cannot be past the mark
+   placed at the end of the block */
+#define	findmark(cp)	((char *) memchr((cp), blockmark, \
+					 (size_t) (block + blocklen + 1 - (cp))))
+
 /* get the next character in the cross-reference */
 /* note that blockp is assumed not to be null */
 #define	getrefchar()	(*(++blockp + 1) != '\0' ? *blockp : \
@@ -75,6 +80,8 @@
 #define	INVPOST	"cscope.po.out"	/* inverted index postings */
 #define	INVNAME2 "cscope.out.in"/* follows correct naming convention */
 #define	INVPOST2 "cscope.out.po"/* follows correct naming convention */
+#define	TRINAME	"cscope.tr.out"	/* trigram index of the source files */
+#define	FPNAME	"cscope.fp.out"	/* content fingerprints of the source files */
 
 #define	STMTMAX	10000		/* maximum source statement length */
 
@@ -65,6 +65,11 @@ static char const rcsid[] =
 			*--s = n + '!';
 
 #define	SYMBOLINC	20      /* symbol list size increment */
+#define	SEGMENTINC	1000    /* segment list size increment */
+
+/* width of the numbers in the database header, which is rewritten in place
+   once the trailer offset is known, so it must hold offsets beyond 4GB */
+#define	HEADERDIGITS	16
 
 long dboffset;                  /* new database offset */
 BOOL errorsfound;               /* prompt before clearing messages */
@@ -72,12 +77,17 @@ long lineoffset;                /* source line database offset */
 long npostings;                 /* number of postings */
 int nsrcoffset;                 /* number of file name database offsets */
 long *srcoffset;                /* source file name database offsets */
+unsigned long *srcfileindex;    /* source file index of each offset */
+SEGMENT *segments;              /* file data in the database */
+unsigned long nsegments;        /* number of file data segments */
 unsigned long symbols;          /* number of symbols */
 
 static char *filename;          /* file name for warning messages */
 static long fcnoffset;          /* function name database offset */
 static long macrooffset;        /* macro name database offset */
 static unsigned long msymbols = SYMBOLINC;      /* maximum number of symbols */
+static unsigned long msegments; /* maximum number of segments */
+static long lastsegment = -1;   /* segment of the file being output */
 
 struct symbol
 {                               /* symbol data */
@@ -91,6 +101,7 @@ static struct symbol *symbol;
 
 static void putcrossref(void);
 static void savesymbol(int token, int num);
+static BOOL xreffile(char *srcfile, BOOL putname);
 
 /*
  * The following code replaces the dbputc and dbputs macros previously defined
@@ -168,6 +179,21 @@ int dbflush()
     return 0;
 }
 
+/* write a block of previously formatted cross-reference data */
+int dbputblock(char *data, long len)
+{
+    if (dbbufpos > 0) {
+        if (dbflush_internal() < 0)
+            return -1;
+    }
+
+    if (len > 0 && fwrite(data, len, 1, newrefs) < 1)
+        return -1;
+
+    dboffset += len;
+    return 0;
+}
+
 /* output the cscope version, current directory, database format options, and
    the database trailer offset */
 void dbputheader(char *dir, long traileroffset)
@@ -178,18 +204,18 @@ void dbputheader(char *dir, long traileroffset)
         dboffset += fprintf(newrefs, " -c");
     }
     if (invertedindex == YES) {
-        dboffset += fprintf(newrefs, " -q %.10ld", totalterms);
+        dboffset += fprintf(newrefs, " -q %.*ld", HEADERDIGITS, totalterms);
     } else {    
         /* leave space so if the header is overwritten without -q
          * because writing the inverted index failed, the header
          * is the same length */
-        dboffset += fprintf(newrefs, "              ");
+        dboffset += fprintf(newrefs, "%*s", HEADERDIGITS + 4, "");
     }
     if (trun_syms == YES) {
         dboffset += fprintf(newrefs, " -T");
     }
 
-    dboffset += fprintf(newrefs, " %.10ld\n", traileroffset);
+    dboffset += fprintf(newrefs, " %.*ld\n", HEADERDIGITS, traileroffset);
 #ifdef PRINTF_RETVAL_BROKEN
     dboffset = ftell(newrefs); 
 #endif
@@ -219,6 +245,23 @@ void dbputlist(char **names, int count)
     }
 }
 
+/* put the segment list into the cross-reference file, after the end of the
+   file data and the number of bytes of dead data before it */
+void dbputsegments(long endoffset, long deadbytes)
+{
+    unsigned long i;
+
+    dbflush();
+    fprintf(newrefs, "%lu %ld %ld\n", nsegments, endoffset, deadbytes);
+    for (i = 0; i < nsegments; ++i) {
+        if (fprintf(newrefs, "%ld %ld\n", segments[i].offset,
+                    segments[i].length) < 0) {
+            cannotwrite(newreffile);
+            /* NOTREACHED */
+        }
+    }
+}
+
 #if 0
 /* database output macros that update its offset */
 #define	dbputc(c)	(++dboffset, (void) putc(c, newrefs))
@@ -226,6 +269,20 @@ void dbputlist(char **names, int count)
 #endif
 
 void crossref(char *srcfile)
+{
+    (void)xreffile(srcfile, YES);
+}
+
+/* cross-reference a source file without writing its name, so that the data
+   can be placed in the database later (see parxref.c); all offsets are
+   relative to the beginning of the data */
+BOOL crossrefbody(char *srcfile)
+{
+    return xreffile(srcfile, NO);
+}
+
+/* cross-reference a source file, returning NO if it cannot be read */
+static BOOL xreffile(char *srcfile, BOOL putname)
 {
     unsigned int i;
     unsigned int length;        /* symbol length */
@@ -237,7 +294,7 @@ void crossref(char *srcfile)
           && S_ISREG(st.st_mode))) {
         cannotopen(srcfile);
         errorsfound = YES;
-        return;
+        return NO;
     }
 
     entry_no = 0;
@@ -245,10 +302,14 @@ void crossref(char *srcfile)
     if ((yyin = myfopen(srcfile, "r")) == NULL) {
         cannotopen(srcfile);
         errorsfound = YES;
-        return;
+        return NO;
     }
     filename = srcfile;         /* save the file name for warning messages */
-    putfilename(srcfile);       /* output the file name */
+    if (putname == YES) {
+        putfilename(srcfile);   /* output the file name */
+    } else {
+        fcnoffset = macrooffset = 0;
+    }
     dbputc('\n');
     dbputc('\n');
 
@@ -316,7 +377,7 @@ void crossref(char *srcfile)
 
             /* output the leading tab expected by the next call */
             dbputc('\t');
-            return;
+            return YES;
         }
     }
 }
@@ -343,19 +404,40 @@ static void savesymbol(int token, int num)
 
 void putfilename(char *srcfile)
 {
+    /* the previous file's data ends at this file mark */
+    if (lastsegment >= 0) {
+        segments[lastsegment].length = dboffset - segments[lastsegment].offset;
+        lastsegment = -1;
+    }
+    if (*srcfile != '\0') {
+        lastsegment = addsegment(dboffset, 0, srcfile) - segments;
+    }
     /* check for file system out of space */
     if (dbputc(NEWFILE) < 0) {
         cannotwrite(newreffile);
         /* NOTREACHED */
     }
-
-    if (invertedindex == YES) {
-        srcoffset[nsrcoffset++] = dboffset;
-    }
     dbfputs(srcfile);
     fcnoffset = macrooffset = 0;
 }
 
+/* add a source file's data to the segment list */
+
+SEGMENT *addsegment(long offset, long length, char *file)
+{
+    SEGMENT *sp;
+
+    if (nsegments == msegments) {
+        msegments += SEGMENTINC;
+        segments = myrealloc(segments, msegments * sizeof(SEGMENT));
+    }
+    sp = &segments[nsegments++];
+    sp->offset = offset;
+    sp->length = length;
+    sp->file = file;
+    return sp;
+}
+
 /* output the symbols and source line */
 
 static void putcrossref(void)
@@ -508,15 +590,9 @@ void freecrossref()
 }
 
 /* output the inverted index posting */
-#if defined(USE_SORTLIB)
-extern file_t postings;
 void putposting(char *term, int type)
 {
-    long i, n, len;
-    char *s;
-    int digits;                 /* digits output */
     long offset;                /* function/macro database offset */
-    static char buf[256];       /* output buffer */
 
     /* get the function or macro name offset */
     offset = fcnoffset;
@@ -546,6 +622,26 @@ void putposting(char *term, int type)
     if (type == INCLUDE) {
         ++term;
     }
+    /* a build worker passes the posting back to the main process, which
+       knows the final offsets */
+    if (buildworker == YES) {
+        workerposting(term, type, lineoffset, offset);
+        return;
+    }
+    writeposting(term, type, lineoffset, offset);
+}
+
+/* write a posting for the term at the given source line offset, with the
+   given function or macro name offset (0 for none) */
+#if defined(USE_SORTLIB)
+extern file_t postings;
+void writeposting(char *term, int type, long lineoff, long offset)
+{
+    long i, n, len;
+    char *s;
+    int digits;                 /* digits output */
+    static char buf[256];       /* output buffer */
+
     /* output the posting, which should be as small as possible to reduce
        the temp file size and sort time */
     len = strlen(term);
@@ -555,7 +651,7 @@ void putposting(char *term, int type)
     /* the line offset is padded so postings for the same term will sort
        in ascending line offset order to order the references as they
        appear withing a source file */
-    ltobase(lineoffset);
+    ltobase(lineoff);
     for (i = PRECISION - digits; i > 0; --i) {
         buf[len++] = '!';
     }
@@ -583,42 +679,13 @@ void putposting(char *term, int type)
 }
 #else
 extern FILE *postings;
-void putposting(char *term, int type)
+void writeposting(char *term, int type, long lineoff, long offset)
 {
     long i, n;
     char *s;
     int digits;                 /* digits output */
-    long offset;                /* function/macro database offset */
     char buf[11];               /* number buffer */
 
-    /* get the function or macro name offset */
-    offset = fcnoffset;
-    if (macrooffset != 0) {
-        offset = macrooffset;
-    }
-    /* then update them to avoid negative relative name offset */
-    switch (type) {
-    case DEFINE:
-        macrooffset = dboffset;
-        break;
-    case DEFINEEND:
-        macrooffset = 0;
-        return;                 /* null term */
-    case FCNDEF:
-        fcnoffset = dboffset;
-        break;
-    case FCNEND:
-        fcnoffset = 0;
-        return;                 /* null term */
-    }
-    /* ignore a null term caused by a enum/struct/union without a tag */
-    if (*term == '\0') {
-        return;
-    }
-    /* skip any #include secondary type char (< or ") */
-    if (type == INCLUDE) {
-        ++term;
-    }
     /* output the posting, which should be as small as possible to reduce
        the temp file size and sort time */
     (void)fputs(term, postings);
@@ -627,7 +694,7 @@ void putposting(char *term, int type)
     /* the line offset is padded so postings for the same term will sort
        in ascending line offset order to order the references as they
        appear withing a source file */
-    ltobase(lineoffset);
+    ltobase(lineoff);
     for (i = PRECISION - digits; i > 0; --i) {
         (void)putc('!', postings);
     }
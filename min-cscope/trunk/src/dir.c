@@ -594,6 +594,11 @@ incfile(char *file, char *type)
     char    *s;
     unsigned int i;
 
+    /* a build worker leaves the source file list to the main process */
+    if (buildworker == YES) {
+	workerinclude(file, type);
+	return;
+    }
     /* see if the file is already in the source file list */
     if (infilelist(file) == YES) {
 	return;
@@ -426,8 +426,12 @@ search(void)
 	FP	f;			/* searching function */
 	int	c;
 	
-	/* open the references found file for writing */
-	if (writerefsfound() == NO) {
+	/* open the references found file for writing, or write the
+	   structured output straight out, counting the references */
+	if (recordmode == YES) {
+		refsfound = stdout;
+		totallines = 0;
+	} else if (writerefsfound() == NO) {
 		return(NO);
 	}
 	/* find the pattern - stop on an interrupt */
@@ -471,18 +475,23 @@ search(void)
 	/* rewind the cross-reference file */
 	(void) lseek(symrefs, (long) 0, 0);
 	
-	/* reopen the references found file for reading */
-	(void) fclose(refsfound);
-	if ((refsfound = myfopen(temp1, "rb")) == NULL) {
-		cannotopen(temp1);
-		return(NO);
+	if (recordmode == YES) {
+		refsfound = NULL;
+		c = totallines > 0 ? '\0' : EOF;
+	} else {
+		/* reopen the references found file for reading */
+		(void) fclose(refsfound);
+		if ((refsfound = myfopen(temp1, "rb")) == NULL) {
+			cannotopen(temp1);
+			return(NO);
+		}
+		nextline = 1;
+		totallines = 0;
+		disprefs = 0;
+		c = getc(refsfound);
 	}
-	nextline = 1;
-	totallines = 0;
-	disprefs = 0;
-	
 	/* see if it is empty */
-	if ((c = getc(refsfound)) == EOF) {
+	if (c == EOF) {
 		if (findresult != NULL) {
 			(void) sprintf(lastmsg, "Egrep %s in this pattern: %s", 
 				       findresult, Pattern);
@@ -502,6 +511,9 @@ search(void)
 		}
 		return(NO);
 	}
+	if (recordmode == YES) {
+		return(YES);
+	}
 	/* put back the character read */
 	(void) ungetc(c, refsfound);
 
@@ -543,7 +555,13 @@ progress(char *what, long current, long max)
 		}
 		else
 #endif /* defined(WITH_CURSES) */
-                    if (verbosemode == YES)
+                    if (verbosemode == YES && recordmode == YES)
+		{
+			(void) printf("P%s%c%ld%c%ld%c", what, '\0', current,
+				      '\0', max, '\0');
+			(void) fflush(stdout);
+		}
+		else if (verbosemode == YES)
 		{
 			sprintf(msg, "> %s %ld of %ld", what, current, max);
 		}
@@ -564,12 +582,23 @@ progress(char *what, long current, long max)
 		}
 		else
 #endif /* defined(WITH_CURSES) */
-			if (linemode == NO || verbosemode == YES)
+			if (linemode == NO ||
+			    (verbosemode == YES && recordmode == NO))
 				postmsg(msg);
 	}
 	++searchcount;
 }
 
+/* end the structured output of a line-mode command, giving the number of
+   references it found */
+
+void
+putrecordend(unsigned int count)
+{
+	(void) printf("E%u%c", count, '\0');
+	(void) fflush(stdout);
+}
+
 /* print error message on system call failure */
 
 void
@@ -604,6 +633,11 @@ postmsg(char *msg)
 	}
 	else
 #endif /* defined(WITH_CURSES) */
+	if (recordmode == YES) {
+		(void) printf("M%s%c", msg, '\0');
+		fflush(stdout);
+	}
+	else
         {
 		(void) printf("%s\n", msg);
 		fflush(stdout);
@@ -45,7 +45,12 @@
 %left STAR PLUS QUEST
 
 %{
+#include "config.h"
+#if defined(HAVE_MEMMEM) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE	/* memmem */
+#endif
 #include "global.h"
+#include "alloc.h"
 #include <ctype.h>
 #include <stdio.h>
 
@@ -56,11 +61,35 @@
 #define MAXLIN 350
 #define MAXPOS 4000
 #define NCHARS 256
-#define NSTATES 128
 #define FINAL -1
-static	char gotofn[NSTATES][NCHARS];
-static	int state[NSTATES];
-static	char out[NSTATES];
+#define MAXMUST 8		/* alternatives with a required string */
+
+/* The automaton is built lazily while searching: the transitions of a state
+ * are computed the first time they are needed, and kept in a bounded cache.
+ * When the cache is full it is emptied, and filled again from the current
+ * state. Each searching thread has its own cache, which is kept for all the
+ * files of a search.
+ */
+#define NSTATES 256		/* cached states */
+#define STATEPOS (NSTATES * 32)	/* cached state positions */
+#define NHASH 509		/* state hash table size */
+
+struct egrepstate {
+	TEXTBUF	text;			/* file contents */
+	short	trans[NSTATES][NCHARS];	/* next states, -1 if not computed */
+	char	out[NSTATES];		/* the state is accepting */
+	int	state[NSTATES];		/* position set of each state */
+	int	hashnext[NSTATES];	/* next state with the same hash */
+	int	hashhead[NHASH];	/* first state of each hash value */
+	int	nstates;
+	int	pos[STATEPOS];		/* state position sets */
+	int	npos;
+	int	tmpstat[MAXLIN];	/* positions of the state being built */
+	int	istat;			/* line start state, -1 if not computed */
+	unsigned long generation;	/* pattern the cache was built for */
+	int	iflag;			/* the cache ignores letter case */
+};
+
 static	unsigned int line;
 static	int name[MAXLIN];
 static	unsigned int left[MAXLIN];
@@ -73,25 +102,37 @@ static	int nxtpos;
 static	int nxtchar;
 static	int tmpstat[MAXLIN];
 static	int initstat[MAXLIN];
-static	int xstate;
 static	int count;
 static	int icount;
 static	char *input;
-static	long lnum;
 static	int iflag;
 static	jmp_buf	env;	/* setjmp/longjmp buffer */
 static	char *message;	/* error message */
+static	unsigned long generation;	/* compiled pattern number */
+static	char must[MAXMUST][MAXLIN + 1];	/* strings contained in every match */
+static	char mustfold[MAXMUST][MAXLIN + 1];	/* in lower case */
+static	size_t mustlen[MAXMUST];
+static	unsigned short mustshift[MAXMUST][NCHARS];	/* caseless skips */
+static	int nmust;
+static	unsigned char fold[NCHARS];	/* lower case of each character */
 
 /* Internal prototypes: */
 static	void cfoll(int v);
-static	void cgotofn(void);
+static	void cinitstat(void);
 static	int cstate(int v);
 static	int member(int symb, int set, int torf);
-static	int notin(int n);
 static	void synerror(void);
 static	void overflo(void);
 static	void add(int *array, int n);
 static	void follow(unsigned int v);
+static	int dfamatch(int k, unsigned int set, int c);
+static	int dfastate(EGREPSTATE *st, int *stat, int cnt);
+static	int dfastep(EGREPSTATE *st, int s, int c);
+static	void dfaflush(EGREPSTATE *st);
+static	void mustinit(char *pat);
+static	int matchline(EGREPSTATE *st, char *p, char *end);
+static	char *findmust(int k, char *text, char *end);
+static	void bufspace(TEXTBUF *buf, long n);
 static	int unary(int x, int d);
 static	int node(int x, int l, int r);
 static	unsigned int cclenter(int x);
@@ -214,13 +255,14 @@ yylex(void)
     case '\\':
 	if ((c = nextch()) == '\0')
 	    synerror();
-	/* not reached */
+	yylval = (unsigned char)c;
+	return (CHAR);
     case '$':
     case '^':
 	c = '\n';
 	/* fall through */
     default:
-	yylval = c;
+	yylval = (unsigned char)c;
 	return (CHAR);
     }
 }
@@ -302,16 +344,13 @@ cfoll(int v)
     }
 }
 
+/* find the positions where a match can start, which are part of every
+   state */
+
 static void
-cgotofn(void)
+cinitstat(void)
 {
-    unsigned int i, n, s;
-    int c, k;
-    char symbol[NCHARS];
-    unsigned int j, l, pc, pos;
-    unsigned int nc;
-    int curpos;
-    unsigned int num, number, newpos;
+    unsigned int n;
 
     count = 0;
     for (n=3; n<=line; n++)
@@ -319,95 +358,11 @@ cgotofn(void)
     if (cstate(line-1)==0) {
 	tmpstat[line] = 1;
 	count++;
-	out[0] = 1;
     }
     for (n=3; n<=line; n++)
 	initstat[n] = tmpstat[n];
     count--;		/*leave out position 1 */
     icount = count;
-    tmpstat[1] = 0;
-    add(state, 0);
-    n = 0;
-    for (s = 0; s <= n; s++)  {
-	if (out[s] == 1)
-	    continue;
-	for (i = 0; i < NCHARS; i++)
-	    symbol[i] = 0;
-	num = positions[state[s]];
-	count = icount;
-	for (i = 3; i <= line; i++)
-	    tmpstat[i] = initstat[i];
-	pos = state[s] + 1;
-	for (i = 0; i < num; i++) {
-	    curpos = positions[pos];
-	    if ((c = name[curpos]) >= 0) {
-		if (c < NCHARS) {
-		    symbol[c] = 1;
-		} else if (c == DOT) {
-		    for (k = 0; k < NCHARS; k++)
-			if (k != '\n')
-			    symbol[k] = 1;
-		} else if (c == CCL) {
-		    nc = chars[right[curpos]];
-		    pc = right[curpos] + 1;
-		    for (j = 0; j < nc; j++)
-			symbol[(unsigned char)(chars[pc++])] = 1;
-		} else if (c == NCCL) {
-		    nc = chars[right[curpos]];
-		    for (j = 0; j < NCHARS; j++) {
-			pc = right[curpos] + 1;
-			for (l = 0; l < nc; l++)
-			    if (j==(unsigned char)(chars[pc++]))
-				goto cont;
-			if (j != '\n')
-			    symbol[j] = 1;
-		    cont:
-			;
-		    }
-		}
-	    }
-	    pos++;
-	} /* for (i) */
-	for (c=0; c<NCHARS; c++) {
-	    if (symbol[c] == 1) {
-		/* nextstate(s,c) */
-		count = icount;
-		for (i=3; i <= line; i++)
-		    tmpstat[i] = initstat[i];
-		pos = state[s] + 1;
-		for (i=0; i<num; i++) {
-		    curpos = positions[pos];
-		    if ((k = name[curpos]) >= 0)
-			if ((k == c)
-			    || (k == DOT)
-			    || (k == CCL && member(c, right[curpos], 1))
-			    || (k == NCCL && member(c, right[curpos], 0))
-			    ) {
-			    number = positions[foll[curpos]];
-			    newpos = foll[curpos] + 1;
-			    for (j = 0; j < number; j++) {
-				if (tmpstat[positions[newpos]] != 1) {
-				    tmpstat[positions[newpos]] = 1;
-				    count++;
-				}
-				newpos++;
-			    }
-			}
-		    pos++;
-		} /* end nextstate */
-		if (notin(n)) {
-		    if (n >= NSTATES)
-			overflo();
-		    add(state, ++n);
-		    if (tmpstat[line] == 1)
-			out[n] = 1;
-		    gotofn[s][c] = n;
-		} else {
-		    gotofn[s][c] = xstate;
-		}
-	    } /* if (symbol) */
-	} /* for(c) */
-    } /* for(s) */
 }
 
 static int
@@ -450,23 +405,6 @@ member(int symb, int set, int torf)
     return (!torf);
 }
 
-static int
-notin(int n)
-{
-	int i, j, pos;
-	for (i=0; i<=n; i++) {
-		if (positions[state[i]] == count) {
-			pos = state[i] + 1;
-			for (j=0; j < count; j++)
-				if (tmpstat[positions[pos++]] != 1) goto nxt;
-			xstate = i;
-			return (0);
-		}
-		nxt: ;
-	}
-	return (1);
-}
-
 static void
 add(int *array, int n)
 {
@@ -522,10 +460,9 @@ follow(unsigned int v)
 char *
 egrepinit(char *egreppat)
 {
+    unsigned int i;
+
     /* initialize the global data */
-    memset(gotofn, 0, sizeof(gotofn));
-    memset(state, 0, sizeof(state));
-    memset(out, 0, sizeof(out));
     line = 1;
     memset(name, 0, sizeof(name));
     memset(left, 0, sizeof(left));
@@ -538,118 +475,421 @@ egrepinit(char *egreppat)
     nxtchar = 0;
     memset(tmpstat, 0, sizeof(tmpstat));
     memset(initstat, 0, sizeof(initstat));
-    xstate = 0;
     count = 0;
     icount = 0;
     input = egreppat;
     message = NULL;
+    nmust = 0;
+    for (i = 0; i < NCHARS; i++)
+	fold[i] = tolower((int)i);
+    ++generation;	/* the cached states are out of date */
     if (setjmp(env) == 0) {
 	yyparse();
 	cfoll(line-1);
-	cgotofn();
+	cinitstat();
+	mustinit(egreppat);
     }
     return(message);
 }
 
-int
-egrep(char *file, FILE *output, char *format)
+/* allocate the state of a search, to be used by one thread at a time */
+
+EGREPSTATE *
+egrepalloc(void)
+{
+    EGREPSTATE *st;
+
+    st = mymalloc(sizeof(EGREPSTATE));
+    st->text.text = NULL;
+    st->text.len = 0;
+    st->text.size = 0;
+    st->generation = 0;		/* flushed before its first use */
+    return(st);
+}
+
+void
+egrepfree(EGREPSTATE *st)
+{
+    if (st != NULL) {
+	free(st->text.text);
+	free(st);
+    }
+}
+
+/* check whether the character at a position of the pattern matches c */
+
+static int
+dfamatch(int k, unsigned int set, int c)
+{
+    if (k < 0)
+	return(0);
+    if (k < NCHARS)
+	return(k == c || (iflag && fold[k] == fold[c]));
+    if (k == DOT)
+	return(c != '\n');
+    if (k == CCL)
+	return(member(c, set, 1) 
+	       || (iflag && (member(fold[c], set, 1) 
+			     || member(toupper(c), set, 1))));
+    if (k == NCCL)
+	return(c != '\n' && member(c, set, 0) 
+	       && (!iflag || (member(fold[c], set, 0) 
+			      && member(toupper(c), set, 0))));
+    return(0);
+}
+
+/* find the state of the positions marked in stat, adding it to the cache
+   if it is new, or return -1 if the cache is full */
+
+static int
+dfastate(EGREPSTATE *st, int *stat, int cnt)
+{
+    unsigned int h, i;
+    int n, j, *set;
+
+    for (h = 0, i = 3; i <= line; i++)
+	if (stat[i] == 1)
+	    h = h * 31 + i;
+    h %= NHASH;
+    for (n = st->hashhead[h]; n >= 0; n = st->hashnext[n]) {
+	set = &st->pos[st->state[n]];
+	if (set[0] == cnt) {
+	    for (j = 1; j <= cnt && stat[set[j]] == 1; j++)
+		;
+	    if (j > cnt)
+		return(n);
+	}
+    }
+    if (st->nstates >= NSTATES || st->npos + cnt + 1 > STATEPOS)
+	return(-1);
+    n = st->nstates++;
+    st->state[n] = st->npos;
+    st->pos[st->npos++] = cnt;
+    for (i = 3; i <= line; i++)
+	if (stat[i] == 1)
+	    st->pos[st->npos++] = i;
+    st->out[n] = (stat[line] == 1);
+    memset(st->trans[n], 0xff, sizeof(st->trans[n]));
+    st->hashnext[n] = st->hashhead[h];
+    st->hashhead[h] = n;
+    return(n);
+}
+
+/* empty the state cache, leaving only the initial state */
+
+static void
+dfaflush(EGREPSTATE *st)
+{
+    int i;
+
+    st->nstates = 0;
+    st->npos = 0;
+    for (i = 0; i < NHASH; i++)
+	st->hashhead[i] = -1;
+    st->istat = -1;
+    (void) dfastate(st, initstat, icount);
+}
+
+/* compute the transition of state s on character c */
+
+static int
+dfastep(EGREPSTATE *st, int s, int c)
+{
+    unsigned int i, j, num, number;
+    int cnt, n, *set, curpos, newpos;
+
+    /* follow the positions matching c, on top of the initial ones */
+    cnt = icount;
+    for (i = 3; i <= line; i++)
+	st->tmpstat[i] = initstat[i];
+    set = &st->pos[st->state[s]];
+    num = *set++;
+    for (i = 0; i < num; i++) {
+	curpos = set[i];
+	if (dfamatch(name[curpos], right[curpos], c)) {
+	    number = positions[foll[curpos]];
+	    newpos = foll[curpos] + 1;
+	    for (j = 0; j < number; j++) {
+		if (st->tmpstat[positions[newpos]] != 1) {
+		    st->tmpstat[positions[newpos]] = 1;
+		    cnt++;
+		}
+		newpos++;
+	    }
+	}
+    }
+    if ((n = dfastate(st, st->tmpstat, cnt)) >= 0) {
+	st->trans[s][c] = n;
+    } else {
+	/* s is gone with the rest of the cache */
+	dfaflush(st);
+	n = dfastate(st, st->tmpstat, cnt);
+    }
+    return(n);
+}
+
+/* find, for each alternative of the pattern, the longest string that its
+   matches contain, so that only the lines containing one of the strings
+   need to be run through the automaton. Characters that are optional,
+   repeated, in a group or in a class end a string, and there are none if
+   an alternative has no such string */
+
+static void
+mustinit(char *pat)
 {
+    char run[MAXLIN + 1];
+    size_t runlen = 0;
+    size_t i, len;
+    int depth = 0;
+    int k;
+    char c;
+
+    mustlen[0] = 0;
+    for (;;) {
+	switch (c = *pat++) {
+	case '|':
+	case '\n':
+	    if (depth > 0) {
+		c = '\0';
+		break;
+	    }
+	    /* fall through */
+	case '\0':
+	    /* end of an alternative */
+	    if (runlen > mustlen[nmust]) {
+		memcpy(must[nmust], run, runlen);
+		mustlen[nmust] = runlen;
+	    }
+	    runlen = 0;
+	    if (mustlen[nmust] == 0 || nmust + 1 == MAXMUST) {
+		nmust = 0;
+		return;
+	    }
+	    if (++nmust, c == '\0')
+		goto shifts;
+	    mustlen[nmust] = 0;
+	    continue;
+	case '[':
+	    if (*pat == '^')
+		pat++;
+	    if (*pat != '\0')
+		pat++;		/* a leading ']' is a member */
+	    while (*pat != '\0' && *pat != ']')
+		pat++;
+	    if (*pat != '\0')
+		pat++;
+	    c = '\0';
+	    break;
+	case '(':
+	    depth++;
+	    c = '\0';
+	    break;
+	case ')':
+	    depth--;
+	    c = '\0';
+	    break;
+	case '.':
+	case '^':
+	case '$':
+	case '*':
+	case '+':
+	case '?':
+	    c = '\0';
+	    break;
+	case '\\':
+	    c = *pat++;
+	    break;
+	}
+	if (c != '\0' && depth == 0 && *pat != '*' && *pat != '?') {
+	    run[runlen++] = c;
+	    if (*pat != '+')
+		continue;
+	}
+	/* the run ends here */
+	if (runlen > mustlen[nmust]) {
+	    memcpy(must[nmust], run, runlen);
+	    mustlen[nmust] = runlen;
+	}
+	runlen = 0;
+    }
+
+shifts:
+    /* set up the caseless searches */
+    for (k = 0; k < nmust; k++) {
+	len = mustlen[k];
+	for (i = 0; i < len; i++)
+	    mustfold[k][i] = fold[(unsigned char)must[k][i]];
+	for (i = 0; i < NCHARS; i++)
+	    mustshift[k][i] = len;
+	for (i = 0; i + 1 < len; i++)
+	    mustshift[k][(unsigned char)mustfold[k][i]] = len - 1 - i;
+    }
+}
+
+/* find the next occurrence of a required string */
+
+static char *
+findmust(int k, char *text, char *end)
+{
+    size_t len = mustlen[k];
+    size_t i;
     char *p;
-    unsigned int cstat;
-    int ccount;
-    char buf[2*BUFSIZ];
-    char *nlp;
-    unsigned int istat;
-    int in_line;
+
+    if ((size_t)(end - text) < len)
+	return(NULL);
+    if (iflag) {
+	/* Horspool's search, comparing the characters in lower case */
+	for (p = text; p <= end - len; 
+	     p += mustshift[k][fold[(unsigned char)p[len - 1]]]) {
+	    for (i = len; fold[(unsigned char)p[i - 1]] 
+		     == (unsigned char)mustfold[k][i - 1]; )
+		if (--i == 0)
+		    return(p);
+	}
+	return(NULL);
+    }
+#if defined(HAVE_MEMMEM)
+    return(memmem(text, end - text, must[k], len));
+#else
+    end -= len - 1;
+    for (p = text; (p = memchr(p, must[k][0], end - p)) != NULL; p++)
+	if (memcmp(p, must[k], len) == 0)
+	    return(p);
+    return(NULL);
+#endif
+}
+
+/* get the string that the matches of alternative k of the pattern contain,
+   or NULL if there are no more alternatives or they need not contain any
+   string */
+
+char *
+egrepmust(int k, size_t *lenp)
+{
+    if (k >= nmust)
+	return(NULL);
+    *lenp = mustlen[k];
+    return(must[k]);
+}
+
+/* run a line through the automaton; end is the position of its newline,
+   or the end of the text */
+
+static int
+matchline(EGREPSTATE *st, char *p, char *end)
+{
+    int cstat, c;
+
+    if (st->istat < 0)
+	st->istat = dfastep(st, 0, '\n');
+    if (st->out[(cstat = st->istat)])
+	return(1);
+    for (; p < end; p++) {
+	c = (unsigned char)*p;
+	if (st->trans[cstat][c] < 0)
+	    cstat = dfastep(st, cstat, c);
+	else
+	    cstat = st->trans[cstat][c];
+	if (st->out[cstat])
+	    return(1);
+    }
+    if (*end == '\n') {
+	cstat = st->trans[cstat]['\n'] < 0 ? 
+	    dfastep(st, cstat, '\n') : st->trans[cstat]['\n'];
+	if (st->out[cstat])
+	    return(1);
+    }
+    return(0);
+}
+
+/* make room for n more characters in a buffer */
+
+static void
+bufspace(TEXTBUF *buf, long n)
+{
+    if (buf->len + n > buf->size) {
+	buf->size = (buf->len + n) * 2;
+	buf->text = myrealloc(buf->text, buf->size);
+    }
+}
+
+/* append the lines of a file matching the compiled pattern to the output
+   buffer, each preceded by the format applied to the file name and the
+   line number. Each thread searching files in parallel needs its own
+   search state */
+
+int
+egrep(char *file, EGREPSTATE *st, TEXTBUF *output, char *format)
+{
     FILE *fptr;
+    TEXTBUF *text = &st->text;
+    char *p, *end, *eol, *hit, *nl;
+    char *hits[MAXMUST];	/* next occurrence of each string */
+    long lnum;
+    long n;
+    int k;
 
     if ((fptr = myfopen(file, "r")) == NULL) 
 	return(-1);
 
-    ccount = 0;
+    /* start a new cache for a new pattern */
+    if (st->generation != generation || st->iflag != iflag) {
+	st->generation = generation;
+	st->iflag = iflag;
+	dfaflush(st);
+    }
+
+    /* read the whole file, leaving room for a terminating newline */
+    text->len = 0;
+    do {
+	bufspace(text, BUFSIZ + 1);
+	n = fread(text->text + text->len, sizeof(char), 
+		  text->size - text->len - 1, fptr);
+	text->len += n;
+    } while (n > 0);
+    fclose(fptr);
+
+    p = text->text;
+    end = p + text->len;
+    *end = '\0';
     lnum = 1;
-    in_line = 0;
-    p = buf;
-    nlp = p;
-    if ((ccount = fread(p, sizeof(char), BUFSIZ, fptr)) <= 0)
-	goto done;
-    in_line = 1;
-    istat = cstat = (unsigned int) gotofn[0]['\n'];
-    if (out[cstat])
-	goto found;
-    for (;;) {
-	if (!iflag)
-	    cstat = (unsigned int) gotofn[cstat][(unsigned int)*p&0377];
-	/* all input chars made positive */
-	else
-	    cstat = (unsigned int) gotofn[cstat][tolower((int)*p&0377)];
-	/* for -i option*/
-	if (out[cstat]) {
-	found:
-	    for(;;) {
-		if (*p++ == '\n') {
-		    in_line = 0;
-		succeed:
-		    fprintf(output, format, file, lnum);
-		    if (p <= nlp) {
-			while (nlp < &buf[2*BUFSIZ])
-			    putc(*nlp++, output);
-			nlp = buf;
-		    }
-		    while (nlp < p)
-			putc(*nlp++, output);
-		    lnum++;
-		    nlp = p;
-		    if ((out[(cstat=istat)]) == 0)
-			goto brk2;
-		} /* if (p++ == \n) */
-	    cfound:
-		if (--ccount <= 0) {
-		    if (p <= &buf[BUFSIZ]) {
-			ccount = fread(p, sizeof(char), BUFSIZ, fptr);
-		    } else if (p == &buf[2*BUFSIZ]) {
-			p = buf;
-			ccount = fread(p, sizeof(char), BUFSIZ, fptr);
-		    } else {
-			ccount = fread(p, sizeof(char), &buf[2*BUFSIZ] - p,
-				       fptr);
-		    }
-		    if (ccount <= 0) {
-			if (in_line) {
-			    in_line = 0;
-			    goto succeed;
-			}
-			goto done;
-		    }
-		} /* if(ccount <= 0) */
-		in_line = 1;
-	    } /* for(ever) */
-	} /* if(out[cstat]) */
-
-	if (*p++ == '\n') {
-	    in_line = 0;
-	    lnum++;
-	    nlp = p;
-	    if (out[(cstat=istat)])
-		goto cfound;
-	}
-    brk2:
-	if (--ccount <= 0) {
-	    if (p <= &buf[BUFSIZ]) {
-		ccount = fread(p, sizeof(char), BUFSIZ, fptr);
-	    } else if (p == &buf[2*BUFSIZ]) {
-		p = buf;
-		ccount = fread(p, sizeof(char), BUFSIZ, fptr);
-	    } else {
-		ccount = fread(p, sizeof(char), &buf[2*BUFSIZ] - p, fptr);
+    for (k = 0; k < nmust; k++)
+	hits[k] = NULL;
+    while (p < end) {
+
+	/* skip to the line of the next occurrence of a required string,
+	   counting the lines passed */
+	if (nmust > 0) {
+	    hit = end;
+	    for (k = 0; k < nmust; k++) {
+		if (hits[k] == NULL || hits[k] < p) {
+		    if ((hits[k] = findmust(k, p, end)) == NULL)
+			hits[k] = end;
+		}
+		if (hits[k] < hit)
+		    hit = hits[k];
 	    }
-	    if (ccount <= 0) 
+	    if (hit == end)
 		break;
+	    while ((nl = memchr(p, '\n', hit - p)) != NULL) {
+		p = nl + 1;
+		lnum++;
+	    }
+	}
+	if ((eol = memchr(p, '\n', end - p)) == NULL)
+	    eol = end;
+	if (matchline(st, p, eol)) {
+	    bufspace(output, strlen(format) + strlen(file) + 24 + 
+		     (eol - p) + 1);
+	    output->len += sprintf(output->text + output->len, format, 
+				   file, lnum);
+	    memcpy(output->text + output->len, p, eol - p);
+	    output->len += eol - p;
+	    output->text[output->len++] = '\n';
 	}
-	in_line = 1;
+	p = eol + 1;
+	lnum++;
     }
-done:
-    fclose(fptr);
     return(0);
 }
 
@@ -0,0 +1,198 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	status of the source files
+ *
+ *	A build needs the modification time of every source file, first to
+ *	see if the old cross-reference is up-to-date, then to see which files
+ *	to cross-reference again. On a network file system each lstat() waits
+ *	for the server, so the status of the files is read once, by a pool of
+ *	threads that keep several requests in flight, into an array that
+ *	follows the source file list.
+ */
+
+#include "global.h"
+#include "alloc.h"
+#include <sys/stat.h>
+#if defined(HAVE_PTHREAD)
+#include <pthread.h>
+#endif
+
+#define	FILECHUNK	32		/* files taken by a thread at a time */
+#define	MAXFILEJOBS	64		/* maximal number of threads */
+#define	STATJOBS	16		/* threads reading the file status */
+
+FILESTAT *filestats;			/* status of each source file */
+static	unsigned long nfilestats;	/* number of files with a status */
+
+#if defined(HAVE_PTHREAD)
+static	unsigned long nextfile;		/* next file to take */
+static	unsigned long lastfile;		/* end of the files to take */
+static	void	(*filefunc)(unsigned long fileindex); /* work on a file */
+static	pthread_mutex_t filelock = PTHREAD_MUTEX_INITIALIZER;
+
+static	void	*fileworker(void *arg);
+#endif /* defined(HAVE_PTHREAD) */
+
+static	void	statfile(unsigned long fileindex);
+
+/* call a function on each of the source files from first up to last, with
+   a number of threads, 0 for as many as for the text searches; the function
+   may be called from several threads at a time, but on a different file */
+
+void
+forfiles(unsigned long first, unsigned long last,
+	 void (*func)(unsigned long fileindex), int jobs)
+{
+	unsigned long i;
+#if defined(HAVE_PTHREAD)
+	pthread_t threads[MAXFILEJOBS];
+	long	nthreads = jobs;
+
+	if (nthreads == 0 && (nthreads = searchjobs) == 0) {
+#if defined(_SC_NPROCESSORS_ONLN)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	}
+	if (nthreads > MAXFILEJOBS) {
+		nthreads = MAXFILEJOBS;
+	}
+	if (first < last &&
+	    (unsigned long)nthreads > (last - first) / FILECHUNK) {
+		nthreads = (last - first) / FILECHUNK;
+	}
+	if (nthreads > 1) {
+		nextfile = first;
+		lastfile = last;
+		filefunc = func;
+		for (i = 0; i < (unsigned long)nthreads; ++i) {
+			if (pthread_create(&threads[i], NULL, fileworker,
+					   NULL) != 0) {
+				break;
+			}
+		}
+		/* the files that no thread took are done below */
+		for (nthreads = i; --nthreads >= 0; ) {
+			pthread_join(threads[nthreads], NULL);
+		}
+		first = nextfile;
+	}
+#else
+	(void) jobs;		/* unused argument */
+#endif /* defined(HAVE_PTHREAD) */
+
+	for (i = first; i < last; ++i) {
+		(*func)(i);
+	}
+}
+
+/* get the status of the source files from first up to last, those that
+   already have one excepted */
+
+void
+statfiles(unsigned long first, unsigned long last)
+{
+	if (first < nfilestats) {
+		first = nfilestats;
+	}
+	if (first >= last) {
+		return;
+	}
+	filestats = myrealloc(filestats, last * sizeof(FILESTAT));
+	nfilestats = last;
+	/* the threads mostly wait for the disk or the server, so there are
+	   more of them than processors */
+	forfiles(first, last, statfile, STATJOBS);
+}
+
+/* free the status of the source files, which no longer follows the source
+   file list */
+
+void
+freefilestats(void)
+{
+	free(filestats);
+	filestats = NULL;
+	nfilestats = 0;
+}
+
+#if defined(HAVE_PTHREAD)
+
+/* file thread: takes the next chunk of files until all the files are
+   taken */
+
+static void *
+fileworker(void *arg)
+{
+	unsigned long i, end;
+
+	(void) arg;		/* unused argument */
+
+	pthread_mutex_lock(&filelock);
+	while (nextfile < lastfile) {
+		i = nextfile;
+		if ((end = i + FILECHUNK) > lastfile) {
+			end = lastfile;
+		}
+		nextfile = end;
+		pthread_mutex_unlock(&filelock);
+
+		for (; i < end; ++i) {
+			(*filefunc)(i);
+		}
+		pthread_mutex_lock(&filelock);
+	}
+	pthread_mutex_unlock(&filelock);
+	return(NULL);
+}
+#endif /* defined(HAVE_PTHREAD) */
+
+/* get the status of a source file */
+
+static void
+statfile(unsigned long fileindex)
+{
+	struct	stat statstruct;
+	FILESTAT *fs = &filestats[fileindex];
+
+	if (lstat(srcfiles[fileindex], &statstruct) == 0) {
+		fs->exists = YES;
+		fs->size = statstruct.st_size;
+		fs->mtime = statstruct.st_mtime;
+	} else {
+		fs->exists = NO;
+		fs->size = 0;
+		fs->mtime = 0;
+	}
+}
@@ -38,10 +38,21 @@
 #include "global.h"
 
 #include "build.h"
+#include "alloc.h"
 #include "scanner.h"		/* for token definitions */
 
 #include <assert.h>
 #include <regex.h>
+#if defined(HAVE_PTHREAD)
+#include <pthread.h>
+#endif
+#if defined(HAVE_MMAP)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if !defined(MAP_ANONYMOUS)
+#define	MAP_ANONYMOUS	MAP_ANON
+#endif
+#endif
 
 #if defined(HAVE_NCURSES)
 #include <ncurses.h>
@@ -57,13 +68,18 @@ static char const rcsid[] = "$Id: find.c,v 1.20 2006/08/20 19:15:54 broeker Exp
  * When the inner loop exits on the char, an outer loop will see if
  * the char is followed by a \0.  If so, it will read the next block
  * and restart the inner loop.
+ * Where possible the whole database is mapped and scanned as a single
+ * block, and the inner loops that only look for the char use memchr().
  */
 
 char	*blockp;			/* pointer to current char in block */
-char	block[BUFSIZ + 2];		/* leave room for end-of-block mark */
-int	blocklen;			/* length of disk block read */
+static	char	blockbuf[BUFSIZ + 2];	/* leave room for end-of-block mark */
+char	*block = blockbuf;		/* disk block or mapped database */
+long	blocklen;			/* length of disk block read */
 char	blockmark;			/* mark character to be searched for */
 long	blocknumber;			/* block number */
+static	char	*dbmapaddr;		/* mapped database, if any */
+static	size_t	dbmaplen;		/* length of the mapping */
 
 static	char	global[] = "<global>";	/* dummy global function name */
 static	char	cpattern[PATLEN + 1];	/* compressed pattern */
@@ -73,6 +89,62 @@ static	long	postingsfound;		/* retrieved number of postings */
 static	regex_t regexp;			/* regular expression */
 static	BOOL	isregexp_valid = NO;	/* regular expression status */
 
+int	searchjobs = 0;			/* number of text search threads */
+
+/* the source files that a text search reads, which are all of them unless
+   the trigram index rules some out */
+static	unsigned long *searchfiles;	/* source file numbers, or NULL */
+static	unsigned long nsearchfiles;	/* number of files to search */
+#define	SEARCHFILE(i)	(searchfiles != NULL ? searchfiles[i] : (i))
+
+/* In the structured line-mode output each file is sent once with an id that
+ * the references to it then give instead of its name.
+ */
+#define	RECFILEHASH	4096	/* file id hash table size */
+
+/* the matching lines of a text search start with their file and number, or
+   only the number in the structured output */
+#define	MATCHFORMAT	(recordmode == YES ? "%.0s%ld " : "%s <unknown> %ld ")
+
+static	struct recfile {	/* file sent in the structured output */
+	char	*name;
+	long	id;
+	struct	recfile *next;
+} *recfiles[RECFILEHASH];
+static	long	nrecfiles;		/* number of files sent */
+
+#if defined(HAVE_PTHREAD)
+
+/* The text searches are split by file among a pool of threads. Each file's
+ * matching lines are collected in the output buffer of a slot of a window
+ * over the source files, and written out by the main thread in source file
+ * order, after which the slot is reused.
+ * An interrupt must not jump out of the search while the threads run, so it
+ * only stops the search; the threads are joined, and the interrupt is then
+ * raised again.
+ */
+
+#define	MAXSEARCHJOBS	64	/* maximal number of search threads */
+#define	SEARCHWINDOW	256	/* files searched ahead of the output */
+
+typedef struct {		/* source file being searched */
+	TEXTBUF	output;		/* matching lines */
+	BOOL	done;		/* the search is finished */
+	BOOL	failed;		/* the file could not be opened */
+} SEARCHSLOT;
+
+static	SEARCHSLOT *searchslots;	/* window of files being searched */
+static	unsigned long nextsearch;	/* next file to search */
+static	unsigned long nextoutput;	/* next file to output */
+static	pthread_mutex_t searchlock = PTHREAD_MUTEX_INITIALIZER;
+static	pthread_cond_t searchdone = PTHREAD_COND_INITIALIZER;
+static	pthread_cond_t slotfree = PTHREAD_COND_INITIALIZER;
+static	volatile sig_atomic_t searchstop;	/* the search was interrupted */
+
+static	RETSIGTYPE stopsearch(int sig);
+static	void	*searchworker(void *arg);
+#endif /* defined(HAVE_PTHREAD) */
+
 static	BOOL	match(void);
 static	BOOL	matchrest(void);
 static	POSTING	*getposting(void);
@@ -82,6 +154,9 @@ static	void	findterm(char *pattern);
 static	void	putline(FILE *output);
 static	void	putpostingref(POSTING *p, char *pat);
 static	void	putref(int seemore, char *file, char *func);
+static	void	putrefhead(FILE *output, char *file, char *func);
+static	void	putmatches(TEXTBUF *matches, char *file);
+static	long	recordfile(char *file);
 static	void	putsource(int seemore, FILE *output);
 
 /* find the symbol in the cross-reference */
@@ -126,9 +201,7 @@ findsymbol(char *pattern)
 	for (;;) {
 		setmark('\n');
 		do {	/* innermost loop optimized to only one test */
-			while (*cp != '\n') {
-				++cp;
-			}
+			cp = findmark(cp);
 		} while (*(cp + 1) == '\0' && (cp = read_block()) != NULL);
 
 		/* skip the found character */
@@ -496,25 +569,196 @@ findstring(char *pattern)
 char *
 findregexp(char *egreppat)
 {
-    unsigned int i;
+    unsigned long i;
+    long n;
     char *egreperror;
+    EGREPSTATE *st;
+    TEXTBUF output = { NULL, 0, 0 };
+#if defined(HAVE_PTHREAD)
+    pthread_t threads[MAXSEARCHJOBS];
+    long nthreads;
+    SEARCHSLOT *slot;
+    sighandler_t savesig;
+#endif
 
     /* compile the pattern */
-    if ((egreperror = egrepinit(egreppat)) == NULL) {
+    if ((egreperror = egrepinit(egreppat)) != NULL) {
+	return(egreperror);
+    }
+    /* skip the files without the strings that every match contains */
+    searchfiles = NULL;
+    nsearchfiles = nsrcfiles;
+    if ((n = trigramfiles(&searchfiles)) >= 0) {
+	nsearchfiles = n;
+    }
+
+#if defined(HAVE_PTHREAD)
+    /* start the search threads */
+    if ((nthreads = searchjobs) == 0) {
+#if defined(_SC_NPROCESSORS_ONLN)
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    if (nthreads > MAXSEARCHJOBS) {
+	nthreads = MAXSEARCHJOBS;
+    }
+    if ((unsigned long)nthreads > nsearchfiles) {
+	nthreads = nsearchfiles;
+    }
+    if (nthreads > 1) {
+	searchslots = mycalloc(SEARCHWINDOW, sizeof(SEARCHSLOT));
+	nextsearch = 0;
+	nextoutput = 0;
+	searchstop = 0;
+	savesig = signal(SIGINT, stopsearch);
+	for (i = 0; i < (unsigned long)nthreads; ++i) {
+	    if (pthread_create(&threads[i], NULL, searchworker, NULL) != 0) {
+		break;
+	    }
+	}
+	if ((nthreads = i) == 0) {
+	    signal(SIGINT, savesig);
+	    free(searchslots);
+	    searchslots = NULL;
+	}
+    } else {
+	nthreads = 0;
+    }
 
-	/* search the files */
-	for (i = 0; i < nsrcfiles; ++i) {
-	    char *file = filepath(srcfiles[i]);
+    /* output the results of each file in turn, as its search finishes */
+    if (nthreads > 0) {
+	for (i = 0; i < nsearchfiles && searchstop == 0; ++i) {
+	    slot = &searchslots[i % SEARCHWINDOW];
+	    pthread_mutex_lock(&searchlock);
+	    /* once stopped, the threads take no more files */
+	    while (slot->done == NO && (searchstop == 0 || i < nextsearch)) {
+		pthread_cond_wait(&searchdone, &searchlock);
+	    }
+	    pthread_mutex_unlock(&searchlock);
+	    if (slot->done == NO) {
+		break;
+	    }
 
-	    progress("Search", searchcount, nsrcfiles);
-	    if (egrep(file, refsfound, "%s <unknown> %ld ") < 0) {
-		posterr ("Cannot open file %s", file);
+	    progress("Search", searchcount, nsearchfiles);
+	    if (slot->failed == YES) {
+		/* filepath() is shared with the threads */
+		pthread_mutex_lock(&searchlock);
+		posterr ("Cannot open file %s",
+			 filepath(srcfiles[SEARCHFILE(i)]));
+		pthread_mutex_unlock(&searchlock);
+	    }
+	    if (slot->output.len > 0) {
+		putmatches(&slot->output, filepath(srcfiles[SEARCHFILE(i)]));
 	    }
+
+	    pthread_mutex_lock(&searchlock);
+	    slot->output.len = 0;
+	    slot->done = NO;
+	    ++nextoutput;
+	    pthread_cond_broadcast(&slotfree);
+	    pthread_mutex_unlock(&searchlock);
+	}
+	/* stop the threads, which finish the files they are searching */
+	pthread_mutex_lock(&searchlock);
+	nextsearch = nsearchfiles;
+	pthread_cond_broadcast(&slotfree);
+	pthread_mutex_unlock(&searchlock);
+	while (--nthreads >= 0) {
+	    pthread_join(threads[nthreads], NULL);
+	}
+	for (i = 0; i < SEARCHWINDOW; ++i) {
+	    free(searchslots[i].output.text);
+	}
+	free(searchslots);
+	searchslots = NULL;
+	free(searchfiles);
+	searchfiles = NULL;
+
+	/* pass an interrupt on, now that nothing is left running */
+	signal(SIGINT, savesig);
+	if (searchstop != 0) {
+	    raise(SIGINT);
 	}
+	return(NULL);
     }
-    return(egreperror);
+#endif /* defined(HAVE_PTHREAD) */
+
+    /* search the files */
+    st = egrepalloc();
+    for (i = 0; i < nsearchfiles; ++i) {
+	char *file = filepath(srcfiles[SEARCHFILE(i)]);
+
+	progress("Search", searchcount, nsearchfiles);
+	output.len = 0;
+	if (egrep(file, st, &output, MATCHFORMAT) < 0) {
+	    posterr ("Cannot open file %s", file);
+	}
+	if (output.len > 0) {
+	    putmatches(&output, file);
+	}
+    }
+    egrepfree(st);
+    free(output.text);
+    free(searchfiles);
+    searchfiles = NULL;
+    return(NULL);
 }
 
+#if defined(HAVE_PTHREAD)
+
+/* search thread: takes the next source file while its slot in the window
+   is free, until all the files are taken */
+
+static void *
+searchworker(void *arg)
+{
+    char path[PATHLEN + 1];
+    EGREPSTATE *st;
+    SEARCHSLOT *slot;
+    BOOL failed;
+
+    (void) arg;		/* unused argument */
+
+    st = egrepalloc();
+    pthread_mutex_lock(&searchlock);
+    for (;;) {
+	while (nextsearch < nsearchfiles 
+	       && nextsearch >= nextoutput + SEARCHWINDOW) {
+	    pthread_cond_wait(&slotfree, &searchlock);
+	}
+	if (nextsearch >= nsearchfiles || searchstop != 0) {
+	    break;
+	}
+	slot = &searchslots[nextsearch % SEARCHWINDOW];
+	strncpy(path, filepath(srcfiles[SEARCHFILE(nextsearch)]), PATHLEN);
+	path[PATHLEN] = '\0';
+	++nextsearch;
+	pthread_mutex_unlock(&searchlock);
+
+	failed = egrep(path, st, &slot->output, MATCHFORMAT) < 0;
+
+	pthread_mutex_lock(&searchlock);
+	slot->failed = failed ? YES : NO;
+	slot->done = YES;
+	pthread_cond_broadcast(&searchdone);
+    }
+    /* the main thread may wait for a file that is no longer taken */
+    pthread_cond_broadcast(&searchdone);
+    pthread_mutex_unlock(&searchlock);
+    egrepfree(st);
+    return(NULL);
+}
+
+/* interrupt handler of a search in threads */
+
+static RETSIGTYPE
+stopsearch(int sig)
+{
+    signal(sig, stopsearch);
+    searchstop = 1;
+}
+#endif /* defined(HAVE_PTHREAD) */
+
 /* find matching file names */
 
 char *
@@ -533,8 +777,12 @@ findfile(char *dummy)
 	    s = srcfiles[i];
 	}
 	if (regexec (&regexp, s, (size_t)0, NULL, 0) == 0) {
-	    (void) fprintf(refsfound, "%s <unknown> 1 <unknown>\n", 
-			   srcfiles[i]);
+	    putrefhead(refsfound, srcfiles[i], "<unknown>");
+	    if (recordmode == YES) {
+		(void) fprintf(refsfound, "1%c<unknown>%c", '\0', '\0');
+	    } else {
+		(void) fputs("1 <unknown>\n", refsfound);
+	    }
 	}
     }
 
@@ -766,10 +1014,84 @@ putref(int seemore, char *file, char *func)
 	else {
 		output = nonglobalrefs;
 	}
-	(void) fprintf(output, "%s %s ", file, func);
+	putrefhead(output, file, func);
 	putsource(seemore, output);
 }
 
+/* put the file and function of a reference into the file */
+
+static void
+putrefhead(FILE *output, char *file, char *func)
+{
+	if (recordmode == YES) {
+		(void) fprintf(output, "R%ld%c%s%c", recordfile(file), '\0',
+			       func, '\0');
+		++totallines;
+	} else {
+		(void) fprintf(output, "%s %s ", file, func);
+	}
+}
+
+/* put the lines that egrep() matched in a file into the references found
+   file */
+
+static void
+putmatches(TEXTBUF *matches, char *file)
+{
+	char	*s, *end, *eol;
+
+	if (recordmode == NO) {
+		(void) fwrite(matches->text, 1, matches->len, refsfound);
+		return;
+	}
+	/* each line has its number and a space before the text */
+	s = matches->text;
+	end = s + matches->len;
+	while (s < end) {
+		if ((eol = memchr(s, '\n', end - s)) == NULL) {
+			eol = end;
+		}
+		putrefhead(refsfound, file, "<unknown>");
+		for (; s < eol && *s != ' '; ++s) {
+			(void) putc(*s, refsfound);
+		}
+		(void) putc('\0', refsfound);
+		/* a null character would end the text early */
+		for (++s; s < eol; ++s) {
+			(void) putc(*s != '\0' ? *s : ' ', refsfound);
+		}
+		(void) putc('\0', refsfound);
+		s = eol + 1;
+	}
+}
+
+/* get the id of a file in the structured output, sending its name the first
+   time */
+
+static long
+recordfile(char *file)
+{
+	struct	recfile *p;
+	int	h;
+
+	h = hash(file) % RECFILEHASH;
+	for (p = recfiles[h]; p != NULL; p = p->next) {
+		if (strcmp(p->name, file) == 0) {
+			return(p->id);
+		}
+	}
+	p = mymalloc(sizeof(struct recfile));
+	p->name = my_strdup(file);
+	p->id = nrecfiles++;
+	p->next = recfiles[h];
+	recfiles[h] = p;
+
+	/* the references may go to the non-global references file, which is
+	   appended later, so the name always goes out first */
+	(void) fprintf(refsfound, "F%ld%c%s%c", p->id, '\0', file, '\0');
+	return(p->id);
+}
+
 /* put the source line into the file */
 
 static void
@@ -802,6 +1124,17 @@ putsource(int seemore, FILE *output)
 		postfatal("Internal error: cannot get source line from database");
 		/* NOTREACHED */
 	}
+	/* the line number is a field of its own in the structured output */
+	if (recordmode == YES) {
+		while (isdigit((unsigned char) *blockp)) {
+			(void) putc(*blockp, output);
+			skiprefchar();
+		}
+		if (*blockp == ' ') {
+			skiprefchar();
+		}
+		(void) putc('\0', output);
+	}
 	/* until a double newline is found */
 	do {
 		/* skip a symbol type */
@@ -822,7 +1155,7 @@ putsource(int seemore, FILE *output)
 		putline(output);
 		if (retreat == YES) retreat = NO;
 	} while (blockp != NULL && getrefchar() != '\n');
-	(void) putc('\n', output);
+	(void) putc(recordmode == YES ? '\0' : '\n', output);
 	if (Change == YES) blockp = cp;
 }
 
@@ -904,9 +1237,7 @@ scanpast(char c)
 	setmark(c);
 	cp = blockp;
 	do {	/* innermost loop optimized to only one test */
-		while (*cp != c) {
-			++cp;
-		}
+		cp = findmark(cp);
 	} while (*(cp + 1) == '\0' && (cp = read_block()) != NULL);
 	blockp = cp;
 	if (cp != NULL) {
@@ -920,6 +1251,14 @@ scanpast(char c)
 char *
 read_block(void)
 {
+	/* the mapped database is the only block */
+	if (dbmapaddr != NULL) {
+		blockp = (blocknumber < 0) ? block : NULL;
+		blocknumber = 0;
+		block[blocklen] = blockmark;
+		block[blocklen + 1] = '\0';
+		return(blockp);
+	}
 	/* read the next block */
 	blocklen = read(symrefs, block, BUFSIZ);
 	blockp = block;
@@ -938,6 +1277,63 @@ read_block(void)
 	return(blockp);
 }
 
+/* map the whole cross-reference, so it can be scanned as a single block */
+void
+dbmap(void)
+{
+#if defined(HAVE_MMAP)
+	struct	stat	st;
+	long	pagesize;
+	size_t	len;
+	char	*addr;
+
+	dbunmap();
+	pagesize = sysconf(_SC_PAGESIZE);
+	if (fstat(symrefs, &st) == -1 || st.st_size == 0 || pagesize <= 0 ||
+	    (off_t) (size_t) st.st_size != st.st_size) {
+		return;
+	}
+	/* reserve private pages for the end-of-block mark after the data */
+	len = ((size_t) st.st_size + 2 + pagesize - 1) / pagesize * pagesize;
+	addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		return;
+	}
+	if (mmap(addr, (size_t) st.st_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_FIXED, symrefs, 0) == MAP_FAILED) {
+		(void) munmap(addr, len);
+		return;
+	}
+#if defined(HAVE_MADVISE)
+	/* searches without the inverted index read it from start to end */
+	if (invertedindex == NO) {
+		(void) madvise(addr, (size_t) st.st_size, MADV_SEQUENTIAL);
+	}
+#endif
+	dbmapaddr = addr;
+	dbmaplen = len;
+	block = addr;
+	blocklen = st.st_size;
+	blocknumber = -1;
+#endif
+}
+
+/* release the mapped cross-reference, if any */
+void
+dbunmap(void)
+{
+#if defined(HAVE_MMAP)
+	if (dbmapaddr != NULL) {
+		(void) munmap(dbmapaddr, dbmaplen);
+		dbmapaddr = NULL;
+	}
+#endif
+	block = blockbuf;
+	blocklen = 0;
+	blocknumber = -1;
+}
+
 static char	*
 lcasify(char *s)
 {
@@ -1155,6 +1551,13 @@ dbseek(long offset)
 	long	n;
 	int	rc = 0;
 	
+	if (dbmapaddr != NULL) {
+		if (blocknumber < 0) {
+			(void) read_block();
+		}
+		blockp = block + (offset < blocklen ? offset : blocklen);
+		return(rc);
+	}
 	if ((n = offset / BUFSIZ) != blocknumber) {
 		if ((rc = lseek(symrefs, n * BUFSIZ, 0)) == -1) {
 			myperror("Lseek failed");
@@ -1170,9 +1573,22 @@ dbseek(long offset)
 	return(rc);
 }
 
+/* get the cross-reference offset of the current character */
+
+long
+dbtell(void)
+{
+	if (dbmapaddr != NULL) {
+		return(blockp - block);
+	}
+	return(blocknumber * BUFSIZ + (blockp - block));
+}
+
 static void
 findcalledbysub(char *file, BOOL macro)
 {
+	char	function[PATLEN + 1];	/* called function name */
+
 	/* find the next function call or the end of this function */
 	while (scanpast('\t') != NULL) {
 		switch (*blockp) {
@@ -1187,13 +1603,10 @@ findcalledbysub(char *file, BOOL macro)
 		
 		case FCNCALL:		/* function call */
 
-			/* output the file name */
-			(void) fprintf(refsfound, "%s ", file);
-
-			/* output the function name */
+			/* output the file and function names */
 			skiprefchar();
-			putline(refsfound);
-			(void) putc(' ', refsfound);
+			fetch_string_from_dbase(function, sizeof(function));
+			putrefhead(refsfound, file, function);
 
 			/* output the source line */
 			putsource(1, refsfound);
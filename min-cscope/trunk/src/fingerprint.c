@@ -0,0 +1,362 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	content fingerprints of the source files
+ *
+ *	A source file modified after the cross-reference is normally
+ *	cross-referenced again, even when only its time has changed, as after
+ *	a checkout or a touch. With the -H option, the fingerprint file
+ *	records the size, modification time and a hash of the contents of
+ *	each source file, and a modified file whose contents hash the same is
+ *	taken as unchanged. Only the files whose size or time differ from
+ *	their record are read to hash them again, several at a time.
+ *
+ *	The fingerprint file is a text file with a header line, followed by
+ *	a line with the hash, size, time and name of each source file. It is
+ *	removed while the cross-reference is rebuilt, so that it never
+ *	describes contents that the cross-reference does not have.
+ */
+
+#include "global.h"
+#include "build.h"
+#include "alloc.h"
+#include "library.h"
+
+#define	FPVERSION	1		/* fingerprint file format version */
+#define	FPREAD		65536		/* source file read size */
+#define	FNVBASIS	14695981039346656037ULL	/* FNV-1a offset basis */
+#define	FNVPRIME	1099511628211ULL	/* FNV-1a prime */
+
+typedef struct {		/* source file fingerprint */
+	char	*file;		/* source file name */
+	unsigned long long hash; /* hash of the contents */
+	long	size;		/* file size */
+	long	mtime;		/* modification time */
+	BOOL	valid;		/* the file could be read */
+	BOOL	read;		/* the file was read by the last scan */
+} FINGERPRINT;
+
+static	FINGERPRINT *oldprints;		/* records of the fingerprint file */
+static	unsigned long noldprints;	/* number of old records */
+static	unsigned long *oldtable;	/* hash table of the old records */
+static	unsigned long oldtablesize;	/* hash table size, a power of 2 */
+static	FINGERPRINT *newprints;		/* records of the source files */
+static	unsigned long nnewprints;	/* number of new records */
+static	unsigned long hashed;		/* files whose contents were read */
+
+static	unsigned long long fnv(unsigned long long h, unsigned char *s,
+			       size_t len);
+static	FINGERPRINT *fpfind(char *file);
+static	BOOL	fphash(char *file, unsigned long long *hp);
+static	void	fprecord(unsigned long fileindex);
+static	BOOL	fpsame(FINGERPRINT *fp, FINGERPRINT *old);
+
+/* read the fingerprint file, if there is one */
+
+void
+fingerprintload(void)
+{
+	FILE	*fp;
+	char	name[PATHLEN + 1];
+	unsigned long long hash;
+	long	size, mtime;
+	unsigned long count, i, h;
+	int	version;
+
+	fingerprintfree();
+	if ((fp = myfopen(fpname, "r")) == NULL) {
+		return;
+	}
+	if (fscanf(fp, "cscope fingerprints %d %lu", &version, &count) != 2 ||
+	    version != FPVERSION) {
+		fclose(fp);
+		return;
+	}
+	oldprints = mymalloc((count + 1) * sizeof(FINGERPRINT));
+	for (i = 0; i < count; ++i) {
+		if (fscanf(fp, "%llx %ld %ld %" PATHLEN_STR "[^\n]",
+			   &hash, &size, &mtime, name) != 4) {
+			break;
+		}
+		oldprints[i].file = my_strdup(name);
+		oldprints[i].hash = hash;
+		oldprints[i].size = size;
+		oldprints[i].mtime = mtime;
+		oldprints[i].valid = YES;
+	}
+	noldprints = i;
+	fclose(fp);
+
+	/* index the records by name, with open addressing */
+	for (oldtablesize = 64; oldtablesize < 2 * noldprints;
+	     oldtablesize *= 2) {
+		;
+	}
+	oldtable = mycalloc(oldtablesize, sizeof(unsigned long));
+	for (i = 0; i < noldprints; ++i) {
+		h = fnv(FNVBASIS, (unsigned char *)oldprints[i].file,
+			strlen(oldprints[i].file));
+		for (h &= oldtablesize - 1; oldtable[h] != 0;
+		     h = (h + 1) & (oldtablesize - 1)) {
+			;
+		}
+		oldtable[h] = i + 1;
+	}
+}
+
+/* record the fingerprints of the source files from first up to last, those
+   already recorded excepted; the files are read in parallel */
+
+void
+fingerprintscan(unsigned long first, unsigned long last)
+{
+	unsigned long i;
+
+	if (first < nnewprints) {
+		first = nnewprints;
+	}
+	if (first >= last) {
+		return;
+	}
+	newprints = myrealloc(newprints, last * sizeof(FINGERPRINT));
+	for (i = first; i < last; ++i) {
+		newprints[i].file = srcfiles[i];
+		newprints[i].valid = NO;
+	}
+	nnewprints = last;
+
+	statfiles(first, last);
+	forfiles(first, last, fprecord, 0);
+	for (i = first; i < last; ++i) {
+		if (newprints[i].read == YES) {
+			++hashed;
+		}
+	}
+}
+
+/* see if the contents of a recorded source file are the same as when the
+   old fingerprint file was written */
+
+BOOL
+fingerprintsame(unsigned long fileindex)
+{
+	if (fileindex >= nnewprints) {
+		return(NO);
+	}
+	return(fpsame(&newprints[fileindex], fpfind(srcfiles[fileindex])));
+}
+
+/* see if the recorded source files differ from those of the old
+   fingerprint file, in their list or their records */
+
+BOOL
+fingerprintschanged(void)
+{
+	unsigned long i;
+
+	if (nnewprints != noldprints) {
+		return(YES);
+	}
+	for (i = 0; i < nnewprints; ++i) {
+		FINGERPRINT *old = fpfind(newprints[i].file);
+
+		if (fpsame(&newprints[i], old) == NO ||
+		    newprints[i].mtime != old->mtime) {
+			return(YES);
+		}
+	}
+	return(NO);
+}
+
+/* get the number of files whose contents were read by the last scans */
+
+unsigned long
+fingerprintshashed(void)
+{
+	return(hashed);
+}
+
+/* write the fingerprints of the recorded source files; returns NO if the
+   file cannot be written */
+
+BOOL
+fingerprintsave(char *name)
+{
+	FILE	*fp;
+	unsigned long i, count = 0;
+	BOOL	status = YES;
+
+	if ((fp = myfopen(name, "w")) == NULL) {
+		return(NO);
+	}
+	for (i = 0; i < nnewprints; ++i) {
+		if (newprints[i].valid == YES) {
+			++count;
+		}
+	}
+	if (fprintf(fp, "cscope fingerprints %d %lu\n", FPVERSION, count) < 0) {
+		status = NO;
+	}
+	for (i = 0; i < nnewprints && status == YES; ++i) {
+		if (newprints[i].valid == YES &&
+		    fprintf(fp, "%016llx %ld %ld %s\n", newprints[i].hash,
+			    newprints[i].size, newprints[i].mtime,
+			    newprints[i].file) < 0) {
+			status = NO;
+		}
+	}
+	if (fclose(fp) == EOF) {
+		status = NO;
+	}
+	if (status == NO) {
+		(void) unlink(name);
+	}
+	return(status);
+}
+
+/* free the old and new records */
+
+void
+fingerprintfree(void)
+{
+	unsigned long i;
+
+	for (i = 0; i < noldprints; ++i) {
+		free(oldprints[i].file);
+	}
+	free(oldprints);
+	free(oldtable);
+	free(newprints);
+	oldprints = NULL;
+	noldprints = 0;
+	oldtable = NULL;
+	oldtablesize = 0;
+	newprints = NULL;
+	nnewprints = 0;
+	hashed = 0;
+}
+
+/* add bytes to an FNV-1a hash */
+
+static unsigned long long
+fnv(unsigned long long h, unsigned char *s, size_t len)
+{
+	unsigned char *end = s + len;
+
+	while (s < end) {
+		h = (h ^ *s++) * FNVPRIME;
+	}
+	return(h);
+}
+
+/* find the old record of a source file */
+
+static FINGERPRINT *
+fpfind(char *file)
+{
+	unsigned long h;
+
+	if (oldtablesize == 0) {
+		return(NULL);
+	}
+	h = fnv(FNVBASIS, (unsigned char *)file, strlen(file));
+	for (h &= oldtablesize - 1; oldtable[h] != 0;
+	     h = (h + 1) & (oldtablesize - 1)) {
+		if (strcmp(oldprints[oldtable[h] - 1].file, file) == 0) {
+			return(&oldprints[oldtable[h] - 1]);
+		}
+	}
+	return(NULL);
+}
+
+/* hash the contents of a source file */
+
+static BOOL
+fphash(char *file, unsigned long long *hp)
+{
+	unsigned char buf[FPREAD];
+	unsigned long long h = FNVBASIS;
+	ssize_t	len;
+	int	fd;
+
+	if ((fd = open(file, O_RDONLY | O_BINARY)) == -1) {
+		return(NO);
+	}
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		h = fnv(h, buf, len);
+	}
+	close(fd);
+	if (len < 0) {
+		return(NO);
+	}
+	*hp = h;
+	return(YES);
+}
+
+/* record the size, time and hash of a source file, taking the hash of its
+   old record if the size and time are the same */
+
+static void
+fprecord(unsigned long fileindex)
+{
+	FINGERPRINT *fp = &newprints[fileindex];
+	FILESTAT *fs = &filestats[fileindex];
+	FINGERPRINT *old;
+
+	fp->read = NO;
+	if (fs->exists == NO) {
+		return;
+	}
+	fp->size = fs->size;
+	fp->mtime = fs->mtime;
+	if ((old = fpfind(fp->file)) != NULL &&
+	    old->size == fp->size && old->mtime == fp->mtime) {
+		fp->hash = old->hash;
+		fp->valid = YES;
+		return;
+	}
+	fp->valid = fphash(fp->file, &fp->hash);
+	fp->read = YES;
+}
+
+/* see if a new record has the same contents as an old one */
+
+static BOOL
+fpsame(FINGERPRINT *fp, FINGERPRINT *old)
+{
+	if (old == NULL || fp->valid == NO) {
+		return(NO);
+	}
+	return(fp->size == old->size && fp->hash == old->hash ? YES : NO);
+}
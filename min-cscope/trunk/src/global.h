@@ -205,12 +205,14 @@ extern	BOOL	editallprompt;	/* prompt between editing files */
 extern	unsigned int fileargc;	/* file argument count */
 extern	char	**fileargv;	/* file argument values */
 extern	int	fileversion;	/* cross-reference file version */
+extern	BOOL	fingerprints;	/* detect changed files by their contents */
 extern	BOOL	incurses;	/* in curses */
 extern	BOOL	invertedindex;	/* the database has an inverted index */
 extern	BOOL	isuptodate;	/* consider the crossref up-to-date */
 extern	BOOL	kernelmode;	/* don't use DFLT_INCDIR - bad for kernels */
 extern	BOOL	linemode;	/* use line oriented user interface */
 extern	BOOL	verbosemode;	/* print extra information on line mode */
+extern	BOOL	recordmode;	/* structured output in line mode */
 extern	BOOL	recurse_dir;	/* recurse dirs when searching for src files */
 extern	char	*namefile;	/* file of file names */
 extern	BOOL	ogs;		/* display OGS book and subsystem names */
@@ -218,7 +220,9 @@ extern	char	*prependpath;	/* prepend path to file names */
 extern	FILE	*refsfound;	/* references found file */
 extern	char	temp1[];	/* temporary file name */
 extern	char	temp2[];	/* temporary file name */
+extern	char	tempdirpv[];	/* private temp directory */
 extern	long	totalterms;	/* total inverted index terms */
+extern	BOOL	trigramindex;	/* build a trigram index */
 extern	BOOL	trun_syms;	/* truncate symbols to 8 characters */
 extern	char	tempstring[TEMPSTRING_LEN + 1]; /* global dummy string buffer */
 extern	char	*tmpdir;	/* temporary directory */
@@ -237,8 +241,14 @@ extern	long	dboffset;	/* new database offset */
 extern	BOOL	errorsfound;	/* prompt before clearing error messages */
 extern	long	lineoffset;	/* source line database offset */
 extern	long	npostings;	/* number of postings */
+extern	struct segment *segments; /* file data in the database */
+extern	unsigned long nsegments; /* number of file data segments */
 extern	unsigned long symbols;	/* number of symbols */
 
+/* parxref.c global data */
+extern	int	buildjobs;	/* number of cross-referencing processes */
+extern	BOOL	buildworker;	/* this is a cross-referencing process */
+
 /* dir.c global data */
 extern	char	currentdir[];	/* current directory */
 extern	char	**incdirs;	/* #include directories */
@@ -269,11 +279,12 @@ extern	unsigned int totallines; /* total reference lines */
 extern	const char dispchars[];	/* display chars for jumping to lines */
 
 /* find.c global data */
-extern	char	block[];	/* cross-reference file block */
+extern	int	searchjobs;	/* number of search threads, 0 for one per processor */
+extern	char	*block;		/* cross-reference file block */
 extern	char	blockmark;	/* mark character to be searched for */
 extern	long	blocknumber;	/* block number */
 extern	char	*blockp;	/* pointer to current character in block */
-extern	int	blocklen;	/* length of disk block read */
+extern	long	blocklen;	/* length of disk block read */
 
 /* lookup.c global data */
 extern	struct	keystruct {
@@ -289,6 +300,33 @@ extern	BOOL	mouse;		/* mouse interface */
 extern	BOOL	unixpcmouse;		/* UNIX PC mouse interface */
 #endif
 
+/* growable text buffer */
+typedef struct {
+	char	*text;
+	long	len;
+	long	size;
+} TEXTBUF;
+
+/* a source file's data in the cross-reference, from its file mark up to the
+   next file mark */
+typedef struct segment {
+	long	offset;		/* file mark offset */
+	long	length;		/* data length */
+	char	*file;		/* source file name */
+} SEGMENT;
+
+typedef struct egrepstate EGREPSTATE;	/* text search state, see egrep.y */
+
+/* status of a source file, see filestat.c */
+typedef struct {
+	BOOL	exists;		/* the status could be read */
+	long	size;		/* file size */
+	long	mtime;		/* modification time */
+} FILESTAT;
+
+/* filestat.c global data */
+extern	FILESTAT *filestats;	/* status of each source file */
+
 /* cscope functions called from more than one function or between files */ 
 
 char	*filepath(char *file);
@@ -320,6 +358,9 @@ void	clearmsg(void);
 void	clearmsg2(void);
 void	countrefs(void);
 void	crossref(char *srcfile);
+BOOL	crossrefbody(char *srcfile);
+void	dbmap(void);
+void	dbunmap(void);
 void    dispinit(void);
 void	display(void);
 void	drawscrollbar(int top, int bot);
@@ -329,6 +370,12 @@ void	editref(int);
 void	entercurses(void);
 void	exitcurses(void);
 void	findcleanup(void);
+void	fingerprintfree(void);
+void	fingerprintload(void);
+void	fingerprintscan(unsigned long first, unsigned long last);
+void	forfiles(unsigned long first, unsigned long last,
+		 void (*func)(unsigned long fileindex), int jobs);
+void	freefilestats(void);
 void    freesrclist(void);
 void    freeinclist(void);
 void    freecrossref(void);
@@ -352,34 +399,54 @@ void	postmsg2(char *msg);
 void	posterr(char *msg,...);
 void	postfatal(const char *msg,...);
 void	putposting(char *term, int type);
+void	putrecordend(unsigned int count);
+void	writeposting(char *term, int type, long lineoff, long offset);
 void	fetch_string_from_dbase(char *, size_t);
 void	resetcmd(void);
+void	trigramload(void);
 void	seekline(unsigned int line);
 void	setfield(void);
+void	statfiles(unsigned long first, unsigned long last);
 void	shellpath(char *out, int limit, char *in);
 void    sourcedir(char *dirlist);
 void	myungetch(int c);
 void	warning(char *text);
+void	workerinclude(char *file, char *type);
+void	workerposting(char *term, int type, long lineoff, long offset);
 void	writestring(char *s);
+void	xrefflush(void);
+void	xrefstop(void);
+void	xrefsubmit(char *file);
 
 BOOL	command(int commandc);
+BOOL	fingerprintsame(unsigned long fileindex);
+BOOL	fingerprintsave(char *name);
+BOOL	fingerprintschanged(void);
 BOOL	infilelist(char *file);
 BOOL	readrefs(char *filename);
 BOOL	search(void);
+BOOL	trigrammake(char *name, BOOL (*kept)(char *file));
 BOOL	writerefsfound(void);
+BOOL	xrefstart(int jobs);
 
 FINDINIT findinit(char *pattern);
 MOUSE	*getmouseaction(char leading_char);
+SEGMENT	*addsegment(long offset, long length, char *file);
 struct	cmd *currentcmd(void);
 struct	cmd *prevcmd(void);
 struct	cmd *nextcmd(void);
 
-int	egrep(char *file, FILE *output, char *format);
+EGREPSTATE *egrepalloc(void);
+void	egrepfree(EGREPSTATE *st);
+int	egrep(char *file, EGREPSTATE *st, TEXTBUF *output, char *format);
 int	mygetline(char p[], char s[], unsigned size, int firstchar, BOOL iscaseless);
 int	mygetch(void);
 int	hash(char *ss);
 int	execute(char *a, ...);
 long	dbseek(long offset);
+long	dbtell(void);
+long	trigramfiles(unsigned long **filesp);
+unsigned long fingerprintshashed(void);
 
 
 #endif /* CSCOPE_GLOBAL_H */
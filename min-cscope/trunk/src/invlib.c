@@ -43,6 +43,10 @@
 #include "invlib.h"
 #include "global.h"
 #include "sort.h"
+#if defined(HAVE_MMAP)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include <assert.h>
 
@@ -53,7 +57,9 @@
 #define	SETINC		100     /* posting set size increment */
 #define	SUPERINC	10000   /* super index size increment */
 #define	TERMMAX		512     /* term max size */
-#define	FMTVERSION	1       /* inverted index format version */
+#define	FMTVERSION	2       /* inverted index format version */
+#define	FMTVERSION1	1       /* format with uncompressed postings */
+#define	MAXPOSTBYTES	31      /* maximum size of a compressed posting */
 #define	ZIPFSIZE	200     /* zipf curve size */
 
 static char const rcsid[] =
@@ -68,7 +74,19 @@ int invbreak;
 
 static int boolready(void);
 static int invnewterm(void);
+static long invnextposting(void *infile, char **termp, POSTING * posting);
+static int invaddposting(char *term, POSTING * posting);
+static long invfileindex(long offset);
+static long involdterm(INVCONTROL * invcntl, char *term, POSTING ** postp);
 static void invstep(INVCONTROL * invcntl);
+static void invgetblk(INVCONTROL * invcntl, long blk);
+static char *invmapfile(FILE * file, long *sizep);
+static void invunmap(INVCONTROL * invcntl);
+static void invwillneed(char *map, long offset, long len);
+static long invencode(POSTING * post, long num);
+static int invdecode(unsigned char *s, unsigned char *end, POSTING * post,
+                     long num);
+static POSTING *invgetpostings(INVCONTROL * invcntl, long offset, long num);
 static void invcannotalloc(unsigned n);
 static void invcannotopen(char *file);
 static void invcannotwrite(char *file);
@@ -80,15 +98,19 @@ int showzipf;                   /* show postings per term distribution */
 static POSTING *item, *enditem, *item1 = NULL, *item2 = NULL;
 static unsigned setsize1, setsize2;
 static long numitems, totterm, zerolong;
+static unsigned postsize;
 static char *indexfile, *postingfile;
 static FILE *outfile, *fpost;
 static unsigned supersize = SUPERINC, supintsize;
-static unsigned int numpost, numlogblk, amtused, nextpost;
+static unsigned int numpost, numlogblk, amtused;
+static unsigned long nextpost;
 static unsigned int lastinblk, numinvitems;
 static POSTING *POST, *postptr;
 static unsigned long *SUPINT, *supint, nextsupfing;
 static char *SUPFING, *supfing;
 static char thisterm[TERMMAX];
+static unsigned char *encbuf;
+static long encsize;
 typedef union logicalblk
 {
     long invblk[BLOCKSIZE / sizeof(long)];
@@ -98,36 +120,42 @@ static t_logicalblk logicalblk;
 
 #if !defined(NSTATS)
 static long totpost;
+static unsigned maxtermlen;
 #endif /* !defined(NSTATS) */
 
+#if defined(USE_SORTLIB)
+#define END_OF_TERM_CHAR '\0'
+#else
+#define END_OF_TERM_CHAR '\n'
+#endif /* defined(USE_SORTLIB) */
+
 #if !defined(NSTATS)
 static int zipf[ZIPFSIZE + 1];
 #endif /* !defined(NSTATS) */
 
 long invmake(char *invname, char *invpost, void *infile)
 {
-    char *s;
+    return (invmerge(invname, invpost, infile, NULL, NULL));
+}
+
+/* make an inverted index from the sorted postings in infile, merged with the
+   postings of the old index that keep() accepts, if there is an old index */
+long invmerge(char *invname, char *invpost, void *infile,
+              INVCONTROL * oldinv, int (*keep)(POSTING *))
+{
+    char *term;
     long num;
     int i;
-    long fileindex = 0;         /* initialze, to avoid warning */
-    unsigned postsize = POSTINC * sizeof(POSTING);
     unsigned long *intptr;
-#if !defined(USE_SORTLIB)
-    char linebuf[TERMMAX];
-#endif /* !defined(USE_SORTLIB) */
-    char *line;
     long tlong;
     PARAM param;
-    POSTING posting;
+    POSTING posting, *oldpost = NULL;
+    char oldterm[TERMMAX];
+    long oldnum = -1, newnum;
     char temp[BLOCKSIZE];
 #if !defined(NSTATS)
     int j;
-    unsigned maxtermlen = 0;
 #endif /* !defined(NSTATS) */
-#if defined(USE_SORTLIB)
-    file_itr_t itr;
-    u32 len;
-#endif /* defined(USE_SORTLIB) */
     /* output file */
     if ((outfile = vpfopen(invname, "w+b")) == NULL) {
         invcannotopen(invname);
@@ -144,6 +172,7 @@ long invmake(char *invname, char *invpost, void *infile)
     postingfile = invpost;
     nextpost = 0;
     /* get space for the postings list */
+    postsize = POSTINC * sizeof(POSTING);
     if ((POST = malloc(postsize)) == NULL) {
         invcannotalloc(postsize);
         return (0);
@@ -172,128 +201,56 @@ long invmake(char *invname, char *invpost, void *infile)
     nextsupfing = 2;
 #if !defined(NSTATS)
     totpost = 0L;
+    maxtermlen = 0;
 #endif /* !defined(NSTATS) */
     totterm = 0L;
     numpost = 1;
 
     /* set up as though a block had come and gone, i.e., set up for new block  */
-    /* FIXME HBB: magic number alert (16) */
-    amtused = 16;               /* leave no space - init 3 words + one for luck */
+    amtused = 4 * sizeof(long); /* leave no space - init 3 words + one for luck */
     numinvitems = 0;
     numlogblk = 0;
     lastinblk = sizeof(t_logicalblk);
 
-    /* now loop as long as more to read (till eof)  */
 #if defined(USE_SORTLIB)
-#define END_OF_TERM_CHAR '\0'
-    itr = file_itr_init((file_t) infile);
-    if (itr == NULL)
+    if ((infile = file_itr_init((file_t) infile)) == NULL)
         return 0;
-
-    while (file_itr_next(itr, &line, &len) == 0) {
-#else
-#define END_OF_TERM_CHAR '\n'
-    while (fgets(linebuf, TERMMAX, (FILE *) infile) != NULL) {
-        line = linebuf;
 #endif /* defined(USE_SORTLIB) */
-#if !defined(NSTATS)
-        ++totpost;
-#endif /* !defined(NSTATS) */
-        s = strchr(line, SEP);
-        if (s != NULL) {
-            *s = '\0';
-        }
-        else {
-            continue;
-        }
-#if! defined(NSTATS)
-        if ((i = strlen(line)) > maxtermlen) {
-            maxtermlen = i;
-        }
-#endif /* !defined(NSTATS) */
-#if !defined(NDEBUG) && !defined(NSTATS)
-        printf("%ld: %s ", totpost, line);
-        fflush(stdout);
-#endif /* !defined(NDEBUG) && !defined(NSTATS) */
-        if (strcmp(thisterm, line) == 0) {
-            if (postptr + 10 > POST + postsize / sizeof(POSTING)) {
-                i = postptr - POST;
-                postsize += POSTINC * sizeof(POSTING);
-                if ((POST = realloc(POST, postsize)) == NULL) {
-                    invcannotalloc(postsize);
-                    return (0);
+    /* start before the first term of the old index */
+    if (oldinv != NULL) {
+        invgetblk(oldinv, 0);
+        oldinv->keypnt = 0;
+        oldnum = involdterm(oldinv, oldterm, &oldpost);
+    }
+    /* now loop as long as more to read (till eof)  */
+    newnum = invnextposting(infile, &term, &posting);
+    while (newnum > 0 || oldnum >= 0) {
+        /* the old postings of a term come before its new ones, which are
+           all further on in the database */
+        if (oldnum >= 0 && (newnum == 0 || strcmp(oldterm, term) <= 0)) {
+            for (num = 0; num < oldnum; ++num) {
+                if (keep(&oldpost[num])) {
+                    oldpost[num].fileindex =
+                        invfileindex(oldpost[num].lineoffset);
+                    if (!invaddposting(oldterm, &oldpost[num])) {
+                        return (0);
+                    }
                 }
-                postptr = i + POST;
-#if !defined(NDEBUG) && !defined(NSTATS)
-                printf("reallocated post space to %u, totpost=%ld\n",
-                       postsize, totpost);
-#endif /* !defined(NDEBUG) && !defined(NSTATS) */
             }
-            numpost++;
+            oldnum = involdterm(oldinv, oldterm, &oldpost);
         }
         else {
-            /* have a new term */
-            if (!invnewterm()) {
+            if (!invaddposting(term, &posting)) {
                 return (0);
             }
-            strcpy(thisterm, line);
-            numpost = 1;
-            postptr = POST;
-            fileindex = 0;
-        }
-        /* get the new posting */
-        num = *++s - '!';
-        i = 1;
-        do {
-            num = BASE * num + *++s - '!';
-        } while (++i < PRECISION);
-        posting.lineoffset = num;
-        /* find the index of the file matching the term offset */
-        {
-            int low, high, mid;
-
-            /* initialize a binary search */
-            low = -1;
-            high = nsrcoffset;
-
-            /* perform a search for the closest value lower/equal to num */
-            while ((high - low) > 1) {
-                mid = (low + high) / 2;
-                if (num == srcoffset[mid]) {
-                    fileindex = mid;
-                    break;
-                }
-                else if (num > srcoffset[mid]) {
-                    fileindex = mid;
-                    low = mid;
-                }
-                else {
-                    high = mid;
-                }
-            }
-        }
-        posting.fileindex = fileindex;
-        posting.type = *++s;
-        num = *++s - '!';
-        if (*s != END_OF_TERM_CHAR) {
-            num = *++s - '!';
-            while (*++s != END_OF_TERM_CHAR) {
-                num = BASE * num + *s - '!';
-            }
-            posting.fcnoffset = num;
-        }
-        else {
-            posting.fcnoffset = 0;
+            newnum = invnextposting(infile, &term, &posting);
         }
-        *postptr++ = posting;
-#if !defined(NDEBUG)
-        printf("%ld %ld %ld %ld\n", posting.fileindex,
-               posting.fcnoffset, posting.lineoffset, posting.type);
-        fflush(stdout);
-#endif /* !defined(NDEBUG) */
+    }
+    if (oldnum < -1) {
+        return (0);
     }
 #if defined(USE_SORTLIB)
-    file_itr_finish(itr);
+    file_itr_finish((file_itr_t) infile);
 #endif /* defined(USE_SORTLIB) */
     if (!invnewterm()) {
         return (0);
@@ -370,8 +327,8 @@ cannotwrite:
     --totterm;                  /* don't count null term */
 #if !defined(NSTATS)
     printf
-        ("logical blocks = %d, postings = %ld, terms = %ld, max term length = %d\n",
-         numlogblk, totpost, totterm, maxtermlen);
+        ("logical blocks = %d, postings = %ld (%lu bytes), terms = %ld, max term length = %d\n",
+         numlogblk, totpost, nextpost, totterm, maxtermlen);
     if (showzipf) {
         printf("\n*************   ZIPF curve  ****************\n");
         for (j = ZIPFSIZE; j > 1; j--)
@@ -392,11 +349,162 @@ cannotwrite:
     return (totterm);
 }
 
+/* get the next posting from the sorted postings file; returns 0 at the end */
+
+static long invnextposting(void *infile, char **termp, POSTING * posting)
+{
+    char *s;
+    long num;
+    int i;
+#if defined(USE_SORTLIB)
+    char *line;
+    u32 len;
+
+    while (file_itr_next((file_itr_t) infile, &line, &len) == 0) {
+#else
+    static char line[TERMMAX];
+
+    while (fgets(line, TERMMAX, (FILE *) infile) != NULL) {
+#endif /* defined(USE_SORTLIB) */
+        s = strchr(line, SEP);
+        if (s != NULL) {
+            *s = '\0';
+        }
+        else {
+            continue;
+        }
+        /* get the new posting */
+        num = *++s - '!';
+        i = 1;
+        do {
+            num = BASE * num + *++s - '!';
+        } while (++i < PRECISION);
+        posting->lineoffset = num;
+        posting->fileindex = invfileindex(num);
+        posting->type = *++s;
+        num = *++s - '!';
+        if (*s != END_OF_TERM_CHAR) {
+            num = *++s - '!';
+            while (*++s != END_OF_TERM_CHAR) {
+                num = BASE * num + *s - '!';
+            }
+            posting->fcnoffset = num;
+        }
+        else {
+            posting->fcnoffset = 0;
+        }
+        *termp = line;
+        return (1);
+    }
+    return (0);
+}
+
+/* add a posting of a term; the terms must come in sorted order */
+
+static int invaddposting(char *term, POSTING * posting)
+{
+    int i;
+
+#if !defined(NSTATS)
+    ++totpost;
+    if ((i = strlen(term)) > maxtermlen) {
+        maxtermlen = i;
+    }
+#endif /* !defined(NSTATS) */
+#if !defined(NDEBUG) && !defined(NSTATS)
+    printf("%ld: %s ", totpost, term);
+    fflush(stdout);
+#endif /* !defined(NDEBUG) && !defined(NSTATS) */
+    if (strcmp(thisterm, term) == 0) {
+        if (postptr + 10 > POST + postsize / sizeof(POSTING)) {
+            i = postptr - POST;
+            postsize += POSTINC * sizeof(POSTING);
+            if ((POST = realloc(POST, postsize)) == NULL) {
+                invcannotalloc(postsize);
+                return (0);
+            }
+            postptr = i + POST;
+#if !defined(NDEBUG) && !defined(NSTATS)
+            printf("reallocated post space to %u, totpost=%ld\n",
+                   postsize, totpost);
+#endif /* !defined(NDEBUG) && !defined(NSTATS) */
+        }
+        numpost++;
+    }
+    else {
+        /* have a new term */
+        if (!invnewterm()) {
+            return (0);
+        }
+        strcpy(thisterm, term);
+        numpost = 1;
+        postptr = POST;
+    }
+    *postptr++ = *posting;
+#if !defined(NDEBUG)
+    printf("%ld %ld %ld %ld\n", posting->fileindex,
+           posting->fcnoffset, posting->lineoffset, posting->type);
+    fflush(stdout);
+#endif /* !defined(NDEBUG) */
+    return (1);
+}
+
+/* find the index of the file matching the term offset */
+
+static long invfileindex(long offset)
+{
+    int low, high, mid;
+    long fileindex = 0;
+
+    if (nsrcoffset == 0) {
+        return (0);
+    }
+    /* initialize a binary search */
+    low = -1;
+    high = nsrcoffset;
+
+    /* perform a search for the closest value lower/equal to offset */
+    while ((high - low) > 1) {
+        mid = (low + high) / 2;
+        if (offset == srcoffset[mid]) {
+            fileindex = mid;
+            break;
+        }
+        else if (offset > srcoffset[mid]) {
+            fileindex = mid;
+            low = mid;
+        }
+        else {
+            high = mid;
+        }
+    }
+    return (srcfileindex[fileindex]);
+}
+
+/* get the next term of an old index and its postings; returns the number of
+   postings, -1 after the last term, or -2 if the postings cannot be read */
+
+static long involdterm(INVCONTROL * invcntl, char *term, POSTING ** postp)
+{
+    long num;
+
+    if (!invforward(invcntl)) {
+        return (-1);
+    }
+    invterm(invcntl, term);
+    boolclear();
+    if ((*postp = boolfile(invcntl, &num, BOOL_OR)) == NULL) {
+        return (-2);
+    }
+    return (num);
+}
+
 /* add a term to the data base */
 
 static int invnewterm(void)
 {
     int backupflag, i, j, holditems, gooditems, howfar;
+    long postlen;
     unsigned int maxback, len, numwilluse, wdlen;
     char *tptr, *tptr2, *tptr3;
 
@@ -460,7 +568,7 @@ static int invnewterm(void)
         while (maxback-- > 1) {
             howfar++;
             iteminfo.packword[0] =
-                logicalblk.invblk[--holditems * 2 + (sizeof(long) - 1)];
+                logicalblk.invblk[--holditems * 2 + 3];
             if ((i = iteminfo.e.size / 10) < maxback) {
                 maxback = i;
                 backupflag = howfar;
@@ -481,7 +589,7 @@ static int invnewterm(void)
             invcannotwrite(indexfile);
             return (0);
         }
-        amtused = 16;
+        amtused = 4 * sizeof(long);
         numlogblk++;
         /* check if had to back up, if so do it */
         if (backupflag) {
@@ -512,7 +620,7 @@ static int invnewterm(void)
             while (tptr3 > tptr)
                 *--tptr2 = *--tptr3;
             lastinblk -= j;
-            amtused += (8 * backupflag + j);
+            amtused += (2 * sizeof(long) * backupflag + j);
             for (i = 3; i < (backupflag * 2 + 2); i += 2) {
                 iteminfo.packword[0] = logicalblk.invblk[i];
                 iteminfo.e.offset += (tptr2 - tptr3);
@@ -541,11 +649,14 @@ static int invnewterm(void)
     amtused += numwilluse;
     logicalblk.invblk[(lastinblk / sizeof(long)) + wdlen] = nextpost;
     if ((i = postptr - POST) > 0) {
-        if (fwrite(POST, sizeof(POSTING), i, fpost) == 0) {
+        if ((postlen = invencode(POST, i)) == 0) {
+            return (0);
+        }
+        if (fwrite(encbuf, 1, postlen, fpost) == 0) {
             invcannotwrite(postingfile);
             return (0);
         }
-        nextpost += i * sizeof(POSTING);
+        nextpost += postlen;
     }
     logicalblk.invblk[3 + 2 * numinvitems++] = iteminfo.packword[0];
     logicalblk.invblk[2 + 2 * numinvitems] = iteminfo.packword[1];
@@ -578,6 +689,8 @@ int invopen(INVCONTROL * invcntl, char *invname, char *invpost, int stat)
 {
     int read_index;
 
+    invcntl->invmap = NULL;
+    invcntl->postmap = NULL;
     if ((invcntl->invfile =
          vpfopen(invname, ((stat == 0) ? "rb" : "r+b"))) == NULL) {
         /* If db created without '-f', but now invoked with '-f cscope.out',
@@ -607,7 +720,8 @@ openedinvname:
         fprintf(stderr, "%s: empty inverted file\n", argv0);
         goto closeinv;
     }
-    if (invcntl->param.version != FMTVERSION) {
+    if (invcntl->param.version != FMTVERSION &&
+        invcntl->param.version != FMTVERSION1) {
         fprintf(stderr,
                 "%s: cannot read old index format; use -U option to force database to rebuild\n",
                 argv0);
@@ -638,11 +752,18 @@ openedinvname:
         goto closeinv;
     }
 openedinvpost:
+    /* map read-only files, so lookups need neither reads nor copies */
+    if (stat == INVAVAIL) {
+        invcntl->invmap = invmapfile(invcntl->invfile, &invcntl->invmapsize);
+        invcntl->postmap = invmapfile(invcntl->postfile,
+                                      &invcntl->postmapsize);
+    }
     /* allocate core for a logical block  */
-    if ((invcntl->logblk = malloc((unsigned)invcntl->param.sizeblk)) == NULL) {
+    if ((invcntl->blkbuf = malloc((unsigned)invcntl->param.sizeblk)) == NULL) {
         invcannotalloc((unsigned)invcntl->param.sizeblk);
         goto closeboth;
     }
+    invcntl->logblk = invcntl->blkbuf;
     /* allocate for and read in superfinger  */
     read_index = 1;
     invcntl->iindex = NULL;
@@ -677,13 +798,21 @@ openedinvpost:
         }
     }
 #endif
+    /* use the superfinger in place if the inverted file is mapped */
+    if (invcntl->iindex == NULL && invcntl->invmap != NULL &&
+        invcntl->param.startbyte % sizeof(long) == 0 &&
+        invcntl->param.startbyte + invcntl->param.supsize <=
+        invcntl->invmapsize) {
+        invcntl->iindex = invcntl->invmap + invcntl->param.startbyte;
+        read_index = 0;
+    }
     if (invcntl->iindex == NULL)
         /* FIXME HBB: magic number alert (4) */
         invcntl->iindex = malloc((unsigned)invcntl->param.supsize
                                  + 4 * sizeof(long));
     if (invcntl->iindex == NULL) {
         invcannotalloc((unsigned)invcntl->param.supsize);
-        free(invcntl->logblk);
+        free(invcntl->blkbuf);
         goto closeboth;
     }
     if (read_index) {
@@ -694,6 +823,7 @@ openedinvpost:
     invcntl->numblk = -1;
     if (boolready() == -1) {
 closeboth:
+        invunmap(invcntl);
         fclose(invcntl->postfile);
 closeinv:
         fclose(invcntl->invfile);
@@ -708,6 +838,161 @@ closeinv:
     return (1);
 }
 
+/*
+ * Postings are compressed term by term. The postings of a term are sorted by
+ * line offset, so each posting is stored as:
+ *	the line offset, as a delta from the previous posting
+ *	the file index, as a delta from the previous posting
+ *	the type character
+ *	0 for no function, otherwise 1 + the zigzag-coded distance of the
+ *	function name back from the line offset
+ * with the numbers as little-endian base-128 varints.
+ */
+
+static unsigned char *putvarint(unsigned char *s, unsigned long n)
+{
+    while (n >= 0x80) {
+        *s++ = (unsigned char)(n | 0x80);
+        n >>= 7;
+    }
+    *s++ = (unsigned char)n;
+    return (s);
+}
+
+static unsigned char *getvarint(unsigned char *s, unsigned char *end,
+                                unsigned long *np)
+{
+    unsigned long n = 0;
+    int shift;
+
+    /* most deltas fit in a single byte */
+    if (s < end && *s < 0x80) {
+        *np = *s;
+        return (s + 1);
+    }
+    for (shift = 0; s < end && shift < (int)sizeof(long) * 8; shift += 7) {
+        n |= (unsigned long)(*s & 0x7f) << shift;
+        if (*s++ < 0x80) {
+            *np = n;
+            return (s);
+        }
+    }
+    return (NULL);
+}
+
+/** invencode compresses the postings of a term into encbuf **/
+static long invencode(POSTING * post, long num)
+{
+    unsigned char *s;
+    unsigned long lineoffset = 0, fileindex = 0;
+    long dist;
+
+    if (num * MAXPOSTBYTES > encsize) {
+        encsize = num * MAXPOSTBYTES + POSTINC;
+        if ((encbuf = realloc(encbuf, encsize)) == NULL) {
+            invcannotalloc((unsigned)encsize);
+            encsize = 0;
+            return (0);
+        }
+    }
+    s = encbuf;
+    for (; num > 0; --num, ++post) {
+        s = putvarint(s, post->lineoffset - lineoffset);
+        s = putvarint(s, post->fileindex - fileindex);
+        *s++ = (unsigned char)post->type;
+        if (post->fcnoffset == 0) {
+            *s++ = 0;
+        }
+        else {
+            dist = post->lineoffset - post->fcnoffset;
+            s = putvarint(s, ((unsigned long)dist << 1 ^ (dist < 0 ? ~0UL : 0))
+                          + 1);
+        }
+        lineoffset = post->lineoffset;
+        fileindex = post->fileindex;
+    }
+    return (s - encbuf);
+}
+
+/** invdecode expands a compressed posting list **/
+static int invdecode(unsigned char *s, unsigned char *end, POSTING * post,
+                     long num)
+{
+    unsigned long lineoffset = 0, fileindex = 0, n;
+
+    for (; num > 0; --num, ++post) {
+        if ((s = getvarint(s, end, &n)) == NULL)
+            return (-1);
+        lineoffset += n;
+        if ((s = getvarint(s, end, &n)) == NULL || s >= end)
+            return (-1);
+        fileindex += n;
+        post->lineoffset = lineoffset;
+        post->fileindex = fileindex;
+        post->type = *s++;
+        if ((s = getvarint(s, end, &n)) == NULL)
+            return (-1);
+        if (n == 0) {
+            post->fcnoffset = 0;
+        }
+        else {
+            --n;
+            post->fcnoffset = lineoffset - ((n >> 1) ^ -(n & 1));
+        }
+    }
+    return (0);
+}
+
+/** invgetpostings reads and expands the compressed postings of a term **/
+static POSTING *invgetpostings(INVCONTROL * invcntl, long offset, long num)
+{
+    static POSTING *postings;
+    static unsigned char *buf;
+    static long postingssize, bufsize;
+    unsigned char *s, *end;
+    long len;
+
+    if (num > postingssize) {
+        postingssize = num + SETINC;
+        if ((postings = realloc(postings, postingssize * sizeof(POSTING)))
+            == NULL) {
+            invcannotalloc((unsigned)(postingssize * sizeof(POSTING)));
+            postingssize = 0;
+            return (NULL);
+        }
+    }
+    if (invcntl->postmap != NULL && offset < invcntl->postmapsize) {
+        s = (unsigned char *)invcntl->postmap + offset;
+        end = (unsigned char *)invcntl->postmap + invcntl->postmapsize;
+        /* the list size is not known; assume about 4 bytes a posting */
+        len = num * 4;
+        if (len > invcntl->postmapsize - offset)
+            len = invcntl->postmapsize - offset;
+        invwillneed(invcntl->postmap, offset, len);
+    }
+    else {
+        len = num * MAXPOSTBYTES;
+        if (len > bufsize) {
+            bufsize = len;
+            if ((buf = realloc(buf, bufsize)) == NULL) {
+                invcannotalloc((unsigned)bufsize);
+                bufsize = 0;
+                return (NULL);
+            }
+        }
+        fseek(invcntl->postfile, offset, SEEK_SET);
+        len = fread(buf, 1, len, invcntl->postfile);
+        s = buf;
+        end = buf + len;
+    }
+    if (invdecode(s, end, postings, num) < 0) {
+        fprintf(stderr, "%s: bad posting list in the inverted index\n",
+                argv0);
+        return (NULL);
+    }
+    return (postings);
+}
+
 /** invclose must be called to wrap things up and deallocate core  **/
 void invclose(INVCONTROL * invcntl)
 {
@@ -731,9 +1016,90 @@ void invclose(INVCONTROL * invcntl)
         invcntl->iindex = NULL;
     }
 #endif
-    if (invcntl->iindex != NULL)
+    if (invcntl->iindex != NULL && (invcntl->invmap == NULL ||
+                                    invcntl->iindex != invcntl->invmap +
+                                    invcntl->param.startbyte))
         free(invcntl->iindex);
-    free(invcntl->logblk);
+    free(invcntl->blkbuf);
+    invunmap(invcntl);
+}
+
+/** invmapfile maps a whole index file for reading **/
+static char *invmapfile(FILE * file, long *sizep)
+{
+#if defined(HAVE_MMAP)
+    struct stat st;
+    void *ptr;
+
+    if (fstat(fileno(file), &st) < 0 || st.st_size == 0)
+        return (NULL);
+    ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED,
+               fileno(file), 0);
+    if (ptr == MAP_FAILED)
+        return (NULL);
+#if defined(HAVE_MADVISE)
+    /* lookups jump between blocks and posting lists */
+    (void)madvise(ptr, (size_t)st.st_size, MADV_RANDOM);
+#endif
+    *sizep = (long)st.st_size;
+    return (ptr);
+#else
+    (void)file;
+    *sizep = 0;
+    return (NULL);
+#endif
+}
+
+/** invunmap releases the file mappings, if any **/
+static void invunmap(INVCONTROL * invcntl)
+{
+#if defined(HAVE_MMAP)
+    if (invcntl->invmap != NULL)
+        munmap(invcntl->invmap, (size_t)invcntl->invmapsize);
+    if (invcntl->postmap != NULL)
+        munmap(invcntl->postmap, (size_t)invcntl->postmapsize);
+#endif
+    invcntl->invmap = NULL;
+    invcntl->postmap = NULL;
+}
+
+/** invwillneed asks for a range of a mapping to be read ahead **/
+static void invwillneed(char *map, long offset, long len)
+{
+#if defined(HAVE_MADVISE)
+    static long pagesize;
+    long start;
+
+    if (pagesize == 0)
+        pagesize = sysconf(_SC_PAGESIZE);
+    /* not worth a system call for lists on a single page */
+    if (pagesize <= 0 || len < pagesize)
+        return;
+    start = offset - offset % pagesize;
+    (void)madvise(map + start, (size_t)(offset + len - start),
+                  MADV_WILLNEED);
+#else
+    (void)map;
+    (void)offset;
+    (void)len;
+#endif
+}
+
+/** invgetblk makes a logical block of the inverted file the present one **/
+static void invgetblk(INVCONTROL * invcntl, long blk)
+{
+    long offset;
+
+    offset = blk * invcntl->param.sizeblk + invcntl->param.cntlsize;
+    invcntl->numblk = blk;
+    if (invcntl->invmap != NULL &&
+        offset + invcntl->param.sizeblk <= invcntl->invmapsize) {
+        invcntl->logblk = (union logicalblk *)(invcntl->invmap + offset);
+        return;
+    }
+    invcntl->logblk = invcntl->blkbuf;
+    fseek(invcntl->invfile, offset, SEEK_SET);
+    fread(invcntl->logblk, (int)invcntl->param.sizeblk, 1, invcntl->invfile);
 }
 
 /** invstep steps the inverted file forward one item **/
@@ -744,14 +1110,8 @@ static void invstep(INVCONTROL * invcntl)
         return;
     }
 
-    /* move forward a block else wrap */
-    invcntl->numblk = invcntl->logblk->invblk[1];       /* was: *(int *)(invcntl->logblk + sizeof(long)) */
-
-    /* now read in the block  */
-    fseek(invcntl->invfile,
-          invcntl->numblk * invcntl->param.sizeblk + invcntl->param.cntlsize,
-          SEEK_SET);
-    fread(invcntl->logblk, (int)invcntl->param.sizeblk, 1, invcntl->invfile);
+    /* move forward a block else wrap, and read it in */
+    invgetblk(invcntl, invcntl->logblk->invblk[1]);     /* was: *(int *)(invcntl->logblk + sizeof(long)) */
     invcntl->keypnt = 0;
 }
 
@@ -820,14 +1180,8 @@ long invfind(INVCONTROL * invcntl, char *searchterm)
 
     /* fetch the appropriate logical block if not in core  */
     /* note always fetch it if the file is busy */
-    if ((imid != invcntl->numblk) || (invcntl->param.filestat >= INVBUSY)) {
-        fseek(invcntl->invfile,
-              (imid * invcntl->param.sizeblk) + invcntl->param.cntlsize,
-              SEEK_SET);
-        invcntl->numblk = imid;
-        fread(invcntl->logblk, (int)invcntl->param.sizeblk, 1,
-              invcntl->invfile);
-    }
+    if ((imid != invcntl->numblk) || (invcntl->param.filestat >= INVBUSY))
+        invgetblk(invcntl, imid);
 
 srch_ext:
     /* now find the term in this block. tricky this  */
@@ -892,11 +1246,7 @@ void invdump(INVCONTROL * invcntl, char *term)
     else if (*term == '#') {
         j = atoi(term + 1);
         /* fetch the appropriate logical block */
-        invcntl->numblk = j;
-        fseek(invcntl->invfile,
-              (j * invcntl->param.sizeblk) + invcntl->param.cntlsize, SEEK_SET);
-        fread(invcntl->logblk, (int)invcntl->param.sizeblk, 1,
-              invcntl->invfile);
+        invgetblk(invcntl, j);
     }
     else
         i = abs((int)invfind(invcntl, term));
@@ -952,6 +1302,15 @@ void boolclear(void)
     enditem = item;
 }
 
+/* get the next posting of the list, from the posting file mapping if the
+   list was found there */
+#define	nextposting()	do { \
+			    if (postp == NULL) \
+				fread(&posting, sizeof(posting), 1, file); \
+			    else if (postp < postend) \
+				posting = *postp++; \
+			} while (0)
+
 POSTING *boolfile(INVCONTROL * invcntl, long *num, int boolarg)
 {
     ENTRY *entryptr;
@@ -960,6 +1319,7 @@ POSTING *boolfile(INVCONTROL * invcntl, long *num, int boolarg)
     unsigned long *ptr2;
     POSTING *newitem = NULL;    /* initialize, to avoid warning */
     POSTING posting;
+    POSTING *postp = NULL, *postend = NULL;
     unsigned u;
     POSTING *newsetp = NULL, *set1p;
     long newsetc, set1c, set2c;
@@ -1020,8 +1380,24 @@ cannotalloc:
         newsetp = newitem;
     }
     file = invcntl->postfile;
-    fseek(file, *ptr2, SEEK_SET);
-    fread(&posting, sizeof(posting), 1, file);
+    if (invcntl->param.version != FMTVERSION1) {
+        /* expand the compressed list */
+        if ((postp = invgetpostings(invcntl, (long)*ptr2, *num)) == NULL) {
+            boolready();
+            *num = -1;
+            return (NULL);
+        }
+        postend = postp + *num;
+    }
+    else if (invcntl->postmap != NULL &&
+        (long)*ptr2 + *num * (long)sizeof(POSTING) <= invcntl->postmapsize) {
+        postp = (POSTING *) (invcntl->postmap + *ptr2);
+        postend = postp + *num;
+        invwillneed(invcntl->postmap, (long)*ptr2, *num * sizeof(POSTING));
+    }
+    else
+        fseek(file, *ptr2, SEEK_SET);
+    nextposting();
     newsetc = 0;
     switch (boolarg) {
     case BOOL_OR:
@@ -1035,7 +1411,7 @@ cannotalloc:
             }
             else if (set1p->lineoffset > posting.lineoffset) {
                 *newsetp++ = posting;
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
             else if (set1p->type < posting.type) {
@@ -1044,13 +1420,13 @@ cannotalloc:
             }
             else if (set1p->type > posting.type) {
                 *newsetp++ = posting;
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
             else {              /* identical postings */
                 *newsetp++ = *set1p++;
                 set1c++;
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
         }
@@ -1065,7 +1441,7 @@ cannotalloc:
             while (set2c++ < *num) {
                 *newsetp++ = posting;
                 newsetc++;
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
             }
         }
         item = newitem;
@@ -1078,7 +1454,7 @@ cannotalloc:
                 set1c++;
             }
             else if (set1p->lineoffset > posting.lineoffset) {
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
             else if (set1p->type < posting.type) {
@@ -1086,14 +1462,14 @@ cannotalloc:
                 set1c++;
             }
             else if (set1p->type > posting.type) {
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
             else {              /* identical postings */
                 *newsetp++ = *set1p++;
                 newsetc++;
                 set1c++;
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
         }
@@ -1107,7 +1483,7 @@ cannotalloc:
                 set1c++;
             }
             else if (set1p->lineoffset > posting.lineoffset) {
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
             else if (set1p->type < posting.type) {
@@ -1116,13 +1492,13 @@ cannotalloc:
                 set1c++;
             }
             else if (set1p->type > posting.type) {
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
             else {              /* identical postings */
                 set1c++;
                 set1p++;
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
         }
@@ -1140,7 +1516,7 @@ cannotalloc:
             }
             else if (set1p->lineoffset > posting.lineoffset) {
                 *newsetp++ = posting;
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
             else if (set1p->type < posting.type) {
@@ -1149,20 +1525,20 @@ cannotalloc:
             }
             else if (set1p->type > posting.type) {
                 *newsetp++ = posting;
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
             else {              /* identical postings */
                 set1c++;
                 set1p++;
-                fread(&posting, (int)sizeof(posting), 1, file);
+                nextposting();
                 set2c++;
             }
         }
         while (set2c++ < *num) {
             *newsetp++ = posting;
             newsetc++;
-            fread(&posting, (int)sizeof(posting), 1, file);
+            nextposting();
         }
         item = newitem;
         break;                  /* end of REVERSENOT  */
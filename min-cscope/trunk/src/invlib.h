@@ -43,13 +43,22 @@
 
 /* postings temporary file long number coding into characters */
 /* FIXME HBB: where would these definitions come from ? */
+/* a 64-bit long needs more digits for offsets into databases over 4GB */
 #if CHAR_MAX==255
 # define	BASE		223	/* 255 - ' ' */
-# define	PRECISION	4	/* maximum digits after converting a long */
+# if LONG_MAX > 0x7fffffffL
+#  define	PRECISION	5	/* maximum digits after converting a long */
+# else
+#  define	PRECISION	4	/* maximum digits after converting a long */
+# endif
 #else
 # if CHAR_MAX==127	/* assume sign-extension of a char when converted to an int */
 #  define	BASE		95	/* 127 - ' ' */
-#  define	PRECISION	5	/* maximum digits after converting a long */
+#  if LONG_MAX > 0x7fffffffL
+#   define	PRECISION	7	/* maximum digits after converting a long */
+#  else
+#   define	PRECISION	5	/* maximum digits after converting a long */
+#  endif
 # else
   #error Need a platform with 8 bits in a char value
 # endif
@@ -82,9 +91,14 @@ typedef	struct {
 	FILE	*postfile;	/* posting file ptr */
 	PARAM	param;		/* control parameters for the file */
 	char	*iindex;	/* ptr to space for superindex */
-	union logicalblk *logblk;	/* ptr to space for a logical block */
+	union logicalblk *logblk;	/* ptr to the present logical block */
 	long	numblk;		/* number of block presently at *logblk */
 	long	keypnt;		/* number item in present block found */
+	union logicalblk *blkbuf;	/* ptr to space for a logical block */
+	char	*invmap;	/* inverted file mapping, if read-only */
+	long	invmapsize;	/* size of the inverted file mapping */
+	char	*postmap;	/* posting file mapping, if read-only */
+	long	postmapsize;	/* size of the posting file mapping */
 } INVCONTROL;
 
 typedef        struct  {
@@ -103,6 +117,7 @@ typedef	struct {
 
 extern	long	*srcoffset;	/* source file name database offsets */
 extern	int	nsrcoffset;	/* number of file name database offsets */
+extern	unsigned long *srcfileindex; /* source file index of each offset */
 
 
 void	boolclear(void);
@@ -113,6 +128,8 @@ long	invfind(INVCONTROL *invcntl, char *searchterm);
 int	invforward(INVCONTROL *invcntl);
 int	invopen(INVCONTROL *invcntl, char *invname, char *invpost, int status);
 long	invmake(char *invname, char *invpost, void *infile);
+long	invmerge(char *invname, char *invpost, void *infile,
+		 INVCONTROL *oldinv, int (*keep)(POSTING *));
 long	invterm(INVCONTROL *invcntl, char *term);
 
 #endif /* CSCOPE_INVLIB_H */
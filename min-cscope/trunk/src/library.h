@@ -40,6 +40,7 @@
 /* private library */
 char	*compath(char *pathname);
 char	*egrepinit(char *egreppat);
+char	*egrepmust(int k, size_t *lenp);
 char	*logdir(char *name);
 char	*mybasename(char *path);
 FILE	*myfopen(char *path, char *mode);
@@ -93,12 +93,14 @@ BOOL	editallprompt = YES;	/* prompt between editing files */
 unsigned int fileargc;		/* file argument count */
 char	**fileargv;		/* file argument values */
 int	fileversion;		/* cross-reference file version */
+BOOL	fingerprints;		/* detect changed files by their contents */
 BOOL	incurses = NO;		/* in curses */
 BOOL	invertedindex;		/* the database has an inverted index */
 BOOL	isuptodate;		/* consider the crossref up-to-date */
 BOOL	kernelmode;		/* don't use DFLT_INCDIR - bad for kernels */
 BOOL	linemode = NO;		/* use line oriented user interface */
 BOOL	verbosemode = NO;	/* print extra information on line mode */
+BOOL	recordmode = NO;	/* structured output in line mode */
 BOOL	recurse_dir = NO;	/* recurse dirs when searching for src files */
 char	*namefile;		/* file of file names */
 BOOL	ogs;			/* display OGS book and subsystem names */
@@ -108,6 +110,7 @@ char	temp1[PATHLEN + 1];	/* temporary file name */
 char	temp2[PATHLEN + 1];	/* temporary file name */
 char	tempdirpv[PATHLEN + 1];	/* private temp directory */
 long	totalterms;		/* total inverted index terms */
+BOOL	trigramindex;		/* build a trigram index */
 BOOL	trun_syms;		/* truncate symbols to 8 characters */
 char	tempstring[TEMPSTRING_LEN + 1]; /* use this as a buffer, instead of 'yytext', 
 				 * which had better be left alone */
@@ -126,6 +129,7 @@ static	void	initcompress(void);
 static	void	longusage(void);
 static	void	skiplist(FILE *oldrefs);
 static	void	usage(void);
+static	void	endcommand(void);
 
 #ifdef HAVE_FIXKEYPAD
 void	fixkeypad();
@@ -195,6 +199,7 @@ main(int argc, char **argv)
 #else
             fprintf(stderr, "  Interfaces: command-line only\n");
 #endif
+            fprintf(stderr, "  Line-mode output: text, records\n");
 	    myexit(0);
 #endif
 	}
@@ -240,6 +245,9 @@ cscope: pattern too long, cannot be > %d characters\n", PATLEN);
 	    case 'e':	/* suppress ^E prompt between files */
 		editallprompt = NO;
 		break;
+	    case 'H':	/* detect changed files by their contents */
+		fingerprints = YES;
+		break;
 	    case 'k':	/* ignore DFLT_INCDIR */
 		kernelmode = YES;
 		break;
@@ -252,12 +260,22 @@ cscope: pattern too long, cannot be > %d characters\n", PATLEN);
 	    case 'v':
 		verbosemode = YES;
 		break;
+	    case 'z':	/* structured line-mode output */
+		recordmode = YES;
+		break;
+	    case 'm':	/* only list the changed files */
+		listchanges = YES;
+		linemode = YES;
+		break;
 	    case 'o':	/* display OGS book and subsystem names */
 		ogs = YES;
 		break;
 	    case 'q':	/* quick search */
 		invertedindex = YES;
 		break;
+	    case 't':	/* trigram index for text searching */
+		trigramindex = YES;
+		break;
 	    case 'T':	/* truncate symbols to 8 characters */
 		trun_syms = YES;
 		break;
@@ -274,6 +292,7 @@ cscope: pattern too long, cannot be > %d characters\n", PATLEN);
 	    case 'F':	/* symbol reference lines file */
 	    case 'i':	/* file containing file names */
 	    case 'I':	/* #include file directory */
+	    case 'j':	/* parallel cross-referencing processes */
 	    case 'p':	/* file path components to display */
 	    case 'P':	/* prepend path to file names */
 	    case 's':	/* additional source file directory */
@@ -308,6 +327,10 @@ cscope: reffile too long, cannot be > %d characters\n", sizeof(path) - 1);
 		    invname = my_strdup(path);
 		    strcpy(s, ".po");
 		    invpost = my_strdup(path);
+		    strcpy(s, ".tr");
+		    triname = my_strdup(path);
+		    strcpy(s, ".fp");
+		    fpname = my_strdup(path);
 		    break;
 		case 'F':	/* symbol reference lines file */
 		    reflines = s;
@@ -318,6 +341,16 @@ cscope: reffile too long, cannot be > %d characters\n", sizeof(path) - 1);
 		case 'I':	/* #include file directory */
 		    includedir(s);
 		    break;
+		case 'j':	/* parallel cross-referencing processes */
+		    if (*s < '1' || *s > '9' ) {
+			fprintf(stderr, "\
+%s: -j option: missing or invalid numeric value\n", 
+				argv0);
+			goto usage;
+		    }
+		    buildjobs = atoi(s);
+		    searchjobs = buildjobs;
+		    break;
 		case 'p':	/* file path components to display */
 		    if (*s < '0' || *s > '9' ) {
 			fprintf(stderr, "\
@@ -356,6 +389,10 @@ cscope: reffile too long, cannot be > %d characters\n", sizeof(path) - 1);
                   "Specify -l or -L for a line-oriented interface.\n");
     }
 #endif /* !defined(WITH_CURSES) */
+    /* the structured output is only for the line-oriented interface */
+    if (linemode == NO) {
+	recordmode = NO;
+    }
     
     /* read the environment */
     editor = mygetenv("EDITOR", EDITOR);
@@ -440,6 +477,10 @@ cscope: Could not create private temp dir %s\n",
 	    invname = my_strdup(path);
 	    sprintf(path, "%s/%s", home, invpost);
 	    invpost = my_strdup(path);
+	    sprintf(path, "%s/%s", home, triname);
+	    triname = my_strdup(path);
+	    sprintf(path, "%s/%s", home, fpname);
+	    fpname = my_strdup(path);
 	}
     }
 
@@ -624,6 +665,12 @@ cscope: cannot read source file name from file %s\n",
 	/* Tell build.c about the filenames to create: */
 	setup_build_filenames(reffile);
 
+	/* list the changed files instead of building */
+	if (listchanges == YES) {
+	    listchanged();
+	    myexit(0);
+	}
+
 	/* build the cross-reference */
 	initcompress();
 	if (linemode == NO || verbosemode == YES)    /* display if verbose as well */
@@ -642,7 +689,10 @@ cscope: cannot read source file name from file %s\n",
     /* if using the line oriented user interface so cscope can be a 
        subprocess to emacs or samuel */
     if (linemode == YES) {
-	if (*Pattern != '\0') {		/* do any optional search */
+	if (*Pattern != '\0' && recordmode == YES) {
+	    (void) search();
+	    putrecordend(totallines);
+	} else if (*Pattern != '\0') {	/* do any optional search */
 	    if (search() == YES) {
 		/* print the total number of lines in
 		 * verbose mode */
@@ -660,8 +710,11 @@ cscope: cannot read source file name from file %s\n",
 	for (;;) {
 	    char buf[PATLEN + 2];
 			
-	    printf(">> ");
-	    fflush(stdout);
+	    /* the end record of each command says when to send the next one */
+	    if (recordmode == NO) {
+		printf(">> ");
+		fflush(stdout);
+	    }
 	    if (fgets(buf, sizeof(buf), stdin) == NULL) {
 		myexit(0);
 	    }
@@ -682,6 +735,11 @@ cscope: cannot read source file name from file %s\n",
 	    case '9':	/* samuel only */
 		field = *buf - '0';
 		strcpy(Pattern, buf + 1);
+		if (recordmode == YES) {
+		    (void) search();
+		    putrecordend(totallines);
+		    break;
+		}
 		search();
 		printf("cscope: %d lines\n", totallines);
 		while ((c = getc(refsfound)) != EOF) {
@@ -697,6 +755,9 @@ cscope: cannot read source file name from file %s\n",
 		    caseless = NO;
 		}
 		egrepcaseless(caseless);
+		if (recordmode == YES) {
+		    putrecordend(0);
+		}
 		break;
 
 	    case 'r':	/* rebuild database cscope style */
@@ -707,12 +768,12 @@ cscope: cannot read source file name from file %s\n",
 
 	    case 'R':	/* rebuild database samuel style */
 		rebuild();
-		putchar('\n');
+		endcommand();
 		break;
 
 	    case 'C':	/* clear file names */
 		freefilelist();
-		putchar('\n');
+		endcommand();
 		break;
 
 	    case 'F':	/* add a file name */
@@ -721,7 +782,7 @@ cscope: cannot read source file name from file %s\n",
 		    (s = inviewpath(path)) != NULL) {
 		    addsrcfile(s);
 		}
-		putchar('\n');
+		endcommand();
 		break;
 
 	    case 'q':	/* quit */
@@ -731,6 +792,9 @@ cscope: cannot read source file name from file %s\n",
 
 	    default:
 		fprintf(stderr, "cscope: unknown command '%s'\n", buf);
+		if (recordmode == YES) {
+		    putrecordend(0);
+		}
 		break;
 	    }
 	}
@@ -883,8 +947,8 @@ exitcurses(void)
 static void
 usage(void)
 {
-	fprintf(stderr, "Usage: cscope [-bcCdehklLqRTuUvV] [-f file] [-F file] [-i file] [-I dir] [-s dir]\n");
-	fprintf(stderr, "              [-p number] [-P path] [-[0-8] pattern] [source files]\n");
+	fprintf(stderr, "Usage: cscope [-bcCdeHhklLmqRtTuUvVz] [-f file] [-F file] [-i file] [-I dir] [-s dir]\n");
+	fprintf(stderr, "              [-j number] [-p number] [-P path] [-[0-8] pattern] [source files]\n");
 }
 
 
@@ -904,37 +968,58 @@ longusage(void)
 -f reffile    Use reffile as cross-ref file name instead of %s.\n",
 		REFFILE);
 	fprintf(stderr, "\
+-H            Detect changed files by their contents, not only their time.\n\
 -h            This help screen.\n\
 -I incdir     Look in incdir for any #include files.\n\
 -i namefile   Browse through files listed in namefile, instead of %s\n",
 		NAMEFILE);
 	fprintf(stderr, "\
+-j n          Build the database and search text with n parallel jobs.\n\
 -k            Kernel Mode - don't use %s for #include files.\n",
 		DFLT_INCDIR);
 	fputs("\
 -L            Do a single search with line-oriented output.\n\
 -l            Line-oriented interface.\n\
+-m            List the files changed since the last build, without building.\n\
 -num pattern  Go to input field num (counting from 0) and find pattern.\n\
 -P path       Prepend path to relative file names in pre-built cross-ref file.\n\
 -p n          Display the last n file path components.\n\
 -q            Build an inverted index for quick symbol searching.\n\
 -R            Recurse directories for files.\n\
 -s dir        Look in dir for additional source  files.\n\
+-t            Build a trigram index for quick text searching.\n\
 -T            Use only the first eight characters to match against C symbols.\n\
 -U            Check file time stamps.\n\
 -u            Unconditionally build the cross-reference file.\n\
 -v            Be more verbose in line mode.\n\
 -V            Print the version number.\n\
+-z            Write structured records in line mode.\n\
 \n\
 Please see the manpage for more information.\n",
 	      stderr);
 }
 
+/* end the output of a line-mode command without references */
+
+static void
+endcommand(void)
+{
+	if (recordmode == YES) {
+		putrecordend(0);
+	} else {
+		putchar('\n');
+	}
+}
+
 /* cleanup and exit */
 
 void
 myexit(int sig)
 {
+	/* a build worker must not touch the main process's files */
+	if (buildworker == YES) {
+		_exit(sig);
+	}
 	/* HBB 20010313; close file before unlinking it. Unix may not care
 	 * about that, but DOS absolutely needs it */
 	if (refsfound != NULL)
@@ -948,6 +1033,7 @@ myexit(int sig)
             unlink(temp1);
 #endif /* defined(USE_BTREE) */
             unlink(temp2);
+            xrefstop();
             rmdir(tempdirpv);		
 	}
 #if defined(WITH_CURSES)
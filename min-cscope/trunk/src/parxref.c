@@ -0,0 +1,562 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	parallel cross-referencing
+ *
+ *	The scanner and the symbol table are global, so source files are
+ *	cross-referenced in parallel by worker processes rather than threads.
+ *	Each worker writes the data of a file into a private results file, with
+ *	all database offsets relative to the beginning of that data, along with
+ *	the #include directives and the inverted index postings found in the
+ *	file. The main process appends the data to the database in source file
+ *	order, relocating the postings and replaying the #include directives, so
+ *	the database is identical to the one created by a serial build.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include "global.h"
+#include "build.h"
+#include "alloc.h"
+#if defined(HAVE_WAIT_H)
+#include <sys/wait.h>
+#endif
+#include <sys/types.h>      /* pid_t */
+
+int	buildjobs = 1;		/* number of cross-referencing processes */
+BOOL	buildworker = NO;	/* this is a cross-referencing process */
+
+/* Defined in crossref.c */
+int dbflush(void);
+int dbputblock(char *data, long len);
+
+#if defined(HAVE_FORK)
+
+#define	MAXJOBS		64	/* maximal number of worker processes */
+#define	JOBTASKS	16	/* outstanding files per worker process */
+
+typedef struct {		/* worker process */
+	pid_t	pid;		/* process ID */
+	int	taskfd;		/* writes file names to the worker */
+	int	donefd;		/* reads a byte per finished file */
+	FILE	*results;	/* reads the results file */
+	long	readpos;	/* offset of the next result record */
+	int	pending;	/* files not yet merged */
+	char	path[PATHLEN + 1];	/* results file name */
+} WORKER;
+
+typedef struct {		/* file handed to a worker */
+	char	*file;		/* source file name */
+	int	worker;		/* worker index */
+} TASK;
+
+typedef struct {		/* result record header */
+	BOOL	status;		/* the file was cross-referenced */
+	BOOL	errors;		/* errors were found in the file */
+	long	datalen;	/* length of the database data */
+	long	inclen;		/* length of the #include records */
+	long	postlen;	/* length of the posting records */
+} RESULT;
+
+typedef struct {		/* posting record, followed by the term */
+	long	lineoff;	/* source line offset */
+	long	offset;		/* function/macro name offset, 0 for none */
+	int	type;		/* posting type */
+} RELPOSTING;
+
+static	WORKER	*workers;	/* worker processes */
+static	int	nworkers;	/* number of worker processes */
+static	TASK	*tasks;		/* files waiting to be merged, in order */
+static	int	maxtasks;	/* size of the task queue */
+static	int	firsttask;	/* first task in the queue */
+static	int	ntasks;		/* number of tasks in the queue */
+
+static	char	*incbuf;	/* worker #include records */
+static	long	inclen;
+static	long	incsize;
+static	char	*postbuf;	/* worker posting records */
+static	long	postlen;
+static	long	postsize;
+
+static	BOOL	startworker(int n);
+static	void	workerloop(FILE *out, int taskfd, int donefd);
+static	void	mergetask(void);
+static	void	append(char **buf, long *len, long *size, void *data, long n);
+static	BOOL	readall(int fd, void *buf, long len);
+static	BOOL	writeall(int fd, void *buf, long len);
+
+/* start the worker processes, returning NO if the files will be
+   cross-referenced serially */
+
+BOOL
+xrefstart(int jobs)
+{
+	int	i;
+
+	nworkers = 0;
+	if (jobs < 2) {
+		return(NO);
+	}
+	if (jobs > MAXJOBS) {
+		jobs = MAXJOBS;
+	}
+	workers = mymalloc(jobs * sizeof(WORKER));
+	maxtasks = jobs * JOBTASKS;
+	tasks = mymalloc(maxtasks * sizeof(TASK));
+	firsttask = 0;
+	ntasks = 0;
+
+	/* don't let the workers inherit unwritten output */
+	(void) dbflush();
+	(void) fflush(newrefs);
+	(void) fflush(stdout);
+	(void) fflush(stderr);
+	for (i = 0; i < jobs; ++i) {
+		if (startworker(i) == NO) {
+			break;
+		}
+		++nworkers;
+	}
+	if (nworkers == 0) {
+		free(workers);
+		free(tasks);
+		return(NO);
+	}
+	return(YES);
+}
+
+/* cross-reference a source file, either directly or by a worker process */
+
+void
+xrefsubmit(char *file)
+{
+	WORKER	*w;
+	int	i, len;
+
+	if (nworkers == 0) {
+		crossref(file);
+		return;
+	}
+	/* make room in the queue */
+	if (ntasks == maxtasks) {
+		mergetask();
+	}
+	/* hand the file to the least busy worker */
+	w = &workers[0];
+	for (i = 1; i < nworkers; ++i) {
+		if (workers[i].pending < w->pending) {
+			w = &workers[i];
+		}
+	}
+	len = strlen(file);
+	if (writeall(w->taskfd, &len, sizeof(len)) == NO ||
+	    writeall(w->taskfd, file, len) == NO) {
+		postfatal("cscope: cannot pass %s to a cross-referencing process\n",
+			  file);
+		/* NOTREACHED */
+	}
+	i = (firsttask + ntasks) % maxtasks;
+	tasks[i].file = file;
+	tasks[i].worker = w - workers;
+	++ntasks;
+	++w->pending;
+}
+
+/* merge the results of all the files handed to the workers */
+
+void
+xrefflush(void)
+{
+	while (ntasks > 0) {
+		mergetask();
+	}
+}
+
+/* terminate the worker processes */
+
+void
+xrefstop(void)
+{
+	WORKER	*w;
+	int	status;
+
+	if (nworkers == 0) {
+		return;
+	}
+	/* end of input tells a worker to exit */
+	for (w = workers; w < workers + nworkers; ++w) {
+		(void) close(w->taskfd);
+	}
+	for (w = workers; w < workers + nworkers; ++w) {
+		(void) waitpid(w->pid, &status, 0);
+		(void) close(w->donefd);
+		(void) fclose(w->results);
+		(void) unlink(w->path);
+	}
+	free(workers);
+	free(tasks);
+	nworkers = 0;
+	ntasks = 0;
+}
+
+/* record an #include directive found by a worker */
+
+void
+workerinclude(char *file, char *type)
+{
+	append(&incbuf, &inclen, &incsize, type, 1);
+	append(&incbuf, &inclen, &incsize, file, strlen(file) + 1);
+}
+
+/* record an inverted index posting found by a worker */
+
+void
+workerposting(char *term, int type, long lineoff, long offset)
+{
+	RELPOSTING	p;
+
+	p.lineoff = lineoff;
+	p.offset = offset;
+	p.type = type;
+	append(&postbuf, &postlen, &postsize, &p, sizeof(p));
+	append(&postbuf, &postlen, &postsize, term, strlen(term) + 1);
+}
+
+/* create the results file and the pipes of a worker, and fork it */
+
+static BOOL
+startworker(int n)
+{
+	WORKER	*w = &workers[n];
+	FILE	*out;
+	int	taskpipe[2];
+	int	donepipe[2];
+	int	i;
+
+	(void) sprintf(w->path, "%.*s/cscope.w%d", PATHLEN - 12, tempdirpv,
+		       n);
+	if ((out = myfopen(w->path, "wb")) == NULL) {
+		return(NO);
+	}
+	if ((w->results = myfopen(w->path, "rb")) == NULL) {
+		(void) fclose(out);
+		(void) unlink(w->path);
+		return(NO);
+	}
+	/* the worker rewrites a record header after it is written, so a
+	   buffer could keep a stale header that seeking within it would not
+	   discard */
+	(void) setvbuf(w->results, NULL, _IONBF, 0);
+	if (pipe(taskpipe) < 0) {
+		goto nopipe;
+	}
+	if (pipe(donepipe) < 0) {
+		(void) close(taskpipe[0]);
+		(void) close(taskpipe[1]);
+		goto nopipe;
+	}
+	if ((w->pid = fork()) < 0) {
+		(void) close(taskpipe[0]);
+		(void) close(taskpipe[1]);
+		(void) close(donepipe[0]);
+		(void) close(donepipe[1]);
+		goto nopipe;
+	}
+	if (w->pid == 0) {
+		/* keep only this worker's ends of the pipes, so that the
+		   other workers see the end of their input */
+		for (i = 0; i < n; ++i) {
+			(void) close(workers[i].taskfd);
+			(void) close(workers[i].donefd);
+			(void) fclose(workers[i].results);
+		}
+		(void) fclose(w->results);
+		(void) close(taskpipe[1]);
+		(void) close(donepipe[0]);
+		workerloop(out, taskpipe[0], donepipe[1]);
+		/* NOTREACHED */
+	}
+	(void) close(taskpipe[0]);
+	(void) close(donepipe[1]);
+	(void) fclose(out);
+	w->taskfd = taskpipe[1];
+	w->donefd = donepipe[0];
+	w->readpos = 0;
+	w->pending = 0;
+	return(YES);
+
+nopipe:
+	(void) fclose(out);
+	(void) fclose(w->results);
+	(void) unlink(w->path);
+	return(NO);
+}
+
+/* cross-reference the files passed by the main process, appending a result
+   record for each one to the results file */
+
+static void
+workerloop(FILE *out, int taskfd, int donefd)
+{
+	RESULT	hdr;
+	char	*file;
+	long	start;
+	int	len;
+
+	buildworker = YES;
+	newrefs = out;
+	while (readall(taskfd, &len, sizeof(len)) == YES) {
+		file = mymalloc(len + 1);
+		if (readall(taskfd, file, len) == NO) {
+			_exit(1);
+		}
+		file[len] = '\0';
+
+		/* reserve room for the record header */
+		start = ftell(out);
+		memset(&hdr, 0, sizeof(hdr));
+		if (fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+			_exit(1);
+		}
+		/* the data offsets start from the end of the header */
+		dboffset = 0;
+		errorsfound = NO;
+		inclen = 0;
+		postlen = 0;
+		hdr.status = crossrefbody(file);
+		if (dbflush() < 0) {
+			_exit(1);
+		}
+		hdr.errors = errorsfound;
+		hdr.datalen = dboffset;
+		hdr.inclen = inclen;
+		hdr.postlen = postlen;
+		if ((inclen > 0 && fwrite(incbuf, inclen, 1, out) != 1) ||
+		    (postlen > 0 && fwrite(postbuf, postlen, 1, out) != 1) ||
+		    fseek(out, start, SEEK_SET) != 0 ||
+		    fwrite(&hdr, sizeof(hdr), 1, out) != 1 ||
+		    fseek(out, 0, SEEK_END) != 0 ||
+		    fflush(out) == EOF) {
+			_exit(1);
+		}
+		free(file);
+
+		/* the record is complete */
+		if (writeall(donefd, "", 1) == NO) {
+			_exit(1);
+		}
+	}
+	_exit(0);
+}
+
+/* append the results of the first file in the queue to the database */
+
+static void
+mergetask(void)
+{
+	static	char	*buf;		/* record buffer */
+	static	long	bufsize;
+	TASK	*t = &tasks[firsttask];
+	WORKER	*w = &workers[t->worker];
+	RESULT	hdr;
+	RELPOSTING	p;
+	char	c;
+	char	*s;
+	long	base;
+	long	len;
+	long	n;
+
+	/* wait for the worker to finish the file */
+	if (readall(w->donefd, &c, 1) == NO) {
+		postfatal("cscope: cross-referencing process failed on %s\n",
+			  t->file);
+		/* NOTREACHED */
+	}
+	/* seeking discards anything read ahead of the finished record */
+	if (fseek(w->results, w->readpos, SEEK_SET) != 0 ||
+	    fread(&hdr, sizeof(hdr), 1, w->results) != 1) {
+		goto readerror;
+	}
+	w->readpos += sizeof(hdr) + hdr.datalen + hdr.inclen + hdr.postlen;
+	firsttask = (firsttask + 1) % maxtasks;
+	--ntasks;
+	--w->pending;
+
+	if (hdr.errors == YES) {
+		errorsfound = YES;
+	}
+	/* a file that could not be read leaves no trace in the database */
+	if (hdr.status == NO) {
+		return;
+	}
+	len = hdr.datalen;
+	if (hdr.inclen + hdr.postlen > len) {
+		len = hdr.inclen + hdr.postlen;
+	}
+	if (len > bufsize) {
+		bufsize = len;
+		buf = myrealloc(buf, bufsize);
+	}
+	/* copy the data after the file name */
+	putfilename(t->file);
+	base = dboffset;
+	if (hdr.datalen > 0 &&
+	    fread(buf, hdr.datalen, 1, w->results) != 1) {
+		goto readerror;
+	}
+	if (dbputblock(buf, hdr.datalen) < 0) {
+		cannotwrite(newreffile);
+		/* NOTREACHED */
+	}
+	len = hdr.inclen + hdr.postlen;
+	if (len > 0 && fread(buf, len, 1, w->results) != 1) {
+		goto readerror;
+	}
+	/* look for the #included files in the order they were found */
+	for (s = buf; s < buf + hdr.inclen; s += strlen(s) + 1) {
+		incfile(s + 1, s);
+	}
+	/* relocate the postings */
+	for (; s < buf + len; s += strlen(s) + 1) {
+		memcpy(&p, s, sizeof(p));
+		s += sizeof(p);
+		n = p.offset > 0 ? base + p.offset : 0;
+		writeposting(s, p.type, base + p.lineoff, n);
+	}
+	return;
+
+readerror:
+	postfatal("cscope: cannot read %s\n", w->path);
+	/* NOTREACHED */
+}
+
+/* append data to a growing buffer */
+
+static void
+append(char **buf, long *len, long *size, void *data, long n)
+{
+	if (*len + n > *size) {
+		*size = (*len + n) * 2;
+		*buf = myrealloc(*buf, *size);
+	}
+	memcpy(*buf + *len, data, n);
+	*len += n;
+}
+
+/* read exactly len bytes from a pipe, returning NO on end of input */
+
+static BOOL
+readall(int fd, void *buf, long len)
+{
+	char	*p = buf;
+	ssize_t	n;
+
+	while (len > 0) {
+		if ((n = read(fd, p, len)) < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return(NO);
+		}
+		p += n;
+		len -= n;
+	}
+	return(YES);
+}
+
+/* write exactly len bytes to a pipe */
+
+static BOOL
+writeall(int fd, void *buf, long len)
+{
+	char	*p = buf;
+	ssize_t	n;
+
+	while (len > 0) {
+		if ((n = write(fd, p, len)) < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return(NO);
+		}
+		p += n;
+		len -= n;
+	}
+	return(YES);
+}
+
+#else /* !defined(HAVE_FORK) */
+
+/* without fork() the files are always cross-referenced serially */
+
+BOOL
+xrefstart(int jobs)
+{
+	(void) jobs;
+	return(NO);
+}
+
+void
+xrefsubmit(char *file)
+{
+	crossref(file);
+}
+
+void
+xrefflush(void)
+{
+}
+
+void
+xrefstop(void)
+{
+}
+
+void
+workerinclude(char *file, char *type)
+{
+	(void) file;
+	(void) type;
+}
+
+void
+workerposting(char *term, int type, long lineoff, long offset)
+{
+	(void) term;
+	(void) type;
+	(void) lineoff;
+	(void) offset;
+}
+
+#endif /* defined(HAVE_FORK) */
@@ -0,0 +1,838 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	trigram index of the source files
+ *
+ *	A text search has to read every source file. The trigram index lists,
+ *	for each sequence of three characters in lower case, the source files
+ *	that contain it, so that a search only reads the files containing all
+ *	the trigrams of a string that its matches must contain. Trigrams that
+ *	span lines are left out, since matches do not.
+ *
+ *	The index file starts with a header, followed by the source file names
+ *	in the order of the cross-reference, the file lists of the trigrams, and
+ *	a table of the trigrams sorted by value. Each file list holds the
+ *	differences between ascending file numbers, as base-128 varints.
+ *
+ *	An incremental build takes the trigrams of the files whose data was
+ *	kept in the cross-reference from the old index, and only reads the
+ *	other files.
+ */
+
+#include <ctype.h>
+#include "global.h"
+#include "build.h"
+#include "alloc.h"
+#include "library.h"
+#include <sys/stat.h>
+#if defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
+
+#define	TRIVERSION	1		/* index file format version */
+#define	NTRIGRAMS	(1UL << 24)	/* number of possible trigrams */
+#define	TRIBITS		(8 * sizeof(unsigned long))	/* bits in a map word */
+#define	TRIREAD		65536		/* source file read size */
+#define	TRIHASHINC	4096		/* initial trigram hash table size */
+#define	FILETRIINC	8192		/* file trigram list size increment */
+#define	MAXVARINT	(2 + 8 * sizeof(long) / 7)	/* size of a varint */
+
+typedef struct {		/* index file header */
+	long	version;	/* format version */
+	long	nfiles;		/* number of source files */
+	long	namesize;	/* size of the names, a multiple of a long */
+	long	ntrigrams;	/* number of trigrams in the table */
+	long	tableoffset;	/* offset of the trigram table */
+} TRIHEADER;
+
+typedef struct {		/* trigram table entry */
+	unsigned long trigram;	/* three characters, first one highest */
+	unsigned long offset;	/* file list offset */
+	unsigned long count;	/* number of files */
+} TRIENTRY;
+
+typedef struct {		/* read index file */
+	char	*data;		/* file contents */
+	long	size;		/* file size */
+	BOOL	mapped;		/* the contents are mapped */
+	TRIHEADER *header;
+	char	**names;	/* source file names */
+	TRIENTRY *table;	/* trigram table */
+} TRIINDEX;
+
+typedef struct {		/* trigram being indexed */
+	unsigned long trigram;
+	unsigned long count;	/* number of files, 0 for a free slot */
+	unsigned long last;	/* last file number */
+	unsigned char *list;	/* file number differences */
+	unsigned long len;	/* file list length */
+	unsigned long size;	/* file list space */
+} TRIGRAM;
+
+static	TRIINDEX oldindex;		/* index of the old cross-reference */
+static	BOOL	haveold;		/* there is an old index */
+static	TRIGRAM	*trigrams;		/* hash table of the new trigrams */
+static	unsigned long ntrigrams;	/* number of new trigrams */
+static	unsigned long trigramsize;	/* hash table size */
+static	unsigned long *trigrammap;	/* trigrams found in a file */
+static	unsigned long *filetrigrams;	/* list of the trigrams in a file */
+static	unsigned long maxfiletrigrams;	/* file trigram list size */
+static	unsigned char fold[256];	/* lower case of each character */
+
+static	BOOL	triopen(char *name, TRIINDEX *ti);
+static	void	triclose(TRIINDEX *ti);
+static	TRIENTRY *trifind(TRIINDEX *ti, unsigned long trigram);
+static	long	trilist(TRIINDEX *ti, TRIENTRY *ep, unsigned long *files);
+static	BOOL	trifile(char *file, unsigned long fileno);
+static	TRIGRAM	*trislot(unsigned long trigram);
+static	void	triadd(unsigned long trigram, unsigned long fileno);
+static	BOOL	triwritelist(FILE *fp, unsigned long *files, unsigned long n,
+			     TRIENTRY *ep, unsigned long *offset);
+static	int	comparetrigrams(const void *s1, const void *s2);
+static	int	comparefiles(const void *s1, const void *s2);
+static	int	compareentries(const void *s1, const void *s2);
+static	unsigned char *putvarint(unsigned char *s, unsigned long n);
+static	unsigned char *getvarint(unsigned char *s, unsigned char *end,
+				 unsigned long *np);
+static	void	foldinit(void);
+
+/* get the index of the old cross-reference, if there is one, and remove its
+   file, which no longer matches the cross-reference being built */
+
+void
+trigramload(void)
+{
+	if (haveold == YES) {
+		triclose(&oldindex);
+	}
+	haveold = triopen(triname, &oldindex);
+	(void) unlink(triname);
+}
+
+/* create the trigram index of the source files, taking the trigrams of the
+   files that kept() accepts from the old index; returns NO if the index
+   cannot be written */
+
+BOOL
+trigrammake(char *name, BOOL (*kept)(char *file))
+{
+	FILE	*fp;
+	TRIHEADER header;
+	TRIENTRY *table = NULL;		/* new trigram table */
+	TRIENTRY *ep, *oldep, *oldend;
+	TRIGRAM	*tp, *tend;
+	long	*oldfileno = NULL;	/* new number of each old file */
+	char	*fromold;		/* the trigrams come from the old index */
+	char	***names;		/* new file names in sorted order */
+	char	***np;
+	char	**key;
+	unsigned long *files = NULL;	/* file numbers of a trigram */
+	unsigned long nfiles, maxfiles = 0;
+	unsigned long offset, ntable = 0;
+	unsigned char *list;
+	unsigned long i, n;
+	long	j, len;
+	BOOL	status = NO;
+
+	foldinit();
+	trigramsize = TRIHASHINC;
+	trigrams = mycalloc(trigramsize, sizeof(TRIGRAM));
+	ntrigrams = 0;
+	trigrammap = mycalloc(NTRIGRAMS / TRIBITS, sizeof(unsigned long));
+	maxfiletrigrams = FILETRIINC;
+	filetrigrams = mymalloc(maxfiletrigrams * sizeof(unsigned long));
+	fromold = mycalloc(nsrcfiles + 1, sizeof(char));
+
+	/* find the new number of each kept file in the old index */
+	if (haveold == YES) {
+		names = mymalloc((nsrcfiles + 1) * sizeof(char **));
+		for (i = 0; i < nsrcfiles; ++i) {
+			names[i] = &srcfiles[i];
+		}
+		qsort(names, nsrcfiles, sizeof(char **), comparefiles);
+		oldfileno = mymalloc((oldindex.header->nfiles + 1) *
+				     sizeof(long));
+		for (j = 0; j < oldindex.header->nfiles; ++j) {
+			oldfileno[j] = -1;
+			key = &oldindex.names[j];
+			np = bsearch(&key, names, nsrcfiles, sizeof(char **),
+				     comparefiles);
+			if (np != NULL && kept(**np) == YES) {
+				oldfileno[j] = *np - srcfiles;
+				fromold[oldfileno[j]] = YES;
+			}
+		}
+		free(names);
+	}
+	/* read the other files */
+	for (i = 0; i < nsrcfiles; ++i) {
+		if (fromold[i] == NO) {
+			(void) trifile(srcfiles[i], i);
+		}
+	}
+	free(trigrammap);
+	free(filetrigrams);
+	trigrammap = filetrigrams = NULL;
+
+	/* sort the new trigrams */
+	for (tp = tend = trigrams; tp < trigrams + trigramsize; ++tp) {
+		if (tp->count > 0) {
+			*tend++ = *tp;
+		}
+	}
+	qsort(trigrams, ntrigrams, sizeof(TRIGRAM), comparetrigrams);
+
+	/* write the header and the file names */
+	if ((fp = myfopen(name, "wb")) == NULL) {
+		goto done;
+	}
+	memset(&header, 0, sizeof(header));
+	header.version = TRIVERSION;
+	header.nfiles = nsrcfiles;
+	for (i = 0; i < nsrcfiles; ++i) {
+		header.namesize += strlen(srcfiles[i]) + 1;
+	}
+	header.namesize += sizeof(long) - 1;
+	header.namesize -= header.namesize % sizeof(long);
+	if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+		goto cannotwrite;
+	}
+	offset = sizeof(header);
+	for (i = 0; i < nsrcfiles; ++i) {
+		len = strlen(srcfiles[i]) + 1;
+		if (fwrite(srcfiles[i], len, 1, fp) != 1) {
+			goto cannotwrite;
+		}
+		offset += len;
+	}
+	for (; offset < sizeof(header) + header.namesize; ++offset) {
+		if (putc('\0', fp) == EOF) {
+			goto cannotwrite;
+		}
+	}
+
+	/* merge the old and new trigrams, writing their file lists */
+	oldep = oldend = NULL;
+	if (haveold == YES) {
+		oldep = oldindex.table;
+		oldend = oldep + oldindex.header->ntrigrams;
+	}
+	tp = trigrams;
+	tend = trigrams + ntrigrams;
+	table = mymalloc((ntrigrams + (oldend - oldep) + 1) *
+			 sizeof(TRIENTRY));
+	while (tp < tend || oldep < oldend) {
+		ep = &table[ntable];
+		nfiles = 0;
+		if (oldep < oldend && (tp == tend ||
+				       oldep->trigram <= tp->trigram)) {
+			ep->trigram = oldep->trigram;
+			if (oldep->count >
+			    (unsigned long) oldindex.header->nfiles) {
+				goto cannotwrite;
+			}
+			if (oldep->count + (tp < tend ? tp->count : 0) >
+			    maxfiles) {
+				maxfiles = oldep->count +
+					(tp < tend ? tp->count : 0);
+				files = myrealloc(files,
+						  maxfiles * sizeof(long));
+			}
+			if ((len = trilist(&oldindex, oldep, files)) < 0) {
+				goto cannotwrite;
+			}
+			/* keep the files that were not read again */
+			for (j = 0; j < len; ++j) {
+				if (oldfileno[files[j]] >= 0) {
+					files[nfiles++] = oldfileno[files[j]];
+				}
+			}
+			++oldep;
+		} else {
+			ep->trigram = tp->trigram;
+		}
+		if (tp < tend && tp->trigram == ep->trigram) {
+			if (nfiles + tp->count > maxfiles) {
+				maxfiles = nfiles + tp->count;
+				files = myrealloc(files,
+						  maxfiles * sizeof(long));
+			}
+			list = tp->list;
+			for (i = 0; i < tp->count; ++i) {
+				list = getvarint(list, tp->list + tp->len, &n);
+				if (list == NULL) {
+					goto cannotwrite;
+				}
+				files[nfiles + i] = n +
+					(i > 0 ? files[nfiles + i - 1] : 0);
+			}
+			/* the kept files come in the order of the old names */
+			if (nfiles > 0) {
+				nfiles += tp->count;
+				qsort(files, nfiles, sizeof(long), compareentries);
+			} else {
+				nfiles = tp->count;
+			}
+			free(tp->list);
+			tp->list = NULL;
+			++tp;
+		} else if (nfiles > 1) {
+			qsort(files, nfiles, sizeof(long), compareentries);
+		}
+		if (nfiles > 0) {
+			if (triwritelist(fp, files, nfiles, ep, &offset) == NO) {
+				goto cannotwrite;
+			}
+			++ntable;
+		}
+	}
+
+	/* write the trigram table, aligned after the file lists */
+	for (; offset % sizeof(long) != 0; ++offset) {
+		if (putc('\0', fp) == EOF) {
+			goto cannotwrite;
+		}
+	}
+	header.ntrigrams = ntable;
+	header.tableoffset = offset;
+	if ((ntable > 0 && fwrite(table, sizeof(TRIENTRY), ntable, fp) !=
+	     ntable) ||
+	    fseek(fp, 0L, SEEK_SET) != 0 ||
+	    fwrite(&header, sizeof(header), 1, fp) != 1) {
+		goto cannotwrite;
+	}
+	status = YES;
+
+cannotwrite:
+	if (fclose(fp) == EOF) {
+		status = NO;
+	}
+	if (status == NO) {
+		(void) unlink(name);
+	}
+done:
+	for (tp = trigrams; tp < trigrams + ntrigrams; ++tp) {
+		free(tp->list);
+	}
+	free(trigrams);
+	trigrams = NULL;
+	free(table);
+	free(files);
+	free(fromold);
+	free(oldfileno);
+	if (haveold == YES) {
+		triclose(&oldindex);
+		haveold = NO;
+	}
+	return(status);
+}
+
+/* get the source files that can contain matches of the compiled text search
+   pattern, in source file order, as well as those modified since the index
+   was built; returns their number, or -1 if all the files have to be
+   searched */
+
+long
+trigramfiles(unsigned long **filesp)
+{
+	TRIINDEX ti;
+	TRIENTRY *ep[PATLEN];		/* trigrams of a required string */
+	TRIENTRY *e;
+	unsigned long keys[PATLEN];
+	unsigned long *cand = NULL;	/* candidate files of a string */
+	unsigned long *list = NULL;	/* file list of a trigram */
+	char	*found;			/* files containing a string */
+	char	*s;
+	size_t	len;
+	long	ncand, nlist, nfound;
+	long	i, j, n, m;
+	unsigned long key;
+	int	k;
+	struct	stat tristat;		/* index file status */
+
+	if (stat(triname, &tristat) != 0 || triopen(triname, &ti) == NO) {
+		return(-1);
+	}
+	/* the index must be of the files of this cross-reference */
+	if ((unsigned long) ti.header->nfiles != nsrcfiles) {
+		triclose(&ti);
+		return(-1);
+	}
+	for (i = 0; i < ti.header->nfiles; ++i) {
+		if (strcmp(ti.names[i], srcfiles[i]) != 0) {
+			triclose(&ti);
+			return(-1);
+		}
+	}
+	foldinit();
+	found = mycalloc(nsrcfiles + 1, sizeof(char));
+	for (k = 0; (s = egrepmust(k, &len)) != NULL; ++k) {
+
+		/* get the distinct trigrams of the string */
+		for (n = 0, i = 0; i + 2 < (long) len && n < PATLEN; ++i) {
+			keys[n++] = (unsigned long) fold[(unsigned char) s[i]]
+				<< 16 | fold[(unsigned char) s[i + 1]] << 8 |
+				fold[(unsigned char) s[i + 2]];
+		}
+		if (n == 0) {
+			/* any file can match this alternative */
+			k = -1;
+			break;
+		}
+		qsort(keys, n, sizeof(long), compareentries);
+		for (m = 0, i = 0; i < n; ++i) {
+			if (i == 0 || keys[i] != keys[i - 1]) {
+				if ((e = trifind(&ti, keys[i])) == NULL) {
+					break;
+				}
+				ep[m++] = e;
+			}
+		}
+		if (i < n) {
+			continue;	/* a trigram is in no file */
+		}
+		/* intersect the file lists, shortest first */
+		for (i = 1; i < m; ++i) {
+			for (j = i; j > 0 && ep[j]->count < ep[j - 1]->count; --j) {
+				e = ep[j];
+				ep[j] = ep[j - 1];
+				ep[j - 1] = e;
+			}
+		}
+		/* trilist() rejects lists of more than nfiles files */
+		cand = myrealloc(cand, (ti.header->nfiles + 1) * sizeof(long));
+		list = myrealloc(list, (ti.header->nfiles + 1) * sizeof(long));
+		if ((ncand = trilist(&ti, ep[0], cand)) < 0) {
+			k = -1;
+			break;
+		}
+		for (i = 1; i < m && ncand > 0; ++i) {
+			if ((nlist = trilist(&ti, ep[i], list)) < 0) {
+				ncand = -1;
+				break;
+			}
+			for (n = 0, key = 0, j = 0; key < (unsigned long) ncand &&
+				     j < nlist; ) {
+				if (cand[key] < list[j]) {
+					++key;
+				} else if (cand[key] > list[j]) {
+					++j;
+				} else {
+					cand[n++] = cand[key++];
+					++j;
+				}
+			}
+			ncand = n;
+		}
+		if (ncand < 0) {
+			k = -1;
+			break;
+		}
+		for (i = 0; i < ncand; ++i) {
+			found[cand[i]] = YES;
+		}
+	}
+	free(cand);
+	free(list);
+	triclose(&ti);
+
+	/* there are no strings that every match contains */
+	if (k <= 0) {
+		free(found);
+		return(-1);
+	}
+	/* the old trigrams of a file modified since the index was built (in
+	   the same second included) may not have the strings, so the file is
+	   searched anyway, as is a file that is gone, to report it */
+	freefilestats();
+	statfiles(0, nsrcfiles);
+	for (i = 0; (unsigned long) i < nsrcfiles; ++i) {
+		if (filestats[i].exists == NO ||
+		    filestats[i].mtime >= tristat.st_mtime) {
+			found[i] = YES;
+		}
+	}
+	freefilestats();
+	*filesp = mymalloc((nsrcfiles + 1) * sizeof(long));
+	for (nfound = 0, i = 0; (unsigned long) i < nsrcfiles; ++i) {
+		if (found[i] == YES) {
+			(*filesp)[nfound++] = i;
+		}
+	}
+	free(found);
+	return(nfound);
+}
+
+/* read and check an index file */
+
+static BOOL
+triopen(char *name, TRIINDEX *ti)
+{
+	FILE	*fp;
+	char	*s, *end;
+	long	i;
+#if defined(HAVE_MMAP)
+	struct	stat	st;
+	void	*ptr;
+#endif
+
+	memset(ti, 0, sizeof(TRIINDEX));
+	if ((fp = myfopen(name, "rb")) == NULL) {
+		return(NO);
+	}
+#if defined(HAVE_MMAP)
+	if (fstat(fileno(fp), &st) == 0 && st.st_size > 0 &&
+	    (ptr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED,
+			fileno(fp), 0)) != MAP_FAILED) {
+		ti->data = ptr;
+		ti->size = st.st_size;
+		ti->mapped = YES;
+	}
+#endif
+	if (ti->mapped == NO) {
+		if (fseek(fp, 0L, SEEK_END) != 0 || (ti->size = ftell(fp)) <= 0 ||
+		    fseek(fp, 0L, SEEK_SET) != 0) {
+			fclose(fp);
+			return(NO);
+		}
+		ti->data = mymalloc(ti->size);
+		if (fread(ti->data, ti->size, 1, fp) != 1) {
+			free(ti->data);
+			fclose(fp);
+			return(NO);
+		}
+	}
+	fclose(fp);
+
+	/* check the header and the table bounds */
+	ti->header = (TRIHEADER *) ti->data;
+	if (ti->size < (long) sizeof(TRIHEADER) ||
+	    ti->header->version != TRIVERSION || ti->header->nfiles < 0 ||
+	    ti->header->namesize < 0 || ti->header->ntrigrams < 0 ||
+	    ti->header->namesize > ti->size - (long) sizeof(TRIHEADER) ||
+	    ti->header->tableoffset % sizeof(long) != 0 ||
+	    ti->header->tableoffset < (long) sizeof(TRIHEADER) +
+	    ti->header->namesize ||
+	    ti->header->tableoffset > ti->size ||
+	    (unsigned long) ti->header->ntrigrams >
+	    (ti->size - ti->header->tableoffset) / sizeof(TRIENTRY)) {
+		triclose(ti);
+		return(NO);
+	}
+	ti->table = (TRIENTRY *) (ti->data + ti->header->tableoffset);
+
+	/* point at the file names */
+	ti->names = mymalloc((ti->header->nfiles + 1) * sizeof(char *));
+	s = ti->data + sizeof(TRIHEADER);
+	end = s + ti->header->namesize;
+	for (i = 0; i < ti->header->nfiles; ++i) {
+		ti->names[i] = s;
+		if ((s = memchr(s, '\0', end - s)) == NULL) {
+			triclose(ti);
+			return(NO);
+		}
+		++s;
+	}
+	return(YES);
+}
+
+/* release a read index file */
+
+static void
+triclose(TRIINDEX *ti)
+{
+	if (ti->data != NULL) {
+#if defined(HAVE_MMAP)
+		if (ti->mapped == YES) {
+			(void) munmap(ti->data, (size_t) ti->size);
+		} else
+#endif
+		free(ti->data);
+	}
+	free(ti->names);
+	memset(ti, 0, sizeof(TRIINDEX));
+}
+
+/* find a trigram in the table of an index file */
+
+static TRIENTRY *
+trifind(TRIINDEX *ti, unsigned long trigram)
+{
+	long	low, high, mid;
+
+	low = 0;
+	high = ti->header->ntrigrams - 1;
+	while (low <= high) {
+		mid = (low + high) / 2;
+		if (ti->table[mid].trigram < trigram) {
+			low = mid + 1;
+		} else if (ti->table[mid].trigram > trigram) {
+			high = mid - 1;
+		} else {
+			return(&ti->table[mid]);
+		}
+	}
+	return(NULL);
+}
+
+/* get the file numbers of a trigram in an index file, at most the number of
+   files of the index; returns their number, or -1 if the list is corrupt */
+
+static long
+trilist(TRIINDEX *ti, TRIENTRY *ep, unsigned long *files)
+{
+	unsigned char *s, *end;
+	unsigned long n, fileno = 0;
+	unsigned long i;
+
+	if (ep->offset > (unsigned long) ti->header->tableoffset ||
+	    ep->count > (unsigned long) ti->header->nfiles) {
+		return(-1);
+	}
+	s = (unsigned char *) ti->data + ep->offset;
+	end = (unsigned char *) ti->data + ti->header->tableoffset;
+	for (i = 0; i < ep->count; ++i) {
+		if ((s = getvarint(s, end, &n)) == NULL) {
+			return(-1);
+		}
+		fileno += n;
+		if ((i > 0 && n == 0) ||
+		    fileno >= (unsigned long) ti->header->nfiles) {
+			return(-1);
+		}
+		files[i] = fileno;
+	}
+	return(ep->count);
+}
+
+/* add the trigrams of a source file to the new index */
+
+static BOOL
+trifile(char *file, unsigned long fileno)
+{
+	static	unsigned char	buf[TRIREAD];
+	FILE	*fp;
+	unsigned long trigram = 0;
+	unsigned long n = 0;		/* trigrams in the file */
+	unsigned long i;
+	size_t	len, j;
+	int	chars = 0;		/* characters in the trigram */
+
+	if ((fp = myfopen(file, "rb")) == NULL) {
+		return(NO);
+	}
+	while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		for (j = 0; j < len; ++j) {
+			if (buf[j] == '\n') {
+				chars = 0;
+				continue;
+			}
+			trigram = (trigram << 8 | fold[buf[j]]) & (NTRIGRAMS - 1);
+			if (++chars < 3) {
+				continue;
+			}
+			if (!(trigrammap[trigram / TRIBITS] &
+			      1UL << trigram % TRIBITS)) {
+				trigrammap[trigram / TRIBITS] |=
+					1UL << trigram % TRIBITS;
+				if (n == maxfiletrigrams) {
+					maxfiletrigrams += FILETRIINC;
+					filetrigrams = myrealloc(filetrigrams,
+						maxfiletrigrams *
+						sizeof(unsigned long));
+				}
+				filetrigrams[n++] = trigram;
+			}
+		}
+	}
+	fclose(fp);
+
+	/* clear the map for the next file */
+	for (i = 0; i < n; ++i) {
+		trigrammap[filetrigrams[i] / TRIBITS] = 0;
+	}
+	for (i = 0; i < n; ++i) {
+		triadd(filetrigrams[i], fileno);
+	}
+	return(YES);
+}
+
+/* find the hash table slot of a new trigram */
+
+static TRIGRAM *
+trislot(unsigned long trigram)
+{
+	unsigned long i;
+
+	i = (trigram * 2654435761UL) & (trigramsize - 1);
+	while (trigrams[i].count > 0 && trigrams[i].trigram != trigram) {
+		i = (i + 1) & (trigramsize - 1);
+	}
+	return(&trigrams[i]);
+}
+
+/* add a file to the list of a new trigram */
+
+static void
+triadd(unsigned long trigram, unsigned long fileno)
+{
+	TRIGRAM	*tp, *old;
+	unsigned long i, oldsize;
+
+	tp = trislot(trigram);
+	if (tp->count == 0) {
+		/* keep the hash table at most half full */
+		if (2 * (ntrigrams + 1) > trigramsize) {
+			old = trigrams;
+			oldsize = trigramsize;
+			trigramsize *= 2;
+			trigrams = mycalloc(trigramsize, sizeof(TRIGRAM));
+			for (i = 0; i < oldsize; ++i) {
+				if (old[i].count > 0) {
+					*trislot(old[i].trigram) = old[i];
+				}
+			}
+			free(old);
+			tp = trislot(trigram);
+		}
+		tp->trigram = trigram;
+		tp->last = 0;
+		++ntrigrams;
+	}
+	if (tp->len + MAXVARINT > tp->size) {
+		tp->size = tp->size * 2 + MAXVARINT;
+		tp->list = myrealloc(tp->list, tp->size);
+	}
+	tp->len = putvarint(tp->list + tp->len, fileno - tp->last) - tp->list;
+	tp->last = fileno;
+	++tp->count;
+}
+
+/* write the file list of a trigram, completing its table entry */
+
+static BOOL
+triwritelist(FILE *fp, unsigned long *files, unsigned long n, TRIENTRY *ep,
+	     unsigned long *offset)
+{
+	unsigned char buf[MAXVARINT];
+	unsigned long i, last = 0;
+	long	len;
+
+	ep->offset = *offset;
+	ep->count = n;
+	for (i = 0; i < n; ++i) {
+		len = putvarint(buf, files[i] - last) - buf;
+		if (fwrite(buf, len, 1, fp) != 1) {
+			return(NO);
+		}
+		*offset += len;
+		last = files[i];
+	}
+	return(YES);
+}
+
+/* trigram comparison function for sorting the new trigrams */
+
+static int
+comparetrigrams(const void *arg_s1, const void *arg_s2)
+{
+	const TRIGRAM *s1 = (const TRIGRAM *) arg_s1;
+	const TRIGRAM *s2 = (const TRIGRAM *) arg_s2;
+
+	if (s1->trigram < s2->trigram) {
+		return(-1);
+	}
+	return(s1->trigram > s2->trigram);
+}
+
+/* comparison function for pointers to file names */
+
+static int
+comparefiles(const void *arg_s1, const void *arg_s2)
+{
+	return(strcmp(**(char **const *) arg_s1, **(char **const *) arg_s2));
+}
+
+/* number comparison function, for file numbers and trigram values */
+
+static int
+compareentries(const void *arg_s1, const void *arg_s2)
+{
+	unsigned long n1 = *(const unsigned long *) arg_s1;
+	unsigned long n2 = *(const unsigned long *) arg_s2;
+
+	if (n1 < n2) {
+		return(-1);
+	}
+	return(n1 > n2);
+}
+
+static unsigned char *
+putvarint(unsigned char *s, unsigned long n)
+{
+	while (n >= 0x80) {
+		*s++ = (unsigned char) (n | 0x80);
+		n >>= 7;
+	}
+	*s++ = (unsigned char) n;
+	return(s);
+}
+
+static unsigned char *
+getvarint(unsigned char *s, unsigned char *end, unsigned long *np)
+{
+	unsigned long n = 0;
+	int	shift;
+
+	for (shift = 0; s < end && shift < (int) sizeof(long) * 8; shift += 7) {
+		n |= (unsigned long) (*s & 0x7f) << shift;
+		if (*s++ < 0x80) {
+			*np = n;
+			return(s);
+		}
+	}
+	return(NULL);
+}
+
+/* set up the lower case of each character */
+
+static void
+foldinit(void)
+{
+	int	i;
+
+	for (i = 0; i < 256; ++i) {
+		fold[i] = tolower(i);
+	}
+}
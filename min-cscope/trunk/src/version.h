@@ -42,7 +42,7 @@
 #define CSCOPE_VERSION_H
 
 #define APPNAME         "min-cscope"
-#define	FILEVERSION	16
+#define	FILEVERSION	18
 #define	FIXVERSION	".1.1"
 
 #endif /* CSCOPE_VERSION_H */
@@ -133,6 +133,12 @@ void Actions::setup()
 	// Show/hide the query dock.
 	menu->addAction(mainWnd()->queryDock_->toggleViewAction());
 
+	// Show query performance information.
+	action = new QAction(tr("Engine &Statistics..."), this);
+	action->setStatusTip(tr("Show performance information on queries"));
+	connect(action, SIGNAL(triggered()), mainWnd(), SLOT(engineStats()));
+	menu->addAction(action);
+
 	// A group for project actions requiring an open project.
 	// Only enabled when there is an active project.
 	QActionGroup* projectGroup = new QActionGroup(this);
@@ -144,6 +150,16 @@ void Actions::setup()
 	// Enabled only when there is an active project.
 	menu = mainWnd()->menuBar()->addMenu(tr("&Navigate"));
 
+	// Open a project file by name.
+	action = new QAction(tr("&Quick Open..."), this);
+	action->setShortcut(tr("Ctrl+K"));
+	action->setStatusTip(tr("Open a project file by typing parts of its name"));
+	connect(action, SIGNAL(triggered()), mainWnd(), SLOT(quickOpen()));
+	menu->addAction(action);
+	projectGroup->addAction(action);
+
+	menu->addSeparator();
+
 	// Go to the next location in the navigation history.
 	action = new QAction(tr("Next &Location"), this);
 	action->setShortcut(tr("Alt+Right"));
@@ -217,6 +233,21 @@ void Actions::setup()
 	menu->addAction(action);
 	projectGroup->addAction(action);
 
+	// Open another project alongside the active one.
+	action = new QAction(tr("Add to &Workspace..."), this);
+	action->setStatusTip(tr("Query another project along with this one"));
+	connect(action, SIGNAL(triggered()), mainWnd(), SLOT(addToWorkspace()));
+	menu->addAction(action);
+	projectGroup->addAction(action);
+
+	// Close one of the other projects in the workspace.
+	action = new QAction(tr("&Remove from Workspace..."), this);
+	action->setStatusTip(tr("Stop querying another project"));
+	connect(action, SIGNAL(triggered()), mainWnd(),
+	        SLOT(removeFromWorkspace()));
+	menu->addAction(action);
+	projectGroup->addAction(action);
+
 	// View/edit project parameters.
 	action = new QAction(tr("&Properties..."), this);
 	action->setStatusTip(tr("View/edit project parameters"));
@@ -25,6 +25,7 @@
 #include <QDebug>
 #include <core/filefilter.h>
 #include <core/filescanner.h>
+#include <core/gitindexscanner.h>
 #include "addfilesdialog.h"
 #include "projectmanager.h"
 
@@ -140,6 +141,47 @@ void AddFilesDialog::addTree()
 	addTree(true);
 }
 
+/**
+ * Prompts the user for a directory inside a Git working tree.
+ * Adds all files under the selected directory that are tracked by the
+ * repository, and match the current filter. The list is taken from the
+ * repository's index, rather than by scanning the file system. If requested,
+ * untracked files that are not ignored are added as well.
+ */
+void AddFilesDialog::addGitIndex()
+{
+	// Prompt the user for a directory.
+	QStringList list;
+	if (!getFiles(QFileDialog::DirectoryOnly, list))
+		return;
+
+	// Create the scanner object.
+	Core::GitIndexScanner scanner(this);
+	scanner.setProgressMessage(tr("Found %2 of %1 files"));
+
+	// Create a modal progress dialogue.
+	// Reading the index is fast, but scanning for untracked files may take a
+	// while.
+	QProgressDialog dlg(tr("Reading index..."), tr("Cancel"), 0, 0, this);
+	dlg.setModal(true);
+	connect(&dlg, SIGNAL(canceled()), &scanner, SLOT(stop()));
+	connect(&scanner, SIGNAL(progress(const QString&)), &dlg,
+	        SLOT(setLabelText(const QString&)));
+	dlg.show();
+
+	QString filter = filterEdit_->text();
+
+	// Get the list of files.
+	if (scanner.scan(list.first(), Core::FileFilter(filter),
+	                 untrackedCheck_->isChecked())) {
+		fileList_->addItems(scanner.matchedFiles());
+	}
+	else if (!scanner.errorString().isEmpty()) {
+		dlg.hide();
+		QMessageBox::critical(this, tr("Git Index"), scanner.errorString());
+	}
+}
+
 /**
  * Prompts the user for a text file which contains a file filter.
  * The first line in the selected file is set as the current filter.
@@ -49,6 +49,7 @@ protected slots:
 	void addFiles();
 	void addDir();
 	void addTree();
+	void addGitIndex();
 	void loadFilter();
 	void saveFilter();
 	void deleteSelectedFiles();
@@ -20,7 +20,9 @@ SOURCES += openprojectdialog.cpp \
     queryresultdock.cpp \
     queryresultdialog.cpp \
     addfilesdialog.cpp \
-    configenginesdialog.cpp
+    configenginesdialog.cpp \
+    enginestatsdialog.cpp \
+    quickopendialog.cpp
 HEADERS += openprojectdialog.h \
     settings.h \
     session.h \
@@ -41,7 +43,9 @@ HEADERS += openprojectdialog.h \
     projectdialog.h \
     buildprogress.h \
     version.h \
-    configenginesdialog.h
+    configenginesdialog.h \
+    enginestatsdialog.h \
+    quickopendialog.h
 FORMS += querydialog.ui \
     queryresultdialog.ui \
     stackpage.ui \
@@ -49,7 +53,9 @@ FORMS += querydialog.ui \
     addfilesdialog.ui \
     projectdialog.ui \
     configenginesdialog.ui \
-    openprojectdialog.ui
+    openprojectdialog.ui \
+    enginestatsdialog.ui \
+    quickopendialog.ui
 INCLUDEPATH += .. \
     $${QSCI_ROOT_PATH}/include/Qsci \
     .
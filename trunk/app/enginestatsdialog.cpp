@@ -0,0 +1,140 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include "enginestatsdialog.h"
+#include "projectmanager.h"
+#include "strings.h"
+
+namespace KScope
+{
+
+namespace App
+{
+
+/**
+ * Class constructor.
+ * @param  parent  Parent widget
+ */
+EngineStatsDialog::EngineStatsDialog(QWidget* parent)
+	: QDialog(parent), Ui::EngineStatsDialog()
+{
+	setupUi(this);
+
+	// Fill the views with the information collected so far.
+	const Core::QueryStatsLog& log = ProjectManager::queryStats();
+	updateSummary();
+	foreach (const Core::QueryStats& stats, log.recent())
+		addRecent(stats);
+
+	connect(&log, SIGNAL(added(const Core::QueryStats&)), this,
+	        SLOT(queryAdded(const Core::QueryStats&)));
+	connect(clearButton_, SIGNAL(clicked()), this, SLOT(clear()));
+}
+
+/**
+ * Class destructor.
+ */
+EngineStatsDialog::~EngineStatsDialog()
+{
+}
+
+/**
+ * Rebuilds the per-type latency view.
+ */
+void EngineStatsDialog::updateSummary()
+{
+	const Core::QueryStatsLog& log = ProjectManager::queryStats();
+
+	summaryView_->clear();
+	foreach (Core::Query::Type type, log.types()) {
+		Core::QueryStatsLog::Summary summary = log.summary(type);
+
+		QTreeWidgetItem* item = new QTreeWidgetItem(summaryView_);
+		item->setText(0, Strings::toString(type));
+		item->setText(1, QString::number(summary.count_));
+		item->setText(2, QString::number(summary.p50_));
+		item->setText(3, QString::number(summary.p90_));
+		item->setText(4, QString::number(summary.p99_));
+		item->setText(5, QString::number(summary.max_));
+	}
+
+	for (int i = 0; i < summaryView_->columnCount(); i++)
+		summaryView_->resizeColumnToContents(i);
+}
+
+/**
+ * Adds an item for a finished query at the top of the recent queries view.
+ * @param  stats  Performance information for the query
+ */
+void EngineStatsDialog::addRecent(const Core::QueryStats& stats)
+{
+	typedef Core::QueryStats QS;
+
+	QTreeWidgetItem* item = new QTreeWidgetItem();
+	QString text = Strings::toString(stats.query_);
+	if (stats.aborted_)
+		text += tr(" (aborted)");
+
+	item->setText(0, text);
+	item->setText(1, QString::number(stats.elapsed(QS::Queued, QS::Started)));
+	item->setText(2, QString::number(stats.elapsed(QS::Started,
+	                                               QS::ProcessStarted)));
+	item->setText(3, QString::number(stats.elapsed(QS::ProcessStarted,
+	                                               QS::FirstOutput)));
+	item->setText(4, QString::number(stats.elapsed(QS::FirstOutput,
+	                                               QS::SearchDone)));
+	item->setText(5, QString::number(stats.elapsed(QS::SearchDone,
+	                                               QS::Exited)));
+	item->setText(6, QString::number(stats.parseTime_));
+	item->setText(7, QString::number(stats.insertTime_));
+	item->setText(8, QString::number(stats.latency()));
+	item->setText(9, QString::number(stats.bytesRead_));
+	item->setText(10, QString::number(stats.linesParsed_));
+	item->setText(11, QString::number(stats.results_));
+	recentView_->insertTopLevelItem(0, item);
+
+	// Do not keep more items than the log does.
+	while (recentView_->topLevelItemCount() > Core::QueryStatsLog::RecentSize)
+		delete recentView_->takeTopLevelItem(Core::QueryStatsLog::RecentSize);
+}
+
+/**
+ * Called when a query finishes.
+ * @param  stats  Performance information for the query
+ */
+void EngineStatsDialog::queryAdded(const Core::QueryStats& stats)
+{
+	updateSummary();
+	addRecent(stats);
+}
+
+/**
+ * Discards all collected information.
+ */
+void EngineStatsDialog::clear()
+{
+	ProjectManager::queryStats().clear();
+	summaryView_->clear();
+	recentView_->clear();
+}
+
+} // namespace App
+
+} // namespace KScope
@@ -0,0 +1,62 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __APP_ENGINESTATSDIALOG_H__
+#define __APP_ENGINESTATSDIALOG_H__
+
+#include <QDialog>
+#include <core/querystats.h>
+#include "ui_enginestatsdialog.h"
+
+namespace KScope
+{
+
+namespace App
+{
+
+/**
+ * Displays performance information on queries.
+ * The dialogue shows latency percentiles for each query type, along with a
+ * per-phase breakdown of the most recent queries. It is updated as queries
+ * finish.
+ * @author Elad Lahav
+ */
+class EngineStatsDialog : public QDialog, private Ui::EngineStatsDialog
+{
+	Q_OBJECT
+
+public:
+	EngineStatsDialog(QWidget* parent = 0);
+	~EngineStatsDialog();
+
+private:
+	void updateSummary();
+	void addRecent(const Core::QueryStats&);
+
+private slots:
+	void queryAdded(const Core::QueryStats&);
+	void clear();
+};
+
+} // namespace App
+
+} // namespace KScope
+
+#endif // __APP_ENGINESTATSDIALOG_H__
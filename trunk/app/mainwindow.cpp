@@ -22,6 +22,7 @@
 #include <QCloseEvent>
 #include <QStatusBar>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <cscope/managedproject.h>
 #include <editor/editor.h>
 #include "mainwindow.h"
@@ -35,6 +36,8 @@
 #include "openprojectdialog.h"
 #include "projectfilesdialog.h"
 #include "configenginesdialog.h"
+#include "enginestatsdialog.h"
+#include "quickopendialog.h"
 
 namespace KScope
 {
@@ -209,6 +212,19 @@ void MainWindow::promptCallTree()
 	                  true);
 }
 
+/**
+ * Handles the "Navigate->Quick Open..." action.
+ * Prompts the user for a project file, and opens it in an editor.
+ */
+void MainWindow::quickOpen()
+{
+	QuickOpenDialog dlg(this);
+	if (dlg.exec() != QDialog::Accepted)
+		return;
+
+	openFile(dlg.path());
+}
+
 /**
  * Starts a build process for the current project's engine.
  * Provides progress information in either a modal dialogue or a progress-bar
@@ -347,6 +363,12 @@ bool MainWindow::closeProject()
 		// Store session information.
 		Session session(ProjectManager::project()->path());
 		editCont_->saveSession(session);
+
+		QStringList workspace;
+		foreach (const Core::ProjectBase* proj, ProjectManager::workspace())
+			workspace.append(proj->path());
+		session.setWorkspace(workspace);
+
 		queryDock_->saveSession(session);
 		queryDock_->closeAll();
 		session.save();
@@ -374,6 +396,58 @@ void MainWindow::projectFiles()
 	dlg.exec();
 }
 
+/**
+ * Handles the "Project->Add to Workspace..." action.
+ * Prompts the user for a project, which is opened alongside the active one.
+ * Queries are then run on all projects in the workspace.
+ */
+void MainWindow::addToWorkspace()
+{
+	OpenProjectDialog dlg(this);
+	dlg.setWindowTitle(tr("Add to Workspace"));
+	if (dlg.exec() != OpenProjectDialog::Open)
+		return;
+
+	try {
+		ProjectManager::addToWorkspace<Cscope::ManagedProject>(dlg.path());
+	}
+	catch (Core::Exception* e) {
+		e->showMessage();
+		delete e;
+	}
+
+	setWindowTitle(true);
+}
+
+/**
+ * Handles the "Project->Remove from Workspace..." action.
+ * Prompts the user for one of the additional projects in the workspace, and
+ * closes it.
+ */
+void MainWindow::removeFromWorkspace()
+{
+	QList<const Core::ProjectBase*> projList = ProjectManager::workspace();
+	if (projList.isEmpty()) {
+		QMessageBox::information(this, tr("Remove from Workspace"),
+		                         tr("The workspace does not hold any other "
+		                            "projects"));
+		return;
+	}
+
+	QStringList paths;
+	foreach (const Core::ProjectBase* proj, projList)
+		paths.append(proj->path());
+
+	bool ok;
+	QString path = QInputDialog::getItem(this, tr("Remove from Workspace"),
+	                                     tr("Project"), paths, 0, false, &ok);
+	if (!ok)
+		return;
+
+	ProjectManager::removeFromWorkspace(path);
+	setWindowTitle(true);
+}
+
 /**
  * Handles the "Project->Properties..." action.
  * Shows the "Project Properties" dialogue.
@@ -432,6 +506,17 @@ void MainWindow::configEngines()
 	dlg.exec();
 }
 
+/**
+ * Handles the "View->Engine Statistics..." action.
+ * Shows a (non-modal) dialogue with performance information on queries.
+ */
+void MainWindow::engineStats()
+{
+	EngineStatsDialog* dlg = new EngineStatsDialog(this);
+	dlg->setAttribute(Qt::WA_DeleteOnClose);
+	dlg->show();
+}
+
 /**
  * Called before the main window closes.
  * @param  event  Information on the closing event
@@ -485,9 +570,15 @@ void MainWindow::readSettings()
 void MainWindow::setWindowTitle(bool hasProject)
 {
 	QString title = qApp->applicationName();
-	if (hasProject)
+	if (hasProject) {
 		title += " - " + ProjectManager::project()->name();
 
+		// Show the number of other projects in the workspace.
+		int others = ProjectManager::workspace().size();
+		if (others > 0)
+			title += tr(" (+%1)").arg(others);
+	}
+
 	QMainWindow::setWindowTitle(title);
 }
 
@@ -509,6 +600,21 @@ void MainWindow::projectOpenedClosed(bool opened)
 	// Restore the session.
 	Session session(ProjectManager::project()->path());
 	session.load();
+
+	// Reopen the other projects in the workspace.
+	foreach (QString path, session.workspace()) {
+		try {
+			ProjectManager::addToWorkspace<Cscope::ManagedProject>(path);
+		}
+		catch (Core::Exception* e) {
+			e->showMessage();
+			delete e;
+		}
+	}
+
+	if (!session.workspace().isEmpty())
+		setWindowTitle(true);
+
 	editCont_->loadSession(session);
 	queryDock_->loadSession(session);
 
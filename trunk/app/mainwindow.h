@@ -58,6 +58,7 @@ public slots:
 	void promptQuery(Core::Query::Type type = Core::Query::References);
 	void quickDefinition();
 	void promptCallTree();
+	void quickOpen();
 	void buildProject();
 	void openFile(const QString&);
 
@@ -65,9 +66,12 @@ public slots:
 	void newProject();
 	void openProject();
 	bool closeProject();
+	void addToWorkspace();
+	void removeFromWorkspace();
 	void projectFiles();
 	void projectProperties();
 	void configEngines();
+	void engineStats();
 
 protected:
 	virtual void closeEvent(QCloseEvent*);
@@ -42,6 +42,13 @@ ProjectFilesDialog::ProjectFilesDialog(QWidget* parent)
 		Core::CodebaseModel* model
 			= new Core::CodebaseModel(codebase, proj->rootPath(), this);
 		view_->setModel(model);
+
+		// The file list cannot be changed or saved before the model holds
+		// all files.
+		if (model->isBuilding()) {
+			setBuilding(true);
+			connect(model, SIGNAL(ready()), this, SLOT(modelReady()));
+		}
 	}
 	catch (Core::Exception* e) {
 		e->showMessage();
@@ -91,6 +98,26 @@ void ProjectFilesDialog::removeFiles()
 	// TODO: Implement!
 }
 
+/**
+ * Called when the model holds all files in the code base.
+ */
+void ProjectFilesDialog::modelReady()
+{
+	setBuilding(false);
+}
+
+/**
+ * Disables the buttons that change or save the file list while the model is
+ * being built.
+ * @param  building  true while the model is being built, false otherwise
+ */
+void ProjectFilesDialog::setBuilding(bool building)
+{
+	addButton_->setEnabled(!building);
+	removeButton_->setEnabled(!building);
+	okButton_->setEnabled(!building);
+}
+
 }
 
 }
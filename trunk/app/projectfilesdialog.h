@@ -44,6 +44,10 @@ public slots:
 protected slots:
 	void addFiles();
 	void removeFiles();
+	void modelReady();
+
+private:
+	void setBuilding(bool);
 };
 
 }
@@ -18,6 +18,7 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  ***************************************************************************/
 
+#include <QDir>
 #include <core/exception.h>
 #include "projectmanager.h"
 
@@ -28,7 +29,11 @@ namespace App
 {
 
 Core::ProjectBase* ProjectManager::proj_ = NULL;
+Core::QueryScheduler* ProjectManager::scheduler_ = NULL;
+Core::QueryStatsLog ProjectManager::statsLog_;
 ProjectManagerSignals ProjectManager::signals_;
+QList<ProjectManager::Member> ProjectManager::members_;
+Core::FederatedEngine* ProjectManager::federation_ = NULL;
 
 const Core::ProjectBase* ProjectManager::project()
 {
@@ -43,11 +48,13 @@ Core::Engine& ProjectManager::engine()
 	if (proj_ == NULL)
 		throw Core::Exception("No project is currently loaded");
 
-	Core::Engine* engine = proj_->engine();
-	if (engine == NULL)
+	if (scheduler_ == NULL)
 		throw new Core::Exception("No engine is available");
 
-	return *engine;
+	if (federation_)
+		return *federation_;
+
+	return *scheduler_;
 }
 
 Core::Codebase& ProjectManager::codebase()
@@ -67,6 +74,61 @@ const ProjectManagerSignals* ProjectManager::signalProxy()
 	return &signals_;
 }
 
+/**
+ * @return Performance information on the queries run for the current (or
+ *         last) project
+ */
+Core::QueryStatsLog& ProjectManager::queryStats()
+{
+	return statsLog_;
+}
+
+/**
+ * Removes an additional project from the workspace, and closes it.
+ * @param  projPath  The directory of the project
+ */
+void ProjectManager::removeFromWorkspace(const QString& projPath)
+{
+	QString path = QDir::cleanPath(projPath);
+
+	for (int i = 0; i < members_.size(); i++) {
+		Member member = members_[i];
+		if (QDir::cleanPath(member.proj_->path()) != path)
+			continue;
+
+		members_.removeAt(i);
+
+		// Queries are no longer federated once the workspace only holds the
+		// active project.
+		if (members_.isEmpty()) {
+			delete federation_;
+			federation_ = NULL;
+		}
+		else {
+			federation_->removeMember(member.scheduler_);
+		}
+
+		delete member.scheduler_;
+		member.proj_->close();
+		delete member.proj_;
+		return;
+	}
+}
+
+/**
+ * @return The additional projects in the workspace (not including the active
+ *         project)
+ */
+QList<const Core::ProjectBase*> ProjectManager::workspace()
+{
+	QList<const Core::ProjectBase*> projList;
+
+	foreach (const Member& member, members_)
+		projList.append(member.proj_);
+
+	return projList;
+}
+
 void ProjectManager::updateConfig(Core::ProjectBase::Params& params)
 {
 	// Make sure a project is loaded.
@@ -91,6 +153,22 @@ void ProjectManager::close()
 	if (proj_ == NULL)
 		return;
 
+	// Close the other projects in the workspace.
+	// The federated engine needs to go before the engines it uses.
+	delete federation_;
+	federation_ = NULL;
+	foreach (const Member& member, members_) {
+		delete member.scheduler_;
+		member.proj_->close();
+		delete member.proj_;
+	}
+	members_.clear();
+
+	// Stop all queries.
+	delete scheduler_;
+	scheduler_ = NULL;
+	statsLog_.setLogFile(QString());
+
 	// Close the project.
 	proj_->close();
 	delete proj_;
@@ -100,6 +178,66 @@ void ProjectManager::close()
 	signals_.emitHasProject(false);
 }
 
+/**
+ * @param  projPath  The directory of a project
+ * @return true if the project is the active one, or in the workspace, false
+ *         otherwise
+ */
+bool ProjectManager::isOpen(const QString& projPath)
+{
+	QString path = QDir::cleanPath(projPath);
+
+	if (proj_ && (QDir::cleanPath(proj_->path()) == path))
+		return true;
+
+	foreach (const Member& member, members_) {
+		if (QDir::cleanPath(member.proj_->path()) == path)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Adds an open project to the workspace.
+ * The federated engine is created when the first project is added.
+ * @param  proj  The project to add
+ * @throw  Exception
+ */
+void ProjectManager::addMember(Core::ProjectBase* proj)
+{
+	if ((proj->engine() == NULL) || (scheduler_ == NULL)) {
+		proj->close();
+		delete proj;
+		throw new Core::Exception("No engine is available");
+	}
+
+	Member member;
+	member.proj_ = proj;
+	member.scheduler_ = new Core::QueryScheduler(proj->engine());
+	member.scheduler_->setStatsLog(&statsLog_);
+	members_.append(member);
+
+	if (federation_ == NULL) {
+		federation_ = new Core::FederatedEngine();
+		federation_->addMember(memberName(proj_), scheduler_);
+	}
+
+	federation_->addMember(memberName(proj), member.scheduler_);
+}
+
+/**
+ * @param  proj  A project
+ * @return The name identifying the project's results
+ */
+QString ProjectManager::memberName(const Core::ProjectBase* proj)
+{
+	if (!proj->name().isEmpty())
+		return proj->name();
+
+	return QDir(proj->path()).dirName();
+}
+
 void ProjectManager::finishLoad()
 {
 	// Signal the availability of a project.
@@ -23,6 +23,9 @@
 
 #include <QObject>
 #include <core/project.h>
+#include <core/queryscheduler.h>
+#include <core/federatedengine.h>
+#include <core/querystats.h>
 #include "application.h"
 
 namespace KScope
@@ -64,6 +67,11 @@ private:
  * Maintains a ProjectBase object, which is the one and only active project in
  * the application. Also, provides safe access to the engine and code base
  * objects of the project.
+ * Other projects can be added to a workspace around the active project. While
+ * the workspace holds additional projects, engine() returns an engine that
+ * runs every query on all projects in parallel (see Core::FederatedEngine).
+ * The code base, configuration and session remain those of the active
+ * project.
  * @author Elad Lahav
  */
 class ProjectManager
@@ -74,6 +82,7 @@ public:
 	static Core::Engine& engine();
 	static Core::Codebase& codebase();
 	static const ProjectManagerSignals* signalProxy();
+	static Core::QueryStatsLog& queryStats();
 
 	template<class ProjectT>
 	static void load(const QString& projPath) {
@@ -84,6 +93,15 @@ public:
 		// Create and open a project.
 		try {
 			proj_ = new ProjectT(projPath);
+			if (proj_->engine()) {
+				scheduler_ = new Core::QueryScheduler(proj_->engine());
+				scheduler_->setStatsLog(&statsLog_);
+			}
+
+			// Keep a performance log with the project's files.
+			statsLog_.clear();
+			statsLog_.setLogFile(proj_->path() + "querystats.log");
+
 			proj_->open(new OpenCallback());
 		}
 		catch (Core::Exception* e) {
@@ -94,14 +112,78 @@ public:
 		Application::settings().addRecentProject(projPath, proj_->name());
 	}
 
+	/**
+	 * Opens a project as an additional member of the workspace.
+	 * Does nothing if the project is already open.
+	 * @param  projPath  The directory of the project
+	 * @throw  Exception
+	 */
+	template<class ProjectT>
+	static void addToWorkspace(const QString& projPath) {
+		if (proj_ == NULL)
+			throw new Core::Exception("No project is currently loaded");
+
+		if (isOpen(projPath))
+			return;
+
+		ProjectT* proj = new ProjectT(projPath);
+		try {
+			proj->open(NULL);
+		}
+		catch (Core::Exception* e) {
+			delete proj;
+			throw e;
+		}
+
+		addMember(proj);
+	}
+
+	static void removeFromWorkspace(const QString&);
+	static QList<const Core::ProjectBase*> workspace();
+
 	static void updateConfig(Core::ProjectBase::Params&);
 	static void close();
 
 private:
 	static Core::ProjectBase* proj_;
+
+	/**
+	 * Controls the execution of queries on the project's engine.
+	 * All engine requests go through this object.
+	 */
+	static Core::QueryScheduler* scheduler_;
+
+	/**
+	 * Collects performance information on queries.
+	 */
+	static Core::QueryStatsLog statsLog_;
+
 	static ProjectManagerSignals signals_;
 
+	/**
+	 * An additional project in the workspace.
+	 */
+	struct Member
+	{
+		Core::ProjectBase* proj_;
+		Core::QueryScheduler* scheduler_;
+	};
+
+	/**
+	 * Additional projects in the workspace, in order of addition.
+	 */
+	static QList<Member> members_;
+
+	/**
+	 * Runs queries on all projects in the workspace, NULL if the workspace
+	 * only holds the active project.
+	 */
+	static Core::FederatedEngine* federation_;
+
 	static void finishLoad();
+	static bool isOpen(const QString&);
+	static void addMember(Core::ProjectBase*);
+	static QString memberName(const Core::ProjectBase*);
 
 	struct OpenCallback : public Core::Callback<>
 	{
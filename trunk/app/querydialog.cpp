@@ -22,6 +22,7 @@
 #include <QMessageBox>
 #include <QDebug>
 #include "querydialog.h"
+#include "projectmanager.h"
 #include "strings.h"
 
 namespace KScope
@@ -30,6 +31,11 @@ namespace KScope
 namespace App
 {
 
+/**
+ * The maximal number of completions offered for a pattern.
+ */
+static const int MaxCompletions = 50;
+
 /**
  * Class constructor.
  * @param  parent  Parent widget
@@ -38,6 +44,16 @@ QueryDialog::QueryDialog(QWidget* parent)
 	: QDialog(parent), Ui::QueryDialog()
 {
 	setupUi(this);
+
+	// Completions are ordered by the engine, and are not filtered again by
+	// the completer.
+	completionModel_ = new QStringListModel(this);
+	completer_ = new QCompleter(completionModel_, this);
+	completer_->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+	patternCombo_->setCompleter(completer_);
+
+	connect(patternCombo_->lineEdit(), SIGNAL(textEdited(const QString&)),
+	        this, SLOT(updateCompletions(const QString&)));
 }
 
 /**
@@ -75,6 +91,9 @@ int QueryDialog::exec(Core::Query::Type defType, const TypeList& typeList)
 	// Select the default type.
 	typeCombo_->setCurrentIndex(typeCombo_->findData(defType));
 
+	// Discard completions offered for a previous pattern.
+	completionModel_->setStringList(QStringList());
+
 	return QDialog::exec();
 }
 
@@ -152,6 +171,66 @@ void QueryDialog::accept()
 	QDialog::accept();
 }
 
+/**
+ * @param  type  A query type
+ * @return true if the query pattern is a symbol name, false otherwise
+ */
+bool QueryDialog::completesSymbols(Core::Query::Type type)
+{
+	switch (type) {
+	case Core::Query::References:
+	case Core::Query::Definition:
+	case Core::Query::CalledFunctions:
+	case Core::Query::CallingFunctions:
+		return true;
+
+	default:
+		;
+	}
+
+	return false;
+}
+
+/**
+ * Called when the pattern is edited by the user.
+ * Symbol names starting with the text are offered first, followed by fuzzy
+ * matches.
+ * @param  text  The new text of the pattern
+ */
+void QueryDialog::updateCompletions(const QString& text)
+{
+	QStringList names;
+
+	if (!text.isEmpty() && completesSymbols(type())
+	    && ProjectManager::hasProject()) {
+		try {
+			Core::Engine& engine = ProjectManager::engine();
+			names = engine.completions(text, Core::Engine::PrefixMatch,
+			                           MaxCompletions);
+
+			// Fill the list with fuzzy matches, skipping the names that were
+			// already found.
+			if (names.size() < MaxCompletions) {
+				foreach (QString name,
+				         engine.completions(text, Core::Engine::FuzzyMatch,
+				                            MaxCompletions)) {
+					if (names.size() == MaxCompletions)
+						break;
+
+					if (!names.contains(name))
+						names.append(name);
+				}
+			}
+		}
+		catch (Core::Exception* e) {
+			// Completions are optional, do not bother the user.
+			delete e;
+		}
+	}
+
+	completionModel_->setStringList(names);
+}
+
 } // namespace App
 
 } // namespace KScope
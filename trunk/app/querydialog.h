@@ -22,6 +22,8 @@
 #define __APP_QUERYDIALOG_H__
 
 #include <QDialog>
+#include <QCompleter>
+#include <QStringListModel>
 #include <core/engine.h>
 #include "ui_querydialog.h"
 
@@ -33,6 +35,8 @@ namespace App
 
 /**
  * A dialogue that prompts for a query's type and pattern.
+ * For queries on symbols, names of symbols defined in the project are offered
+ * as completions while the pattern is typed.
  * @author Elad Lahav
  */
 class QueryDialog : public QDialog, private Ui::QueryDialog
@@ -53,6 +57,22 @@ public:
 
 public slots:
 	void accept();
+
+private:
+	/**
+	 * Offers completions for the pattern.
+	 */
+	QCompleter* completer_;
+
+	/**
+	 * The names offered by the completer.
+	 */
+	QStringListModel* completionModel_;
+
+	static bool completesSymbols(Core::Query::Type);
+
+private slots:
+	void updateCompletions(const QString&);
 };
 
 } // namespace App
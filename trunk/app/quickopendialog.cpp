@@ -0,0 +1,153 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include <QApplication>
+#include <QDir>
+#include <QKeyEvent>
+#include "quickopendialog.h"
+#include "projectmanager.h"
+
+namespace KScope
+{
+
+namespace App
+{
+
+/**
+ * The maximal number of files listed.
+ */
+static const int MaxFiles = 100;
+
+/**
+ * Class constructor.
+ * @param  parent  Parent widget
+ */
+QuickOpenDialog::QuickOpenDialog(QWidget* parent)
+	: QDialog(parent), Ui::QuickOpenDialog(), finder_(NULL)
+{
+	setupUi(this);
+
+	try {
+		const Core::PathIndex* index = ProjectManager::codebase().pathIndex();
+		if (index) {
+			finder_ = new Core::FileFinder(index, this);
+			connect(finder_,
+			        SIGNAL(found(const QString&, const QStringList&)), this,
+			        SLOT(showFiles(const QString&, const QStringList&)));
+		}
+	}
+	catch (Core::Exception* e) {
+		e->showMessage();
+		delete e;
+	}
+
+	connect(patternEdit_, SIGNAL(textEdited(const QString&)), this,
+	        SLOT(patternEdited(const QString&)));
+	connect(fileList_, SIGNAL(itemActivated(QListWidgetItem*)), this,
+	        SLOT(accept()));
+
+	// Let the arrow keys move the selection while typing.
+	patternEdit_->installEventFilter(this);
+}
+
+/**
+ * Class destructor.
+ */
+QuickOpenDialog::~QuickOpenDialog()
+{
+}
+
+/**
+ * Called when the user clicks the "Open" button, or activates a file.
+ * Paths in the code base may be relative to the project directory.
+ */
+void QuickOpenDialog::accept()
+{
+	QListWidgetItem* item = fileList_->currentItem();
+	if (item == NULL)
+		return;
+
+	path_ = item->text();
+	if (QDir::isRelativePath(path_) && ProjectManager::hasProject())
+		path_ = QDir(ProjectManager::project()->path()).filePath(path_);
+
+	QDialog::accept();
+}
+
+/**
+ * Forwards navigation keys from the pattern editor to the file list.
+ * @param  obj    The object receiving the event
+ * @param  event  The event
+ * @return true if the event was handled, false otherwise
+ */
+bool QuickOpenDialog::eventFilter(QObject* obj, QEvent* event)
+{
+	if ((obj == patternEdit_) && (event->type() == QEvent::KeyPress)) {
+		switch (static_cast<QKeyEvent*>(event)->key()) {
+		case Qt::Key_Up:
+		case Qt::Key_Down:
+		case Qt::Key_PageUp:
+		case Qt::Key_PageDown:
+			QApplication::sendEvent(fileList_, event);
+			return true;
+
+		default:
+			;
+		}
+	}
+
+	return QDialog::eventFilter(obj, event);
+}
+
+/**
+ * Starts a search for the new text.
+ * @param  text  The text of the pattern editor
+ */
+void QuickOpenDialog::patternEdited(const QString& text)
+{
+	if (text.isEmpty()) {
+		fileList_->clear();
+		return;
+	}
+
+	if (finder_)
+		finder_->find(text, MaxFiles);
+}
+
+/**
+ * Lists the results of a search, and selects the best match.
+ * Results for text other than the current one are discarded.
+ * @param  text   The matched text
+ * @param  files  The matching files, best matches first
+ */
+void QuickOpenDialog::showFiles(const QString& text, const QStringList& files)
+{
+	if (text != patternEdit_->text())
+		return;
+
+	fileList_->clear();
+	fileList_->addItems(files);
+	if (!files.isEmpty())
+		fileList_->setCurrentRow(0);
+}
+
+} // namespace App
+
+} // namespace KScope
@@ -0,0 +1,80 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __APP_QUICKOPENDIALOG_H__
+#define __APP_QUICKOPENDIALOG_H__
+
+#include <QDialog>
+#include <core/filefinder.h>
+#include "ui_quickopendialog.h"
+
+namespace KScope
+{
+
+namespace App
+{
+
+/**
+ * A dialogue for opening a project file by typing parts of its name.
+ * The project's files are searched on a separate thread as the user types
+ * (see Core::FileFinder), and the best matches are listed.
+ * @author Elad Lahav
+ */
+class QuickOpenDialog : public QDialog, private Ui::QuickOpenDialog
+{
+	Q_OBJECT
+
+public:
+	QuickOpenDialog(QWidget* parent = 0);
+	~QuickOpenDialog();
+
+	/**
+	 * @return The path of the selected file, once the dialogue is accepted
+	 */
+	const QString& path() const { return path_; }
+
+public slots:
+	void accept();
+
+protected:
+	bool eventFilter(QObject*, QEvent*);
+
+private:
+	/**
+	 * Searches the project's files, NULL if the code base does not keep an
+	 * index of its files.
+	 */
+	Core::FileFinder* finder_;
+
+	/**
+	 * The path of the selected file.
+	 */
+	QString path_;
+
+private slots:
+	void patternEdited(const QString&);
+	void showFiles(const QString&, const QStringList&);
+};
+
+} // namespace App
+
+} // namespace KScope
+
+#endif // __APP_QUICKOPENDIALOG_H__
@@ -71,6 +71,9 @@ void Session::load()
 	activeEditor_ = settings.value("ActiveEditor").toString();
 	maxActiveEditor_ = settings.value("MaxActiveEditor", false).toBool();
 
+	// Get the projects added to the workspace.
+	workspace_ = settings.value("Workspace").toStringList();
+
 	// Load the query XML file.
 	QFile xmlFile(queryViewFile());
 	if (xmlFile.open(QIODevice::ReadOnly))
@@ -100,6 +103,7 @@ void Session::save()
 	// Store other information on the editor container.
 	settings.setValue("ActiveEditor", activeEditor_);
 	settings.setValue("MaxActiveEditor", maxActiveEditor_);
+	settings.setValue("Workspace", workspace_);
 
 	// Save the query view XML document.
 	QFile xmlFile(queryViewFile());
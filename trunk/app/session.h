@@ -101,6 +101,11 @@ public:
 	 */
 	PROPERTY(bool, maxActiveEditor_, maxActiveEditor, setMaxActiveEditor);
 
+	/**
+	 * The paths of additional projects open in the workspace.
+	 */
+	PROPERTY(QStringList, workspace_, workspace, setWorkspace);
+
 private:
 	/**
 	 * The path of the configuration directory holding session information.
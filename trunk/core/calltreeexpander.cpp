@@ -0,0 +1,217 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include "calltreeexpander.h"
+#include "queryview.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * The maximal number of items queried at the same time.
+ */
+static const int MaxActive = 16;
+
+/**
+ * Class constructor.
+ * @param  view  The view whose tree is expanded
+ */
+CallTreeExpander::CallTreeExpander(QueryView* view)
+	: QObject(), view_(view), depth_(0), level_(0), done_(0), total_(0),
+	  advancing_(false)
+{
+}
+
+/**
+ * Class destructor.
+ */
+CallTreeExpander::~CallTreeExpander()
+{
+}
+
+/**
+ * Starts expanding the sub-tree rooted at the given item.
+ * Any expansion in progress is abandoned.
+ * @param  index  The root item (source index)
+ * @param  depth  The number of levels to expand below the root item
+ */
+void CallTreeExpander::expand(const QModelIndex& index, int depth)
+{
+	stop();
+	if (depth <= 0)
+		return;
+
+	depth_ = depth;
+	level_ = 0;
+	done_ = 0;
+	total_ = 0;
+	add(index);
+	advance();
+}
+
+/**
+ * Abandons the expansion in progress.
+ * Queries already handed to the view are not stopped.
+ */
+void CallTreeExpander::stop()
+{
+	depth_ = 0;
+	waiting_.clear();
+	running_.clear();
+	next_.clear();
+}
+
+/**
+ * Called by the view when the query of an item terminates (or when the item
+ * is resolved without a query).
+ * @param  index  The item (source index)
+ */
+void CallTreeExpander::itemDone(const QModelIndex& index)
+{
+	// Ignore items that are not part of the expansion.
+	// An invalid index removes all items deleted from the model while they
+	// were queried.
+	int count = running_.removeAll(index);
+	if (count == 0)
+		return;
+
+	done_ += count;
+	if (index.isValid()
+	    && view_->locationModel()->isEmpty(index) == LocationModel::Full) {
+		ready(index);
+	}
+
+	advance();
+}
+
+/**
+ * Adds an item to the current level.
+ * Items with known children are expanded immediately, while the rest wait to
+ * be queried.
+ * @param  index  The item (source index)
+ */
+void CallTreeExpander::add(const QModelIndex& index)
+{
+	switch (view_->locationModel()->isEmpty(index)) {
+	case LocationModel::Full:
+		ready(index);
+		break;
+
+	case LocationModel::Unknown:
+		total_++;
+		waiting_.append(index);
+		break;
+
+	default:
+		;
+	}
+}
+
+/**
+ * Expands an item of the current level whose children are known, and adds
+ * these children to the next level.
+ * @param  index  The item (source index)
+ */
+void CallTreeExpander::ready(const QModelIndex& index)
+{
+	view_->setExpanded(view_->proxy()->mapFromSource(index), true);
+	if (level_ + 1 >= depth_)
+		return;
+
+	foreach (const QModelIndex& child, view_->childItems(index))
+		next_.append(child);
+}
+
+/**
+ * Hands waiting items to the view for querying, and moves to the next level
+ * once all items of the current one were queried.
+ */
+void CallTreeExpander::advance()
+{
+	// Items resolved by the view without a query call back into this method.
+	if (advancing_ || depth_ == 0)
+		return;
+
+	advancing_ = true;
+
+	for (;;) {
+		// Start a new batch once half of the running queries have
+		// terminated.
+		if (!waiting_.isEmpty() && running_.size() <= MaxActive / 2) {
+			QList<QModelIndex> batch;
+			while (!waiting_.isEmpty() && running_.size() < MaxActive) {
+				QPersistentModelIndex item = waiting_.takeFirst();
+				if (!item.isValid()) {
+					done_++;
+					continue;
+				}
+
+				// The item may have been expanded by the user in the
+				// meantime.
+				running_.append(item);
+				if (view_->findItemQuery(item) == NULL)
+					batch.append(item);
+			}
+
+			view_->queryItems(batch);
+			continue;
+		}
+
+		if (!waiting_.isEmpty() || !running_.isEmpty())
+			break;
+
+		// The current level is done.
+		level_++;
+		if (level_ >= depth_ || next_.isEmpty()) {
+			finish();
+			break;
+		}
+
+		QList<QPersistentModelIndex> items = next_;
+		next_.clear();
+		foreach (const QPersistentModelIndex& item, items) {
+			if (item.isValid())
+				add(item);
+		}
+	}
+
+	if (depth_ > 0) {
+		view_->onProgress(tr("Expanding level %1 of %2...").arg(level_ + 1)
+		                  .arg(depth_), done_, total_);
+	}
+
+	advancing_ = false;
+}
+
+/**
+ * Ends the expansion.
+ */
+void CallTreeExpander::finish()
+{
+	stop();
+	view_->expansionDone();
+}
+
+} // namespace Core
+
+} // namespace KScope
@@ -0,0 +1,121 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CORE_CALLTREEEXPANDER_H__
+#define __CORE_CALLTREEEXPANDER_H__
+
+#include <QObject>
+#include <QPersistentModelIndex>
+
+namespace KScope
+{
+
+namespace Core
+{
+
+class QueryView;
+
+/**
+ * Expands a sub-tree of a call tree to a given depth.
+ * The tree is expanded breadth-first: all items of one level are queried
+ * before any item of the next level. Queries are handed to the view in
+ * batches, and no more than a fixed number of items are queried at the same
+ * time, so that a deep expansion does not flood the engine.
+ * The view answers queries for functions it has already queried from its
+ * cache, and marks items repeating one of their ancestors instead of
+ * querying them (see QueryView::queryItems()). Progress is displayed in the
+ * view's progress-bar.
+ * @author Elad Lahav
+ */
+class CallTreeExpander : public QObject
+{
+	Q_OBJECT
+
+public:
+	CallTreeExpander(QueryView*);
+	~CallTreeExpander();
+
+	void expand(const QModelIndex&, int);
+	void stop();
+	void itemDone(const QModelIndex&);
+
+	/**
+	 * @return true if an expansion is in progress, false otherwise
+	 */
+	bool isActive() const { return depth_ > 0; }
+
+private:
+	/**
+	 * The view whose tree is expanded.
+	 */
+	QueryView* view_;
+
+	/**
+	 * The number of levels to expand below the root item, 0 when no
+	 * expansion is in progress.
+	 */
+	int depth_;
+
+	/**
+	 * The level of the items currently queried (0 for the root item).
+	 */
+	int level_;
+
+	/**
+	 * Items of the current level waiting to be queried.
+	 */
+	QList<QPersistentModelIndex> waiting_;
+
+	/**
+	 * Items of the current level being queried.
+	 */
+	QList<QPersistentModelIndex> running_;
+
+	/**
+	 * Items of the next level.
+	 */
+	QList<QPersistentModelIndex> next_;
+
+	/**
+	 * The number of items queried so far.
+	 */
+	uint done_;
+
+	/**
+	 * The number of items to query found so far.
+	 */
+	uint total_;
+
+	/**
+	 * Prevents recursive calls to advance() from the view.
+	 */
+	bool advancing_;
+
+	void add(const QModelIndex&);
+	void ready(const QModelIndex&);
+	void advance();
+	void finish();
+};
+
+} // namespace Core
+
+} // namespace KScope
+
+#endif // __CORE_CALLTREEEXPANDER_H__
@@ -30,6 +30,8 @@ namespace KScope
 namespace Core
 {
 
+class PathIndex;
+
 /**
  * An abstract base class representing a set of source files.
  * KScope describes a project as a set of source files and a data engine that
@@ -56,6 +58,12 @@ public:
 	virtual bool canModify() = 0;
 	virtual bool needFiles() { return false; }
 
+	/**
+	 * @return An in-memory index of the files in the code base, NULL if the
+	 *         code base does not keep one
+	 */
+	virtual const PathIndex* pathIndex() const { return NULL; }
+
 signals:
 	void loaded();
 	void modified();
@@ -27,33 +27,56 @@ namespace KScope
 namespace Core
 {
 
+/**
+ * Class constructor.
+ * Starts building the tree of files in the code base. The model appears empty
+ * until the tree is complete.
+ * @param  cbase     The code base to display
+ * @param  rootPath  A common path prefix, removed from all file names
+ * @param  parent    Parent object
+ */
 CodebaseModel::CodebaseModel(const Codebase* cbase, const QString& rootPath,
                              QObject* parent) :
 	QAbstractItemModel(parent),
-	root_(rootPath)
+	root_(rootPath),
+	builder_(NULL)
 {
 	// TODO: rootPath may be invalid.
 	// Need to set root_ to "/", and ignore rootPath.
 
-	// Add all files in the code base.
-	AddFilesCallback cb(this);
-	cbase->getFiles(cb);
+	// Add all files in the code base, on a separate thread.
+	builder_ = new Builder(this, cbase);
+	connect(builder_, SIGNAL(finished()), this, SLOT(buildFinished()));
+	builder_->start();
 }
 
+/**
+ * Class destructor.
+ */
 CodebaseModel::~CodebaseModel()
 {
+	// The thread accesses the tree, so it must terminate before the tree is
+	// deleted.
+	if (builder_) {
+		builder_->stop();
+		builder_->wait();
+	}
 }
 
+/**
+ * Adds files to the model.
+ * Rows are inserted only under directories that were already fetched by the
+ * view. Other directories will show the new files when expanded.
+ * @param  fileList  The files to add
+ */
 void CodebaseModel::addFiles(const QStringList& fileList)
 {
+	waitForBuild();
+
 	// Add each of the files in the list to the tree structure.
 	QStringList::ConstIterator itr;
 	for (itr = fileList.begin(); itr != fileList.end(); ++itr)
 		addFile(*itr);
-
-	// It's much easier to just reset the model than to emit individual
-	// dataChanged() signals, since files are added all over the tree.
-	reset();
 }
 
 /**
@@ -62,24 +85,31 @@ void CodebaseModel::addFiles(const QStringList& fileList)
  */
 void CodebaseModel::getFiles(QStringList& fileList) const
 {
+	// Make sure the tree is complete.
+	if (builder_)
+		builder_->wait();
+
 	getFiles(&root_, "", fileList);
 }
 
 QModelIndex CodebaseModel::index(int row, int column,
                                  const QModelIndex& parent) const
 {
-	const ItemT* item;
+	const Node* node;
 
 	if (!parent.isValid()) {
-		item = &root_;
+		node = &root_;
 	}
 	else {
-		item = indexData(parent);
-		if (item == NULL)
+		node = indexData(parent);
+		if (node == NULL)
 			return QModelIndex();
 	}
 
-	return createIndex(row, column, (void*)item->child(row));
+	if (row < 0 || row >= node->childList_.size())
+		return QModelIndex();
+
+	return createIndex(row, column, (void*)node->childList_[row]);
 }
 
 QModelIndex CodebaseModel::parent(const QModelIndex& index) const
@@ -87,11 +117,11 @@ QModelIndex CodebaseModel::parent(const QModelIndex& index) const
 	if (!index.isValid())
 		return QModelIndex();
 
-	ItemT* item = indexData(index);
-	if (item == NULL || item->parent() == &root_)
+	Node* node = indexData(index);
+	if (node == NULL || node->parent_ == &root_)
 		return QModelIndex();
 
-	return createIndex(item->parent()->index(), 0, (void*)item->parent());
+	return createIndex(node->parent_->row_, 0, (void*)node->parent_);
 }
 
 QVariant CodebaseModel::headerData(int section, Qt::Orientation orient,
@@ -106,18 +136,18 @@ QVariant CodebaseModel::headerData(int section, Qt::Orientation orient,
 
 int CodebaseModel::rowCount(const QModelIndex& parent) const
 {
-	const TreeItem<QString>* item;
+	const Node* node;
 
 	if (!parent.isValid()) {
-		item = &root_;
+		node = &root_;
 	}
 	else {
-		item = static_cast<TreeItem<QString>*>(parent.internalPointer());
-		if (item == NULL)
+		node = indexData(parent);
+		if (node == NULL)
 			return 0;
 	}
 
-	return item->childCount();
+	return node->childList_.size();
 }
 
 int CodebaseModel::columnCount(const QModelIndex& parent) const
@@ -126,30 +156,108 @@ int CodebaseModel::columnCount(const QModelIndex& parent) const
 	return 1;
 }
 
-QVariant CodebaseModel::data(const QModelIndex& index, int role) const
+/**
+ * Determines whether a node has children.
+ * This is true for all directories, including the ones whose children were
+ * not fetched yet.
+ * @param  parent  The index to check
+ * @return true for a directory, false for a file
+ */
+bool CodebaseModel::hasChildren(const QModelIndex& parent) const
+{
+	// The tree cannot be accessed while it is being built.
+	if (builder_)
+		return false;
+
+	const Node* node;
+	if (!parent.isValid()) {
+		node = &root_;
+	}
+	else {
+		node = indexData(parent);
+		if (node == NULL)
+			return false;
+	}
+
+	return !node->childMap_.isEmpty();
+}
+
+/**
+ * @param  parent  The index to check
+ * @return true if this is a directory whose children were not yet exposed
+ *         to the view, false otherwise
+ */
+bool CodebaseModel::canFetchMore(const QModelIndex& parent) const
+{
+	if (builder_)
+		return false;
+
+	const Node* node;
+	if (!parent.isValid()) {
+		node = &root_;
+	}
+	else {
+		node = indexData(parent);
+		if (node == NULL)
+			return false;
+	}
+
+	return !node->fetched_ && !node->childMap_.isEmpty();
+}
+
+/**
+ * Exposes the children of a directory to the view.
+ * Called by the view when the directory is first expanded.
+ * @param  parent  The directory's index
+ */
+void CodebaseModel::fetchMore(const QModelIndex& parent)
 {
-	QString file;
+	if (!canFetchMore(parent))
+		return;
+
+	Node* node = parent.isValid() ? indexData(parent) : &root_;
+
+	// Sort the children.
+	QList<Node*> childList = node->childMap_.values();
+	qSort(childList.begin(), childList.end(), lessThan);
 
+	beginInsertRows(parent, 0, childList.size() - 1);
+	for (int i = 0; i < childList.size(); i++)
+		childList[i]->row_ = i;
+	node->childList_ = childList;
+	node->fetched_ = true;
+	endInsertRows();
+}
+
+QVariant CodebaseModel::data(const QModelIndex& index, int role) const
+{
 	if (!index.isValid())
 		return QVariant();
 
 	if (role != Qt::DisplayRole)
 		return QVariant();
 
-	TreeItem<QString>* item
-		= static_cast<TreeItem<QString>*>(index.internalPointer());
-	if (item == NULL)
+	Node* node = indexData(index);
+	if (node == NULL)
 		return QVariant();
 
-	return item->data();
+	return node->name_;
 }
 
+/**
+ * Adds a single file to the tree.
+ * Each path component is located using a hash lookup in its parent
+ * directory. If new nodes are created under a directory that was already
+ * fetched, the view is notified of the top-most new node only (the rest are
+ * fetched with it).
+ * @param  path  The path of the file to add
+ */
 void CodebaseModel::addFile(const QString& path)
 {
 	// Remove the root path prefix.
 	QString actPath;
-	if (path.startsWith(root_.data()))
-		actPath = path.mid(root_.data().length());
+	if (path.startsWith(root_.name_))
+		actPath = path.mid(root_.name_.length());
 	else
 		actPath = path;
 
@@ -157,45 +265,107 @@ void CodebaseModel::addFile(const QString& path)
 	QStringList pathParts = actPath.split('/', QString::SkipEmptyParts);
 
 	// Descend down the tree, following the path components.
-	ItemT* item = &root_;
-	QStringList::iterator itr;
+	// Create new nodes where the path components do not exist.
+	Node* node = &root_;
+	Node* newNode = NULL;
+	QStringList::ConstIterator itr;
 	for (itr = pathParts.begin(); itr != pathParts.end(); ++itr) {
-		// Find a child of the current item corresponding to the component.
-		// Create a new one if the child could not be found.
-		ItemT* child;
-		if ((child = item->findChild(*itr)) != NULL)
-			item = child;
-		else
-			item = item->addChild(*itr);
+		QHash<QString, Node*>::ConstIterator child
+			= node->childMap_.find(*itr);
+		if (child != node->childMap_.end()) {
+			node = *child;
+			continue;
+		}
+
+		Node* parent = node;
+		node = new Node(*itr, parent);
+		parent->childMap_.insert(*itr, node);
+
+		if (newNode == NULL)
+			newNode = node;
 	}
+
+	// Nothing to do if the file exists, or if the view is not showing the
+	// directory in which new nodes were created.
+	if (newNode == NULL || !newNode->parent_->fetched_)
+		return;
+
+	// Insert the new node in sorted order.
+	Node* parent = newNode->parent_;
+	QList<Node*>::Iterator pos = qLowerBound(parent->childList_.begin(),
+	                                         parent->childList_.end(),
+	                                         newNode, lessThan);
+	int row = pos - parent->childList_.begin();
+
+	QModelIndex parentIndex;
+	if (parent != &root_)
+		parentIndex = createIndex(parent->row_, 0, (void*)parent);
+
+	beginInsertRows(parentIndex, row, row);
+	parent->childList_.insert(row, newNode);
+	for (int i = row; i < parent->childList_.size(); i++)
+		parent->childList_[i]->row_ = i;
+	endInsertRows();
 }
 
 /**
  * An internal, recursive version of getFiles().
- * @param  item      The current item in a DFS
- * @param  path      The path of the item's parent
+ * @param  node      The current node in a DFS
+ * @param  path      The path of the node's parent
  * @param  fileList  The list to fill
  */
-void CodebaseModel::getFiles(const ItemT* item, const QString& path,
+void CodebaseModel::getFiles(const Node* node, const QString& path,
                              QStringList& fileList) const
 {
-	QString name = path + item->data();
+	QString name = path + node->name_;
 
-	if (item->childCount()) {
+	if (!node->childMap_.isEmpty()) {
 		// Add directory separator, if required.
 		if (!name.endsWith("/"))
 			name += "/";
 
 		// Descend to sub-directories.
-		for (int i = 0; i < item->childCount(); i++)
-			getFiles(item->child(i), name, fileList);
+		QHash<QString, Node*>::ConstIterator itr;
+		for (itr = node->childMap_.begin(); itr != node->childMap_.end();
+		     ++itr) {
+			getFiles(*itr, name, fileList);
+		}
 	}
-	else {
+	else if (node != &root_) {
 		// Found a file, add to the list.
 		fileList.append(name);
 	}
 }
 
+/**
+ * Blocks until the tree is complete.
+ */
+void CodebaseModel::waitForBuild()
+{
+	if (builder_) {
+		builder_->wait();
+		buildFinished();
+	}
+}
+
+/**
+ * Determines the display order of nodes: directories first, then files, each
+ * group sorted by name.
+ * @param  node1  The first node to compare
+ * @param  node2  The second node to compare
+ * @return true if node1 should be displayed before node2, false otherwise
+ */
+bool CodebaseModel::lessThan(const Node* node1, const Node* node2)
+{
+	bool isDir1 = !node1->childMap_.isEmpty();
+	bool isDir2 = !node2->childMap_.isEmpty();
+
+	if (isDir1 != isDir2)
+		return isDir1;
+
+	return node1->name_ < node2->name_;
+}
+
 #ifndef QT_NO_DEBUG
 void CodebaseModel::verify(const QModelIndex& parent)
 {
@@ -216,6 +386,33 @@ void CodebaseModel::verify(const QModelIndex& parent)
 }
 #endif
 
+/**
+ * Called when the thread building the tree terminates.
+ * Exposes the top-level entries to the view.
+ */
+void CodebaseModel::buildFinished()
+{
+	// May be called twice, if waitForBuild() was used.
+	if (builder_ == NULL)
+		return;
+
+	builder_->deleteLater();
+	builder_ = NULL;
+
+	fetchMore(QModelIndex());
+	emit ready();
+}
+
+/**
+ * Thread function.
+ * Adds all files in the code base to the tree.
+ */
+void CodebaseModel::Builder::run()
+{
+	AddFilesCallback cb(this);
+	cbase_->getFiles(cb);
+}
+
 }
 
 }
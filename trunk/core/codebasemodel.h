@@ -22,7 +22,8 @@
 #define __CORE_CODEBASEMODEL_H
 
 #include <QAbstractItemModel>
-#include "treeitem.h"
+#include <QHash>
+#include <QThread>
 #include "codebase.h"
 
 namespace KScope
@@ -32,6 +33,11 @@ namespace Core
 {
 
 /**
+ * A tree model for displaying the files in a code base.
+ * The directory tree is built on a separate thread, so that opening a view on
+ * a large code base does not block the GUI. Directories are only exposed to
+ * the view when expanded (using the canFetchMore()/fetchMore() mechanism), so
+ * the view does not need to handle the entire tree at once.
  * @author Elad Lahav
  */
 class CodebaseModel : public QAbstractItemModel
@@ -51,38 +57,131 @@ public:
 	virtual QModelIndex parent(const QModelIndex& index) const;
 	virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
 	virtual int columnCount(const QModelIndex& parent = QModelIndex()) const;
+	virtual bool hasChildren(const QModelIndex& parent = QModelIndex()) const;
+	virtual bool canFetchMore(const QModelIndex& parent) const;
+	virtual void fetchMore(const QModelIndex& parent);
 	virtual QVariant data(const QModelIndex&,
 	                      int role = Qt::DisplayRole) const;
 	virtual QVariant headerData(int, Qt::Orientation,
 	                            int role = Qt::DisplayRole) const;
 
-private:
-	typedef TreeItem<QString> ItemT;
-	ItemT root_;
+	/**
+	 * @return true while the tree is being built, false otherwise
+	 */
+	bool isBuilding() const { return builder_ != NULL; }
 
-	void addFile(const QString&);
-	void getFiles(const ItemT*, const QString&, QStringList&) const;
+signals:
+	/**
+	 * Emitted when all files in the code base were added to the model.
+	 */
+	void ready();
 
-	static inline ItemT* indexData(QModelIndex index) {
-		return static_cast<ItemT*>(index.internalPointer());
-	}
+private:
+	/**
+	 * A file or directory in the tree.
+	 * Directories are nodes with children, files are leaves.
+	 */
+	struct Node
+	{
+		/**
+		 * Struct constructor.
+		 * @param  name    The path component represented by the node
+		 * @param  parent  The parent node
+		 */
+		Node(const QString& name, Node* parent = NULL)
+			: name_(name), parent_(parent), row_(0), fetched_(false) {}
+
+		/**
+		 * Struct destructor.
+		 * Deletes all descendants.
+		 */
+		~Node() { qDeleteAll(childMap_); }
+
+		/**
+		 * The path component represented by the node.
+		 */
+		QString name_;
+
+		/**
+		 * The parent node, NULL for the root.
+		 */
+		Node* parent_;
+
+		/**
+		 * All children, hashed by name.
+		 */
+		QHash<QString, Node*> childMap_;
+
+		/**
+		 * The children exposed to the view, in display order.
+		 * This list is empty until fetchMore() is called for the node.
+		 */
+		QList<Node*> childList_;
+
+		/**
+		 * The position of the node in its parent's child list.
+		 */
+		int row_;
+
+		/**
+		 * Whether fetchMore() was called for this node.
+		 */
+		bool fetched_;
+	};
 
-	struct AddFilesCallback : public Core::Callback<const QString&>
+	/**
+	 * Builds the initial tree, from the files in the code base.
+	 */
+	class Builder : public QThread
 	{
+	public:
+		Builder(CodebaseModel* model, const Codebase* cbase)
+			: QThread(model), model_(model), cbase_(cbase), stop_(false) {}
+
+		virtual void run();
+
+		/**
+		 * Makes the thread ignore the rest of the files.
+		 */
+		void stop() { stop_ = true; }
+
+	private:
 		CodebaseModel* model_;
+		const Codebase* cbase_;
+		volatile bool stop_;
+
+		struct AddFilesCallback : public Core::Callback<const QString&>
+		{
+			Builder* self_;
 
-		AddFilesCallback(CodebaseModel* model) : model_(model) {}
+			AddFilesCallback(Builder* self) : self_(self) {}
 
-		void call(const QString& file) {
-			model_->addFile(file);
-		}
+			void call(const QString& file) {
+				if (!self_->stop_)
+					self_->model_->addFile(file);
+			}
+		};
 	};
 
-	friend struct AddFilesCallback;
+	Node root_;
+	Builder* builder_;
+
+	void addFile(const QString&);
+	void getFiles(const Node*, const QString&, QStringList&) const;
+	void waitForBuild();
+
+	static inline Node* indexData(QModelIndex index) {
+		return static_cast<Node*>(index.internalPointer());
+	}
+
+	static bool lessThan(const Node*, const Node*);
 
 #ifndef QT_NO_DEBUG
 	void verify(const QModelIndex&);
 #endif
+
+private slots:
+	void buildFinished();
 };
 
 }
@@ -8,14 +8,21 @@ HEADERS += locationtreemodel.h \
     locationmodel.h \
     projectconfig.h \
     filescanner.h \
+    gitindexscanner.h \
     filefilter.h \
     queryview.h \
+    calltreeexpander.h \
+    queryscheduler.h \
+    federatedengine.h \
+    querystats.h \
     locationlistmodel.h \
     parser.h \
     exception.h \
     project.h \
     codebase.h \
     codebasemodel.h \
+    pathindex.h \
+    filefinder.h \
     globals.h \
     process.h \
     statemachine.h \
@@ -29,9 +36,16 @@ FORMS += progressbar.ui \
 SOURCES += locationtreemodel.cpp \
     locationmodel.cpp \
     filescanner.cpp \
+    gitindexscanner.cpp \
     queryview.cpp \
+    calltreeexpander.cpp \
+    queryscheduler.cpp \
+    federatedengine.cpp \
+    querystats.cpp \
     locationlistmodel.cpp \
     codebasemodel.cpp \
+    pathindex.cpp \
+    filefinder.cpp \
     process.cpp \
     progressbar.cpp \
     locationview.cpp \
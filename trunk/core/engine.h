@@ -22,6 +22,7 @@
 #define __CORE_ENGINE_H
 
 #include <QObject>
+#include <QStringList>
 #include <QWidget>
 #include "globals.h"
 
@@ -31,6 +32,8 @@ namespace KScope
 namespace Core
 {
 
+struct QueryStats;
+
 /**
  * Abstract base-class for cross-reference databases.
  * This class is the at the heart of KScope's implementation. Its derivations
@@ -103,6 +106,48 @@ public:
 	 */
 	virtual QList<Location::Fields> queryFields(Query::Type type) const = 0;
 
+	/**
+	 * Ways of matching symbol names against partial text (see
+	 * completions()).
+	 */
+	enum MatchMode {
+		/**
+		 * Names starting with the text.
+		 */
+		PrefixMatch,
+
+		/**
+		 * Names containing the text, ignoring case.
+		 */
+		SubstringMatch,
+
+		/**
+		 * Names containing the characters of the text, in the same order
+		 * (but not necessarily adjacent), ignoring case.
+		 * The closest matches come first.
+		 */
+		FuzzyMatch
+	};
+
+	/**
+	 * Looks up the names of symbols defined in the project that match a
+	 * partial name, e.g., to complete a query pattern as it is typed.
+	 * The lookup is synchronous, and should be fast enough to be called on
+	 * every key stroke. The default implementation, for engines that do not
+	 * keep a dictionary of symbol names, returns an empty list.
+	 * @param  text  The partial name
+	 * @param  mode  How to match names against the text
+	 * @param  max   The maximal number of names to return
+	 * @return The matching names
+	 */
+	virtual QStringList completions(const QString& text, MatchMode mode,
+	                                int max) const {
+		(void)text;
+		(void)mode;
+		(void)max;
+		return QStringList();
+	}
+
 	/**
 	 * Abstract base class for a controllable object.
 	 * This allows an engine operation to be stopped.
@@ -125,10 +170,32 @@ public:
 	 */
 	struct Connection
 	{
+		/**
+		 * Scheduling classes for operations.
+		 * Engines that run several operations concurrently (see
+		 * QueryScheduler) start operations of a higher class first.
+		 */
+		enum Priority {
+			/** Operations the user is waiting for. */
+			Interactive,
+			/** Expansion of items in a tree view. */
+			TreeExpansion,
+			/** Operations whose results are not immediately needed. */
+			Background
+		};
+
 		/**
 		 * Struct constructor.
+		 * @param  priority  The scheduling class of operations started on
+		 *                   this connection
+		 */
+		Connection(Priority priority = Interactive)
+			: ctrlObject_(NULL), priority_(priority), stats_(NULL) {}
+
+		/**
+		 * Struct destructor.
 		 */
-		Connection() : ctrlObject_(NULL) {}
+		virtual ~Connection() {}
 
 		/**
 		 * @param  ctrlObject  A controlled object that allows the operation to
@@ -136,6 +203,30 @@ public:
 		 */
 		void setCtrlObject(Controlled* ctrlObject) { ctrlObject_ = ctrlObject; }
 
+		/**
+		 * @return The scheduling class of operations started on this
+		 *         connection
+		 */
+		Priority priority() const { return priority_; }
+
+		/**
+		 * @param  priority  The scheduling class to use for operations started
+		 *                   on this connection
+		 */
+		void setPriority(Priority priority) { priority_ = priority; }
+
+		/**
+		 * @return An object for recording performance information on the
+		 *         current operation, NULL if no information is collected
+		 */
+		QueryStats* stats() const { return stats_; }
+
+		/**
+		 * @param  stats  An object for recording performance information on
+		 *                operations started on this connection
+		 */
+		void setStats(QueryStats* stats) { stats_ = stats; }
+
 		/**
 		 * Stops the current operation.
 		 */
@@ -173,6 +264,41 @@ public:
 		 * An object which can be used to stop the current operation.
 		 */
 		Controlled* ctrlObject_;
+
+		/**
+		 * The scheduling class of operations started on this connection.
+		 */
+		Priority priority_;
+
+		/**
+		 * Performance information on the current operation (may be NULL).
+		 */
+		QueryStats* stats_;
+	};
+
+	/**
+	 * A query in a batch, along with the connection that receives its
+	 * results.
+	 */
+	struct BatchQuery
+	{
+		/**
+		 * Struct constructor.
+		 * @param  conn   Used for communication with the query's operation
+		 * @param  query  The query to execute
+		 */
+		BatchQuery(Connection* conn, const Query& query)
+			: conn_(conn), query_(query) {}
+
+		/**
+		 * Receives the results of the query.
+		 */
+		Connection* conn_;
+
+		/**
+		 * The query to execute.
+		 */
+		Query query_;
 	};
 
 public slots:
@@ -183,6 +309,19 @@ public slots:
 	 */
 	virtual void query(Connection* conn, const Query& query) const = 0;
 
+	/**
+	 * Starts a batch of queries.
+	 * Each query reports its progress, results and termination through its
+	 * own connection, exactly as if it was started by query(). Engines that
+	 * can execute several queries in a single operation should re-implement
+	 * this method. The default implementation starts each query separately.
+	 * @param  batch  The queries to execute
+	 */
+	virtual void queryBatch(const QList<BatchQuery>& batch) const {
+		foreach (const BatchQuery& bq, batch)
+			query(bq.conn_, bq.query_);
+	}
+
 	/**
 	 * (Re)builds the symbols database.
 	 * @param  conn    Used for communication with the ongoing operation
@@ -0,0 +1,473 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include <QSet>
+#include <QTimer>
+#include <QDebug>
+#include "federatedengine.h"
+#include "exception.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * Class constructor.
+ * @param  parent  Parent object
+ */
+FederatedEngine::FederatedEngine(QObject* parent) : Engine(parent)
+{
+}
+
+/**
+ * Class destructor.
+ * Running operations are stopped. Their callers are notified, and the
+ * operations deleted, once the member engines are done with them, which
+ * means that the member engines need to outlive this object.
+ */
+FederatedEngine::~FederatedEngine()
+{
+	foreach (FederatedOperation* op, operations_) {
+		op->engine_ = NULL;
+		op->stop();
+	}
+}
+
+/**
+ * Adds an engine to the federation.
+ * @param  name    The name of the engine's project, shown with results
+ * @param  engine  The engine to add
+ */
+void FederatedEngine::addMember(const QString& name, Engine* engine)
+{
+	members_.append(Member(name, engine));
+}
+
+/**
+ * Removes an engine from the federation.
+ * The parts of running operations executed by the engine are stopped, while
+ * the rest of these operations continue on the other members.
+ * @param  engine  The engine to remove
+ */
+void FederatedEngine::removeMember(Engine* engine)
+{
+	for (int i = 0; i < members_.size(); i++) {
+		if (members_[i].engine_ == engine) {
+			members_.removeAt(i);
+			break;
+		}
+	}
+
+	foreach (FederatedOperation* op, operations_.values()) {
+		foreach (FederatedOperation::Part* part, op->parts_) {
+			if ((part->engine_ == engine) && !part->done_)
+				part->stop();
+		}
+	}
+}
+
+/**
+ * Member engines are opened separately, so there is nothing to do.
+ * @param  initString  Ignored
+ * @param  cb          Called immediately
+ */
+void FederatedEngine::open(const QString& initString, Callback<>* cb)
+{
+	(void)initString;
+
+	if (cb)
+		cb->call();
+}
+
+/**
+ * @return Ready if all members are ready, Build if none of them can be
+ *         queried, Rebuild otherwise
+ */
+Engine::Status FederatedEngine::status() const
+{
+	if (members_.isEmpty())
+		return Unknown;
+
+	int ready = 0, build = 0;
+	foreach (const Member& member, members_) {
+		switch (member.engine_->status()) {
+		case Ready:
+			ready++;
+			break;
+
+		case Build:
+		case Unknown:
+			build++;
+			break;
+
+		default:
+			;
+		}
+	}
+
+	if (ready == members_.size())
+		return Ready;
+
+	if (build == members_.size())
+		return Build;
+
+	return Rebuild;
+}
+
+/**
+ * @param  type  The requested query type
+ * @return The fields filled by the member engines, preceded by the project
+ *         name
+ */
+QList<Location::Fields> FederatedEngine::queryFields(Query::Type type) const
+{
+	QList<Location::Fields> fieldList;
+
+	fieldList << Location::Project;
+	if (!members_.isEmpty())
+		fieldList << members_.first().engine_->queryFields(type);
+
+	return fieldList;
+}
+
+/**
+ * Collects symbol names from all member engines.
+ * Names found by more than one member are listed once, in the position given
+ * by the first member that found them.
+ * @param  text  The partial name
+ * @param  mode  How to match names against the text
+ * @param  max   The maximal number of names to return
+ * @return The matching names
+ */
+QStringList FederatedEngine::completions(const QString& text, MatchMode mode,
+                                         int max) const
+{
+	QStringList names;
+	QSet<QString> found;
+
+	foreach (const Member& member, members_) {
+		foreach (QString name, member.engine_->completions(text, mode, max)) {
+			if (names.size() == max)
+				return names;
+
+			if (!found.contains(name)) {
+				found.insert(name);
+				names.append(name);
+			}
+		}
+	}
+
+	return names;
+}
+
+/**
+ * Starts a query on all member engines that can be queried.
+ * @param  conn   Receives the combined results
+ * @param  query  The query to execute
+ */
+void FederatedEngine::query(Connection* conn, const Query& query) const
+{
+	QList<Member> members = queryableMembers();
+	FederatedOperation* op = startOperation(conn, members);
+
+	for (int i = 0; i < members.size(); i++) {
+		try {
+			members[i].engine_->query(op->parts_[i], query);
+		}
+		catch (Exception* e) {
+			qDebug() << "Query failed in" << members[i].name_ << e->reason();
+			delete e;
+			op->parts_[i]->onAborted();
+		}
+	}
+}
+
+/**
+ * Starts a batch of queries on all member engines that can be queried.
+ * Each member receives the entire batch, so that it can execute the queries
+ * together.
+ * @param  batch  The queries to execute
+ */
+void FederatedEngine::queryBatch(const QList<BatchQuery>& batch) const
+{
+	QList<Member> members = queryableMembers();
+
+	QList<FederatedOperation*> ops;
+	foreach (const BatchQuery& bq, batch)
+		ops.append(startOperation(bq.conn_, members));
+
+	for (int i = 0; i < members.size(); i++) {
+		QList<BatchQuery> memberBatch;
+		for (int j = 0; j < batch.size(); j++)
+			memberBatch.append(BatchQuery(ops[j]->parts_[i], batch[j].query_));
+
+		try {
+			members[i].engine_->queryBatch(memberBatch);
+		}
+		catch (Exception* e) {
+			qDebug() << "Query failed in" << members[i].name_ << e->reason();
+			delete e;
+			foreach (const BatchQuery& bq, memberBatch) {
+				FederatedOperation::Part* part
+					= static_cast<FederatedOperation::Part*>(bq.conn_);
+				if (!part->done_)
+					part->onAborted();
+			}
+		}
+	}
+}
+
+/**
+ * Builds the databases of all member engines.
+ * @param  conn  Receives the combined progress
+ */
+void FederatedEngine::build(Connection* conn) const
+{
+	FederatedOperation* op = startOperation(conn, members_);
+
+	for (int i = 0; i < members_.size(); i++)
+		members_[i].engine_->build(op->parts_[i]);
+}
+
+/**
+ * @return The member engines that can be queried (i.e., their databases were
+ *         built)
+ */
+QList<FederatedEngine::Member> FederatedEngine::queryableMembers() const
+{
+	QList<Member> members;
+
+	foreach (const Member& member, members_) {
+		Status status = member.engine_->status();
+		if ((status == Ready) || (status == Rebuild))
+			members.append(member);
+	}
+
+	return members;
+}
+
+/**
+ * Creates an operation with a part for each of the given members.
+ * An operation previously started on the connection is detached from it.
+ * All parts are created before any of them is started, so that an early
+ * termination does not complete the operation.
+ * @param  conn     The caller's connection
+ * @param  members  The members on which the operation runs
+ * @return The new operation
+ */
+FederatedOperation*
+FederatedEngine::startOperation(Connection* conn,
+                                const QList<Member>& members) const
+{
+	FederatedOperation* op = operations_.take(conn);
+	if (op)
+		op->detach();
+
+	op = new FederatedOperation(this, conn);
+	foreach (const Member& member, members)
+		op->addPart(member.name_, member.engine_);
+
+	operations_.insert(conn, op);
+	op->start();
+	return op;
+}
+
+/**
+ * Called by an operation once it has reported to its caller.
+ * @param  op  The operation
+ */
+void FederatedEngine::operationDone(FederatedOperation* op)
+{
+	QHash<Connection*, FederatedOperation*>::Iterator itr
+		= operations_.find(op->conn_);
+	if ((itr != operations_.end()) && (*itr == op))
+		operations_.erase(itr);
+}
+
+/**
+ * Class constructor.
+ * @param  engine  The engine starting the operation
+ * @param  conn    The caller's connection
+ */
+FederatedOperation::FederatedOperation(const FederatedEngine* engine,
+                                       Engine::Connection* conn)
+	: QObject(), engine_(engine), conn_(conn), running_(0), succeeded_(false),
+	  stopped_(false)
+{
+}
+
+/**
+ * Class destructor.
+ */
+FederatedOperation::~FederatedOperation()
+{
+	qDeleteAll(parts_);
+}
+
+/**
+ * Creates the connection for a member engine.
+ * @param  project  The name of the member's project
+ * @param  engine   The member engine
+ * @return The connection to pass to the member engine
+ */
+Engine::Connection* FederatedOperation::addPart(const QString& project,
+                                                Engine* engine)
+{
+	Part* part = new Part(this, project, engine);
+	parts_.append(part);
+	return part;
+}
+
+/**
+ * Marks all parts as running.
+ * Must be called after all parts were added, and before any of them is passed
+ * to an engine. An operation without parts finishes from the event loop.
+ */
+void FederatedOperation::start()
+{
+	running_ = parts_.size();
+	conn_->setCtrlObject(this);
+
+	if (running_ == 0)
+		QTimer::singleShot(0, this, SLOT(finish()));
+}
+
+/**
+ * Stops all running parts.
+ * The caller is notified once all of them are done.
+ */
+void FederatedOperation::stop()
+{
+	stopped_ = true;
+
+	foreach (Part* part, parts_) {
+		if (!part->done_)
+			part->stop();
+	}
+}
+
+/**
+ * Stops the operation, without reporting to the caller.
+ * Used when the caller starts a new operation on the same connection.
+ */
+void FederatedOperation::detach()
+{
+	if (conn_)
+		conn_->setCtrlObject(NULL);
+
+	conn_ = NULL;
+	stop();
+}
+
+/**
+ * Called when a member engine is done.
+ * @param  part  The member's connection
+ * @param  ok    Whether the member finished successfully
+ */
+void FederatedOperation::partDone(Part* part, bool ok)
+{
+	if (part->done_)
+		return;
+
+	part->done_ = true;
+	part->setCtrlObject(NULL);
+	if (ok)
+		succeeded_ = true;
+
+	if (--running_ == 0)
+		finish();
+}
+
+/**
+ * Reports the combined progress of all parts.
+ * @param  text  The text reported by the last part to make progress
+ */
+void FederatedOperation::progress(const QString& text)
+{
+	if (conn_ == NULL)
+		return;
+
+	uint cur = 0, total = 0;
+	foreach (Part* part, parts_) {
+		cur += part->cur_;
+		total += part->total_;
+	}
+
+	conn_->onProgress(text, cur, total);
+}
+
+/**
+ * Reports termination to the caller, and deletes the operation.
+ * Member engines may still refer to the parts while reporting termination,
+ * so the deletion is deferred.
+ */
+void FederatedOperation::finish()
+{
+	if (engine_)
+		const_cast<FederatedEngine*>(engine_)->operationDone(this);
+
+	if (conn_) {
+		conn_->setCtrlObject(NULL);
+		if (succeeded_ && !stopped_)
+			conn_->onFinished();
+		else
+			conn_->onAborted();
+	}
+
+	deleteLater();
+}
+
+/**
+ * Forwards results to the caller, tagged with the member's project.
+ * @param  locList  The results
+ */
+void FederatedOperation::Part::onDataReady(const LocationList& locList)
+{
+	if (op_->conn_ == NULL)
+		return;
+
+	LocationList tagged = locList;
+	for (LocationList::Iterator itr = tagged.begin(); itr != tagged.end();
+	     ++itr) {
+		(*itr).project_ = project_;
+	}
+
+	op_->conn_->onDataReady(tagged);
+}
+
+/**
+ * Records the member's progress, and reports the combined progress.
+ * @param  text   A message describing the kind of progress made
+ * @param  cur    The current value
+ * @param  total  The expected final value
+ */
+void FederatedOperation::Part::onProgress(const QString& text, uint cur,
+                                          uint total)
+{
+	cur_ = cur;
+	total_ = total;
+	op_->progress(QString("%1: %2").arg(project_).arg(text));
+}
+
+} // namespace Core
+
+} // namespace KScope
@@ -0,0 +1,219 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CORE_FEDERATEDENGINE_H__
+#define __CORE_FEDERATEDENGINE_H__
+
+#include <QHash>
+#include "engine.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+class FederatedOperation;
+
+/**
+ * Combines the engines of several projects into a single engine.
+ * Every operation is started on all member engines at once, and reported
+ * through the caller's connection as a single operation, which finishes once
+ * all members are done. Results are tagged with the name of the project in
+ * which they were found (see Location::project_), and queryFields() adds a
+ * column showing it.
+ * Each member keeps its own database status: queries are not sent to members
+ * whose database was never built.
+ * As with QueryScheduler, starting a new query on a connection cancels any
+ * query previously started on that connection.
+ * @author Elad Lahav
+ */
+class FederatedEngine : public Engine
+{
+	Q_OBJECT
+
+public:
+	FederatedEngine(QObject* parent = NULL);
+	~FederatedEngine();
+
+	void addMember(const QString&, Engine*);
+	void removeMember(Engine*);
+
+	/**
+	 * @return The number of member engines
+	 */
+	int memberCount() const { return members_.size(); }
+
+	virtual void open(const QString&, Callback<>*);
+	virtual Status status() const;
+	virtual QList<Location::Fields> queryFields(Query::Type) const;
+	virtual QStringList completions(const QString&, MatchMode, int) const;
+
+public slots:
+	virtual void query(Connection*, const Query&) const;
+	virtual void queryBatch(const QList<BatchQuery>&) const;
+	virtual void build(Connection*) const;
+
+private:
+	/**
+	 * A member engine.
+	 */
+	struct Member
+	{
+		Member(const QString& name, Engine* engine)
+			: name_(name), engine_(engine) {}
+
+		/**
+		 * The name of the member's project.
+		 */
+		QString name_;
+
+		/**
+		 * The project's engine.
+		 */
+		Engine* engine_;
+	};
+
+	/**
+	 * The member engines, in order of addition.
+	 */
+	QList<Member> members_;
+
+	/**
+	 * Running operations, keyed by the caller's connection.
+	 */
+	mutable QHash<Connection*, FederatedOperation*> operations_;
+
+	QList<Member> queryableMembers() const;
+	FederatedOperation* startOperation(Connection*,
+	                                   const QList<Member>&) const;
+	void operationDone(FederatedOperation*);
+
+	friend class FederatedOperation;
+};
+
+/**
+ * A single operation of a FederatedEngine, running on several member engines.
+ * The operation holds a connection for each member (a part), and reports
+ * to the caller's connection once all parts are done. The operation finishes
+ * successfully if any of the parts did.
+ * @author Elad Lahav
+ */
+class FederatedOperation : public QObject, public Engine::Controlled
+{
+	Q_OBJECT
+
+public:
+	FederatedOperation(const FederatedEngine*, Engine::Connection*);
+	~FederatedOperation();
+
+	Engine::Connection* addPart(const QString&, Engine*);
+	void start();
+	void stop();
+	void detach();
+
+private:
+	/**
+	 * Receives the results of a member engine.
+	 */
+	struct Part : public Engine::Connection
+	{
+		Part(FederatedOperation* op, const QString& project, Engine* engine)
+			: Engine::Connection(op->conn_->priority()), op_(op),
+			  project_(project), engine_(engine), cur_(0), total_(0),
+			  done_(false) {}
+
+		void onDataReady(const LocationList&);
+		void onFinished() { op_->partDone(this, true); }
+		void onAborted() { op_->partDone(this, false); }
+		void onProgress(const QString&, uint, uint);
+
+		/**
+		 * The owning operation.
+		 */
+		FederatedOperation* op_;
+
+		/**
+		 * The name of the member's project.
+		 */
+		QString project_;
+
+		/**
+		 * The member engine.
+		 */
+		Engine* engine_;
+
+		/**
+		 * The last progress values reported by the member.
+		 */
+		uint cur_;
+		uint total_;
+
+		/**
+		 * Whether the member is done.
+		 */
+		bool done_;
+	};
+
+	/**
+	 * The engine that started the operation, NULL if it was deleted.
+	 */
+	const FederatedEngine* engine_;
+
+	/**
+	 * The caller's connection, NULL if the caller is no longer interested in
+	 * the operation.
+	 */
+	Engine::Connection* conn_;
+
+	/**
+	 * One part per member engine.
+	 */
+	QList<Part*> parts_;
+
+	/**
+	 * The number of parts still running.
+	 */
+	int running_;
+
+	/**
+	 * Whether any of the parts finished successfully.
+	 */
+	bool succeeded_;
+
+	/**
+	 * Whether the operation was stopped by the caller.
+	 */
+	bool stopped_;
+
+	void partDone(Part*, bool);
+	void progress(const QString&);
+
+	friend class FederatedEngine;
+
+private slots:
+	void finish();
+};
+
+} // namespace Core
+
+} // namespace KScope
+
+#endif // __CORE_FEDERATEDENGINE_H__
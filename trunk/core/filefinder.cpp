@@ -0,0 +1,104 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include "filefinder.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * Class constructor.
+ * Starts the thread, which waits for requests.
+ * @param  index   The index to search
+ * @param  parent  Parent object
+ */
+FileFinder::FileFinder(const PathIndex* index, QObject* parent)
+	: QThread(parent), index_(index), max_(0), pending_(false), quit_(false),
+	  cancel_(false)
+{
+	start();
+}
+
+/**
+ * Class destructor.
+ * Abandons the current search, and waits for the thread to terminate.
+ */
+FileFinder::~FileFinder()
+{
+	mutex_.lock();
+	quit_ = true;
+	cancel_ = true;
+	cond_.wakeOne();
+	mutex_.unlock();
+
+	wait();
+}
+
+/**
+ * Requests a search.
+ * found() is emitted once the search completes, unless another search is
+ * requested in the meantime.
+ * @param  text  The text to match
+ * @param  max   The maximal number of files to return
+ */
+void FileFinder::find(const QString& text, int max)
+{
+	QMutexLocker locker(&mutex_);
+
+	text_ = text;
+	max_ = max;
+	pending_ = true;
+	cancel_ = true;
+	cond_.wakeOne();
+}
+
+/**
+ * Serves search requests until the object is destroyed.
+ */
+void FileFinder::run()
+{
+	forever {
+		mutex_.lock();
+		while (!pending_ && !quit_)
+			cond_.wait(&mutex_);
+
+		if (quit_) {
+			mutex_.unlock();
+			return;
+		}
+
+		QString text = text_;
+		int max = max_;
+		pending_ = false;
+		cancel_ = false;
+		mutex_.unlock();
+
+		QStringList files = index_->match(text, max, &cancel_);
+		if (!cancel_)
+			emit found(text, files);
+	}
+}
+
+} // namespace Core
+
+} // namespace KScope
@@ -0,0 +1,108 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CORE_FILEFINDER_H__
+#define __CORE_FILEFINDER_H__
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include "pathindex.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * Searches a PathIndex on a separate thread.
+ * Only the latest request matters: a new request abandons a search that is
+ * still running, so that typing does not queue up searches for stale text.
+ * @author Elad Lahav
+ */
+class FileFinder : public QThread
+{
+	Q_OBJECT
+
+public:
+	FileFinder(const PathIndex*, QObject* parent = NULL);
+	~FileFinder();
+
+	void find(const QString&, int);
+
+signals:
+	/**
+	 * Emitted when a search completes.
+	 * @param  text   The text that was matched
+	 * @param  files  The best matching files (see PathIndex::match())
+	 */
+	void found(const QString& text, const QStringList& files);
+
+protected:
+	virtual void run();
+
+private:
+	/**
+	 * The searched index.
+	 */
+	const PathIndex* index_;
+
+	/**
+	 * Protects the request parameters.
+	 */
+	QMutex mutex_;
+
+	/**
+	 * Wakes up the thread when a request arrives.
+	 */
+	QWaitCondition cond_;
+
+	/**
+	 * The text to match for the next search.
+	 */
+	QString text_;
+
+	/**
+	 * The maximal number of results for the next search.
+	 */
+	int max_;
+
+	/**
+	 * Whether a search was requested since the last one started.
+	 */
+	bool pending_;
+
+	/**
+	 * Set to terminate the thread.
+	 */
+	bool quit_;
+
+	/**
+	 * Set to abandon the current search.
+	 */
+	volatile bool cancel_;
+};
+
+} // namespace Core
+
+} // namespace KScope
+
+#endif // __CORE_FILEFINDER_H__
@@ -0,0 +1,579 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include <QApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QDebug>
+#include <string.h>
+#include "gitindexscanner.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * Reads a big-endian 32-bit value from the index.
+ * @param  p  Points to the first byte of the value
+ * @return The value in host order
+ */
+static inline quint32 readU32(const uchar* p)
+{
+	return (quint32(p[0]) << 24) | (quint32(p[1]) << 16)
+	       | (quint32(p[2]) << 8) | quint32(p[3]);
+}
+
+/**
+ * Reads a big-endian 16-bit value from the index.
+ * @param  p  Points to the first byte of the value
+ * @return The value in host order
+ */
+static inline quint16 readU16(const uchar* p)
+{
+	return (quint16(p[0]) << 8) | quint16(p[1]);
+}
+
+/**
+ * Converts a .gitignore glob into a regular expression.
+ * Unlike QRegExp::Wildcard, '*' and '?' do not match a directory separator,
+ * while "**" matches any number of path components.
+ * @param  glob  The pattern to convert
+ * @return The equivalent regular expression
+ */
+static QRegExp globToRegExp(const QString& glob)
+{
+	QString exp;
+	int len = glob.length();
+
+	for (int i = 0; i < len; i++) {
+		QChar c = glob[i];
+
+		if (c == '*') {
+			if ((i + 1 < len) && (glob[i + 1] == '*')) {
+				// "**/" matches zero or more leading directories, "/**"
+				// matches everything inside a directory.
+				if ((i + 2 < len) && (glob[i + 2] == '/')) {
+					exp += "(.*/)?";
+					i += 2;
+				}
+				else {
+					exp += ".*";
+					i++;
+				}
+			}
+			else {
+				exp += "[^/]*";
+			}
+		}
+		else if (c == '?') {
+			exp += "[^/]";
+		}
+		else if (c == '[') {
+			// Copy a character class, translating the negation character.
+			int end = glob.indexOf(']', i + 2);
+			if (end == -1) {
+				exp += "\\[";
+				continue;
+			}
+
+			QString cls = glob.mid(i + 1, end - i - 1);
+			if (cls.startsWith('!'))
+				cls[0] = '^';
+			exp += "[" + cls + "]";
+			i = end;
+		}
+		else if ((c == '\\') && (i + 1 < len)) {
+			exp += QRegExp::escape(QString(glob[++i]));
+		}
+		else {
+			exp += QRegExp::escape(QString(c));
+		}
+	}
+
+	return QRegExp(exp);
+}
+
+/**
+ * Class constructor.
+ * @param  parent  Owner object
+ */
+GitIndexScanner::GitIndexScanner(QObject* parent) : QObject(parent)
+{
+}
+
+/**
+ * Class destructor.
+ */
+GitIndexScanner::~GitIndexScanner()
+{
+}
+
+/**
+ * Lists the files tracked under the given directory, using the given filter.
+ * The directory does not need to be the root of the working tree: the
+ * repository is located by searching the directory's ancestors, and only
+ * index entries under the directory are considered.
+ * @param  dir        The directory to scan
+ * @param  filter     The filter to use
+ * @param  untracked  true to also add untracked files that are not ignored,
+ *                    false to list tracked files only
+ * @return true if successful, false if the scan failed or was aborted
+ */
+bool GitIndexScanner::scan(const QDir& dir, const FileFilter& filter,
+                           bool untracked)
+{
+	scanned_ = 0;
+	fileList_.clear();
+	tracked_.clear();
+	dirMatch_.clear();
+	filter_ = filter;
+	stop_ = false;
+	error_ = QString();
+
+	// Locate the repository.
+	workTree_ = findWorkTree(dir);
+	if (workTree_.isEmpty()) {
+		error_ = tr("'%1' is not inside a Git working tree").arg(dir.path());
+		return false;
+	}
+
+	// Only consider entries under the requested directory.
+	prefix_ = dir.absolutePath() + "/";
+	prefix_ = prefix_.mid(workTree_.length());
+
+	QString git = gitDir(workTree_);
+	qDebug() << "Reading Git index" << git << prefix_ << untracked;
+
+	if (!readIndex(git + "/index"))
+		return false;
+
+	if (!untracked)
+		return true;
+
+	// Collect the exclusion rules that apply to the scanned directory: the
+	// repository's private exclude file, and any .gitignore file found in
+	// directories above it.
+	IgnoreRuleList rules;
+	loadIgnoreFile(git + "/info/exclude", QString(), rules);
+
+	QStringList parts = prefix_.split('/', QString::SkipEmptyParts);
+	QString base;
+	QStringList::ConstIterator itr;
+	for (itr = parts.begin(); itr != parts.end(); ++itr) {
+		loadIgnoreFile(workTree_ + base + ".gitignore", base, rules);
+		base += *itr + "/";
+	}
+
+	return scanUntracked(prefix_, rules);
+}
+
+/**
+ * Finds the root of the Git working tree containing the given directory.
+ * @param  dir  The directory to start from
+ * @return The absolute path of the work tree (with a trailing '/'), or an
+ *         empty string if the directory is not under Git control
+ */
+QString GitIndexScanner::findWorkTree(const QDir& dir)
+{
+	QDir cur(dir.absolutePath());
+
+	do {
+		if (cur.exists(".git")) {
+			QString path = cur.absolutePath();
+			if (!path.endsWith("/"))
+				path += "/";
+			return path;
+		}
+	} while (cur.cdUp());
+
+	return QString();
+}
+
+/**
+ * Parses the index file and adds all entries under the scanned directory.
+ * Versions 2, 3 and 4 of the index format are supported. The file is mapped
+ * into memory, if possible, to avoid copying.
+ * @param  path  The path of the index file
+ * @return true if successful, false otherwise
+ */
+bool GitIndexScanner::readIndex(const QString& path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		error_ = tr("Cannot open '%1' for reading").arg(path);
+		return false;
+	}
+
+	// Map the file, falling back to a copy if mapping fails.
+	qint64 size = file.size();
+	QByteArray buf;
+	const uchar* data = file.map(0, size);
+	if (data == NULL) {
+		buf = file.readAll();
+		data = reinterpret_cast<const uchar*>(buf.constData());
+	}
+
+	// Validate the header.
+	// The last 20 bytes of the file hold a checksum.
+	if ((size < 32) || (memcmp(data, "DIRC", 4) != 0)) {
+		error_ = tr("'%1' is not a Git index file").arg(path);
+		return false;
+	}
+
+	quint32 version = readU32(data + 4);
+	if ((version < 2) || (version > 4)) {
+		error_ = tr("Unsupported Git index version %1").arg(version);
+		return false;
+	}
+
+	quint32 count = readU32(data + 8);
+	const uchar* pos = data + 12;
+	const uchar* end = data + size - 20;
+	QByteArray name;
+
+	for (quint32 i = 0; i < count; i++) {
+		// Each entry starts with 62 bytes of stat information, the object
+		// name and the flags.
+		if (pos + 62 > end)
+			break;
+
+		quint32 mode = readU32(pos + 24);
+		quint16 flags = readU16(pos + 60);
+		const uchar* namePos = pos + 62;
+
+		// Extended flags (version 3 and up).
+		quint16 extFlags = 0;
+		if (flags & 0x4000) {
+			if (namePos + 2 > end)
+				break;
+
+			extFlags = readU16(namePos);
+			namePos += 2;
+		}
+
+		// Version 4 prefix-compresses the name: a variable-length integer
+		// gives the number of bytes to drop from the end of the previous
+		// name, followed by a NUL-terminated suffix.
+		int strip = 0;
+		if (version == 4) {
+			if (namePos >= end)
+				break;
+
+			uchar c = *namePos++;
+			strip = c & 0x7f;
+			while ((c & 0x80) && (namePos < end) && (strip <= name.size())) {
+				c = *namePos++;
+				strip = ((strip + 1) << 7) | (c & 0x7f);
+			}
+
+			// The integer runs past the end of the entries, or strips more
+			// than the previous name.
+			if ((c & 0x80) || (strip > name.size()))
+				break;
+		}
+
+		const uchar* nameEnd
+			= static_cast<const uchar*>(memchr(namePos, 0, end - namePos));
+		if (nameEnd == NULL)
+			break;
+
+		if (version == 4) {
+			name.chop(strip);
+			name.append(reinterpret_cast<const char*>(namePos),
+			            nameEnd - namePos);
+			pos = nameEnd + 1;
+		}
+		else {
+			name = QByteArray(reinterpret_cast<const char*>(namePos),
+			                  nameEnd - namePos);
+
+			// Entries are NUL-padded to a multiple of 8 bytes.
+			pos += ((namePos - pos) + (nameEnd - namePos) + 8) & ~7;
+		}
+
+		scanned_++;
+		emitProgress();
+		if (stop_)
+			return false;
+
+		// Skip sub-modules, sparse directory entries and files excluded from
+		// the working tree by a sparse checkout.
+		if (((mode & 0170000) == 0160000) || ((mode & 0170000) == 0040000))
+			continue;
+		if (extFlags & 0x4000)
+			continue;
+
+		// Skip entries outside the scanned directory.
+		QString relPath = QFile::decodeName(name);
+		if (!relPath.startsWith(prefix_))
+			continue;
+
+		// Unmerged files appear once for each stage.
+		if (tracked_.contains(relPath))
+			continue;
+
+		tracked_.insert(relPath);
+		addFile(relPath);
+	}
+
+	return true;
+}
+
+/**
+ * Recursively adds untracked files under a directory.
+ * Files listed in the index are skipped, as are files and directories matched
+ * by the exclusion rules.
+ * @param  relDir  The directory to scan, relative to the work tree
+ * @param  rules   Exclusion rules inherited from the parent directories
+ * @return true if successful, false if the scan was aborted
+ */
+bool GitIndexScanner::scanUntracked(const QString& relDir,
+                                    IgnoreRuleList rules)
+{
+	QDir dir(workTree_ + relDir);
+	loadIgnoreFile(dir.filePath(".gitignore"), relDir, rules);
+
+	QFileInfoList infos = dir.entryInfoList(QDir::Files | QDir::Dirs
+	                                        | QDir::Hidden
+	                                        | QDir::NoDotAndDotDot);
+
+	QFileInfoList::Iterator itr;
+	for (itr = infos.begin(); itr != infos.end(); ++itr) {
+		scanned_++;
+		emitProgress();
+		if (stop_)
+			return false;
+
+		QString relPath = relDir + (*itr).fileName();
+		if ((*itr).isDir() && !(*itr).isSymLink()) {
+			// Do not descend into the repository itself, nested
+			// repositories or ignored directories.
+			if ((*itr).fileName() == ".git")
+				continue;
+			if (QFileInfo(QDir((*itr).filePath()), ".git").exists())
+				continue;
+			if (isIgnored(rules, relPath, true))
+				continue;
+
+			if (!scanUntracked(relPath + "/", rules))
+				return false;
+		}
+		else if (!tracked_.contains(relPath)
+		         && !isIgnored(rules, relPath, false)) {
+			addFile(relPath);
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Adds a file to the list, if it is accepted by the filter.
+ * @param  relPath  The path of the file, relative to the work tree
+ */
+void GitIndexScanner::addFile(const QString& relPath)
+{
+	QString relDir = relPath.left(relPath.lastIndexOf('/') + 1);
+	if (!dirAddsFiles(relDir))
+		return;
+
+	// The default match is set to false, so that files not matched by any
+	// rule will not be added.
+	QString path = workTree_ + relPath;
+	if (filter_.match(path, false))
+		fileList_.append(path);
+}
+
+/**
+ * Determines whether files under the given directory should be considered.
+ * Follows the rules used by FileScanner for a recursive scan:
+ * 1. If an inclusion rule is matched, add files.
+ * 2. If an exclusion rule is matched, do not add files.
+ * 3. If no rule is matched, inherit the behaviour of the parent directory.
+ * @param  relDir  The directory, relative to the work tree, with a trailing
+ *                 '/'
+ * @return true to add files in this directory, false otherwise
+ */
+bool GitIndexScanner::dirAddsFiles(const QString& relDir)
+{
+	QHash<QString, bool>::ConstIterator itr = dirMatch_.find(relDir);
+	if (itr != dirMatch_.end())
+		return *itr;
+
+	bool result;
+	if (relDir.length() <= prefix_.length()) {
+		// The scanned directory itself.
+		result = filter_.match(workTree_ + relDir, true);
+	}
+	else {
+		QString parentDir = relDir.left(relDir.lastIndexOf('/',
+		                                                   -2) + 1);
+		result = filter_.match(workTree_ + relDir, dirAddsFiles(parentDir));
+	}
+
+	dirMatch_.insert(relDir, result);
+	return result;
+}
+
+/**
+ * Emits progress information and handles events every 256 scanned entries.
+ */
+void GitIndexScanner::emitProgress()
+{
+	if ((scanned_ & 0xff) != 0)
+		return;
+
+	if (!progressMessage_.isEmpty()) {
+		QString msg = progressMessage_.arg(scanned_).arg(fileList_.size());
+		emit progress(msg);
+	}
+	else {
+		emit progress(scanned_, fileList_.size());
+	}
+
+	// Make sure event processing continues during a long scan.
+	qApp->processEvents();
+}
+
+/**
+ * Reads exclusion patterns from a .gitignore-style file.
+ * Missing files are silently ignored.
+ * @param  path   The file to read
+ * @param  base   The directory, relative to the work tree, to which the
+ *                patterns in the file apply
+ * @param  rules  The list to which rules are appended
+ */
+void GitIndexScanner::loadIgnoreFile(const QString& path, const QString& base,
+                                     IgnoreRuleList& rules)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return;
+
+	QTextStream strm(&file);
+	while (!strm.atEnd()) {
+		QString line = strm.readLine();
+
+		// Remove trailing whitespace, and skip blank lines and comments.
+		while (line.endsWith(' ') && !line.endsWith("\\ "))
+			line.chop(1);
+		if (line.isEmpty() || line.startsWith('#'))
+			continue;
+
+		IgnoreRule rule;
+		rule.base_ = base;
+		rule.negate_ = false;
+		rule.dirOnly_ = false;
+
+		if (line.startsWith('!')) {
+			rule.negate_ = true;
+			line.remove(0, 1);
+		}
+		else if (line.startsWith("\\#") || line.startsWith("\\!")) {
+			line.remove(0, 1);
+		}
+
+		if (line.endsWith('/')) {
+			rule.dirOnly_ = true;
+			line.chop(1);
+		}
+
+		// A pattern containing a separator is matched against the full
+		// path, relative to the directory of the .gitignore file.
+		rule.anchored_ = line.contains('/');
+		if (line.startsWith('/'))
+			line.remove(0, 1);
+
+		if (line.isEmpty())
+			continue;
+
+		rule.exp_ = globToRegExp(line);
+		rules.append(rule);
+	}
+}
+
+/**
+ * Checks a path against a list of exclusion rules.
+ * As in Git, the last matching rule decides.
+ * @param  rules    The list of rules
+ * @param  relPath  The path to check, relative to the work tree
+ * @param  isDir    Whether the path refers to a directory
+ * @return true if the path is ignored, false otherwise
+ */
+bool GitIndexScanner::isIgnored(const IgnoreRuleList& rules,
+                                const QString& relPath, bool isDir)
+{
+	QString name = relPath.mid(relPath.lastIndexOf('/') + 1);
+
+	for (int i = rules.size() - 1; i >= 0; i--) {
+		const IgnoreRule& rule = rules[i];
+		if (rule.dirOnly_ && !isDir)
+			continue;
+		if (!relPath.startsWith(rule.base_))
+			continue;
+
+		bool match;
+		if (rule.anchored_)
+			match = rule.exp_.exactMatch(relPath.mid(rule.base_.length()));
+		else
+			match = rule.exp_.exactMatch(name);
+
+		if (match)
+			return !rule.negate_;
+	}
+
+	return false;
+}
+
+/**
+ * Locates the repository directory for a work tree.
+ * Handles both a regular .git directory and a .git file pointing elsewhere
+ * (as created for linked work trees and sub-modules).
+ * @param  workTree  The root of the work tree (with a trailing '/')
+ * @return The path of the repository directory
+ */
+QString GitIndexScanner::gitDir(const QString& workTree)
+{
+	QString path = workTree + ".git";
+	QFileInfo fi(path);
+	if (fi.isDir())
+		return path;
+
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return path;
+
+	QString line = QTextStream(&file).readLine();
+	if (!line.startsWith("gitdir:"))
+		return path;
+
+	QString dir = line.mid(7).trimmed();
+	if (QDir::isRelativePath(dir))
+		dir = workTree + dir;
+
+	return QDir::cleanPath(dir);
+}
+
+}
+
+}
@@ -0,0 +1,177 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CORE_GITINDEXSCANNER_H__
+#define __CORE_GITINDEXSCANNER_H__
+
+#include <QObject>
+#include <QDir>
+#include <QHash>
+#include <QSet>
+#include <QRegExp>
+#include "filefilter.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * Enumerates the files tracked by a Git working tree.
+ * Instead of walking the file system, the scanner reads the repository's
+ * index file (.git/index) directly, which is much faster on large trees and
+ * does not pick up build output. Optionally, untracked files that are not
+ * excluded by the .gitignore rules can be added to the list.
+ * The resulting list is passed through a FileFilter, with the same semantics
+ * as a recursive FileScanner scan: directory rules determine whether files
+ * under a directory are considered, and file rules are applied with a default
+ * of "no match".
+ * The git executable is never invoked.
+ * @author Elad Lahav
+ */
+class GitIndexScanner : public QObject
+{
+	Q_OBJECT
+
+public:
+	GitIndexScanner(QObject* parent = NULL);
+	~GitIndexScanner();
+
+	bool scan(const QDir&, const FileFilter&, bool untracked = false);
+
+	static QString findWorkTree(const QDir&);
+
+	/**
+	 * Changes the type of progress signal emitted to be a formatted message.
+	 * The given string should include a '%1' marker to be replaced by the
+	 * number of scanned files, and a '%2' marker to be replaced by the
+	 * number of files matching the filter.
+	 * @param msg
+	 */
+	void setProgressMessage(const QString& msg) {
+		progressMessage_ = msg;
+	}
+
+	/**
+	 * Returns the list of files matched during the last scan.
+	 * @return The matching file list
+	 */
+	const QStringList& matchedFiles() const { return fileList_; }
+
+	/**
+	 * @return A description of the last error, if scan() failed for a reason
+	 *         other than being stopped
+	 */
+	const QString& errorString() const { return error_; }
+
+public slots:
+	/**
+	 * Signals the scan process to stop.
+	 */
+	void stop() { stop_ = true; }
+
+signals:
+	void progress(int scanned, int matched);
+	void progress(const QString& msg);
+
+private:
+	/**
+	 * A single pattern read from a .gitignore (or info/exclude) file.
+	 */
+	struct IgnoreRule
+	{
+		/**
+		 * The pattern, converted to a regular expression.
+		 */
+		QRegExp exp_;
+
+		/**
+		 * The directory (relative to the work tree, with a trailing '/')
+		 * holding the file that defined the rule.
+		 */
+		QString base_;
+
+		/**
+		 * Whether the pattern was prefixed by '!'.
+		 */
+		bool negate_;
+
+		/**
+		 * Whether the pattern ends with a '/', and thus only matches
+		 * directories.
+		 */
+		bool dirOnly_;
+
+		/**
+		 * Whether the pattern is matched against the full path (relative to
+		 * base_) rather than against the last path component.
+		 */
+		bool anchored_;
+	};
+
+	typedef QList<IgnoreRule> IgnoreRuleList;
+
+	/**
+	 * The root of the working tree being scanned (with a trailing '/').
+	 */
+	QString workTree_;
+
+	/**
+	 * The path of the scanned directory relative to the work tree.
+	 * Only index entries under this prefix are considered.
+	 */
+	QString prefix_;
+
+	int scanned_;
+	QStringList fileList_;
+	FileFilter filter_;
+	bool stop_;
+	QString progressMessage_;
+	QString error_;
+
+	/**
+	 * Paths (relative to the work tree) of all files listed in the index.
+	 */
+	QSet<QString> tracked_;
+
+	/**
+	 * Caches the filter decision for each directory (relative path, with a
+	 * trailing '/'), so that every directory is matched only once.
+	 */
+	QHash<QString, bool> dirMatch_;
+
+	bool readIndex(const QString&);
+	bool scanUntracked(const QString&, IgnoreRuleList);
+	void addFile(const QString&);
+	bool dirAddsFiles(const QString&);
+	void emitProgress();
+
+	static void loadIgnoreFile(const QString&, const QString&,
+	                           IgnoreRuleList&);
+	static bool isIgnored(const IgnoreRuleList&, const QString&, bool);
+	static QString gitDir(const QString&);
+};
+
+}
+
+}
+
+#endif // __CORE_GITINDEXSCANNER_H__
@@ -121,6 +121,12 @@ struct Location
 	 */
 	QString text_;
 
+	/**
+	 * The name of the project in which the location was found (optional, set
+	 * when querying several projects at once).
+	 */
+	QString project_;
+
 	/**
 	 * Each member in the structure is assigned a numeric value. These can be
 	 * used for, e.g., creating lists of fields for displaying query results.
@@ -140,7 +146,9 @@ struct Location
 		/** Scope of the tag (function name, structure, global, etc.) */
 		Scope,
 		/** Line text. */
-		Text
+		Text,
+		/** Project name. */
+		Project
 	};
 
 	/**
@@ -162,6 +162,10 @@ QVariant LocationModel::locationData(const Location& loc, uint col,
 	case Location::Text:
 		// Line text.
 		return loc.text_;
+
+	case Location::Project:
+		// Project name.
+		return loc.project_;
 	}
 
 	return QVariant();
@@ -195,6 +199,9 @@ QString LocationModel::columnText(Location::Fields col) const
 
 	case Location::Text:
 		return tr("Text");
+
+	case Location::Project:
+		return tr("Project");
 	}
 
 	return "";
@@ -18,6 +18,7 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  ***************************************************************************/
 
+#include <QBrush>
 #include "locationtreemodel.h"
 
 namespace KScope
@@ -240,6 +241,41 @@ QModelIndex LocationTreeModel::prevIndex(const QModelIndex& idx) const
 	return QModelIndex();
 }
 
+/**
+ * Marks an item as repeating one of its ancestors.
+ * Such an item is considered to have been queried with no results, so that it
+ * is not expanded, and is displayed differently from other items.
+ * @param  idx  The index of the item
+ */
+void LocationTreeModel::markCycle(const QModelIndex& idx)
+{
+	if (!idx.isValid())
+		return;
+
+	Node* node = static_cast<Node*>(idx.internalPointer());
+	if (node == NULL)
+		return;
+
+	node->data().cycle_ = true;
+	node->data().locationsAdded_ = true;
+	emit dataChanged(index(idx.row(), 0, idx.parent()),
+	                 index(idx.row(), columnCount() - 1, idx.parent()));
+}
+
+/**
+ * @param  idx  The index of an item
+ * @return true if the item was marked as repeating one of its ancestors,
+ *         false otherwise
+ */
+bool LocationTreeModel::isCycle(const QModelIndex& idx) const
+{
+	if (!idx.isValid())
+		return false;
+
+	const Node* node = static_cast<Node*>(idx.internalPointer());
+	return node != NULL && node->data().cycle_;
+}
+
 /**
  * Creates an index for the given parameters.
  * @param  row     Row number, with respect to the parent
@@ -364,6 +400,20 @@ QVariant LocationTreeModel::data(const QModelIndex& idx, int role) const
 	if (node == NULL)
 		return false;
 
+	// Show items repeating an ancestor as disabled.
+	if (node->data().cycle_) {
+		switch (role) {
+		case Qt::ForegroundRole:
+			return QBrush(Qt::gray);
+
+		case Qt::ToolTipRole:
+			return tr("Already expanded above (recursive call)");
+
+		default:
+			;
+		}
+	}
+
 	// Get the column-specific data.
 	return locationData(node->data().loc_, idx.column(), role);
 }
@@ -53,6 +53,9 @@ public:
 	QModelIndex nextIndex(const QModelIndex&) const;
 	QModelIndex prevIndex(const QModelIndex&) const;
 
+	void markCycle(const QModelIndex&);
+	bool isCycle(const QModelIndex&) const;
+
 	// QAsbstractItemModel implementation.
 	virtual QModelIndex index(int row, int column,
 							  const QModelIndex& parent) const;
@@ -79,12 +82,18 @@ private:
 		 */
 		bool locationsAdded_;
 
+		/**
+		 * Whether the item repeats one of its ancestors (e.g., a recursive
+		 * call), and should therefore not be expanded.
+		 */
+		bool cycle_;
+
 		/**
 		 * Struct constructor.
 		 * @param  loc The location to store
 		 */
 		LocationTreeItem(const Location& loc)
-			: loc_(loc), locationsAdded_(false) {}
+			: loc_(loc), locationsAdded_(false), cycle_(false) {}
 	};
 
 	typedef TreeItem<LocationTreeItem> Node;
@@ -260,6 +260,11 @@ void LocationView::locationToXML(QDomDocument& doc, QDomElement& parentElem,
 				name = "Text";
 				node = doc.createCDATASection(loc.text_);
 				break;
+
+			case Location::Project:
+				name = "Project";
+				node = doc.createTextNode(loc.project_);
+				break;
 			}
 
 			QDomElement child = doc.createElement(name);
@@ -344,6 +349,8 @@ void LocationView::locationFromXML(const QDomElement& locListElem,
 				loc.tag_.scope_ = child.text();
 			else if (child.tagName() == "Text")
 				loc.text_ = child.firstChild().toCDATASection().data();
+			else if (child.tagName() == "Project")
+				loc.project_ = child.text();
 			else if (child.tagName() == "LocationList")
 				childLists.append(QPair<int, QDomElement>(i, child));
 		}
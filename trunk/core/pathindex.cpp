@@ -0,0 +1,355 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include "pathindex.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * Score added for a character matched right after the previous one.
+ */
+static const int ConsecutiveBonus = 4;
+
+/**
+ * Score added for a character matched at the beginning of a word.
+ */
+static const int BoundaryBonus = 3;
+
+/**
+ * Score added for matching the text within the base name, so that such
+ * matches come before those that span the directory.
+ */
+static const int NameBonus = 1000;
+
+/**
+ * The number of files matched between checks for cancellation.
+ */
+static const int CancelInterval = 1024;
+
+/**
+ * Splits a path into its directory (including the trailing separator) and
+ * base name.
+ * @param  path  The path to split
+ * @param  dir   Holds the directory, upon return
+ * @param  name  Holds the base name, upon return
+ */
+static inline void splitPath(const QString& path, QString& dir, QString& name)
+{
+	int sep = path.lastIndexOf('/');
+	dir = path.left(sep + 1);
+	name = path.mid(sep + 1);
+}
+
+/**
+ * @param  c  A character in a path
+ * @return true if a word starts after this character, false otherwise
+ */
+static inline bool isBoundary(QChar c)
+{
+	return (c == '/') || (c == '_') || (c == '-') || (c == '.') || (c == ' ');
+}
+
+/**
+ * Matches the characters of the text, in order, against a string.
+ * Characters are matched as early as possible in the string.
+ * @param  str    The string to match against
+ * @param  text   The text to match
+ * @param  pos    The position of the first unmatched character in the text,
+ *                advanced past the characters matched in this string
+ * @param  score  Increased for every matched character
+ */
+static inline void matchChars(const QString& str, const QString& text,
+                              int& pos, int& score)
+{
+	const QChar* strData = str.unicode();
+	const QChar* textData = text.unicode();
+	int last = -2;
+
+	for (int i = 0; (i < str.size()) && (pos < text.size()); i++) {
+		if (strData[i] != textData[pos])
+			continue;
+
+		score++;
+		if (i == last + 1)
+			score += ConsecutiveBonus;
+		if ((i == 0) || isBoundary(strData[i - 1]))
+			score += BoundaryBonus;
+
+		last = i;
+		pos++;
+	}
+}
+
+/**
+ * A file matching a search.
+ * Matches are ordered by decreasing score, then by the length of the base
+ * name, and finally by position in the index.
+ */
+struct PathMatch
+{
+	int score_;
+	int length_;
+	int index_;
+
+	bool operator<(const PathMatch& other) const {
+		if (score_ != other.score_)
+			return score_ > other.score_;
+
+		if (length_ != other.length_)
+			return length_ < other.length_;
+
+		return index_ < other.index_;
+	}
+};
+
+/**
+ * Class constructor.
+ */
+PathIndex::PathIndex()
+{
+}
+
+/**
+ * Class destructor.
+ */
+PathIndex::~PathIndex()
+{
+}
+
+/**
+ * Adds files to the index.
+ * Files that are already in the index are ignored.
+ * @param  fileList  The paths of the files to add
+ */
+void PathIndex::add(const QStringList& fileList)
+{
+	QWriteLocker locker(&lock_);
+
+	foreach (QString file, fileList) {
+		if (file.isEmpty() || (findEntry(file) >= 0))
+			continue;
+
+		Entry entry;
+		QString dir;
+		splitPath(file, dir, entry.name_);
+		entry.lowerName_ = entry.name_.toLower();
+
+		// Intern the directory.
+		QHash<QString, int>::ConstIterator itr = dirIds_.find(dir);
+		if (itr == dirIds_.end()) {
+			entry.dir_ = dirs_.size();
+			dirIds_.insert(dir, entry.dir_);
+			dirs_.append(dir);
+			lowerDirs_.append(dir.toLower());
+		}
+		else {
+			entry.dir_ = *itr;
+		}
+
+		names_.insert(entry.name_, entries_.size());
+		entries_.append(entry);
+	}
+}
+
+/**
+ * Removes files from the index.
+ * Files that are not in the index are ignored. Interned directories are kept,
+ * even if no files remain in them.
+ * @param  fileList  The paths of the files to remove
+ */
+void PathIndex::remove(const QStringList& fileList)
+{
+	QWriteLocker locker(&lock_);
+
+	foreach (QString file, fileList) {
+		int pos = findEntry(file);
+		if (pos < 0)
+			continue;
+
+		// Fill the hole with the last entry.
+		names_.remove(entries_[pos].name_, pos);
+		int last = entries_.size() - 1;
+		if (pos != last)
+			setEntryPos(last, pos);
+
+		entries_.resize(last);
+	}
+}
+
+/**
+ * Removes all files from the index.
+ */
+void PathIndex::clear()
+{
+	QWriteLocker locker(&lock_);
+
+	dirs_.clear();
+	lowerDirs_.clear();
+	dirIds_.clear();
+	entries_.clear();
+	names_.clear();
+}
+
+/**
+ * @return The number of files in the index
+ */
+int PathIndex::count() const
+{
+	QReadLocker locker(&lock_);
+	return entries_.size();
+}
+
+/**
+ * Finds the files best matching the given text.
+ * A file matches if the characters of the text appear in its path, in order
+ * (but not necessarily adjacent), ignoring case. Unless the text contains a
+ * separator, files are first matched by their base names. Matches are scored
+ * by the number of adjacent characters, and by the number of characters that
+ * start words.
+ * @param  text    The text to match
+ * @param  max     The maximal number of files to return
+ * @param  cancel  If not NULL, the search is abandoned once the pointed value
+ *                 becomes true
+ * @return The paths of the matching files, best matches first (an empty list
+ *         if the search was abandoned)
+ */
+QStringList PathIndex::match(const QString& text, int max,
+                             const volatile bool* cancel) const
+{
+	QStringList result;
+
+	if (text.isEmpty() || (max <= 0))
+		return result;
+
+	QString lowerText = text.toLower();
+	bool fullPath = lowerText.contains('/');
+
+	QReadLocker locker(&lock_);
+
+	QList<PathMatch> best;
+	for (int i = 0; i < entries_.size(); i++) {
+		if (cancel && ((i % CancelInterval) == 0) && *cancel)
+			return QStringList();
+
+		const Entry& entry = entries_[i];
+		PathMatch match;
+		int pos = 0;
+
+		match.score_ = 0;
+		if (!fullPath) {
+			matchChars(entry.lowerName_, lowerText, pos, match.score_);
+			if (pos == lowerText.size())
+				match.score_ += NameBonus;
+		}
+
+		// Match against the full path.
+		if (pos < lowerText.size()) {
+			pos = 0;
+			match.score_ = 0;
+			matchChars(lowerDirs_[entry.dir_], lowerText, pos, match.score_);
+			matchChars(entry.lowerName_, lowerText, pos, match.score_);
+			if (pos < lowerText.size())
+				continue;
+		}
+
+		match.length_ = entry.name_.size();
+		match.index_ = i;
+		if ((best.size() == max) && !(match < best.last()))
+			continue;
+
+		best.insert(qLowerBound(best.begin(), best.end(), match), match);
+		if (best.size() > max)
+			best.removeLast();
+	}
+
+	foreach (const PathMatch& match, best)
+		result.append(path(entries_[match.index_]));
+
+	return result;
+}
+
+/**
+ * Finds the files whose paths contain a match for a regular expression.
+ * @param  regExp  The expression to match
+ * @return The paths of the matching files, in sorted order
+ */
+QStringList PathIndex::find(const QRegExp& regExp) const
+{
+	QStringList result;
+
+	QReadLocker locker(&lock_);
+
+	foreach (const Entry& entry, entries_) {
+		QString file = path(entry);
+		if (regExp.indexIn(file) >= 0)
+			result.append(file);
+	}
+
+	locker.unlock();
+
+	result.sort();
+	return result;
+}
+
+/**
+ * Looks up a file.
+ * Must be called with the lock held.
+ * @param  file  The path of the file
+ * @return The position of the file in entries_, -1 if not found
+ */
+int PathIndex::findEntry(const QString& file) const
+{
+	QString dir, name;
+	splitPath(file, dir, name);
+
+	int dirId = dirIds_.value(dir, -1);
+	if (dirId < 0)
+		return -1;
+
+	QMultiHash<QString, int>::ConstIterator itr = names_.find(name);
+	for (; (itr != names_.end()) && (itr.key() == name); ++itr) {
+		if (entries_[*itr].dir_ == dirId)
+			return *itr;
+	}
+
+	return -1;
+}
+
+/**
+ * Moves an entry to a different position in entries_.
+ * Must be called with the write lock held.
+ * @param  from  The current position of the entry
+ * @param  to    The new position, whose entry is overwritten
+ */
+void PathIndex::setEntryPos(int from, int to)
+{
+	const QString& name = entries_[from].name_;
+	names_.remove(name, from);
+	names_.insert(name, to);
+	entries_[to] = entries_[from];
+}
+
+} // namespace Core
+
+} // namespace KScope
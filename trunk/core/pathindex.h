@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CORE_PATHINDEX_H__
+#define __CORE_PATHINDEX_H__
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QRegExp>
+#include <QStringList>
+#include <QVector>
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * An in-memory index of the paths of the files in a code base.
+ * Each path is split into its directory and base name. Directories are
+ * interned, so that a directory holding many files is stored once. Lower-case
+ * versions of the directories and base names are kept alongside, so that
+ * case-insensitive matching does not convert any strings.
+ * The index can be searched from any thread: a read-write lock allows
+ * concurrent searches, while the list of files is updated.
+ * @author Elad Lahav
+ */
+class PathIndex
+{
+public:
+	PathIndex();
+	~PathIndex();
+
+	void add(const QStringList&);
+	void remove(const QStringList&);
+	void clear();
+	int count() const;
+	QStringList match(const QString&, int,
+	                  const volatile bool* cancel = NULL) const;
+	QStringList find(const QRegExp&) const;
+
+private:
+	/**
+	 * A single file.
+	 */
+	struct Entry
+	{
+		/**
+		 * The position of the file's directory in dirs_.
+		 */
+		int dir_;
+
+		/**
+		 * The base name of the file.
+		 */
+		QString name_;
+
+		/**
+		 * The base name, in lower case.
+		 */
+		QString lowerName_;
+	};
+
+	/**
+	 * Interned directories, each ending with a separator.
+	 */
+	QStringList dirs_;
+
+	/**
+	 * The interned directories, in lower case.
+	 */
+	QStringList lowerDirs_;
+
+	/**
+	 * Maps each directory to its position in dirs_.
+	 */
+	QHash<QString, int> dirIds_;
+
+	/**
+	 * All files, in no particular order.
+	 */
+	QVector<Entry> entries_;
+
+	/**
+	 * Maps base names to the positions of the files in entries_.
+	 */
+	QMultiHash<QString, int> names_;
+
+	/**
+	 * Protects the index against updates during searches.
+	 */
+	mutable QReadWriteLock lock_;
+
+	int findEntry(const QString&) const;
+	void setEntryPos(int, int);
+
+	/**
+	 * @param  entry  A file in the index
+	 * @return The full path of the file
+	 */
+	QString path(const Entry& entry) const {
+		return dirs_[entry.dir_] + entry.name_;
+	}
+};
+
+} // namespace Core
+
+} // namespace KScope
+
+#endif // __CORE_PATHINDEX_H__
@@ -26,7 +26,7 @@ namespace KScope
 namespace Core
 {
 
-Process::Process(QObject* parent) : QProcess(parent)
+Process::Process(QObject* parent) : QProcess(parent), stats_(NULL)
 {
 	connect(this, SIGNAL(readyReadStandardOutput()), this,
 	        SLOT(readStandardOutput()));
@@ -50,15 +50,39 @@ void Process::setDeleteOnExit()
 void Process::readStandardOutput()
 {
 	// Read from standard output.
-	stdOut_ += readAllStandardOutput();
+	QByteArray data = readAllStandardOutput();
 
-	// Parse the text.
-	if (!parse(stdOut_)) {
+	if (stats_) {
+		stats_->mark(QueryStats::FirstOutput);
+		stats_->bytesRead_ += data.size();
+	}
+
+	// Parse the output.
+	QTime parseTimer;
+	parseTimer.start();
+	bool ok = parseOutput(data);
+	if (stats_)
+		stats_->parseTime_ += parseTimer.elapsed();
+
+	if (!ok) {
 		emit parseError();
 		return;
 	}
 }
 
+/**
+ * Parses output read from the process.
+ * The default implementation passes the output, as text, to the state machine.
+ * Sub-classes reading output that is not line-oriented text override it.
+ * @param  data  The output read
+ * @return true if parsing was successful, false otherwise
+ */
+bool Process::parseOutput(const QByteArray& data)
+{
+	stdOut_ += data;
+	return parse(stdOut_);
+}
+
 void Process::readStandardError()
 {
 	qDebug() << readAllStandardError();
@@ -77,6 +101,9 @@ void Process::handleError(QProcess::ProcessError code)
 void Process::handleStateChange(QProcess::ProcessState state)
 {
 	qDebug() << "Process state" << state;
+	if (state == QProcess::Running && stats_)
+		stats_->mark(QueryStats::ProcessStarted);
+
 	if (state == QProcess::NotRunning && deleteOnExit_)
 		deleteLater();
 }
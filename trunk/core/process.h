@@ -23,6 +23,7 @@
 
 #include <QProcess>
 #include "statemachine.h"
+#include "querystats.h"
 
 namespace KScope
 {
@@ -52,6 +53,17 @@ protected slots:
 	virtual void handleError(QProcess::ProcessError);
 	virtual void handleStateChange(QProcess::ProcessState);
 
+protected:
+	virtual bool parseOutput(const QByteArray&);
+
+	/**
+	 * Performance information on the current operation, NULL if no
+	 * information is collected.
+	 * Sub-classes set this object from their connection when starting an
+	 * operation, and record phases and counters specific to their output.
+	 */
+	QueryStats* stats_;
+
 private:
 	QString stdOut_;
 	bool deleteOnExit_;
@@ -0,0 +1,651 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include <QSet>
+#include <QThread>
+#include "queryscheduler.h"
+#include "exception.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * The maximal number of results kept by a running operation for connections
+ * that attach to it later.
+ */
+static const int MaxCatchUp = 10000;
+
+/**
+ * A single query operation on the wrapped engine.
+ * The job serves as the engine's connection for the operation, and forwards
+ * everything it receives to the connections attached to it.
+ * Since the engine may still access the job after reporting its termination,
+ * jobs are always deleted through deleteLater().
+ */
+struct QueryScheduler::Job : public QObject, public Engine::Connection
+{
+	Job(QueryScheduler* sched, const Query& query, Priority priority,
+	    int batch)
+		: QObject(), Engine::Connection(priority), sched_(sched),
+		  query_(query), batch_(batch), started_(false), catchUp_(true) {
+		record_.start(query);
+		setStats(&record_);
+	}
+
+	void onDataReady(const LocationList&);
+	void onFinished();
+	void onAborted();
+	void onProgress(const QString&, uint, uint);
+
+	/**
+	 * The owning scheduler, NULL if the scheduler was deleted while the
+	 * operation was running.
+	 */
+	QueryScheduler* sched_;
+
+	/**
+	 * The query to run.
+	 */
+	Query query_;
+
+	/**
+	 * Identifies the batch in which the query was scheduled, 0 if it was
+	 * scheduled on its own.
+	 * Jobs of the same batch are passed to the engine together.
+	 */
+	int batch_;
+
+	/**
+	 * Whether the query was passed to the engine.
+	 */
+	bool started_;
+
+	/**
+	 * Connections attached to this operation.
+	 */
+	QList<Waiter*> waiters_;
+
+	/**
+	 * Whether results_ holds all results received so far, so that new
+	 * connections can still be attached to the operation.
+	 */
+	bool catchUp_;
+
+	/**
+	 * Results received so far, passed to connections that are attached
+	 * after the operation has started.
+	 * The results are dropped once there are more than MaxCatchUp of them,
+	 * and identical queries then start operations of their own.
+	 */
+	LocationList results_;
+
+	/**
+	 * Performance information for the operation.
+	 */
+	QueryStats record_;
+};
+
+/**
+ * Attaches a connection to a job.
+ * Serves as the connection's controlled object, so that stopping the
+ * connection only detaches it from the job.
+ */
+struct QueryScheduler::Waiter : public Engine::Controlled
+{
+	Waiter(QueryScheduler* sched, Connection* conn, Job* job)
+		: sched_(sched), conn_(conn), job_(job) {}
+
+	void stop() { sched_->cancel(conn_, true); }
+
+	QueryScheduler* sched_;
+	Connection* conn_;
+	Job* job_;
+};
+
+/**
+ * Tracks a build operation, so that the number of concurrent queries can be
+ * reduced while it runs.
+ * Stopping the caller's connection stops the build.
+ */
+struct QueryScheduler::BuildJob : public QObject, public Engine::Connection,
+                                  public Engine::Controlled
+{
+	BuildJob(QueryScheduler* sched, Connection* conn)
+		: QObject(), Engine::Connection(), sched_(sched), conn_(conn) {
+		conn_->setCtrlObject(this);
+	}
+
+	void stop() { Engine::Connection::stop(); }
+
+	void onDataReady(const LocationList& locList) {
+		conn_->onDataReady(locList);
+	}
+
+	void onFinished() { done(true); }
+	void onAborted() { done(false); }
+
+	void onProgress(const QString& text, uint cur, uint total) {
+		conn_->onProgress(text, cur, total);
+	}
+
+	void done(bool ok) {
+		if (sched_)
+			sched_->buildDone(this);
+
+		conn_->setCtrlObject(NULL);
+		if (ok)
+			conn_->onFinished();
+		else
+			conn_->onAborted();
+
+		deleteLater();
+	}
+
+	QueryScheduler* sched_;
+	Connection* conn_;
+};
+
+/**
+ * Passes results to all attached connections.
+ * @param  locList  Query results
+ */
+void QueryScheduler::Job::onDataReady(const LocationList& locList)
+{
+	record_.results_ += locList.size();
+	if (catchUp_) {
+		results_ += locList;
+		if (results_.size() > MaxCatchUp) {
+			results_.clear();
+			catchUp_ = false;
+		}
+	}
+
+	// Iterate over a copy, as connections may detach themselves.
+	QTime timer;
+	timer.start();
+	QList<Waiter*> waiters = waiters_;
+	foreach (Waiter* waiter, waiters) {
+		if (waiters_.contains(waiter))
+			waiter->conn_->onDataReady(locList);
+	}
+	record_.insertTime_ += timer.elapsed();
+}
+
+/**
+ * Passes progress information to all attached connections.
+ * @param  text  Progress message
+ * @param  cur   Current value
+ * @param  total Expected final value
+ */
+void QueryScheduler::Job::onProgress(const QString& text, uint cur,
+                                     uint total)
+{
+	QList<Waiter*> waiters = waiters_;
+	foreach (Waiter* waiter, waiters) {
+		if (waiters_.contains(waiter))
+			waiter->conn_->onProgress(text, cur, total);
+	}
+}
+
+void QueryScheduler::Job::onFinished()
+{
+	if (sched_)
+		sched_->jobDone(this, true);
+	else
+		deleteLater();
+}
+
+void QueryScheduler::Job::onAborted()
+{
+	if (sched_)
+		sched_->jobDone(this, false);
+	else
+		deleteLater();
+}
+
+/**
+ * Class constructor.
+ * @param  engine  The engine to forward requests to
+ * @param  parent  Parent object
+ */
+QueryScheduler::QueryScheduler(Engine* engine, QObject* parent)
+	: Engine(parent), engine_(engine),
+	  maxActive_(qMax(2, QThread::idealThreadCount())), lastBatch_(0),
+	  statsLog_(NULL)
+{
+}
+
+/**
+ * Class destructor.
+ * Waiting queries are discarded, and running ones are stopped. Connections
+ * are detached without notification.
+ */
+QueryScheduler::~QueryScheduler()
+{
+	foreach (Waiter* waiter, waiters_)
+		waiter->conn_->setCtrlObject(NULL);
+	qDeleteAll(waiters_);
+
+	for (int i = Connection::Interactive; i <= Connection::Background; i++)
+		qDeleteAll(pending_[i]);
+
+	// Running jobs delete themselves once the engine is done with them.
+	foreach (Job* job, active_) {
+		job->sched_ = NULL;
+		job->waiters_.clear();
+		job->stop();
+	}
+
+	foreach (BuildJob* build, builds_)
+		build->sched_ = NULL;
+}
+
+/**
+ * Opens the wrapped engine.
+ * @param  initString  Implementation-specific string
+ * @param  cb          Called when the engine is ready
+ */
+void QueryScheduler::open(const QString& initString, Callback<>* cb)
+{
+	engine_->open(initString, cb);
+}
+
+/**
+ * @return The status of the wrapped engine
+ */
+Engine::Status QueryScheduler::status() const
+{
+	return engine_->status();
+}
+
+/**
+ * @param  type  The requested query type
+ * @return The fields filled by the wrapped engine for this query type
+ */
+QList<Location::Fields> QueryScheduler::queryFields(Query::Type type) const
+{
+	return engine_->queryFields(type);
+}
+
+/**
+ * @param  text  The partial name
+ * @param  mode  How to match names against the text
+ * @param  max   The maximal number of names to return
+ * @return The names found by the wrapped engine
+ */
+QStringList QueryScheduler::completions(const QString& text, MatchMode mode,
+                                        int max) const
+{
+	return engine_->completions(text, mode, max);
+}
+
+/**
+ * @return The number of operations running on the wrapped engine (a batch of
+ *         queries is a single operation)
+ */
+int QueryScheduler::activeCount() const
+{
+	int count = 0;
+	QSet<int> batches;
+	foreach (Job* job, active_) {
+		if (job->batch_ == 0)
+			count++;
+		else
+			batches.insert(job->batch_);
+	}
+
+	return count + batches.size();
+}
+
+/**
+ * Changes the number of queries that can run at the same time.
+ * @param  maxActive  The new limit (at least 1)
+ */
+void QueryScheduler::setMaxActive(int maxActive)
+{
+	maxActive_ = qMax(1, maxActive);
+	dispatchSafe();
+}
+
+/**
+ * Schedules a query.
+ * The method is const as required by the Engine interface: it does not
+ * affect the database, only the scheduler's queues.
+ * @param  conn   Used for communication with the ongoing operation
+ * @param  query  The query to execute
+ * @throw  Exception
+ */
+void QueryScheduler::query(Connection* conn, const Query& query) const
+{
+	const_cast<QueryScheduler*>(this)->schedule(conn, query);
+}
+
+/**
+ * Schedules a batch of queries.
+ * Queries in the batch that are not identical to ones already waiting or
+ * running are passed to the wrapped engine together, when the first of them
+ * is started.
+ * @param  batch  The queries to execute
+ * @throw  Exception
+ */
+void QueryScheduler::queryBatch(const QList<BatchQuery>& batch) const
+{
+	const_cast<QueryScheduler*>(this)->scheduleBatch(batch);
+}
+
+/**
+ * Starts a build on the wrapped engine.
+ * @param  conn  Used for communication with the ongoing operation
+ * @throw  Exception
+ */
+void QueryScheduler::build(Connection* conn) const
+{
+	const_cast<QueryScheduler*>(this)->startBuild(conn);
+}
+
+/**
+ * Schedules a single query.
+ * @param  conn   The connection to attach
+ * @param  query  The query to execute
+ * @throw  Exception
+ */
+void QueryScheduler::schedule(Connection* conn, const Query& query)
+{
+	attach(conn, query, 0);
+	dispatch();
+}
+
+/**
+ * Schedules a batch of queries.
+ * The queries are all queued before any of them is started, so that they
+ * are passed to the engine in a single call.
+ * @param  batch  The queries to execute
+ * @throw  Exception
+ */
+void QueryScheduler::scheduleBatch(const QList<BatchQuery>& batch)
+{
+	int id = ++lastBatch_;
+	foreach (const BatchQuery& bq, batch)
+		attach(bq.conn_, bq.query_, id);
+
+	dispatch();
+}
+
+/**
+ * Attaches a connection to an operation for the given query, creating a new
+ * one if no identical query is waiting or running.
+ * @param  conn   The connection to attach
+ * @param  query  The query to execute
+ * @param  batch  Identifies the batch of a new operation (0 for none)
+ */
+void QueryScheduler::attach(Connection* conn, const Query& query, int batch)
+{
+	// A new query supersedes any previous one on the same connection.
+	cancel(conn, false);
+
+	Connection::Priority priority = conn->priority();
+	Job* job = findJob(query);
+	if (job) {
+		// Promote a waiting job, if required.
+		if (!job->started_ && priority < job->priority()) {
+			pending_[job->priority()].removeAll(job);
+			job->setPriority(priority);
+			pending_[priority].append(job);
+		}
+	}
+	else {
+		job = new Job(this, query, priority, batch);
+		pending_[priority].append(job);
+	}
+
+	Waiter* waiter = new Waiter(this, conn, job);
+	job->waiters_.append(waiter);
+	waiters_.insert(conn, waiter);
+	conn->setCtrlObject(waiter);
+
+	// Catch up with an operation that is already running.
+	if (!job->results_.isEmpty())
+		conn->onDataReady(job->results_);
+}
+
+/**
+ * Starts a build on the wrapped engine.
+ * @param  conn  Used for communication with the ongoing operation
+ * @throw  Exception
+ */
+void QueryScheduler::startBuild(Connection* conn)
+{
+	BuildJob* build = new BuildJob(this, conn);
+	builds_.append(build);
+
+	try {
+		engine_->build(build);
+	}
+	catch (Exception* e) {
+		builds_.removeAll(build);
+		conn->setCtrlObject(NULL);
+		delete build;
+		throw e;
+	}
+}
+
+/**
+ * Detaches a connection from its operation.
+ * A waiting operation with no more connections is discarded, while a running
+ * one is stopped.
+ * @param  conn    The connection to detach
+ * @param  notify  true to call the connection's onAborted() method
+ */
+void QueryScheduler::cancel(Connection* conn, bool notify)
+{
+	Waiter* waiter = waiters_.take(conn);
+	if (waiter == NULL)
+		return;
+
+	Job* job = waiter->job_;
+	job->waiters_.removeAll(waiter);
+	conn->setCtrlObject(NULL);
+	delete waiter;
+
+	if (job->waiters_.isEmpty()) {
+		if (job->started_) {
+			// The engine reports termination through jobDone().
+			job->stop();
+		}
+		else {
+			pending_[job->priority()].removeAll(job);
+			delete job;
+		}
+	}
+
+	if (notify)
+		conn->onAborted();
+}
+
+/**
+ * Starts waiting queries, as long as the number of running queries is below
+ * the limit.
+ * @throw  Exception
+ */
+void QueryScheduler::dispatch()
+{
+	// Leave the disk to the build process.
+	int limit = builds_.isEmpty() ? maxActive_ : 1;
+
+	while (activeCount() < limit) {
+		// Get the first job of the highest non-empty priority.
+		Job* job = NULL;
+		for (int i = Connection::Interactive; i <= Connection::Background;
+		     i++) {
+			if (!pending_[i].isEmpty()) {
+				job = pending_[i].takeFirst();
+				break;
+			}
+		}
+
+		if (job == NULL)
+			break;
+
+		// Take the rest of the job's batch, regardless of priority.
+		QList<Job*> jobs;
+		jobs.append(job);
+		if (job->batch_ != 0) {
+			for (int i = Connection::Interactive;
+			     i <= Connection::Background; i++) {
+				foreach (Job* other, pending_[i]) {
+					if (other->batch_ == job->batch_) {
+						pending_[i].removeAll(other);
+						jobs.append(other);
+					}
+				}
+			}
+		}
+
+		QList<BatchQuery> batch;
+		foreach (Job* started, jobs) {
+			active_.append(started);
+			started->started_ = true;
+			started->record_.mark(QueryStats::Started);
+			batch.append(BatchQuery(started, started->query_));
+		}
+
+		try {
+			if (batch.size() == 1)
+				engine_->query(job, job->query_);
+			else
+				engine_->queryBatch(batch);
+		}
+		catch (Exception* e) {
+			foreach (Job* started, jobs) {
+				if (active_.removeAll(started) > 0)
+					finish(started, false);
+			}
+			throw e;
+		}
+	}
+}
+
+/**
+ * A version of dispatch() for calls that do not originate with a caller
+ * that can handle exceptions.
+ */
+void QueryScheduler::dispatchSafe()
+{
+	try {
+		dispatch();
+	}
+	catch (Exception* e) {
+		e->showMessage();
+		delete e;
+	}
+}
+
+/**
+ * Looks for a waiting or running job for the given query.
+ * Jobs with no attached connections are being stopped, and are ignored, as
+ * are jobs that no longer keep their results for new connections.
+ * @param  query  The query to look for
+ * @return The matching job, NULL if none was found
+ */
+QueryScheduler::Job* QueryScheduler::findJob(const Query& query) const
+{
+	QList<Job*> jobs = active_;
+	for (int i = Connection::Interactive; i <= Connection::Background; i++)
+		jobs += pending_[i];
+
+	foreach (Job* job, jobs) {
+		if (job->query_.type_ == query.type_
+		    && job->query_.flags_ == query.flags_
+		    && job->query_.pattern_ == query.pattern_
+		    && !job->waiters_.isEmpty()
+		    && job->catchUp_) {
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Called when the engine terminates a query.
+ * Starts the next waiting query, and then notifies the attached connections.
+ * @param  job  The terminated job
+ * @param  ok   Whether the query terminated normally
+ */
+void QueryScheduler::jobDone(Job* job, bool ok)
+{
+	active_.removeAll(job);
+	dispatchSafe();
+	finish(job, ok);
+}
+
+/**
+ * Detaches all connections from a job, notifying them of its termination, and
+ * deletes the job.
+ * @param  job  The terminated job
+ * @param  ok   Whether the query terminated normally
+ */
+void QueryScheduler::finish(Job* job, bool ok)
+{
+	QList<Waiter*> waiters = job->waiters_;
+	job->waiters_.clear();
+	foreach (Waiter* waiter, waiters) {
+		waiters_.remove(waiter->conn_);
+		waiter->conn_->setCtrlObject(NULL);
+	}
+
+	// Connections may start new queries from these calls.
+	foreach (Waiter* waiter, waiters) {
+		if (ok)
+			waiter->conn_->onFinished();
+		else
+			waiter->conn_->onAborted();
+
+		delete waiter;
+	}
+
+	// Record performance information for operations that reached the
+	// engine.
+	if (job->started_ && statsLog_) {
+		job->record_.mark(QueryStats::Finished);
+		job->record_.aborted_ = job->record_.aborted_ || !ok;
+		statsLog_->add(job->record_);
+	}
+
+	job->deleteLater();
+}
+
+/**
+ * Called when a build operation terminates.
+ * Restores the concurrency limit for queries.
+ * @param  build  The terminated build
+ */
+void QueryScheduler::buildDone(BuildJob* build)
+{
+	builds_.removeAll(build);
+	dispatchSafe();
+}
+
+} // namespace Core
+
+} // namespace KScope
@@ -0,0 +1,168 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CORE_QUERYSCHEDULER_H__
+#define __CORE_QUERYSCHEDULER_H__
+
+#include <QHash>
+#include "engine.h"
+#include "querystats.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * Controls the execution of queries on an engine.
+ * The scheduler is an engine in its own right, which forwards all requests to
+ * the engine it wraps. Queries, however, are not started immediately:
+ * - At most maxActive() queries run at the same time (only one while the
+ *   database is being built). The rest wait in a queue, and are started
+ *   according to the priority of their connection (see
+ *   Engine::Connection::Priority), and in order of arrival within the same
+ *   priority.
+ * - A query that is identical to one already waiting or running (same type,
+ *   pattern and flags) does not start a new operation. Instead, the connection
+ *   is attached to the existing operation, and all attached connections
+ *   receive the same results. A running operation only keeps a limited
+ *   number of results for connections attached later; once it has more, it
+ *   takes no new connections.
+ * - The queries of a batch (see Engine::queryBatch()) are started together,
+ *   as a single operation of the wrapped engine, once the first of them is
+ *   due to start. Queries that are identical to ones already waiting or
+ *   running are attached to the existing operations instead.
+ * - Starting a new query on a connection cancels any query previously started
+ *   on that connection. The connection is detached from the operation, which
+ *   is stopped if no other connection waits for it.
+ * Calling stop() on a connection only affects that connection: it is detached
+ * from its operation (which is stopped if left with no connections), and
+ * receives an onAborted() call.
+ * Performance information is collected for every query operation, and handed
+ * to a QueryStatsLog object, if one was set.
+ * @author Elad Lahav
+ */
+class QueryScheduler : public Engine
+{
+	Q_OBJECT
+
+public:
+	QueryScheduler(Engine*, QObject* parent = NULL);
+	~QueryScheduler();
+
+	virtual void open(const QString&, Callback<>*);
+	virtual Status status() const;
+	virtual QList<Location::Fields> queryFields(Query::Type) const;
+	virtual QStringList completions(const QString&, MatchMode, int) const;
+
+	void setMaxActive(int);
+
+	/**
+	 * @param  log  Receives performance information on finished queries
+	 *              (NULL to discard the information)
+	 */
+	void setStatsLog(QueryStatsLog* log) { statsLog_ = log; }
+
+	/**
+	 * @return The maximal number of queries running at the same time
+	 */
+	int maxActive() const { return maxActive_; }
+
+	/**
+	 * @return The number of queries waiting to be started
+	 */
+	int pendingCount() const {
+		return pending_[Connection::Interactive].size()
+		       + pending_[Connection::TreeExpansion].size()
+		       + pending_[Connection::Background].size();
+	}
+
+	int activeCount() const;
+
+public slots:
+	virtual void query(Connection*, const Query&) const;
+	virtual void queryBatch(const QList<BatchQuery>&) const;
+	virtual void build(Connection*) const;
+
+private:
+	struct Job;
+	struct Waiter;
+	struct BuildJob;
+
+	/**
+	 * The engine executing the operations.
+	 */
+	Engine* engine_;
+
+	/**
+	 * The maximal number of queries running at the same time.
+	 */
+	int maxActive_;
+
+	/**
+	 * The identifier given to the last scheduled batch of queries.
+	 */
+	int lastBatch_;
+
+	/**
+	 * Queries waiting to be started, one queue per priority.
+	 */
+	QList<Job*> pending_[Connection::Background + 1];
+
+	/**
+	 * Running queries.
+	 */
+	QList<Job*> active_;
+
+	/**
+	 * Maps each connection waiting for query results to its attachment
+	 * object.
+	 */
+	QHash<Connection*, Waiter*> waiters_;
+
+	/**
+	 * Running build operations.
+	 */
+	QList<BuildJob*> builds_;
+
+	/**
+	 * Receives performance information on finished queries.
+	 */
+	QueryStatsLog* statsLog_;
+
+	void schedule(Connection*, const Query&);
+	void scheduleBatch(const QList<BatchQuery>&);
+	void attach(Connection*, const Query&, int);
+	void startBuild(Connection*);
+	void cancel(Connection*, bool);
+	void dispatch();
+	void dispatchSafe();
+	Job* findJob(const Query&) const;
+	void jobDone(Job*, bool);
+	void finish(Job*, bool);
+	void buildDone(BuildJob*);
+};
+
+} // namespace Core
+
+} // namespace KScope
+
+#endif // __CORE_QUERYSCHEDULER_H__
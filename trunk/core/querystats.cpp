@@ -0,0 +1,268 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QTextStream>
+#include "querystats.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * Struct constructor.
+ */
+QueryStats::QueryStats()
+	: parseTime_(0), insertTime_(0), bytesRead_(0), linesParsed_(0),
+	  results_(0), aborted_(false)
+{
+	for (int i = 0; i < PhaseCount; i++)
+		time_[i] = -1;
+}
+
+/**
+ * Starts measuring a query.
+ * @param  query  The query to measure
+ */
+void QueryStats::start(const Query& query)
+{
+	query_ = query;
+	startTime_ = QDateTime::currentDateTime();
+	timer_.start();
+	time_[Queued] = 0;
+}
+
+/**
+ * Computes the time between two phases.
+ * @param  from  The first phase
+ * @param  to    The second phase
+ * @return The time, in milliseconds, -1 if either phase was not reached
+ */
+int QueryStats::elapsed(Phase from, Phase to) const
+{
+	if (time_[from] < 0 || time_[to] < 0)
+		return -1;
+
+	return time_[to] - time_[from];
+}
+
+/**
+ * Provides a fixed (untranslated) name for each query type, for use in log
+ * files.
+ * @param  type  The query type
+ * @return The name of the type
+ */
+QString QueryStats::typeKey(Query::Type type)
+{
+	switch (type) {
+	case Query::Text:
+		return "text";
+
+	case Query::Definition:
+		return "definition";
+
+	case Query::References:
+		return "references";
+
+	case Query::CalledFunctions:
+		return "called";
+
+	case Query::CallingFunctions:
+		return "calling";
+
+	case Query::FindFile:
+		return "findfile";
+
+	case Query::IncludingFiles:
+		return "including";
+
+	case Query::LocalTags:
+		return "localtags";
+
+	default:
+		;
+	}
+
+	return "invalid";
+}
+
+/**
+ * Class constructor.
+ * @param  parent  Parent object
+ */
+QueryStatsLog::QueryStatsLog(QObject* parent) : QObject(parent),
+	maxLogSize_(0)
+{
+}
+
+/**
+ * Class destructor.
+ */
+QueryStatsLog::~QueryStatsLog()
+{
+}
+
+/**
+ * Determines the file to which records are appended.
+ * @param  path     The path of the log file, empty to stop logging
+ * @param  maxSize  The size beyond which the file is rotated
+ */
+void QueryStatsLog::setLogFile(const QString& path, qint64 maxSize)
+{
+	logPath_ = path;
+	maxLogSize_ = maxSize;
+}
+
+/**
+ * Adds a record for a finished query.
+ * @param  stats  The query's performance information
+ */
+void QueryStatsLog::add(const QueryStats& stats)
+{
+	int type = stats.query_.type_;
+	counts_[type]++;
+
+	// Only queries that terminated normally count towards latency figures.
+	if (!stats.aborted_ && stats.latency() >= 0) {
+		QList<int>& window = latencies_[type];
+		window.append(stats.latency());
+		if (window.size() > WindowSize)
+			window.removeFirst();
+	}
+
+	recent_.append(stats);
+	if (recent_.size() > RecentSize)
+		recent_.removeFirst();
+
+	writeLog(stats);
+	emit added(stats);
+}
+
+/**
+ * Discards all collected information.
+ * The log file is not affected.
+ */
+void QueryStatsLog::clear()
+{
+	latencies_.clear();
+	counts_.clear();
+	recent_.clear();
+}
+
+/**
+ * Computes latency percentiles for a query type, using the nearest-rank
+ * method.
+ * @param  type  The query type
+ * @return Latency figures for the type (all 0 if no query of this type
+ *         finished)
+ */
+QueryStatsLog::Summary QueryStatsLog::summary(Query::Type type) const
+{
+	Summary summary;
+	summary.count_ = counts_.value(type, 0);
+	summary.p50_ = summary.p90_ = summary.p99_ = summary.max_ = 0;
+
+	QList<int> window = latencies_.value(type);
+	if (window.isEmpty())
+		return summary;
+
+	qSort(window);
+	int n = window.size();
+	summary.p50_ = window[qMax(0, (n * 50 + 99) / 100 - 1)];
+	summary.p90_ = window[qMax(0, (n * 90 + 99) / 100 - 1)];
+	summary.p99_ = window[qMax(0, (n * 99 + 99) / 100 - 1)];
+	summary.max_ = window.last();
+	return summary;
+}
+
+/**
+ * @return All query types for which records were added, in order
+ */
+QList<Query::Type> QueryStatsLog::types() const
+{
+	QList<int> keys = counts_.keys();
+	qSort(keys);
+
+	QList<Query::Type> types;
+	foreach (int key, keys)
+		types.append(static_cast<Query::Type>(key));
+
+	return types;
+}
+
+/**
+ * Appends a record to the log file.
+ * Each record is a single line of tab-separated fields, in the order given by
+ * the header line written at the top of the file.
+ * @param  stats  The record to write
+ */
+void QueryStatsLog::writeLog(const QueryStats& stats)
+{
+	if (logPath_.isEmpty())
+		return;
+
+	// Rotate the log file.
+	QFileInfo fi(logPath_);
+	if (fi.exists() && maxLogSize_ > 0 && fi.size() > maxLogSize_) {
+		QFile::remove(logPath_ + ".1");
+		QFile::rename(logPath_, logPath_ + ".1");
+	}
+
+	QFile file(logPath_);
+	bool isNew = !file.exists();
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+		return;
+
+	QTextStream str(&file);
+	if (isNew) {
+		str << "# time\ttype\tstatus\tqueue\tstart\topen\tsearch\ttransfer"
+		       "\tdeliver\ttotal\tparse\tinsert\tbytes\tlines\tresults"
+		       "\tpattern\n";
+	}
+
+	str << stats.startTime_.toString(Qt::ISODate) << '\t'
+	    << QueryStats::typeKey(stats.query_.type_) << '\t'
+	    << (stats.aborted_ ? "aborted" : "ok") << '\t'
+	    << stats.elapsed(QueryStats::Queued, QueryStats::Started) << '\t'
+	    << stats.elapsed(QueryStats::Started, QueryStats::ProcessStarted)
+	    << '\t'
+	    << stats.elapsed(QueryStats::ProcessStarted, QueryStats::FirstOutput)
+	    << '\t'
+	    << stats.elapsed(QueryStats::FirstOutput, QueryStats::SearchDone)
+	    << '\t'
+	    << stats.elapsed(QueryStats::SearchDone, QueryStats::Exited) << '\t'
+	    << stats.elapsed(QueryStats::Exited, QueryStats::Finished) << '\t'
+	    << stats.latency() << '\t'
+	    << stats.parseTime_ << '\t'
+	    << stats.insertTime_ << '\t'
+	    << stats.bytesRead_ << '\t'
+	    << stats.linesParsed_ << '\t'
+	    << stats.results_ << '\t'
+	    << QString(stats.query_.pattern_).replace(QRegExp("[\t\n]"), " ")
+	    << '\n';
+}
+
+} // namespace Core
+
+} // namespace KScope
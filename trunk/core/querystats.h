@@ -0,0 +1,234 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CORE_QUERYSTATS_H__
+#define __CORE_QUERYSTATS_H__
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QTime>
+#include "globals.h"
+
+namespace KScope
+{
+
+namespace Core
+{
+
+/**
+ * Performance information for a single query.
+ * The object is attached to the engine's connection (see
+ * Engine::Connection::stats()), and each component handling the query records
+ * the time at which it reaches a phase, as well as the amount of work done.
+ * Times are measured in milliseconds from the moment the query was accepted.
+ * @author Elad Lahav
+ */
+struct QueryStats
+{
+	/**
+	 * Query phases, in order.
+	 */
+	enum Phase {
+		/** The query was accepted. */
+		Queued,
+		/** The query was passed to the engine. */
+		Started,
+		/** The engine's process is running. */
+		ProcessStarted,
+		/** First output was received (the database is open). */
+		FirstOutput,
+		/** The engine has finished searching. */
+		SearchDone,
+		/** The engine's process has terminated, and all output was read. */
+		Exited,
+		/** Results were delivered. */
+		Finished,
+		/** Number of phases (not a phase). */
+		PhaseCount
+	};
+
+	QueryStats();
+
+	void start(const Query&);
+
+	/**
+	 * Records the time at which a phase was reached.
+	 * Only the first call for each phase has an effect.
+	 * @param  phase  The reached phase
+	 */
+	void mark(Phase phase) {
+		if (time_[phase] < 0)
+			time_[phase] = timer_.elapsed();
+	}
+
+	int elapsed(Phase, Phase) const;
+
+	/**
+	 * @return The time from acceptance to delivery, -1 if the query did not
+	 *         finish
+	 */
+	int latency() const { return time_[Finished]; }
+
+	static QString typeKey(Query::Type);
+
+	/**
+	 * The query being measured.
+	 */
+	Query query_;
+
+	/**
+	 * The time at which the query was accepted.
+	 */
+	QDateTime startTime_;
+
+	/**
+	 * Measures time from the moment the query was accepted.
+	 */
+	QTime timer_;
+
+	/**
+	 * The time at which each phase was reached, -1 for phases that were not
+	 * reached.
+	 */
+	int time_[PhaseCount];
+
+	/**
+	 * Total time spent parsing engine output.
+	 */
+	int parseTime_;
+
+	/**
+	 * Total time spent adding results to views.
+	 */
+	int insertTime_;
+
+	/**
+	 * Number of bytes read from the engine.
+	 */
+	qint64 bytesRead_;
+
+	/**
+	 * Number of parsed output lines.
+	 */
+	uint linesParsed_;
+
+	/**
+	 * Number of results delivered.
+	 */
+	uint results_;
+
+	/**
+	 * Whether the query terminated abnormally.
+	 */
+	bool aborted_;
+};
+
+/**
+ * Collects performance information on finished queries.
+ * Keeps a window of recent latencies per query type, from which percentiles
+ * are computed, as well as the full information of the most recent queries.
+ * Each record is also appended to a log file, which is rotated (the old file
+ * is kept with a ".1" suffix) once it grows beyond a given size.
+ * @author Elad Lahav
+ */
+class QueryStatsLog : public QObject
+{
+	Q_OBJECT
+
+public:
+	QueryStatsLog(QObject* parent = NULL);
+	~QueryStatsLog();
+
+	/**
+	 * Latency figures for a query type.
+	 */
+	struct Summary
+	{
+		/**
+		 * Number of measured queries (including ones that are no longer
+		 * part of the window).
+		 */
+		uint count_;
+
+		/**
+		 * Latency percentiles over the window, in milliseconds.
+		 */
+		int p50_, p90_, p99_, max_;
+	};
+
+	void setLogFile(const QString&, qint64 maxSize = 1024 * 1024);
+	void add(const QueryStats&);
+	void clear();
+	Summary summary(Query::Type) const;
+	QList<Query::Type> types() const;
+
+	/**
+	 * @return The most recent records, oldest first
+	 */
+	const QList<QueryStats>& recent() const { return recent_; }
+
+	/**
+	 * Number of latencies kept per query type.
+	 */
+	static const int WindowSize = 1000;
+
+	/**
+	 * Number of full records kept.
+	 */
+	static const int RecentSize = 200;
+
+signals:
+	void added(const Core::QueryStats& stats);
+
+private:
+	/**
+	 * A window of recent latencies (in milliseconds) per query type.
+	 */
+	QHash<int, QList<int> > latencies_;
+
+	/**
+	 * The total number of queries measured, per type.
+	 */
+	QHash<int, uint> counts_;
+
+	/**
+	 * The most recent records, oldest first.
+	 */
+	QList<QueryStats> recent_;
+
+	/**
+	 * The path of the log file, empty if records are not written.
+	 */
+	QString logPath_;
+
+	/**
+	 * The size beyond which the log file is rotated.
+	 */
+	qint64 maxLogSize_;
+
+	void writeLog(const QueryStats&);
+};
+
+} // namespace Core
+
+} // namespace KScope
+
+#endif // __CORE_QUERYSTATS_H__
@@ -18,9 +18,11 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  ***************************************************************************/
 
+#include <QInputDialog>
 #include "queryview.h"
 #include "exception.h"
 #include "engine.h"
+#include "locationtreemodel.h"
 #include "progressbar.h"
 
 namespace KScope
@@ -29,13 +31,23 @@ namespace KScope
 namespace Core
 {
 
+/**
+ * The maximal number of siblings prefetched along with an expanded item.
+ */
+static const int MaxPrefetch = 16;
+
+/**
+ * The default number of levels expanded below an item by "Expand All Below".
+ */
+static const int ExpandDepth = 3;
+
 /**
  * Class constructor.
  * @param  parent  The parent widget
  * @param  type    Whether the view works in list or tree modes
  */
 QueryView::QueryView(QWidget* parent, Type type)
-	: LocationView(parent, type), progBar_(NULL),
+	: LocationView(parent, type), expander_(this), progBar_(NULL),
 	  autoSelectSingleResult_(false)
 {
 	// Query child items when expanded (in a tree view).
@@ -45,6 +57,10 @@ QueryView::QueryView(QWidget* parent, Type type)
 	}
 
 	menu_->addAction(tr("&Rerun Query"), this, SLOT(requery()));
+	if (type_ == Tree) {
+		menu_->addAction(tr("Expand All &Below"), this,
+		                 SLOT(expandAllBelow()));
+	}
 }
 
 /**
@@ -52,6 +68,10 @@ QueryView::QueryView(QWidget* parent, Type type)
  */
 QueryView::~QueryView()
 {
+	// Make sure the engine does not call into a deleted view.
+	expander_.stop();
+	stopItemQueries();
+	stop();
 }
 
 /**
@@ -60,6 +80,9 @@ QueryView::~QueryView()
 void QueryView::query(const Query& query)
 {
 	// Delete the model data.
+	expander_.stop();
+	stopItemQueries();
+	itemResults_.clear();
 	locationModel()->clear(QModelIndex());
 
 	try {
@@ -125,7 +148,7 @@ void QueryView::fromXML(const QDomElement& viewElem)
  */
 void QueryView::onDataReady(const LocationList& locList)
 {
-	locationModel()->add(locList, queryIndex_);
+	locationModel()->add(locList, QModelIndex());
 }
 
 /**
@@ -157,8 +180,8 @@ void QueryView::onProgress(const QString& text, uint cur, uint total)
 void QueryView::onFinished()
 {
 	// Handle an empty result set.
-	if (locationModel()->rowCount(queryIndex_) == 0)
-		locationModel()->add(LocationList(), queryIndex_);
+	if (locationModel()->rowCount(QModelIndex()) == 0)
+		locationModel()->add(LocationList(), QModelIndex());
 
 	// Destroy the progress-bar, if it exists.
 	if (progBar_) {
@@ -171,7 +194,8 @@ void QueryView::onFinished()
 
 	// Auto-select a single result, if required.
 	Location loc;
-	if (autoSelectSingleResult_ && locationModel()->rowCount(queryIndex_) == 1
+	if (autoSelectSingleResult_
+	    && locationModel()->rowCount(QModelIndex()) == 1
 	                            && locationModel()->firstLocation(loc)) {
 		emit locationRequested(loc);
 	}
@@ -201,37 +225,278 @@ void QueryView::onAborted()
 void QueryView::stopQuery()
 {
 	stop();
+
+	// Cancel an "Expand All Below" command.
+	if (expander_.isActive()) {
+		expander_.stop();
+		stopItemQueries();
+		expansionDone();
+	}
 }
 
 /**
  * Called when a tree item is expanded.
- * If this item was not queried before, a query is performed.
+ * If this item was not queried before, a query is performed. Siblings of the
+ * item that were not queried either are prefetched in the same batch, so that
+ * expanding them later on does not require waiting for a query.
  * @param  index  The expanded item (proxy index)
  */
 void QueryView::queryTreeItem(const QModelIndex& index)
 {
 	// Query previously-non-queried items only.
 	QModelIndex srcIndex = proxy()->mapToSource(index);
-	if (locationModel()->isEmpty(srcIndex) != LocationModel::Unknown)
+	if (!needsQuery(srcIndex))
 		return;
 
-	// Get the location information from the index.
-	Location loc;
-	if (!locationModel()->locationFromIndex(srcIndex, loc))
+	QList<QModelIndex> items;
+	items.append(srcIndex);
+	foreach (const QModelIndex& sibling, childItems(srcIndex.parent())) {
+		if (items.size() > MaxPrefetch)
+			break;
+
+		if (sibling != srcIndex && needsQuery(sibling))
+			items.append(sibling);
+	}
+
+	queryItems(items);
+}
+
+/**
+ * Expands the item for which the context menu was displayed, along with
+ * several levels below it.
+ * The user is asked for the number of levels.
+ */
+void QueryView::expandAllBelow()
+{
+	if (type_ != Tree || !menuIndex_.isValid())
+		return;
+
+	QModelIndex srcIndex = proxy()->mapToSource(menuIndex_);
+
+	bool ok;
+	int depth = QInputDialog::getInteger(this, tr("Expand All Below"),
+	                                     tr("Levels to expand:"),
+	                                     ExpandDepth, 1, 20, 1, &ok);
+	if (!ok)
 		return;
 
-	// Run a query on this location.
+	expander_.expand(srcIndex, depth);
+}
+
+/**
+ * @param  index  A tree item (source index)
+ * @return true if the item was neither queried nor is being queried, false
+ *         otherwise
+ */
+bool QueryView::needsQuery(const QModelIndex& index) const
+{
+	return locationModel()->isEmpty(index) == LocationModel::Unknown
+	       && findItemQuery(index) == NULL;
+}
+
+/**
+ * Determines whether a tree item repeats the function of one of its ancestors
+ * (including the function queried by the view).
+ * @param  index    A tree item (source index)
+ * @param  pattern  The item's function
+ * @return true if the function was already expanded above the item, false
+ *         otherwise
+ */
+bool QueryView::repeatsAncestor(const QModelIndex& index,
+                                const QString& pattern) const
+{
+	for (QModelIndex parent = index.parent(); parent.isValid();
+	     parent = parent.parent()) {
+		Location loc;
+		if (locationModel()->locationFromIndex(parent, loc)
+		    && loc.tag_.scope_ == pattern) {
+			return true;
+		}
+	}
+
+	return pattern == query_.pattern_;
+}
+
+/**
+ * @param  index  A tree item (source index)
+ * @return The item's children (source indices)
+ */
+QList<QModelIndex> QueryView::childItems(const QModelIndex& index) const
+{
+	QList<QModelIndex> children;
+	int rows = locationModel()->rowCount(index);
+	for (int row = 0; row < rows; row++)
+		children.append(locationModel()->index(row, 0, index));
+
+	return children;
+}
+
+/**
+ * Runs queries on several tree items, as a single batch.
+ * Items repeating one of their ancestors are marked as such, and items whose
+ * function was already queried get the stored results, without running a
+ * query.
+ * @param  items  The items to query (source indices)
+ */
+void QueryView::queryItems(const QList<QModelIndex>& items)
+{
+	QList<ItemConnection*> conns;
+
 	try {
 		Engine* eng;
-		if ((eng = engine()) != NULL) {
-			queryIndex_ = srcIndex;
-			eng->query(this, Query(query_.type_, loc.tag_.scope_));
+		if ((eng = engine()) == NULL)
+			return;
+
+		// Create a connection for each item that needs a query.
+		QList<Engine::BatchQuery> batch;
+		foreach (const QModelIndex& item, items) {
+			// Get the location information from the index.
+			Location loc;
+			if (!locationModel()->locationFromIndex(item, loc))
+				continue;
+
+			QString pattern = loc.tag_.scope_;
+			if (repeatsAncestor(item, pattern)) {
+				static_cast<LocationTreeModel*>(locationModel())
+					->markCycle(item);
+				expander_.itemDone(item);
+				continue;
+			}
+
+			if (itemResults_.contains(pattern)) {
+				locationModel()->add(itemResults_.value(pattern), item);
+				expander_.itemDone(item);
+				continue;
+			}
+
+			ItemConnection* conn = new ItemConnection(this, item, pattern);
+			itemConns_.append(conn);
+			conns.append(conn);
+			batch.append(Engine::BatchQuery(conn, Query(query_.type_,
+			                                            pattern)));
 		}
+
+		// Run the queries.
+		if (batch.size() == 1)
+			eng->query(batch.first().conn_, batch.first().query_);
+		else if (!batch.isEmpty())
+			eng->queryBatch(batch);
 	}
 	catch (Exception* e) {
 		e->showMessage();
 		delete e;
+
+		// Release connections the engine did not report on.
+		foreach (ItemConnection* conn, conns) {
+			if (itemConns_.contains(conn))
+				itemQueryDone(conn);
+		}
+	}
+}
+
+/**
+ * Called when an "Expand All Below" command ends.
+ */
+void QueryView::expansionDone()
+{
+	// Destroy the progress-bar, if it exists.
+	if (progBar_) {
+		delete progBar_;
+		progBar_ = NULL;
+	}
+
+	resizeColumns();
+}
+
+/**
+ * @param  index  A tree item (source index)
+ * @return The connection for a query running on this item, NULL if there is
+ *         none
+ */
+QueryView::ItemConnection* QueryView::findItemQuery(const QModelIndex& index)
+	const
+{
+	foreach (ItemConnection* conn, itemConns_) {
+		if (conn->index_ == index)
+			return conn;
+	}
+
+	return NULL;
+}
+
+/**
+ * Stops a query running on a tree item.
+ * @param  conn  The item's connection
+ */
+void QueryView::stopItemQuery(ItemConnection* conn)
+{
+	conn->stop();
+
+	// The engine may only report termination later on. Make sure that any
+	// results delivered by then are ignored.
+	if (itemConns_.removeAll(conn) > 0) {
+		expander_.itemDone(conn->index_);
+		conn->index_ = QPersistentModelIndex();
+	}
+}
+
+/**
+ * Stops all queries running on tree items.
+ */
+void QueryView::stopItemQueries()
+{
+	// Iterate over a copy, as stopping removes connections from the list.
+	QList<ItemConnection*> conns = itemConns_;
+	foreach (ItemConnection* conn, conns)
+		stopItemQuery(conn);
+}
+
+/**
+ * Called when a query on a tree item terminates.
+ * @param  conn  The item's connection
+ */
+void QueryView::itemQueryDone(ItemConnection* conn)
+{
+	itemConns_.removeAll(conn);
+	conn->deleteLater();
+
+	expander_.itemDone(conn->index_);
+}
+
+/**
+ * Adds query results under the queried item.
+ * @param  locList  Query results
+ */
+void QueryView::ItemConnection::onDataReady(const LocationList& locList)
+{
+	results_ += locList;
+
+	// The item may have been removed while the query was running.
+	if (index_.isValid())
+		view_->locationModel()->add(locList, index_);
+}
+
+/**
+ * Stores the results for other items of the same function, handles an empty
+ * result set, and adjusts the view's columns.
+ */
+void QueryView::ItemConnection::onFinished()
+{
+	view_->itemResults_.insert(pattern_, results_);
+
+	if (index_.isValid()) {
+		if (view_->locationModel()->rowCount(index_) == 0)
+			view_->locationModel()->add(LocationList(), index_);
+
+		view_->resizeColumns();
 	}
+
+	view_->itemQueryDone(this);
+}
+
+void QueryView::ItemConnection::onAborted()
+{
+	view_->itemQueryDone(this);
 }
 
 /**
@@ -251,6 +516,15 @@ void QueryView::requery()
 
 	// Tree view: rerun the current branch only.
 	QModelIndex srcIndex = proxy()->mapToSource(menuIndex_);
+	ItemConnection* conn = findItemQuery(srcIndex);
+	if (conn)
+		stopItemQuery(conn);
+
+	// Do not use stored results for the branch.
+	Location loc;
+	if (locationModel()->locationFromIndex(srcIndex, loc))
+		itemResults_.remove(loc.tag_.scope_);
+
 	locationModel()->clear(srcIndex);
 	queryTreeItem(menuIndex_);
 }
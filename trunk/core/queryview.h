@@ -21,9 +21,12 @@
 #ifndef __CORE_QUERYVIEW_H__
 #define __CORE_QUERYVIEW_H__
 
+#include <QHash>
+#include <QPersistentModelIndex>
 #include "locationview.h"
 #include "globals.h"
 #include "engine.h"
+#include "calltreeexpander.h"
 
 namespace KScope
 {
@@ -51,6 +54,15 @@ class ProgressBar;
  * Note that the tree view can only work with option 2, as the queryTreeItem()
  * method, connected to the expanded() signal, uses the engine to query run a
  * query on a child item.
+ * Each expanded item is queried through its own connection (with a
+ * TreeExpansion priority), so that several items can be queried at the same
+ * time. The item's siblings are prefetched in the same batch of queries (see
+ * Engine::queryBatch()). The results of each function are kept for the
+ * lifetime of the view's query, so that a function appearing under several
+ * parents is only queried once, and items repeating one of their ancestors
+ * (i.e., recursive calls) are marked instead of being queried. The "Expand
+ * All Below" command uses a CallTreeExpander to expand a sub-tree to a given
+ * depth.
  * @author Elad Lahav
  */
 class QueryView : public LocationView, public Engine::Connection
@@ -91,6 +103,8 @@ protected:
 	virtual Engine* engine() { return NULL; }
 
 private:
+	friend class CallTreeExpander;
+
 	/**
 	 * The query associated with this view.
 	 * This can be used, e.g., for re-running the query from within the view.
@@ -98,9 +112,58 @@ private:
 	Query query_;
 
 	/**
-	 * The index under which query results should be put.
+	 * Receives the results of a query run on a single tree item.
+	 * Deleted through deleteLater(), as the engine may still access the
+	 * connection after reporting termination.
+	 */
+	struct ItemConnection : public QObject, public Engine::Connection
+	{
+		ItemConnection(QueryView* view, const QModelIndex& index,
+		               const QString& pattern)
+			: QObject(view), Engine::Connection(TreeExpansion), view_(view),
+			  index_(index), pattern_(pattern) {}
+
+		void onDataReady(const LocationList&);
+		void onFinished();
+		void onAborted();
+		void onProgress(const QString&, uint, uint) {}
+
+		/**
+		 * The owning view.
+		 */
+		QueryView* view_;
+
+		/**
+		 * The index under which query results should be put.
+		 */
+		QPersistentModelIndex index_;
+
+		/**
+		 * The queried function.
+		 */
+		QString pattern_;
+
+		/**
+		 * Results received so far, stored in the view's cache once the
+		 * query terminates.
+		 */
+		LocationList results_;
+	};
+
+	/**
+	 * Connections for running tree item queries.
 	 */
-	QModelIndex queryIndex_;
+	QList<ItemConnection*> itemConns_;
+
+	/**
+	 * Maps functions queried for tree items to their results.
+	 */
+	QHash<QString, LocationList> itemResults_;
+
+	/**
+	 * Expands sub-trees for the "Expand All Below" command.
+	 */
+	CallTreeExpander expander_;
 
 	/**
 	 * A progress-bar for displaying query progress information.
@@ -116,9 +179,20 @@ private:
 	 */
 	bool autoSelectSingleResult_;
 
+	ItemConnection* findItemQuery(const QModelIndex&) const;
+	bool needsQuery(const QModelIndex&) const;
+	bool repeatsAncestor(const QModelIndex&, const QString&) const;
+	QList<QModelIndex> childItems(const QModelIndex&) const;
+	void queryItems(const QList<QModelIndex>&);
+	void expansionDone();
+	void stopItemQuery(ItemConnection*);
+	void stopItemQueries();
+	void itemQueryDone(ItemConnection*);
+
 private slots:
 	void stopQuery();
 	void queryTreeItem(const QModelIndex&);
+	void expandAllBelow();
 	void requery();
 };
 
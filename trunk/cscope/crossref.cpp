@@ -34,7 +34,8 @@ namespace Cscope
  * Class constructor.
  * @param  parent  Parent object
  */
-Crossref::Crossref(QObject* parent) : Core::Engine(parent), status_(Unknown)
+Crossref::Crossref(QObject* parent) : Core::Engine(parent), status_(Unknown),
+	tagBuilder_(NULL), paths_(NULL)
 {
 }
 
@@ -43,6 +44,11 @@ Crossref::Crossref(QObject* parent) : Core::Engine(parent), status_(Unknown)
  */
 Crossref::~Crossref()
 {
+	// The builder deletes itself once its processes terminate.
+	if (tagBuilder_) {
+		disconnect(tagBuilder_, NULL, this, NULL);
+		tagBuilder_->stop();
+	}
 }
 
 /**
@@ -94,6 +100,12 @@ void Crossref::open(const QString& initString, Core::Callback<>* cb)
 	args_ = args;
 	status_ = status;
 
+	// Find out the output format of the executable before the first query.
+	RecordProbe::probe(Cscope::execPath_);
+
+	// Load the tag database, if one was generated.
+	loadTags();
+
 	if (cb)
 		cb->call();
 }
@@ -152,6 +164,19 @@ Crossref::queryFields(Core::Query::Type type) const
 	return fieldList;
 }
 
+/**
+ * Looks up symbol names in the dictionary generated with the tag database.
+ * @param  text  The partial name
+ * @param  mode  How to match names against the text
+ * @param  max   The maximal number of names to return
+ * @return The matching names
+ */
+QStringList Crossref::completions(const QString& text, MatchMode mode,
+                                  int max) const
+{
+	return symbols_.lookup(text, mode, max);
+}
+
 /**
  * Starts a Cscope query.
  * Creates a new Cscope process to handle the query.
@@ -162,60 +187,143 @@ Crossref::queryFields(Core::Query::Type type) const
 void Crossref::query(Core::Engine::Connection* conn,
                      const Core::Query& query) const
 {
-	Cscope::QueryType type;
+	// Local tags are taken from the tag database, or listed by Ctags if the
+	// file was modified since the database was generated.
+	if (query.type_ == Core::Query::LocalTags) {
+		Core::LocationList tags;
+		if (tags_.lookup(query.pattern_, tags)) {
+			new IndexedQuery(conn, tags);
+			return;
+		}
+
+		Ctags* ctags = new Ctags();
+		ctags->setDeleteOnExit();
+		ctags->query(conn, query.pattern_);
+		return;
+	}
+
+	// Files are looked up in the in-memory list of the project's files, if
+	// available.
+	if ((query.type_ == Core::Query::FindFile) && findFiles(conn, query))
+		return;
+
+	Cscope::QueryType type = cscopeType(query);
+
+	// Create a new Cscope process object, and start the query.
+	Cscope* cscope = new Cscope();
+	cscope->setDeleteOnExit();
+	cscope->query(conn, path_, type, query.pattern_);
+}
+
+/**
+ * Starts a batch of queries.
+ * All Cscope queries in the batch are executed by a single Cscope process,
+ * which opens the database only once.
+ * @param  batch  The queries to execute
+ * @throw  Exception
+ */
+void Crossref::queryBatch(const QList<Core::Engine::BatchQuery>& batch) const
+{
+	// Translate all queries before starting any of them.
+	QList<Cscope::Command> commands;
+	QList<Core::Engine::BatchQuery> localQueries;
+	foreach (const Core::Engine::BatchQuery& bq, batch) {
+		if ((bq.query_.type_ == Core::Query::LocalTags)
+		    || (bq.query_.type_ == Core::Query::FindFile))
+			localQueries.append(bq);
+		else
+			commands.append(Cscope::Command(bq.conn_, cscopeType(bq.query_),
+			                                bq.query_.pattern_));
+	}
+
+	// Local tags and file queries are answered without Cscope, if possible.
+	foreach (const Core::Engine::BatchQuery& bq, localQueries)
+		query(bq.conn_, bq.query_);
+
+	if (commands.isEmpty())
+		return;
+
+	// A single query does not need the line-mode interface.
+	Cscope* cscope = new Cscope();
+	cscope->setDeleteOnExit();
+	if (commands.size() == 1) {
+		const Cscope::Command& cmd = commands.first();
+		cscope->query(cmd.conn_, path_, cmd.type_, cmd.pattern_);
+	}
+	else {
+		cscope->queryBatch(path_, commands);
+	}
+}
+
+/**
+ * Answers a file query from the in-memory list of the project's files.
+ * As with Cscope, the pattern is a regular expression, which can match any
+ * part of a file's path.
+ * @param  conn   Connection object waiting for the results
+ * @param  query  Query information
+ * @return true if the query was answered, false if Cscope needs to handle it
+ */
+bool Crossref::findFiles(Core::Engine::Connection* conn,
+                         const Core::Query& query) const
+{
+	if ((paths_ == NULL) || (paths_->count() == 0))
+		return false;
+
+	QRegExp regExp(query.pattern_,
+	               (query.flags_ & Core::Query::IgnoreCase)
+	               ? Qt::CaseInsensitive : Qt::CaseSensitive);
+	if (!regExp.isValid())
+		return false;
+
+	Core::LocationList locList;
+	foreach (QString file, paths_->find(regExp))
+		locList.append(Core::Location(file, 1));
+
+	new IndexedQuery(conn, locList);
+	return true;
+}
 
-	// Translate the requested type into a Cscope query number.
+/**
+ * Translates a query into a Cscope query number.
+ * @param  query  Query information
+ * @return The matching Cscope query type
+ * @throw  Exception
+ */
+Cscope::QueryType Crossref::cscopeType(const Core::Query& query) const
+{
 	switch (query.type_) {
 	case Core::Query::Text:
 		if (query.flags_ & Core::Query::RegExp)
-			type = Cscope::EGrepPattern;
-		else
-			type = Cscope::Text;
-		break;
+			return Cscope::EGrepPattern;
+
+		return Cscope::Text;
 
 	case Core::Query::References:
-		type = Cscope::References;
-		break;
+		return Cscope::References;
 
 	case Core::Query::Definition:
-		type = Cscope::Definition;
-		break;
+		return Cscope::Definition;
 
 	case Core::Query::CalledFunctions:
-		type = Cscope::CalledFunctions;
-		break;
+		return Cscope::CalledFunctions;
 
 	case Core::Query::CallingFunctions:
-		type = Cscope::CallingFunctions;
-		break;
+		return Cscope::CallingFunctions;
 
 	case Core::Query::FindFile:
-		type = Cscope::FindFile;
-		break;
+		return Cscope::FindFile;
 
 	case Core::Query::IncludingFiles:
-		type = Cscope::IncludingFiles;
-		break;
-
-	case Core::Query::LocalTags:
-		{
-			Ctags* ctags = new Ctags();
-			ctags->setDeleteOnExit();
-			ctags->query(conn, query.pattern_);
-			return;
-		}
+		return Cscope::IncludingFiles;
 
 	default:
-		// Query type is not supported.
-		// TODO: What happens if an exception is thrown from within a slot?
-		throw new Core::Exception(QString("Unsupported query type '%1")
-		                          .arg(query.type_));
+		;
 	}
 
-	// Create a new Cscope process object, and start the query.
-	Cscope* cscope = new Cscope();
-	cscope->setDeleteOnExit();
-	cscope->query(conn, path_, type, query.pattern_);
+	// Query type is not supported.
+	// TODO: What happens if an exception is thrown from within a slot?
+	throw new Core::Exception(QString("Unsupported query type '%1")
+	                          .arg(query.type_));
 }
 
 /**
@@ -234,6 +342,27 @@ void Crossref::build(Core::Engine::Connection* conn) const
 
 	// Start the build process.
 	cscope->build(conn, path_, args_);
+
+	// Generate the tag database alongside the cross-reference database.
+	const_cast<Crossref*>(this)->buildTags();
+}
+
+/**
+ * Starts generating a new tag database.
+ * A builder that is still running is stopped.
+ */
+void Crossref::buildTags()
+{
+	if (tagBuilder_) {
+		disconnect(tagBuilder_, NULL, this, NULL);
+		tagBuilder_->stop();
+	}
+
+	tagBuilder_ = new TagBuilder(path_, tagsPath(), symbolsPath());
+	connect(tagBuilder_, SIGNAL(done(bool)), this, SLOT(tagsBuilt(bool)));
+	connect(tagBuilder_, SIGNAL(done(bool)), tagBuilder_,
+	        SLOT(deleteLater()));
+	tagBuilder_->start(tags_);
 }
 
 void Crossref::buildProcessFinished(int code, QProcess::ExitStatus status)
@@ -242,6 +371,30 @@ void Crossref::buildProcessFinished(int code, QProcess::ExitStatus status)
 		status_ = Ready;
 }
 
+/**
+ * Called when a new tag database was generated.
+ * @param  ok  true if the database file was written, false otherwise
+ */
+void Crossref::tagsBuilt(bool ok)
+{
+	tagBuilder_ = NULL;
+
+	if (ok)
+		loadTags();
+}
+
+/**
+ * Maps the tag database and the symbol dictionary into memory.
+ */
+void Crossref::loadTags()
+{
+	if (!tags_.open(tagsPath()))
+		qDebug() << "Failed to load the tag database" << tagsPath();
+
+	if (!symbols_.open(symbolsPath()))
+		qDebug() << "Failed to load the symbol index" << symbolsPath();
+}
+
 } // namespace Cscope
 
 } // namespace KScope
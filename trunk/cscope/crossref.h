@@ -23,6 +23,10 @@
 
 #include "cscope.h"
 #include "ctags.h"
+#include "tagindex.h"
+#include "symbolindex.h"
+#include "tagbuilder.h"
+#include <core/pathindex.h>
 #include "engineconfigwidget.h"
 
 namespace KScope
@@ -38,6 +42,12 @@ namespace Cscope
  * independent Cscope processes used to query and build these files. When
  * building the cross-reference database, Cscope uses temporary files, so that
  * the existing database can still be queried.
+ * Building the database also generates a project-wide tag database (see
+ * TagIndex), from which local tags queries are answered without running
+ * Ctags, and a dictionary of symbol names (see SymbolIndex), used for
+ * completing partial names.
+ * File queries are answered from the in-memory list of the project's files,
+ * if one is available (see setPathIndex()).
  * @author Elad Lahav
  */
 class Crossref : public Core::Engine
@@ -56,9 +66,17 @@ public:
 	Status status() const { return status_; }
 
 	QList<Core::Location::Fields> queryFields(Core::Query::Type) const;
+	QStringList completions(const QString&, MatchMode, int) const;
+
+	/**
+	 * @param  paths  The files of the project, used for answering file
+	 *                queries without running Cscope (may be NULL)
+	 */
+	void setPathIndex(const Core::PathIndex* paths) { paths_ = paths; }
 
 public slots:
 	void query(Core::Engine::Connection*, const Core::Query&) const;
+	void queryBatch(const QList<Core::Engine::BatchQuery>&) const;
 	void build(Core::Engine::Connection*) const;
 
 	const QString& path() { return path_; }
@@ -79,8 +97,46 @@ private:
 	 */
 	Status status_;
 
+	/**
+	 * The project's tag database.
+	 */
+	TagIndex tags_;
+
+	/**
+	 * The names of all symbols in the tag database.
+	 */
+	SymbolIndex symbols_;
+
+	/**
+	 * Generates a new tag database, NULL if none is being generated.
+	 */
+	TagBuilder* tagBuilder_;
+
+	/**
+	 * The files of the project, NULL if not available.
+	 */
+	const Core::PathIndex* paths_;
+
+	/**
+	 * @return The path of the tag database file
+	 */
+	QString tagsPath() const { return path_ + "/kscope.tags"; }
+
+	/**
+	 * @return The path of the symbol dictionary file
+	 */
+	QString symbolsPath() const { return path_ + "/kscope.symbols"; }
+
+	void loadTags();
+	bool findFiles(Core::Engine::Connection*, const Core::Query&) const;
+
+	void buildTags();
+
+	Cscope::QueryType cscopeType(const Core::Query&) const;
+
 private slots:
 	void buildProcessFinished(int, QProcess::ExitStatus);
+	void tagsBuilt(bool);
 };
 
 } // namespace Cscope
@@ -103,8 +159,10 @@ struct EngineConfig<Cscope::Crossref>
 
 	static void setConfig(const KeyValuePairs& confParams) {
 		QString cscopePath = confParams["CscopePath"].toString();
-		if (!cscopePath.isEmpty())
+		if (!cscopePath.isEmpty()) {
 			Cscope::Cscope::execPath_ = cscopePath;
+			Cscope::RecordProbe::probe(cscopePath);
+		}
 
 		QString ctagsPath = confParams["CtagsPath"].toString();
 		if (!ctagsPath.isEmpty())
@@ -127,6 +185,7 @@ struct EngineConfig<Cscope::Crossref>
 			return;
 
 		Cscope::Cscope::execPath_ = configWidget->cscopePath();
+		Cscope::RecordProbe::probe(Cscope::Cscope::execPath_);
 		Cscope::Ctags::execPath_ = configWidget->ctagsPath();
 	}
 };
@@ -29,6 +29,93 @@ namespace Cscope
 {
 
 QString Cscope::execPath_("/usr/bin/cscope");
+QHash<QString, bool> RecordProbe::results_;
+QMutex RecordProbe::lock_;
+
+/**
+ * Starts a probe of an executable, unless it was already probed.
+ * The probe deletes itself once it completes.
+ * @param  path  The path of the Cscope executable
+ */
+void RecordProbe::probe(const QString& path)
+{
+	{
+		QMutexLocker locker(&lock_);
+		if (results_.contains(path))
+			return;
+
+		results_.insert(path, false);
+	}
+
+	RecordProbe* proc = new RecordProbe(path);
+	proc->start(path, QStringList() << "-V");
+}
+
+/**
+ * @param  path  The path of a Cscope executable
+ * @return true if the executable was found to support structured records,
+ *         false if it does not, or was not probed yet
+ */
+bool RecordProbe::supported(const QString& path)
+{
+	QMutexLocker locker(&lock_);
+	return results_.value(path, false);
+}
+
+/**
+ * Class constructor.
+ * @param  path  The path of the probed executable
+ */
+RecordProbe::RecordProbe(const QString& path) : QProcess(), path_(path)
+{
+	connect(this, SIGNAL(finished(int, QProcess::ExitStatus)), this,
+	        SLOT(probeFinished(int, QProcess::ExitStatus)));
+	connect(this, SIGNAL(error(QProcess::ProcessError)), this,
+	        SLOT(probeFailed(QProcess::ProcessError)));
+}
+
+/**
+ * Records the answer of the executable.
+ * The feature list is printed to the standard error.
+ * @param  code    Unused
+ * @param  status  Unused
+ */
+void RecordProbe::probeFinished(int code, QProcess::ExitStatus status)
+{
+	(void)code;
+	(void)status;
+
+	bool records = readAllStandardError().contains(
+	               "Line-mode output: text, records");
+	qDebug() << path_ << (records ? "supports" : "does not support")
+	         << "structured records";
+
+	{
+		QMutexLocker locker(&lock_);
+		results_.insert(path_, records);
+	}
+
+	deleteLater();
+}
+
+/**
+ * Handles an executable that could not be run.
+ * The path is forgotten, so that it is probed again by the next query, in
+ * case the executable was installed in the meantime.
+ * @param  error  The type of error
+ */
+void RecordProbe::probeFailed(QProcess::ProcessError error)
+{
+	if (error != QProcess::FailedToStart)
+		return;
+
+	{
+		QMutexLocker locker(&lock_);
+		results_.remove(path_);
+	}
+
+	deleteLater();
+}
 
 /**
  * Class constructor.
@@ -40,7 +127,10 @@ Cscope::Cscope()
 	  buildInitState_("BuildInit"),
 	  buildProgState_("BuildProgress"),
 	  queryProgState_("QueryProgress"),
-	  queryResultState_("QueryResults")
+	  queryResultState_("QueryResults"),
+	  batchInitState_("BatchInit"),
+	  records_(false),
+	  curCommand_(0)
 {
 	addRule(buildInitState_, Parser::Literal("Building cross-reference...\n"),
 	        buildProgState_);
@@ -72,6 +162,9 @@ Cscope::Cscope()
 	                         << Parser::Number()
 	                         << Parser::Literal(" lines\n"),
 	        queryResultState_, QueryEndAction(*this));
+	addRule(batchInitState_, Parser::Literal(">> "), queryProgState_);
+	addRule(queryResultState_, Parser::Literal(">> "), queryProgState_,
+	        CommandEndAction(*this));
 	addRule(queryResultState_, Parser::String<>(' ')
 	                           << Parser::Whitespace()
 	                           << Parser::String<>(' ')
@@ -88,6 +181,7 @@ Cscope::Cscope()
  */
 Cscope::~Cscope()
 {
+	qDeleteAll(commands_);
 }
 
 /**
@@ -111,6 +205,9 @@ void Cscope::query(Core::Engine::Connection* conn, const QString& path,
 	QStringList args;
 	args << "-d";
 	args << "-v";
+	records_ = hasRecordOutput();
+	if (records_)
+		args << "-z";
 	args << QString("-L%1").arg(type);
 	args << pattern;
 	setWorkingDirectory(path);
@@ -118,15 +215,73 @@ void Cscope::query(Core::Engine::Connection* conn, const QString& path,
 	// Initialise parsing.
 	conn_ = conn;
 	conn_->setCtrlObject(this);
+	stats_ = conn_->stats();
 	setState(queryProgState_);
 	locList_.clear();
 	type_ = type;
+	recBuf_.clear();
+	recFiles_.clear();
+	resParsed_ = 0;
 
 	// Start the process.
 	qDebug() << "Running" << execPath_ << args << "in" << path;
 	start(execPath_, args);
 }
 
+/**
+ * Starts a Cscope process for a batch of queries.
+ * The process reads the queries as line-mode commands from its standard input,
+ * and executes them one after the other, so that the database is only opened
+ * once for the entire batch. The end of each command's output (a prompt for
+ * the next command, or an end record with structured output) terminates the
+ * command's operation.
+ * @param  path      The directory to execute under
+ * @param  commands  The queries to run
+ * @throw  Exception
+ */
+void Cscope::queryBatch(const QString& path, const QList<Command>& commands)
+{
+	// Abort if a process is already running.
+	if (state() != QProcess::NotRunning || conn_ != NULL)
+		throw Core::Exception("Process already running");
+
+	// Prepare the argument list.
+	QStringList args;
+	args << "-d";
+	args << "-v";
+	args << "-l";
+	records_ = hasRecordOutput();
+	if (records_)
+		args << "-z";
+	setWorkingDirectory(path);
+
+	// Take over the connections.
+	foreach (const Command& cmd, commands) {
+		Command* copy = new Command(cmd);
+		copy->self_ = this;
+		copy->conn_->setCtrlObject(copy);
+		commands_.append(copy);
+	}
+
+	// Initialise parsing.
+	setState(records_ ? queryProgState_ : batchInitState_);
+	recBuf_.clear();
+	recFiles_.clear();
+	startCommand(0);
+
+	// Start the process, and send all commands at once.
+	// Closing the write channel makes the process exit after the last
+	// command.
+	qDebug() << "Running" << execPath_ << args << "in" << path << "for"
+	         << commands_.size() << "queries";
+	start(execPath_, args);
+	foreach (Command* cmd, commands_) {
+		QString line = QString::number(cmd->type_) + cmd->pattern_ + "\n";
+		write(line.toLocal8Bit());
+	}
+	closeWriteChannel();
+}
+
 /**
  * Starts a Cscope build process.
  * @param  conn      A connection object used for reporting progress and data
@@ -160,6 +315,263 @@ void Cscope::build(Core::Engine::Connection* conn, const QString& path,
 	start(prog, args);
 }
 
+/**
+ * Parses query output in structured records.
+ * Each record starts with a character giving its type, and is followed by a
+ * fixed number of fields, each terminated by a null character:
+ * F<id> <name>                A file, sent before the first result in it
+ * R<file id> <scope> <line> <text>
+ *                             A result
+ * P<what> <current> <total>   Progress
+ * M<message>                  A message
+ * E<count>                    The end of the results
+ * Output in text lines (when building the database, or when the Cscope
+ * executable does not have structured output) is passed to the state machine.
+ * @param  data  The output read
+ * @return true if parsing was successful, false otherwise
+ */
+bool Cscope::parseOutput(const QByteArray& data)
+{
+	if (!records_)
+		return Process::parseOutput(data);
+
+	recBuf_ += data;
+
+	// Handle each complete record.
+	const char* buf = recBuf_.constData();
+	int len = recBuf_.size();
+	int pos = 0;
+	for (;;) {
+		if (pos == len)
+			break;
+
+		// Get the number of fields for the record type.
+		int fieldNum;
+		switch (buf[pos]) {
+		case 'R':
+			fieldNum = 4;
+			break;
+
+		case 'P':
+			fieldNum = 3;
+			break;
+
+		case 'F':
+			fieldNum = 2;
+			break;
+
+		case 'M':
+		case 'E':
+			fieldNum = 1;
+			break;
+
+		default:
+			qDebug() << "Unknown record type" << buf[pos];
+			return false;
+		}
+
+		// Find the fields, waiting for more output if the record is
+		// incomplete.
+		const char* fields[4];
+		int end = pos + 1;
+		int i;
+		for (i = 0; i < fieldNum; i++) {
+			fields[i] = buf + end;
+			const char* nul = (const char*)memchr(buf + end, '\0',
+			                                      len - end);
+			if (nul == NULL)
+				break;
+
+			end = nul - buf + 1;
+		}
+		if (i < fieldNum)
+			break;
+
+		switch (buf[pos]) {
+		case 'F':
+			recFiles_.insert(QByteArray(fields[0]),
+			                 QString::fromLocal8Bit(fields[1]));
+			break;
+
+		case 'R':
+			addResult(recFiles_.value(QByteArray(fields[0])),
+			          QString::fromLocal8Bit(fields[1]),
+			          QByteArray(fields[2]).toUInt(),
+			          QString::fromLocal8Bit(fields[3]));
+			break;
+
+		case 'P':
+			conn_->onProgress(tr("Querying..."), QByteArray(fields[1]).toUInt(),
+			                  QByteArray(fields[2]).toUInt());
+			break;
+
+		case 'M':
+			qDebug() << "Cscope:" << fields[0];
+			break;
+
+		case 'E':
+			resNum_ = QByteArray(fields[0]).toUInt();
+			if (stats_)
+				stats_->mark(Core::QueryStats::SearchDone);
+			if (!commands_.isEmpty())
+				endCommand(true);
+			break;
+		}
+
+		pos = end;
+	}
+
+	recBuf_.remove(0, pos);
+	return true;
+}
+
+/**
+ * Adds a query result to the list of locations.
+ * @param  file   The file of the result
+ * @param  scope  Cscope's "Scope" field for the result
+ * @param  line   The line number of the result
+ * @param  text   The text of the line
+ */
+void Cscope::addResult(const QString& file, const QString& scope, uint line,
+                       const QString& text)
+{
+	// Fill-in a Location object, using the parsed result information.
+	Core::Location loc;
+	loc.file_ = file;
+	loc.line_ = line;
+	loc.column_ = 0;
+	loc.text_ = text;
+	loc.tag_.type_ = Core::Tag::UnknownTag;
+
+	// Cscope's "Scope" result field should be handled differently for each
+	// query type.
+	switch (type_) {
+	case References:
+	case CalledFunctions:
+	case CallingFunctions:
+		loc.tag_.scope_ = scope;
+		break;
+
+	case Definition:
+		loc.tag_.name_ = scope;
+		break;
+
+	default:
+		;
+	}
+
+	// Add to the list of parsed locations.
+	locList_.append(loc);
+	resParsed_++;
+	if (stats_)
+		stats_->linesParsed_++;
+
+	// Provide progress information for result-parsing (the total is only
+	// known in advance for text output).
+	if ((resParsed_ & 0xff) == 0 && !records_)
+		conn_->onProgress(tr("Parsing..."), resParsed_, resNum_);
+}
+
+/**
+ * Makes a command of the batch the current one, so that progress and results
+ * are reported to its connection.
+ * @param  index  The index of the command in the batch
+ */
+void Cscope::startCommand(int index)
+{
+	curCommand_ = index;
+	locList_.clear();
+	resNum_ = 0;
+	resParsed_ = 0;
+
+	if (curCommand_ >= commands_.size()) {
+		conn_ = NULL;
+		stats_ = NULL;
+		return;
+	}
+
+	Command* cmd = commands_[curCommand_];
+	conn_ = cmd->conn_;
+	type_ = cmd->type_;
+	stats_ = conn_->stats();
+
+	// Only the first command waits for the process to start.
+	if (stats_ && curCommand_ > 0)
+		stats_->mark(Core::QueryStats::ProcessStarted);
+}
+
+/**
+ * Reports the termination of the current command, and moves on to the next
+ * one.
+ * @param  ok  Whether the command's output was read in full
+ */
+void Cscope::endCommand(bool ok)
+{
+	if (curCommand_ >= commands_.size())
+		return;
+
+	Command* cmd = commands_[curCommand_];
+	ok = ok && !cmd->stopped_;
+
+	if (stats_) {
+		stats_->mark(Core::QueryStats::Exited);
+		stats_->aborted_ = !ok;
+	}
+
+	// Detach before notifying, as the connection may start a new operation.
+	conn_->setCtrlObject(NULL);
+	if (ok) {
+		if (!locList_.isEmpty())
+			conn_->onDataReady(locList_);
+
+		conn_->onFinished();
+	}
+	else {
+		conn_->onAborted();
+	}
+
+	startCommand(curCommand_ + 1);
+}
+
+/**
+ * Stops a command of the batch.
+ * The command's termination is reported when its output ends. The process is
+ * killed once all commands that did not terminate yet were stopped.
+ * @param  cmd  The command to stop
+ */
+void Cscope::stopCommand(Command* cmd)
+{
+	cmd->stopped_ = true;
+
+	for (int i = curCommand_; i < commands_.size(); i++) {
+		if (!commands_[i]->stopped_)
+			return;
+	}
+
+	kill();
+}
+
+/**
+ * Stops a command in a batch.
+ */
+void Cscope::Command::stop()
+{
+	self_->stopCommand(this);
+}
+
+/**
+ * Determines whether the Cscope executable can write query results in
+ * structured records.
+ * The executable is probed if it was not already, in which case text output
+ * is used until the probe completes.
+ * @return true if structured output is supported, false otherwise
+ */
+bool Cscope::hasRecordOutput()
+{
+	RecordProbe::probe(execPath_);
+	return RecordProbe::supported(execPath_);
+}
+
 /**
  * Called when the process terminates.
  * @param  code    The exit code of the process
@@ -169,6 +581,21 @@ void Cscope::handleFinished(int code, QProcess::ExitStatus status)
 {
 	Process::handleFinished(code, status);
 
+	// Commands of a batch terminate as their output ends. Any command left
+	// did not complete.
+	if (!commands_.isEmpty()) {
+		while (curCommand_ < commands_.size())
+			endCommand(false);
+
+		return;
+	}
+
+	if (stats_) {
+		stats_->mark(Core::QueryStats::Exited);
+		stats_->aborted_ = (status != QProcess::NormalExit);
+		stats_ = NULL;
+	}
+
 	// Hand over data to the other side of the connection.
 	if (!locList_.isEmpty())
 		conn_->onDataReady(locList_);
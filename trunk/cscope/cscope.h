@@ -21,6 +21,8 @@
 #ifndef __CSCOPE_CSCOPE_H__
 #define __CSCOPE_CSCOPE_H__
 
+#include <QHash>
+#include <QMutex>
 #include <core/process.h>
 #include <core/globals.h>
 #include <core/engine.h>
@@ -31,6 +33,46 @@ namespace KScope
 namespace Cscope
 {
 
+/**
+ * Finds out whether a Cscope executable can write query results in structured
+ * records (see -z in min-cscope), without waiting for it.
+ * A probe runs the executable with -V, and looks for the feature in the list
+ * it prints. The answer is kept with the executable path. Until it arrives,
+ * the path is taken not to support records, and queries use text output.
+ * @author Elad Lahav
+ */
+class RecordProbe : public QProcess
+{
+	Q_OBJECT
+
+public:
+	static void probe(const QString&);
+	static bool supported(const QString&);
+
+private:
+	RecordProbe(const QString&);
+
+	/**
+	 * The path of the probed executable.
+	 */
+	QString path_;
+
+	/**
+	 * Whether each probed executable supports records.
+	 * A path is added, as not supporting records, when its probe starts.
+	 */
+	static QHash<QString, bool> results_;
+
+	/**
+	 * Protects results_.
+	 */
+	static QMutex lock_;
+
+private slots:
+	void probeFinished(int, QProcess::ExitStatus);
+	void probeFailed(QProcess::ProcessError);
+};
+
 /**
  * Front-end to a Cscope process.
  * This object can be used for both querying and building the Cscope
@@ -60,8 +102,57 @@ public:
 		IncludingFiles = 8
 	};
 
+	/**
+	 * A query executed as a line-mode command, as part of a batch.
+	 * The command serves as the controlled object of its connection, so that
+	 * stopping the connection does not affect other commands in the batch.
+	 */
+	struct Command : public Core::Engine::Controlled
+	{
+		/**
+		 * Struct constructor.
+		 * @param  conn     Used for reporting the progress and results of
+		 *                  the query
+		 * @param  type     The type of query to run
+		 * @param  pattern  The pattern to query
+		 */
+		Command(Core::Engine::Connection* conn, QueryType type,
+		        const QString& pattern)
+			: self_(NULL), conn_(conn), type_(type), pattern_(pattern),
+			  stopped_(false) {}
+
+		void stop();
+
+		/**
+		 * The Cscope process running the command.
+		 */
+		Cscope* self_;
+
+		/**
+		 * Used for reporting the progress and results of the query.
+		 */
+		Core::Engine::Connection* conn_;
+
+		/**
+		 * The type of query to run.
+		 */
+		QueryType type_;
+
+		/**
+		 * The pattern to query.
+		 */
+		QString pattern_;
+
+		/**
+		 * Whether the command was stopped, in which case its results are
+		 * discarded.
+		 */
+		bool stopped_;
+	};
+
 	void query(Core::Engine::Connection*, const QString&, QueryType,
 	           const QString&);
+	void queryBatch(const QString&, const QList<Command>&);
 	void build(Core::Engine::Connection*, const QString&, const QStringList&);
 
 	/**
@@ -71,6 +162,9 @@ public:
 
 	static QString execPath_;
 
+protected:
+	virtual bool parseOutput(const QByteArray&);
+
 protected slots:
 	virtual void handleFinished(int, QProcess::ExitStatus);
 
@@ -112,6 +206,12 @@ private:
 	 */
 	State queryResultState_;
 
+	/**
+	 * Initial state for a batch of line-mode commands, before the first
+	 * prompt.
+	 */
+	State batchInitState_;
+
 	/**
 	 * List of locations.
 	 * The list is constructed when result lines are parsed.
@@ -123,6 +223,38 @@ private:
 	 */
 	QueryType type_;
 
+	/**
+	 * Whether the query output is in structured records (see -z in
+	 * min-cscope) rather than text lines.
+	 */
+	bool records_;
+
+	/**
+	 * Output received in the middle of a record.
+	 */
+	QByteArray recBuf_;
+
+	/**
+	 * Maps file ids in the structured output to file names.
+	 */
+	QHash<QByteArray, QString> recFiles_;
+
+	/**
+	 * The commands of a batch, empty for a single query.
+	 */
+	QList<Command*> commands_;
+
+	/**
+	 * The index of the command whose output is being parsed.
+	 */
+	int curCommand_;
+
+	static bool hasRecordOutput();
+	void addResult(const QString&, const QString&, uint, const QString&);
+	void startCommand(int);
+	void endCommand(bool);
+	void stopCommand(Command*);
+
 	/**
 	 * Functor for progress-states transition-functions.
 	 */
@@ -176,6 +308,9 @@ private:
 		void operator()(const Parser::CapList& capList) const {
 			self_.resNum_ = capList[0].toUInt();
 			self_.resParsed_ = 0;
+			if (self_.stats_)
+				self_.stats_->mark(Core::QueryStats::SearchDone);
+
 			self_.conn_->onProgress(tr("Parsing..."), 0, self_.resNum_);
 		}
 
@@ -185,6 +320,34 @@ private:
 		Cscope& self_;
 	};
 
+	/**
+	 * Functor for the end-of-command transition-function (a line-mode
+	 * prompt following the results of a command).
+	 */
+	struct CommandEndAction
+	{
+		/**
+		 * Struct constructor.
+		 * @param  self  The owner Cscope object
+		 */
+		CommandEndAction(Cscope& self) : self_(self) {}
+
+		/**
+		 * Functor operator.
+		 * Reports the termination of the current command.
+		 * @param  capList  List of captured strings
+		 */
+		void operator()(const Parser::CapList& capList) const {
+			(void)capList;
+			self_.endCommand(true);
+		}
+
+		/**
+		 * The owner Cscope object.
+		 */
+		Cscope& self_;
+	};
+
 	/**
 	 * Functor for the query-result-state transition-function.
 	 */
@@ -202,40 +365,8 @@ private:
 		 * @param  capList  List of captured strings
 		 */
 		void operator()(const Parser::CapList& capList) const {
-			// Fill-in a Location object, using the parsed result information.
-			Core::Location loc;
-			loc.file_ = capList[0].toString();
-			loc.line_ = capList[2].toUInt();
-			loc.column_ = 0;
-			loc.text_ = capList[3].toString();
-			loc.tag_.type_ = Core::Tag::UnknownTag;
-
-			// Cscope's "Scope" result field should be handled differently
-			// for each query type.
-			switch (self_.type_) {
-			case Cscope::References:
-			case Cscope::CalledFunctions:
-			case Cscope::CallingFunctions:
-				loc.tag_.scope_ = capList[1].toString();
-				break;
-
-			case Cscope::Definition:
-				loc.tag_.name_ = capList[1].toString();
-				break;
-
-			default:
-				;
-			}
-
-			// Add to the list of parsed locations.
-			self_.locList_.append(loc);
-			self_.resParsed_++;
-
-			// Provide progress information for result-parsing.
-			if ((self_.resParsed_ & 0xff) == 0) {
-				self_.conn_->onProgress(tr("Parsing..."), self_.resParsed_,
-				                        self_.resNum_);
-			}
+			self_.addResult(capList[0].toString(), capList[1].toString(),
+			                capList[2].toUInt(), capList[3].toString());
 		}
 
 		/**
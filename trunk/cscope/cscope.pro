@@ -11,7 +11,12 @@ HEADERS += engineconfigwidget.h \
     managedproject.h \
     crossref.h \
     cscope.h \
-    files.h
+    files.h \
+    fileindex.h \
+    tagindex.h \
+    tagbuilder.h \
+    symbolindex.h \
+    varint.h
 FORMS += configwidget.ui \
     engineconfigwidget.ui
 SOURCES += engineconfigwidget.cpp \
@@ -20,7 +25,11 @@ SOURCES += engineconfigwidget.cpp \
     managedproject.cpp \
     crossref.cpp \
     cscope.cpp \
-    files.cpp
+    files.cpp \
+    fileindex.cpp \
+    tagindex.cpp \
+    tagbuilder.cpp \
+    symbolindex.cpp
 INCLUDEPATH += .. \
     .
 LIBS += -L../core -lkscope_core
@@ -18,6 +18,7 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  ***************************************************************************/
 
+#include <QFile>
 #include <core/exception.h>
 #include "ctags.h"
 
@@ -80,6 +81,7 @@ void Ctags::query(Core::Engine::Connection* conn, const QString& file)
 	// Initialise parsing.
 	conn_ = conn;
 	conn_->setCtrlObject(this);
+	stats_ = conn_->stats();
 	locList_.clear();
 
 	// Start the process.
@@ -87,6 +89,43 @@ void Ctags::query(Core::Engine::Connection* conn, const QString& file)
 	start(execPath_, args);
 }
 
+/**
+ * Starts a Ctags process for a list of files.
+ * The list is passed on the process's standard input, so that it is not
+ * limited by the maximal length of a command line.
+ * @param  conn   A connection object used for reporting results
+ * @param  files  The files to parse
+ * @throw  Exception
+ */
+void Ctags::query(Core::Engine::Connection* conn, const QStringList& files)
+{
+	// Abort if a process is already running.
+	if (state() != QProcess::NotRunning || conn_ != NULL)
+		throw Core::Exception("Process already running");
+
+	// Prepare the argument list.
+	QStringList args;
+	args << "-n"          // use line numbers instead of patterns
+	     << "--fields=+s" // add scope information
+	     << "--sort=no"   // do not sort by tag name
+	     << "-f" << "-"   // output to stdout instead of a file
+	     << "-L" << "-";  // read the file list from stdin
+
+	// Initialise parsing.
+	conn_ = conn;
+	conn_->setCtrlObject(this);
+	stats_ = conn_->stats();
+	locList_.clear();
+
+	// Start the process.
+	qDebug() << "Running" << execPath_ << args << "for" << files.size()
+	         << "files";
+	start(execPath_, args);
+	foreach (QString file, files)
+		write(QFile::encodeName(file) + "\n");
+	closeWriteChannel();
+}
+
 /**
  * Called when the process terminates.
  * @param  code    The exit code of the process
@@ -96,6 +135,13 @@ void Ctags::handleFinished(int code, QProcess::ExitStatus status)
 {
 	Process::handleFinished(code, status);
 
+	if (stats_) {
+		stats_->mark(Core::QueryStats::SearchDone);
+		stats_->mark(Core::QueryStats::Exited);
+		stats_->aborted_ = (status != QProcess::NormalExit);
+		stats_ = NULL;
+	}
+
 	// Hand over data to the other side of the connection.
 	if (!locList_.isEmpty())
 		conn_->onDataReady(locList_);
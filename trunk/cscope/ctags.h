@@ -46,6 +46,7 @@ public:
 	~Ctags();
 
 	void query(Core::Engine::Connection*, const QString&);
+	void query(Core::Engine::Connection*, const QStringList&);
 
 	/**
 	 * Stops a running process.
@@ -148,6 +149,8 @@ private:
 
 			// Add to the list of parsed locations.
 			self_.locList_.append(loc);
+			if (self_.stats_)
+				self_.stats_->linesParsed_++;
 		}
 		/**
 		 * The owner Ctags object.
@@ -0,0 +1,633 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include <QtEndian>
+#include <QDebug>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "fileindex.h"
+#include "varint.h"
+
+namespace KScope
+{
+
+namespace Cscope
+{
+
+/**
+ * Base file layout (all integers are little-endian):
+ * 0   "KSFI"
+ * 4   Format version
+ * 8   Number of records
+ * 12  Next identifier to assign
+ * 16  Number of restart points
+ * 20  Offset of the restart point table
+ * 24  Generation
+ * 28  Records, each given as:
+ *     varint  Length of the prefix shared with the previous path
+ *     varint  Length of the suffix
+ *     bytes   Suffix
+ *     varint  Identifier
+ * The restart point table holds the 32-bit offset of every RestartInterval'th
+ * record, which always has an empty shared prefix.
+ * The generation is incremented by every new base file. The journal starts
+ * with a "#<generation>" line, and only applies to the base file of the same
+ * generation.
+ */
+static const char Magic[4] = { 'K', 'S', 'F', 'I' };
+static const quint32 Version = 2;
+static const uint HeaderSize = 28;
+
+/**
+ * Class constructor.
+ */
+FileIndex::FileIndex() : base_(NULL), baseSize_(0), baseCount_(0),
+                         restartCount_(0), restarts_(NULL), generation_(0),
+                         nextId_(0), journalSize_(0), journalValid_(false)
+{
+}
+
+/**
+ * Class destructor.
+ */
+FileIndex::~FileIndex()
+{
+	unmap();
+}
+
+/**
+ * Loads an index.
+ * Maps the base file and replays the journal. A missing base file describes
+ * an empty list.
+ * @param  path  The path of the base file
+ * @return true if successful, false if either file is corrupt
+ */
+bool FileIndex::open(const QString& path)
+{
+	close();
+	path_ = path;
+
+	if (!map() || !readJournal()) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Releases all resources held by the index.
+ */
+void FileIndex::close()
+{
+	unmap();
+	added_.clear();
+	removed_.clear();
+	nextId_ = 0;
+	journalSize_ = 0;
+	journalValid_ = false;
+}
+
+/**
+ * Replaces the contents of the index with the given list.
+ * Paths that are already in the index keep their identifiers.
+ * @param  fileList  The new list of paths
+ * @return true if successful, false otherwise
+ */
+bool FileIndex::build(const QStringList& fileList)
+{
+	QMap<QByteArray, quint32> pathMap;
+
+	QStringList::ConstIterator itr;
+	for (itr = fileList.begin(); itr != fileList.end(); ++itr) {
+		QByteArray key = QFile::encodeName(*itr);
+		if (key.isEmpty() || pathMap.contains(key))
+			continue;
+
+		int id = lookup(*itr);
+		pathMap.insert(key, id >= 0 ? quint32(id) : nextId_++);
+	}
+
+	return writeBase(pathMap);
+}
+
+/**
+ * Adds paths to the index.
+ * The change is recorded in the journal, without rewriting the base file.
+ * @param  fileList  The paths to add
+ * @return true if successful, false otherwise
+ */
+bool FileIndex::add(const QStringList& fileList)
+{
+	QByteArray records;
+
+	QStringList::ConstIterator itr;
+	for (itr = fileList.begin(); itr != fileList.end(); ++itr) {
+		QByteArray key = QFile::encodeName(*itr);
+		if (key.isEmpty())
+			continue;
+
+		quint32 id;
+		if (removed_.contains(key)) {
+			// Restore a path removed from the base file, with its original
+			// identifier.
+			removed_.remove(key);
+			id = lookupBase(key);
+		}
+		else if (added_.contains(key) || (lookupBase(key) >= 0)) {
+			continue;
+		}
+		else {
+			id = nextId_++;
+			added_.insert(key, id);
+		}
+
+		records += "+" + QByteArray::number(id) + " " + key + "\n";
+		journalSize_++;
+	}
+
+	return appendJournal(records);
+}
+
+/**
+ * Removes paths from the index.
+ * The change is recorded in the journal, without rewriting the base file.
+ * @param  fileList  The paths to remove
+ * @return true if successful, false otherwise
+ */
+bool FileIndex::remove(const QStringList& fileList)
+{
+	QByteArray records;
+
+	QStringList::ConstIterator itr;
+	for (itr = fileList.begin(); itr != fileList.end(); ++itr) {
+		QByteArray key = QFile::encodeName(*itr);
+
+		if (added_.remove(key) == 0) {
+			if (removed_.contains(key) || (lookupBase(key) < 0))
+				continue;
+
+			removed_.insert(key);
+		}
+
+		records += "-" + key + "\n";
+		journalSize_++;
+	}
+
+	return appendJournal(records);
+}
+
+/**
+ * Finds the identifier of a path.
+ * Runs a binary search on the base file, after checking the journalled
+ * changes.
+ * @param  path  The path to look for
+ * @return The identifier, -1 if the path is not in the list
+ */
+int FileIndex::lookup(const QString& path) const
+{
+	QByteArray key = QFile::encodeName(path);
+
+	QMap<QByteArray, quint32>::ConstIterator itr = added_.find(key);
+	if (itr != added_.end())
+		return *itr;
+
+	if (removed_.contains(key))
+		return -1;
+
+	return lookupBase(key);
+}
+
+/**
+ * Calls the given callback for each path in the list, in sorted order.
+ * @param  cb  The callback object
+ */
+void FileIndex::getFiles(Core::Callback<const QString&>& cb) const
+{
+	Reader reader(base_ ? base_ + HeaderSize : NULL, restarts_);
+	bool haveBase = reader.next();
+	QMap<QByteArray, quint32>::ConstIterator itr = added_.begin();
+
+	// Merge the base file with the sorted map of added paths.
+	while (haveBase || (itr != added_.end())) {
+		if (!haveBase || ((itr != added_.end())
+		                  && (itr.key() < reader.path_))) {
+			cb.call(QFile::decodeName(itr.key()));
+			++itr;
+		}
+		else {
+			if (!removed_.contains(reader.path_))
+				cb.call(QFile::decodeName(reader.path_));
+			haveBase = reader.next();
+		}
+	}
+}
+
+/**
+ * Maps the base file into memory and validates its contents.
+ * All records are decoded once, so that a corrupt file is rejected here
+ * rather than found by a later lookup.
+ * @return true if successful, false if the file is corrupt
+ */
+bool FileIndex::map()
+{
+	unmap();
+
+	file_.setFileName(path_);
+	if (!file_.exists())
+		return true;
+
+	if (!file_.open(QIODevice::ReadOnly))
+		return false;
+
+	baseSize_ = file_.size();
+	if (baseSize_ < HeaderSize)
+		return false;
+
+	base_ = file_.map(0, baseSize_);
+	if (base_ == NULL)
+		return false;
+
+	if ((memcmp(base_, Magic, sizeof(Magic)) != 0)
+	    || (qFromLittleEndian<quint32>(base_ + 4) != Version)) {
+		qDebug() << "Invalid file index" << path_;
+		return false;
+	}
+
+	baseCount_ = qFromLittleEndian<quint32>(base_ + 8);
+	nextId_ = qFromLittleEndian<quint32>(base_ + 12);
+	restartCount_ = qFromLittleEndian<quint32>(base_ + 16);
+	generation_ = qFromLittleEndian<quint32>(base_ + 24);
+
+	quint32 offset = qFromLittleEndian<quint32>(base_ + 20);
+	if ((offset < HeaderSize)
+	    || (offset + restartCount_ * 4 > quint64(baseSize_))) {
+		return false;
+	}
+
+	restarts_ = base_ + offset;
+
+	// Every restart point must be within the records.
+	for (uint i = 0; i < restartCount_; i++) {
+		quint32 restart = qFromLittleEndian<quint32>(restarts_ + (i * 4));
+		if ((restart < HeaderSize) || (restart >= offset))
+			return false;
+	}
+
+	// Every restart point must start a record with an empty shared prefix,
+	// and all records must decode.
+	uint count = 0;
+	uint restart = 0;
+	Reader reader(base_ + HeaderSize, restarts_);
+	while (reader.pos_ < restarts_) {
+		if ((count % RestartInterval) == 0) {
+			if ((restart >= restartCount_)
+			    || (restartRecord(restart) != reader.pos_)) {
+				return false;
+			}
+
+			reader.path_.clear();
+			restart++;
+		}
+
+		if (!reader.next())
+			break;
+
+		count++;
+	}
+
+	return !reader.error_ && (count == baseCount_)
+	       && (restart == restartCount_);
+}
+
+/**
+ * Releases the mapping of the base file.
+ */
+void FileIndex::unmap()
+{
+	if (base_ != NULL)
+		file_.unmap(const_cast<uchar*>(base_));
+
+	file_.close();
+	base_ = NULL;
+	restarts_ = NULL;
+	baseSize_ = 0;
+	baseCount_ = 0;
+	restartCount_ = 0;
+	generation_ = 0;
+}
+
+/**
+ * Replays the journal into the in-memory lists of added and removed paths.
+ * A journal of another generation than the base file is left over from a
+ * merge that was interrupted before the journal was removed, and is ignored.
+ * @return true if successful, false if the journal is corrupt
+ */
+bool FileIndex::readJournal()
+{
+	QFile file(journalPath());
+	if (!file.exists())
+		return true;
+
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	// A journal without a complete header was not started before a crash.
+	QByteArray header = file.readLine();
+	if (!header.endsWith('\n'))
+		return true;
+
+	if (!header.startsWith('#'))
+		return false;
+
+	header.chop(1);
+	if (header.mid(1).toUInt() != generation_) {
+		qDebug() << "Ignoring stale journal" << journalPath();
+		return true;
+	}
+
+	journalValid_ = true;
+
+	while (!file.atEnd()) {
+		QByteArray line = file.readLine();
+		if (!line.endsWith('\n'))
+			break;
+
+		line.chop(1);
+		if (line.startsWith('+')) {
+			int sep = line.indexOf(' ');
+			if (sep < 0)
+				return false;
+
+			quint32 id = line.mid(1, sep - 1).toUInt();
+			QByteArray key = line.mid(sep + 1);
+			if (!removed_.remove(key))
+				added_.insert(key, id);
+
+			if (id >= nextId_)
+				nextId_ = id + 1;
+		}
+		else if (line.startsWith('-')) {
+			QByteArray key = line.mid(1);
+			if (added_.remove(key) == 0)
+				removed_.insert(key);
+		}
+		else {
+			return false;
+		}
+
+		journalSize_++;
+	}
+
+	return true;
+}
+
+/**
+ * Writes records to the end of the journal.
+ * Unless the journal applies to the base file, it is started anew, with the
+ * generation of the base file.
+ * Merges the journal into the base file if it has grown too large.
+ * @param  records  Text records to append
+ * @return true if successful, false otherwise
+ */
+bool FileIndex::appendJournal(const QByteArray& records)
+{
+	if (records.isEmpty())
+		return true;
+
+	QFile file(journalPath());
+	QByteArray data;
+	QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Append;
+	if (!journalValid_) {
+		data = "#" + QByteArray::number(generation_) + "\n";
+		mode = QIODevice::WriteOnly | QIODevice::Truncate;
+	}
+
+	if (!file.open(mode))
+		return false;
+
+	data += records;
+	if (file.write(data) != data.size())
+		return false;
+
+	file.close();
+	journalValid_ = true;
+
+	// Lookups in the journalled changes are cheap, but the journal is replayed
+	// on every open.
+	if (journalSize_ > (baseCount_ / 8) + 1024)
+		return compact();
+
+	return true;
+}
+
+/**
+ * Merges the journal into a new base file.
+ * @return true if successful, false otherwise
+ */
+bool FileIndex::compact()
+{
+	QMap<QByteArray, quint32> pathMap = added_;
+
+	if (base_ != NULL) {
+		Reader reader(base_ + HeaderSize, restarts_);
+		while (reader.next()) {
+			if (!removed_.contains(reader.path_))
+				pathMap.insert(reader.path_, reader.id_);
+		}
+	}
+
+	return writeBase(pathMap);
+}
+
+/**
+ * Creates a new base file and clears the journal.
+ * The file is written under a temporary name, and then atomically replaces the
+ * current one. A crash before the journal is removed leaves a journal of the
+ * previous generation, which is ignored when the index is opened.
+ * @param  pathMap  A sorted map of paths to identifiers
+ * @return true if successful, false otherwise
+ */
+bool FileIndex::writeBase(const QMap<QByteArray, quint32>& pathMap)
+{
+	QByteArray data;
+	QList<quint32> restartList;
+	QByteArray prev;
+	uint count = 0;
+
+	// Reserve room for the header.
+	data.fill(0, HeaderSize);
+
+	QMap<QByteArray, quint32>::ConstIterator itr;
+	for (itr = pathMap.begin(); itr != pathMap.end(); ++itr, count++) {
+		const QByteArray& key = itr.key();
+
+		// Compute the length of the prefix shared with the previous path.
+		int shared = 0;
+		if ((count % RestartInterval) == 0) {
+			restartList.append(data.size());
+		}
+		else {
+			int max = qMin(key.size(), prev.size());
+			while ((shared < max) && (key[shared] == prev[shared]))
+				shared++;
+		}
+
+		writeVarint(shared, data);
+		writeVarint(key.size() - shared, data);
+		data.append(key.constData() + shared, key.size() - shared);
+		writeVarint(*itr, data);
+
+		prev = key;
+	}
+
+	// Write the restart point table.
+	quint32 offset = data.size();
+	foreach (quint32 restart, restartList) {
+		uchar buf[4];
+		qToLittleEndian(restart, buf);
+		data.append(reinterpret_cast<char*>(buf), 4);
+	}
+
+	// Fill in the header.
+	uchar* header = reinterpret_cast<uchar*>(data.data());
+	memcpy(header, Magic, sizeof(Magic));
+	qToLittleEndian(Version, header + 4);
+	qToLittleEndian(quint32(count), header + 8);
+	qToLittleEndian(nextId_, header + 12);
+	qToLittleEndian(quint32(restartList.size()), header + 16);
+	qToLittleEndian(offset, header + 20);
+	qToLittleEndian(generation_ + 1, header + 24);
+
+	// Write to a temporary file.
+	QString tmpPath = path_ + ".tmp";
+	QFile file(tmpPath);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	if ((file.write(data) != data.size()) || !file.flush()
+	    || (fsync(file.handle()) != 0)) {
+		file.remove();
+		return false;
+	}
+
+	file.close();
+
+	// Replace the current base file.
+	unmap();
+	if (::rename(QFile::encodeName(tmpPath), QFile::encodeName(path_)) != 0) {
+		file.remove();
+		map();
+		return false;
+	}
+
+	// The journal is now merged.
+	QFile::remove(journalPath());
+	added_.clear();
+	removed_.clear();
+	journalSize_ = 0;
+	journalValid_ = false;
+
+	return map();
+}
+
+/**
+ * Finds the identifier of a path in the base file.
+ * Runs a binary search over the restart points, followed by a linear scan of
+ * at most RestartInterval records.
+ * @param  key  The encoded path to look for
+ * @return The identifier, -1 if the path is not in the base file
+ */
+int FileIndex::lookupBase(const QByteArray& key) const
+{
+	if (restartCount_ == 0)
+		return -1;
+
+	// Find the last restart point whose path is not greater than the key.
+	uint low = 0, high = restartCount_;
+	while (high - low > 1) {
+		uint mid = (low + high) / 2;
+		Reader reader(restartRecord(mid), restarts_);
+		reader.next();
+
+		if (key < reader.path_)
+			high = mid;
+		else
+			low = mid;
+	}
+
+	// Scan forward from the restart point.
+	Reader reader(restartRecord(low), restarts_);
+	for (uint i = 0; (i < RestartInterval) && reader.next(); i++) {
+		if (reader.path_ == key)
+			return reader.id_;
+
+		if (key < reader.path_)
+			break;
+	}
+
+	return -1;
+}
+
+/**
+ * @param  index  The ordinal number of a restart point
+ * @return The position of the record at the given restart point
+ */
+const uchar* FileIndex::restartRecord(uint index) const
+{
+	return base_ + qFromLittleEndian<quint32>(restarts_ + (index * 4));
+}
+
+/**
+ * Decodes the next record.
+ * A record that runs past the end of the records, or shares more than the
+ * previous path, sets error_.
+ * @return true if successful, false if there are no more records, or the
+ *         record is corrupt
+ */
+bool FileIndex::Reader::next()
+{
+	if (error_ || (pos_ >= end_))
+		return false;
+
+	quint32 shared, len;
+	if (!readVarint(pos_, end_, shared) || !readVarint(pos_, end_, len)
+	    || (shared > quint32(path_.size()))
+	    || (len > quint32(end_ - pos_))) {
+		error_ = true;
+		return false;
+	}
+
+	path_.truncate(shared);
+	path_.append(reinterpret_cast<const char*>(pos_), len);
+	pos_ += len;
+
+	if (!readVarint(pos_, end_, id_)) {
+		error_ = true;
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace Cscope
+
+} // namespace KScope
@@ -0,0 +1,180 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CSCOPE_FILEINDEX_H__
+#define __CSCOPE_FILEINDEX_H__
+
+#include <QFile>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+#include <core/globals.h>
+
+namespace KScope
+{
+
+namespace Cscope
+{
+
+/**
+ * A sorted, prefix-compressed list of file paths, with a stable numeric
+ * identifier for each path.
+ * The list is kept in two files:
+ * - A base file, holding all paths in sorted order. Paths are front-coded
+ *   (each record stores only the suffix that differs from the previous path),
+ *   with a full path stored every RestartInterval records. A table of these
+ *   restart points allows for a binary search. The file is memory-mapped.
+ * - A journal, to which additions and removals are appended. The journal is
+ *   replayed into memory when the index is opened, and merged into a new base
+ *   file once it grows too large. Both files carry a generation number, so
+ *   that a journal already merged into the base file is not replayed again.
+ * Identifiers are never reused, so that they remain valid for as long as the
+ * path is part of the list.
+ * @author Elad Lahav
+ */
+class FileIndex
+{
+public:
+	FileIndex();
+	~FileIndex();
+
+	bool open(const QString&);
+	void close();
+	bool build(const QStringList&);
+	bool add(const QStringList&);
+	bool remove(const QStringList&);
+	int lookup(const QString&) const;
+	void getFiles(Core::Callback<const QString&>&) const;
+
+	/**
+	 * @return The number of paths in the list
+	 */
+	uint count() const { return baseCount_ - removed_.size() + added_.size(); }
+
+	/**
+	 * The number of records between full (uncompressed) paths.
+	 */
+	static const uint RestartInterval = 16;
+
+private:
+	/**
+	 * The path of the base file.
+	 * The journal uses the same path, with a ".log" extension.
+	 */
+	QString path_;
+
+	/**
+	 * The base file.
+	 */
+	QFile file_;
+
+	/**
+	 * Mapped contents of the base file (NULL if there is no base file).
+	 */
+	const uchar* base_;
+
+	/**
+	 * The size of the mapped base file.
+	 */
+	qint64 baseSize_;
+
+	/**
+	 * Number of paths in the base file.
+	 */
+	uint baseCount_;
+
+	/**
+	 * Number of restart points in the base file.
+	 */
+	uint restartCount_;
+
+	/**
+	 * Location of the restart point table in the base file.
+	 */
+	const uchar* restarts_;
+
+	/**
+	 * The generation of the base file (0 if there is no base file).
+	 */
+	quint32 generation_;
+
+	/**
+	 * The next identifier to assign.
+	 */
+	quint32 nextId_;
+
+	/**
+	 * Paths added since the base file was written, with their identifiers.
+	 */
+	QMap<QByteArray, quint32> added_;
+
+	/**
+	 * Paths in the base file that were removed since it was written.
+	 */
+	QSet<QByteArray> removed_;
+
+	/**
+	 * Number of records in the journal.
+	 */
+	uint journalSize_;
+
+	/**
+	 * Whether the journal file applies to the base file.
+	 */
+	bool journalValid_;
+
+	bool map();
+	void unmap();
+	bool readJournal();
+	bool appendJournal(const QByteArray&);
+	bool compact();
+	bool writeBase(const QMap<QByteArray, quint32>&);
+	int lookupBase(const QByteArray&) const;
+	const uchar* restartRecord(uint) const;
+
+	inline QString journalPath() const { return path_ + ".log"; }
+
+	/**
+	 * Iterates over the records in the base file.
+	 */
+	struct Reader
+	{
+		Reader(const uchar* pos, const uchar* end)
+			: pos_(pos), end_(end), id_(0), error_(false) {}
+
+		bool next();
+
+		const uchar* pos_;
+		const uchar* end_;
+		QByteArray path_;
+		quint32 id_;
+
+		/**
+		 * Whether a corrupt record was found.
+		 */
+		bool error_;
+	};
+};
+
+} // namespace Cscope
+
+} // namespace KScope
+
+#endif // __CSCOPE_FILEINDEX_H__
@@ -20,6 +20,8 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QDateTime>
+#include <QSet>
 #include <QTextStream>
 #include <core/exception.h>
 #include "files.h"
@@ -34,7 +36,8 @@ namespace Cscope
  * Class constructor.
  * @param  parent  Parent object
  */
-Files::Files(QObject* parent) : Core::Codebase(parent), writable_(false)
+Files::Files(QObject* parent) : Core::Codebase(parent), indexed_(false),
+                                writable_(false), empty_(true)
 {
 }
 
@@ -64,6 +67,10 @@ void Files::create(const QString& path)
 	path_ = dir.filePath("cscope.files");
 	writable_ = true;
 	empty_ = true;
+
+	// Start with an empty index.
+	indexed_ = index_.open(path_ + ".idx")
+	           && index_.build(QStringList());
 }
 
 void Files::open(const QString& path, Core::Callback<>* cb)
@@ -83,6 +90,7 @@ void Files::open(const QString& path, Core::Callback<>* cb)
 		path_ = dir.filePath("cscope.files");
 		writable_ = fi.isWritable();
 		empty_ = (fi.size() == 0);
+		loadIndex();
 	}
 	else {
 		// No, create a new file.
@@ -94,6 +102,8 @@ void Files::open(const QString& path, Core::Callback<>* cb)
 		}
 	}
 
+	loadPaths();
+
 	if (cb)
 		cb->call();
 }
@@ -103,8 +113,17 @@ void Files::save(const QString& path)
 	(void)path;
 }
 
+/**
+ * Calls the given callback for each file in the code base.
+ * @param  cb  The callback object
+ */
 void Files::getFiles(Core::Callback<const QString&>& cb) const
 {
+	if (indexed_) {
+		index_.getFiles(cb);
+		return;
+	}
+
 	QFile file(path_);
 	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
 		return;
@@ -114,18 +133,198 @@ void Files::getFiles(Core::Callback<const QString&>& cb) const
 		cb.call(strm.readLine());
 }
 
+/**
+ * Replaces the list of files in the code base.
+ * Only the differences between the current and new lists are applied to the
+ * index.
+ * @param  fileList  The new list of files
+ */
 void Files::setFiles(const QStringList& fileList)
 {
+	// Get the current list.
+	QStringList curList;
+	FileListCallback cb(curList);
+	getFiles(cb);
+
+	// Files in the current list that are not in the new one are removed.
+	// Whatever is left in the new set after this pass is added.
+	QSet<QString> newSet = fileList.toSet();
+	QStringList removeList;
+	QStringList::ConstIterator itr;
+	for (itr = curList.begin(); itr != curList.end(); ++itr) {
+		if (!newSet.remove(*itr))
+			removeList.append(*itr);
+	}
+
+	update(newSet.toList(), removeList);
+}
+
+/**
+ * Adds files to the code base.
+ * @param  fileList  The files to add
+ */
+void Files::addFiles(const QStringList& fileList)
+{
+	update(fileList, QStringList());
+}
+
+/**
+ * Removes files from the code base.
+ * @param  fileList  The files to remove
+ */
+void Files::removeFiles(const QStringList& fileList)
+{
+	update(QStringList(), fileList);
+}
+
+/**
+ * Loads the file index.
+ * The index is (re)built from the cscope.files file if it does not exist, is
+ * corrupt or is older than the text file (which means the latter was modified
+ * by someone else).
+ */
+void Files::loadIndex()
+{
+	QString idxPath = path_ + ".idx";
+	QFileInfo listInfo(path_);
+	QFileInfo idxInfo(idxPath);
+	QFileInfo logInfo(idxPath + ".log");
+
+	// Get the time of the last change to the index.
+	QDateTime stamp = idxInfo.lastModified();
+	if (logInfo.exists() && (logInfo.lastModified() > stamp))
+		stamp = logInfo.lastModified();
+
+	bool import = !idxInfo.exists() || (listInfo.lastModified() > stamp);
+
+	// Discard a corrupt index.
+	indexed_ = index_.open(idxPath);
+	if (!indexed_) {
+		QFile::remove(idxPath);
+		QFile::remove(idxPath + ".log");
+		indexed_ = index_.open(idxPath);
+		import = true;
+	}
+
+	if (!indexed_ || !import)
+		return;
+
+	// Read the text file.
+	QStringList fileList;
 	QFile file(path_);
-	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+	if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		QTextStream strm(&file);
+		while (!strm.atEnd()) {
+			QString line = strm.readLine();
+			if (!line.isEmpty())
+				fileList.append(line);
+		}
+	}
+
+	// Identifiers are preserved for files that were already indexed.
+	indexed_ = index_.build(fileList);
+}
+
+/**
+ * Fills the in-memory index with the current list of files.
+ */
+void Files::loadPaths()
+{
+	QStringList fileList;
+	FileListCallback cb(fileList);
+	getFiles(cb);
+
+	paths_.clear();
+	paths_.add(fileList);
+}
+
+/**
+ * Applies changes to the file list.
+ * Only the files that are actually added or removed are looked at; the rest of
+ * the list is streamed from the index into the text file. The cscope.files
+ * file is written first, so that the index is never older than the text file.
+ * @param  addList     Files to add
+ * @param  removeList  Files to remove
+ */
+void Files::update(const QStringList& addList, const QStringList& removeList)
+{
+	// Without an index, the text file is read into memory for lookups.
+	QStringList curList;
+	QSet<QString> curSet;
+	if (!indexed_) {
+		FileListCallback cb(curList);
+		getFiles(cb);
+		curSet = curList.toSet();
+	}
+
+	// Keep only the changes that apply to the current list.
+	QSet<QString> addSet;
+	QSet<QString> removeSet;
+	QStringList::ConstIterator itr;
+	for (itr = removeList.begin(); itr != removeList.end(); ++itr) {
+		if (indexed_ ? (index_.lookup(*itr) >= 0) : curSet.contains(*itr))
+			removeSet.insert(*itr);
+	}
+	for (itr = addList.begin(); itr != addList.end(); ++itr) {
+		if (itr->isEmpty() || removeSet.contains(*itr))
+			continue;
+
+		if (indexed_ ? (index_.lookup(*itr) < 0) : !curSet.contains(*itr))
+			addSet.insert(*itr);
+	}
+
+	if (addSet.isEmpty() && removeSet.isEmpty())
 		return;
 
+	// Export the text file for Cscope.
+	QStringList newList = addSet.toList();
+	newList.sort();
+	if (!exportFiles(curList, newList, removeSet))
+		return;
+
+	// Update the index.
+	QStringList oldList = removeSet.toList();
+	if (indexed_)
+		indexed_ = index_.remove(oldList) && index_.add(newList);
+
+	paths_.remove(oldList);
+	paths_.add(newList);
+
+	if (indexed_)
+		empty_ = (index_.count() == 0);
+	else
+		empty_ = (curList.size() - removeSet.size() + addSet.size() == 0);
+}
+
+/**
+ * Writes the cscope.files file.
+ * The current list is taken from the index, or from the given list if there
+ * is no index. The added files are merged into it in sorted order.
+ * @param  curList    The current list of files, if there is no index
+ * @param  addList    A sorted list of files to add
+ * @param  removeSet  Files to leave out
+ * @return true if successful, false otherwise
+ */
+bool Files::exportFiles(const QStringList& curList, const QStringList& addList,
+                        const QSet<QString>& removeSet)
+{
+	QFile file(path_);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		return false;
+
 	QTextStream strm(&file);
-	QStringList::ConstIterator itr;
-	for (itr = fileList.begin(); itr != fileList.end(); ++itr)
-		strm << *itr << endl;
+	ExportCallback cb(strm, addList, removeSet);
+	if (indexed_) {
+		index_.getFiles(cb);
+	}
+	else {
+		QStringList::ConstIterator itr;
+		for (itr = curList.begin(); itr != curList.end(); ++itr)
+			cb.call(*itr);
+	}
 
-	empty_ = fileList.isEmpty();
+	cb.finish();
+	return true;
 }
 
 } // namespace Cscope
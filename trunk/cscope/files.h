@@ -21,7 +21,11 @@
 #ifndef __CSCOPE_FILES_H__
 #define __CSCOPE_FILES_H__
 
+#include <QSet>
+#include <QTextStream>
 #include <core/codebase.h>
+#include <core/pathindex.h>
+#include "fileindex.h"
 
 namespace KScope
 {
@@ -33,6 +37,12 @@ namespace Cscope
  * Manages a cscope.files file.
  * A cscope.files file is a text file containing the name of each file in the
  * project on a separate line.
+ * The list is kept in an indexed form (see FileIndex), which is what the
+ * class reads from and modifies. The text file is only written for the
+ * benefit of the Cscope executable, and is re-imported if it is modified
+ * outside KScope.
+ * The paths are also kept in memory (see Core::PathIndex), for finding files
+ * by name without running Cscope.
  * @author Elad Lahav
  */
 class Files : public Core::Codebase
@@ -52,6 +62,18 @@ public:
 	void setFiles(const QStringList&);
 	bool canModify() { return writable_; }
 	bool needFiles() { return writable_ && empty_; }
+	const Core::PathIndex* pathIndex() const { return &paths_; }
+
+	void addFiles(const QStringList&);
+	void removeFiles(const QStringList&);
+
+	/**
+	 * @param  path  A file path
+	 * @return A numeric identifier for the path, which does not change for as
+	 *         long as the file is a part of the code base, or -1 if the file
+	 *         is not in the code base
+	 */
+	int fileId(const QString& path) const { return index_.lookup(path); }
 
 private:
 	/**
@@ -59,6 +81,23 @@ private:
 	 */
 	QString path_;
 
+	/**
+	 * Indexed version of the file list.
+	 */
+	FileIndex index_;
+
+	/**
+	 * In-memory version of the file list.
+	 */
+	Core::PathIndex paths_;
+
+	/**
+	 * Whether the index is available.
+	 * If not (e.g., the project directory is read-only), the text file is
+	 * used directly.
+	 */
+	bool indexed_;
+
 	/**
 	 * Whether the file can be written to.
 	 */
@@ -68,6 +107,56 @@ private:
 	 * Whether the file contains any data.
 	 */
 	bool empty_;
+
+	void loadIndex();
+	void loadPaths();
+	void update(const QStringList&, const QStringList&);
+	bool exportFiles(const QStringList&, const QStringList&,
+	                 const QSet<QString>&);
+
+	/**
+	 * Collects the file list into a QStringList.
+	 */
+	struct FileListCallback : public Core::Callback<const QString&>
+	{
+		QStringList& list_;
+
+		FileListCallback(QStringList& list) : list_(list) {}
+
+		void call(const QString& file) {
+			list_.append(file);
+		}
+	};
+
+	/**
+	 * Writes the file list to a stream, leaving out removed files and
+	 * merging in a sorted list of added ones.
+	 */
+	struct ExportCallback : public Core::Callback<const QString&>
+	{
+		QTextStream& strm_;
+		QStringList::ConstIterator add_;
+		QStringList::ConstIterator addEnd_;
+		const QSet<QString>& removeSet_;
+
+		ExportCallback(QTextStream& strm, const QStringList& addList,
+		               const QSet<QString>& removeSet)
+			: strm_(strm), add_(addList.begin()), addEnd_(addList.end()),
+			  removeSet_(removeSet) {}
+
+		void call(const QString& file) {
+			for (; (add_ != addEnd_) && (*add_ < file); ++add_)
+				strm_ << *add_ << '\n';
+
+			if (!removeSet_.contains(file))
+				strm_ << file << '\n';
+		}
+
+		void finish() {
+			for (; add_ != addEnd_; ++add_)
+				strm_ << *add_ << '\n';
+		}
+	};
 };
 
 } // namespace Cscope
@@ -33,6 +33,8 @@ namespace Cscope
 ManagedProject::ManagedProject(const QString& projPath)
 	: Core::Project<Crossref, Files>("project.conf", projPath)
 {
+	// Let the engine answer file queries from the code base's file list.
+	engine_.setPathIndex(codebase_.pathIndex());
 }
 
 /**
@@ -82,12 +82,16 @@ struct ProjectConfig<Cscope::ManagedProject>
 			widget->kernelCheck_->setChecked(args.contains("-k"));
 			widget->invIndexCheck_->setChecked(args.contains("-q"));
 			widget->compressCheck_->setChecked(!args.contains("-c"));
+			widget->trigramCheck_->setChecked(args.contains("-t"));
+			widget->fingerprintCheck_->setChecked(args.contains("-H"));
 		}
 		else {
 			// New project: set default configuration.
 			widget->kernelCheck_->setChecked(false);
 			widget->invIndexCheck_->setChecked(true);
 			widget->compressCheck_->setChecked(true);
+			widget->trigramCheck_->setChecked(false);
+			widget->fingerprintCheck_->setChecked(false);
 		}
 
 		return widget;
@@ -112,6 +116,10 @@ struct ProjectConfig<Cscope::ManagedProject>
 				params.engineString_ += ":-q";
 			if (!confWidget->compressCheck_->isChecked())
 				params.engineString_ += ":-c";
+			if (confWidget->trigramCheck_->isChecked())
+				params.engineString_ += ":-t";
+			if (confWidget->fingerprintCheck_->isChecked())
+				params.engineString_ += ":-H";
 		}
 	}
 };
@@ -0,0 +1,450 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include <QtEndian>
+#include <QDebug>
+#include <string.h>
+#include "symbolindex.h"
+
+namespace KScope
+{
+
+namespace Cscope
+{
+
+/**
+ * File layout (all integers are little-endian):
+ * 0   "KSSY"
+ * 4   Format version
+ * 8   Number of names
+ * 12  Offset of the name table
+ * 16  The names, each in UTF-8 and terminated by a null character, sorted in
+ *     byte order
+ * The name table holds the offset of each name, as a 32-bit integer.
+ */
+static const char Magic[4] = { 'K', 'S', 'S', 'Y' };
+static const quint32 Version = 1;
+static const uint HeaderSize = 16;
+
+/**
+ * Converts an ASCII upper-case letter to lower case.
+ * Other characters, including bytes of multi-byte UTF-8 sequences, are not
+ * affected.
+ * @param  c  The character to convert
+ * @return The converted character
+ */
+static inline char foldCase(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/**
+ * Converts all ASCII upper-case letters in a string to lower case.
+ * @param  str  The string to convert
+ * @return The converted string
+ */
+static QByteArray foldCase(const QByteArray& str)
+{
+	QByteArray result = str;
+	for (int i = 0; i < result.size(); i++)
+		result[i] = foldCase(result[i]);
+
+	return result;
+}
+
+/**
+ * Determines whether a name contains the given text, ignoring case.
+ * @param  name  A null-terminated name
+ * @param  text  The text to look for, converted to lower case
+ * @return true if the text was found, false otherwise
+ */
+static inline bool containsText(const char* name, const QByteArray& text)
+{
+	const char* str = text.constData();
+	int len = text.size();
+
+	for (; *name; name++) {
+		// The null character at the end of the name never matches.
+		int i = 0;
+		while ((i < len) && (foldCase(name[i]) == str[i]))
+			i++;
+
+		if (i == len)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * A name matching a fuzzy lookup.
+ * Matches are ordered by the number of characters skipped in the name before
+ * and between the characters of the text, then by the length of the name,
+ * and finally by the name itself.
+ */
+struct FuzzyMatch
+{
+	int skipped_;
+	int length_;
+	uint index_;
+
+	bool operator<(const FuzzyMatch& other) const {
+		if (skipped_ != other.skipped_)
+			return skipped_ < other.skipped_;
+
+		if (length_ != other.length_)
+			return length_ < other.length_;
+
+		return index_ < other.index_;
+	}
+};
+
+/**
+ * Matches a name against the characters of the given text, in order.
+ * Characters are matched as early as possible in the name.
+ * @param  name   A null-terminated name
+ * @param  text   The text to match, converted to lower case
+ * @param  match  Holds the match properties, upon successful return
+ * @return true if all characters were matched, false otherwise
+ */
+static inline bool matchFuzzy(const char* name, const QByteArray& text,
+                              FuzzyMatch& match)
+{
+	const char* str = text.constData();
+	const char* end = str + text.size();
+	int pos, last = -1;
+
+	match.skipped_ = 0;
+	for (pos = 0; name[pos]; pos++) {
+		if ((str == end) || (foldCase(name[pos]) != *str))
+			continue;
+
+		match.skipped_ += pos - last - 1;
+		last = pos;
+		str++;
+	}
+
+	match.length_ = pos;
+	return str == end;
+}
+
+/**
+ * Class constructor.
+ */
+SymbolIndex::SymbolIndex() : base_(NULL), size_(0), count_(0), table_(NULL)
+{
+}
+
+/**
+ * Class destructor.
+ */
+SymbolIndex::~SymbolIndex()
+{
+	close();
+}
+
+/**
+ * Maps a dictionary file into memory and validates its header and name table.
+ * A missing file describes an empty dictionary.
+ * @param  path  The path of the dictionary file
+ * @return true if successful, false if the file is corrupt
+ */
+bool SymbolIndex::open(const QString& path)
+{
+	close();
+
+	file_.setFileName(path);
+	if (!file_.exists())
+		return true;
+
+	if (!file_.open(QIODevice::ReadOnly))
+		return false;
+
+	size_ = file_.size();
+	if (size_ < HeaderSize) {
+		close();
+		return false;
+	}
+
+	base_ = file_.map(0, size_);
+	if (base_ == NULL) {
+		close();
+		return false;
+	}
+
+	if ((memcmp(base_, Magic, sizeof(Magic)) != 0)
+	    || (qFromLittleEndian<quint32>(base_ + 4) != Version)) {
+		qDebug() << "Invalid symbol index" << path;
+		close();
+		return false;
+	}
+
+	// The names must be followed by a null character, so that a scan never
+	// runs past them.
+	count_ = qFromLittleEndian<quint32>(base_ + 8);
+	quint32 offset = qFromLittleEndian<quint32>(base_ + 12);
+	if ((offset < HeaderSize)
+	    || (offset + quint64(count_) * 4 > quint64(size_))
+	    || ((count_ > 0) && (base_[offset - 1] != 0))) {
+		close();
+		return false;
+	}
+
+	table_ = base_ + offset;
+
+	// Every name must start between the header and the table, so that name()
+	// always points into the names.
+	for (uint i = 0; i < count_; i++) {
+		quint32 nameOffset = qFromLittleEndian<quint32>(table_ + (i * 4));
+		if ((nameOffset < HeaderSize) || (nameOffset >= offset)) {
+			qDebug() << "Invalid symbol index" << path;
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Releases the mapping of the dictionary file.
+ */
+void SymbolIndex::close()
+{
+	if (base_ != NULL)
+		file_.unmap(const_cast<uchar*>(base_));
+
+	file_.close();
+	base_ = NULL;
+	table_ = NULL;
+	size_ = 0;
+	count_ = 0;
+	fuzzyCache_.clear();
+}
+
+/**
+ * Finds names matching the given text.
+ * Prefix and substring matches are returned in sorted order, fuzzy matches
+ * with the closest ones first.
+ * @param  text  The text to match
+ * @param  mode  How to match names against the text
+ * @param  max   The maximal number of names to return
+ * @return The matching names
+ */
+QStringList SymbolIndex::lookup(const QString& text,
+                                Core::Engine::MatchMode mode, int max) const
+{
+	QStringList result;
+
+	if ((base_ == NULL) || text.isEmpty() || (max <= 0))
+		return result;
+
+	switch (mode) {
+	case Core::Engine::PrefixMatch:
+		findPrefix(text.toUtf8(), max, result);
+		break;
+
+	case Core::Engine::SubstringMatch:
+		findSubstring(foldCase(text.toUtf8()), max, result);
+		break;
+
+	case Core::Engine::FuzzyMatch:
+		findFuzzy(foldCase(text.toUtf8()), max, result);
+		break;
+	}
+
+	return result;
+}
+
+/**
+ * Writes a dictionary file.
+ * The file is written under a temporary name, and then replaces the current
+ * one, so that readers holding a mapping of the old file are not affected.
+ * @param  path   The path of the dictionary file
+ * @param  names  The names to store
+ * @return true if successful, false otherwise
+ */
+bool SymbolIndex::write(const QString& path, const QSet<QString>& names)
+{
+	// Sort by the encoded names, which is the order used for lookups.
+	QList<QByteArray> sorted;
+	foreach (QString name, names) {
+		QByteArray data = name.toUtf8();
+		if (!data.isEmpty() && !data.contains('\0'))
+			sorted.append(data);
+	}
+
+	qSort(sorted);
+
+	QByteArray data;
+	QByteArray table;
+
+	// Reserve room for the header.
+	data.fill(0, HeaderSize);
+
+	foreach (const QByteArray& name, sorted) {
+		uchar entry[4];
+
+		qToLittleEndian(quint32(data.size()), entry);
+		table.append(reinterpret_cast<char*>(entry), sizeof(entry));
+
+		data.append(name);
+		data.append('\0');
+	}
+
+	// Fill in the header.
+	uchar* header = reinterpret_cast<uchar*>(data.data());
+	memcpy(header, Magic, sizeof(Magic));
+	qToLittleEndian(Version, header + 4);
+	qToLittleEndian(quint32(sorted.size()), header + 8);
+	qToLittleEndian(quint32(data.size()), header + 12);
+	data.append(table);
+
+	// Write to a temporary file.
+	QString tmpPath = path + ".tmp";
+	QFile file(tmpPath);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	if (file.write(data) != data.size()) {
+		file.remove();
+		return false;
+	}
+
+	file.close();
+
+	// Replace the current file.
+	QFile::remove(path);
+	return file.rename(path);
+}
+
+/**
+ * @param  index  The position of a name in the sorted order
+ * @return The null-terminated name
+ */
+const char* SymbolIndex::name(uint index) const
+{
+	quint32 offset = qFromLittleEndian<quint32>(table_ + (index * 4));
+	return reinterpret_cast<const char*>(base_ + offset);
+}
+
+/**
+ * Finds the names starting with the given text.
+ * Runs a binary search for the first name that is not smaller than the text,
+ * and collects names from that point on, as long as they match.
+ * @param  text    The prefix to look for
+ * @param  max     The maximal number of names to return
+ * @param  result  Holds the matching names
+ */
+void SymbolIndex::findPrefix(const QByteArray& text, int max,
+                             QStringList& result) const
+{
+	uint low = 0, high = count_;
+	while (low < high) {
+		uint mid = (low + high) / 2;
+		if (strcmp(name(mid), text.constData()) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (uint i = low; (i < count_) && (result.size() < max); i++) {
+		const char* str = name(i);
+		if (strncmp(str, text.constData(), text.size()) != 0)
+			break;
+
+		result.append(QString::fromUtf8(str));
+	}
+}
+
+/**
+ * Finds the names containing the given text, ignoring case.
+ * @param  text    The text to look for, converted to lower case
+ * @param  max     The maximal number of names to return
+ * @param  result  Holds the matching names
+ */
+void SymbolIndex::findSubstring(const QByteArray& text, int max,
+                                QStringList& result) const
+{
+	for (uint i = 0; (i < count_) && (result.size() < max); i++) {
+		const char* str = name(i);
+		if (containsText(str, text))
+			result.append(QString::fromUtf8(str));
+	}
+}
+
+/**
+ * Finds the names containing the characters of the given text, in order,
+ * ignoring case.
+ * Scans the names matching the longest prefix of the text for which a lookup
+ * was cached, or all names, keeping the closest matches found so far. The
+ * matches of the text are then cached in turn.
+ * @param  text    The text to match, converted to lower case
+ * @param  max     The maximal number of names to return
+ * @param  result  Holds the matching names
+ */
+void SymbolIndex::findFuzzy(const QByteArray& text, int max,
+                            QStringList& result) const
+{
+	// Drop the cached lookups that do not apply to this text (i.e., after
+	// characters were deleted or replaced).
+	while (!fuzzyCache_.isEmpty()
+	       && !text.startsWith(fuzzyCache_.last().text_)) {
+		fuzzyCache_.removeLast();
+	}
+
+	const QVector<uint>* candidates = NULL;
+	uint scanCount = count_;
+	if (!fuzzyCache_.isEmpty()) {
+		candidates = &fuzzyCache_.last().matches_;
+		scanCount = candidates->size();
+	}
+
+	FuzzyCache cache;
+	QList<FuzzyMatch> best;
+	FuzzyMatch match;
+
+	cache.text_ = text;
+	for (uint j = 0; j < scanCount; j++) {
+		uint i = candidates ? candidates->at(j) : j;
+		if (!matchFuzzy(name(i), text, match))
+			continue;
+
+		cache.matches_.append(i);
+
+		match.index_ = i;
+		if ((best.size() == max) && !(match < best.last()))
+			continue;
+
+		best.insert(qLowerBound(best.begin(), best.end(), match), match);
+		if (best.size() > max)
+			best.removeLast();
+	}
+
+	if (fuzzyCache_.isEmpty() || (fuzzyCache_.last().text_ != text))
+		fuzzyCache_.append(cache);
+
+	foreach (const FuzzyMatch& m, best)
+		result.append(QString::fromUtf8(name(m.index_)));
+}
+
+} // namespace Cscope
+
+} // namespace KScope
@@ -0,0 +1,117 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CSCOPE_SYMBOLINDEX_H__
+#define __CSCOPE_SYMBOLINDEX_H__
+
+#include <QFile>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+#include <core/engine.h>
+
+namespace KScope
+{
+
+namespace Cscope
+{
+
+/**
+ * A dictionary of the names of all symbols defined in the project.
+ * The dictionary is kept in a single memory-mapped file, holding the names in
+ * sorted order, followed by a table of their offsets. Prefix lookups run a
+ * binary search over the table, while substring and fuzzy lookups scan the
+ * names, which are stored contiguously. Fuzzy lookups made as a name is typed
+ * only scan the names that matched the text typed before. The dictionary is generated along
+ * with the tag database (see TagBuilder), and is used to complete symbol
+ * names as they are typed.
+ * @author Elad Lahav
+ */
+class SymbolIndex
+{
+public:
+	SymbolIndex();
+	~SymbolIndex();
+
+	bool open(const QString&);
+	void close();
+	QStringList lookup(const QString&, Core::Engine::MatchMode, int) const;
+
+	/**
+	 * @return The number of names in the dictionary
+	 */
+	uint count() const { return count_; }
+
+	static bool write(const QString&, const QSet<QString>&);
+
+private:
+	/**
+	 * The dictionary file.
+	 */
+	QFile file_;
+
+	/**
+	 * Mapped contents of the file (NULL if there is no dictionary).
+	 */
+	const uchar* base_;
+
+	/**
+	 * The size of the mapped file.
+	 */
+	qint64 size_;
+
+	/**
+	 * Number of names in the dictionary.
+	 */
+	uint count_;
+
+	/**
+	 * Location of the offset table.
+	 */
+	const uchar* table_;
+
+	/**
+	 * The names matching the text of a fuzzy lookup.
+	 */
+	struct FuzzyCache
+	{
+		QByteArray text_;
+		QVector<uint> matches_;
+	};
+
+	/**
+	 * The matches of recent fuzzy lookups, each for a text extending that of
+	 * the one before it.
+	 * A name matching a text also matches any prefix of it, so a lookup only
+	 * scans the matches of the longest cached prefix of its text.
+	 */
+	mutable QList<FuzzyCache> fuzzyCache_;
+
+	const char* name(uint) const;
+	void findPrefix(const QByteArray&, int, QStringList&) const;
+	void findSubstring(const QByteArray&, int, QStringList&) const;
+	void findFuzzy(const QByteArray&, int, QStringList&) const;
+};
+
+} // namespace Cscope
+
+} // namespace KScope
+
+#endif // __CSCOPE_SYMBOLINDEX_H__
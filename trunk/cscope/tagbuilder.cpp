@@ -0,0 +1,228 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+#include <QDebug>
+#include "tagbuilder.h"
+#include "ctags.h"
+
+namespace KScope
+{
+
+namespace Cscope
+{
+
+/**
+ * Class constructor.
+ * @param  path    The project directory, holding cscope.files
+ * @param  dbPath       The path of the database file
+ * @param  symbolsPath  The path of the symbol dictionary file
+ * @param  parent       Parent object
+ */
+TagBuilder::TagBuilder(const QString& path, const QString& dbPath,
+                       const QString& symbolsPath, QObject* parent)
+	: QObject(parent), path_(path), dbPath_(dbPath), symbolsPath_(symbolsPath),
+	  running_(0), failed_(false)
+{
+}
+
+/**
+ * Class destructor.
+ * The builder must not be deleted while Ctags processes are running (see
+ * stop()).
+ */
+TagBuilder::~TagBuilder()
+{
+	qDeleteAll(shards_);
+}
+
+/**
+ * Starts the Ctags processes.
+ * done() is emitted once all of them terminate.
+ * @param  current  The current database, from which the tags of unmodified
+ *                  files are taken
+ */
+void TagBuilder::start(const TagIndex& current)
+{
+	// Find the files that need to be parsed.
+	QStringList pending;
+	foreach (QString file, readFileList()) {
+		QFileInfo fi(file);
+		if (!fi.exists())
+			continue;
+
+		TagIndex::FileTags& ft = fileTags_[file];
+		ft.mtime_ = fi.lastModified().toTime_t();
+		if (!current.lookup(file, ft.mtime_, ft.tags_))
+			pending.append(file);
+	}
+
+	// Divide the files among the processes.
+	int shardNum = qMin(qMax(1, QThread::idealThreadCount()),
+	                    (pending.size() + MinShardSize - 1) / MinShardSize);
+	int shardSize = shardNum > 0 ? (pending.size() + shardNum - 1) / shardNum
+	                             : 0;
+
+	qDebug() << "Parsing tags of" << pending.size() << "of"
+	         << fileTags_.size() << "files in" << shardNum << "shards";
+
+	// All shards are created before any process is started, so that an early
+	// failure does not complete the operation.
+	for (int i = 0; i < shardNum; i++) {
+		Shard* shard = new Shard(this);
+		shard->ctags_ = new Ctags();
+		shard->ctags_->setDeleteOnExit();
+		connect(shard->ctags_, SIGNAL(error(QProcess::ProcessError)), this,
+		        SLOT(ctagsError(QProcess::ProcessError)));
+		shards_.append(shard);
+	}
+
+	running_ = shardNum;
+	for (int i = 0; i < shardNum; i++)
+		shards_[i]->ctags_->query(shards_[i], pending.mid(i * shardSize,
+		                                                  shardSize));
+
+	if (shardNum == 0)
+		finish();
+}
+
+/**
+ * Stops all running Ctags processes.
+ * The database is not written, and done() is emitted once all processes
+ * terminate.
+ */
+void TagBuilder::stop()
+{
+	failed_ = true;
+
+	foreach (Shard* shard, shards_)
+		shard->stop();
+}
+
+/**
+ * Reads the list of files from cscope.files.
+ * @return The absolute paths of the files
+ */
+QStringList TagBuilder::readFileList() const
+{
+	QStringList fileList;
+	QDir dir(path_);
+
+	QFile file(dir.filePath("cscope.files"));
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return fileList;
+
+	QTextStream strm(&file);
+	QString line;
+	while (!(line = strm.readLine()).isNull()) {
+		line = line.trimmed();
+
+		// Skip empty lines and Cscope options.
+		if (line.isEmpty() || line.startsWith('-'))
+			continue;
+
+		if (line.startsWith('"') && line.endsWith('"') && line.size() > 1)
+			line = line.mid(1, line.size() - 2);
+
+		fileList.append(QDir::cleanPath(dir.absoluteFilePath(line)));
+	}
+
+	return fileList;
+}
+
+/**
+ * Called when a Ctags process terminates.
+ * @param  shard  The shard handled by the process
+ * @param  ok     Whether the process terminated normally
+ */
+void TagBuilder::shardDone(Shard* shard, bool ok)
+{
+	(void)shard;
+
+	if (!ok)
+		failed_ = true;
+
+	if (--running_ == 0)
+		finish();
+}
+
+/**
+ * Writes the database and the symbol dictionary, once all processes have
+ * terminated.
+ */
+void TagBuilder::finish()
+{
+	bool ok = !failed_ && TagIndex::write(dbPath_, fileTags_);
+
+	if (ok) {
+		QSet<QString> names;
+		foreach (const TagIndex::FileTags& ft, fileTags_) {
+			foreach (const Core::Location& loc, ft.tags_)
+				names.insert(loc.tag_.name_);
+		}
+
+		ok = SymbolIndex::write(symbolsPath_, names);
+	}
+
+	fileTags_.clear();
+	emit done(ok);
+}
+
+/**
+ * Handles a Ctags process that could not be started.
+ * Such a process does not report termination through its connection.
+ * @param  code  The error code
+ */
+void TagBuilder::ctagsError(QProcess::ProcessError code)
+{
+	if (code != QProcess::FailedToStart)
+		return;
+
+	foreach (Shard* shard, shards_) {
+		if (shard->ctags_ == sender()) {
+			shard->setCtrlObject(NULL);
+			shardDone(shard, false);
+			break;
+		}
+	}
+}
+
+/**
+ * Stores the tags parsed by the shard's process.
+ * @param  locList  Parsed tags
+ */
+void TagBuilder::Shard::onDataReady(const Core::LocationList& locList)
+{
+	QMap<QString, TagIndex::FileTags>& fileTags = builder_->fileTags_;
+
+	foreach (const Core::Location& loc, locList) {
+		QMap<QString, TagIndex::FileTags>::Iterator itr
+			= fileTags.find(loc.file_);
+		if (itr != fileTags.end())
+			itr->tags_.append(loc);
+	}
+}
+
+} // namespace Cscope
+
+} // namespace KScope
@@ -0,0 +1,144 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CSCOPE_TAGBUILDER_H__
+#define __CSCOPE_TAGBUILDER_H__
+
+#include <QObject>
+#include <QProcess>
+#include "tagindex.h"
+#include "symbolindex.h"
+
+namespace KScope
+{
+
+namespace Cscope
+{
+
+class Ctags;
+
+/**
+ * Generates the project's tag database (see TagIndex).
+ * The files listed in cscope.files are divided into shards, each parsed by a
+ * separate Ctags process, with all processes running in parallel. Files that
+ * were not modified since the current database was written keep their
+ * existing tags, and are not parsed again.
+ * The names of all tags are written to a symbol dictionary (see SymbolIndex)
+ * along with the database.
+ * @author Elad Lahav
+ */
+class TagBuilder : public QObject
+{
+	Q_OBJECT
+
+public:
+	TagBuilder(const QString&, const QString&, const QString&,
+	           QObject* parent = NULL);
+	~TagBuilder();
+
+	void start(const TagIndex&);
+	void stop();
+
+	/**
+	 * The minimal number of files handed to a Ctags process.
+	 */
+	static const int MinShardSize = 64;
+
+signals:
+	/**
+	 * Emitted when the builder is done.
+	 * @param  ok  true if a new database and symbol dictionary were written,
+	 *             false otherwise
+	 */
+	void done(bool ok);
+
+private:
+	/**
+	 * Receives the output of a single Ctags process.
+	 */
+	struct Shard : public Core::Engine::Connection
+	{
+		Shard(TagBuilder* builder) : Core::Engine::Connection(Background),
+			builder_(builder) {}
+
+		void onDataReady(const Core::LocationList&);
+		void onFinished() { builder_->shardDone(this, true); }
+		void onAborted() { builder_->shardDone(this, false); }
+		void onProgress(const QString&, uint, uint) {}
+
+		/**
+		 * The owning builder.
+		 */
+		TagBuilder* builder_;
+
+		/**
+		 * The process parsing the shard's files.
+		 */
+		Ctags* ctags_;
+	};
+
+	/**
+	 * The project directory, holding cscope.files.
+	 */
+	QString path_;
+
+	/**
+	 * The path of the database file.
+	 */
+	QString dbPath_;
+
+	/**
+	 * The path of the symbol dictionary file.
+	 */
+	QString symbolsPath_;
+
+	/**
+	 * The tags of all files, collected as the shards are parsed.
+	 */
+	QMap<QString, TagIndex::FileTags> fileTags_;
+
+	/**
+	 * All shards, including terminated ones.
+	 */
+	QList<Shard*> shards_;
+
+	/**
+	 * The number of shards still being parsed.
+	 */
+	int running_;
+
+	/**
+	 * Whether any of the shards failed.
+	 */
+	bool failed_;
+
+	QStringList readFileList() const;
+	void shardDone(Shard*, bool);
+	void finish();
+
+private slots:
+	void ctagsError(QProcess::ProcessError);
+};
+
+} // namespace Cscope
+
+} // namespace KScope
+
+#endif // __CSCOPE_TAGBUILDER_H__
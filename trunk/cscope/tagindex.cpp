@@ -0,0 +1,469 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#include <QtEndian>
+#include <QDir>
+#include <QFileInfo>
+#include <QTimer>
+#include <QDebug>
+#include <string.h>
+#include <core/querystats.h>
+#include "tagindex.h"
+#include "varint.h"
+
+namespace KScope
+{
+
+namespace Cscope
+{
+
+/**
+ * File layout (all integers are little-endian):
+ * 0   "KSTG"
+ * 4   Format version
+ * 8   Number of files
+ * 12  Offset of the file table
+ * 16  For each file, its path followed by its tags, each given as:
+ *     varint  Line number
+ *     byte    Tag type (Core::Tag::Type)
+ *     varint  Length of the tag name
+ *     bytes   Tag name
+ *     varint  Length of the scope
+ *     bytes   Scope
+ * The file table is sorted by path, and holds an entry of EntrySize bytes for
+ * each file:
+ * 0   Offset of the path
+ * 4   Length of the path
+ * 8   Modification time of the file
+ * 12  Offset of the first tag
+ * 16  Number of tags
+ * A tag takes at least MinTagSize bytes. The tags of a file are decoded only
+ * when requested, and are checked against the end of the data at that time.
+ */
+static const char Magic[4] = { 'K', 'S', 'T', 'G' };
+static const quint32 Version = 1;
+static const uint HeaderSize = 16;
+static const uint EntrySize = 20;
+static const uint MinTagSize = 4;
+
+/**
+ * Encodes a length-prefixed string.
+ * @param  str  The string to encode
+ * @param  buf  The buffer to append to
+ */
+static inline void writeString(const QString& str, QByteArray& buf)
+{
+	QByteArray data = str.toUtf8();
+	writeVarint(data.size(), buf);
+	buf.append(data);
+}
+
+/**
+ * Decodes a length-prefixed string.
+ * @param  pos  The position to read from, advanced past the string
+ * @param  end  The end of the data
+ * @param  str  Holds the decoded string, upon successful return
+ * @return true if successful, false if the string overruns the data
+ */
+static inline bool readString(const uchar*& pos, const uchar* end,
+                              QString& str)
+{
+	quint32 len;
+	if (!readVarint(pos, end, len) || (len > quint32(end - pos)))
+		return false;
+
+	str = QString::fromUtf8(reinterpret_cast<const char*>(pos), len);
+	pos += len;
+	return true;
+}
+
+/**
+ * Class constructor.
+ */
+TagIndex::TagIndex() : base_(NULL), size_(0), fileCount_(0), table_(NULL)
+{
+}
+
+/**
+ * Class destructor.
+ */
+TagIndex::~TagIndex()
+{
+	close();
+}
+
+/**
+ * Maps a database file into memory and validates its header and file table.
+ * A missing file describes an empty database.
+ * @param  path  The path of the database file
+ * @return true if successful, false if the file is corrupt
+ */
+bool TagIndex::open(const QString& path)
+{
+	close();
+
+	file_.setFileName(path);
+	if (!file_.exists())
+		return true;
+
+	if (!file_.open(QIODevice::ReadOnly))
+		return false;
+
+	size_ = file_.size();
+	if (size_ < HeaderSize) {
+		close();
+		return false;
+	}
+
+	base_ = file_.map(0, size_);
+	if (base_ == NULL) {
+		close();
+		return false;
+	}
+
+	if ((memcmp(base_, Magic, sizeof(Magic)) != 0)
+	    || (qFromLittleEndian<quint32>(base_ + 4) != Version)) {
+		qDebug() << "Invalid tag index" << path;
+		close();
+		return false;
+	}
+
+	fileCount_ = qFromLittleEndian<quint32>(base_ + 8);
+	quint32 offset = qFromLittleEndian<quint32>(base_ + 12);
+	if ((offset < HeaderSize)
+	    || (offset + quint64(fileCount_) * EntrySize > quint64(size_))) {
+		close();
+		return false;
+	}
+
+	table_ = base_ + offset;
+
+	// Every entry must refer to data between the header and the table.
+	for (uint i = 0; i < fileCount_; i++) {
+		const uchar* pos = table_ + (i * EntrySize);
+		quint32 pathOffset = qFromLittleEndian<quint32>(pos);
+		quint32 pathLen = qFromLittleEndian<quint32>(pos + 4);
+		quint32 tagOffset = qFromLittleEndian<quint32>(pos + 12);
+		quint32 tagCount = qFromLittleEndian<quint32>(pos + 16);
+
+		if ((pathOffset < HeaderSize) || (pathOffset > offset)
+		    || (pathLen > offset - pathOffset) || (tagOffset < HeaderSize)
+		    || (tagOffset > offset)
+		    || (tagCount > (offset - tagOffset) / MinTagSize)) {
+			qDebug() << "Invalid tag index" << path;
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Releases the mapping of the database file.
+ */
+void TagIndex::close()
+{
+	if (base_ != NULL)
+		file_.unmap(const_cast<uchar*>(base_));
+
+	file_.close();
+	base_ = NULL;
+	table_ = NULL;
+	size_ = 0;
+	fileCount_ = 0;
+}
+
+/**
+ * Retrieves the tags of a file, provided that the file was not modified since
+ * its tags were generated.
+ * @param  path  The path of the file
+ * @param  tags  Holds the tags of the file, upon successful return
+ * @return true if successful, false if the file is not in the database, or
+ *         its entry is out of date
+ */
+bool TagIndex::lookup(const QString& path, Core::LocationList& tags) const
+{
+	QFileInfo fi(path);
+	if (!fi.exists())
+		return false;
+
+	return lookup(QDir::cleanPath(fi.absoluteFilePath()),
+	              fi.lastModified().toTime_t(), tags);
+}
+
+/**
+ * Retrieves the tags of a file, provided that they were generated for the
+ * given version of the file.
+ * @param  path   The absolute path of the file
+ * @param  mtime  The modification time of the file
+ * @param  tags   Holds the tags of the file, upon successful return
+ * @return true if successful, false if the file is not in the database, or
+ *         its entry is for a different modification time
+ */
+bool TagIndex::lookup(const QString& path, uint mtime,
+                      Core::LocationList& tags) const
+{
+	int entry = find(QFile::encodeName(path));
+	if (entry < 0)
+		return false;
+
+	const uchar* pos = table_ + (entry * EntrySize);
+	if (qFromLittleEndian<quint32>(pos + 8) != mtime)
+		return false;
+
+	tags.clear();
+	if (!readTags(entry, tags)) {
+		tags.clear();
+		discard();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Calls the given callback for each tag in the database.
+ * Files are visited in sorted order, and tags in the order of appearance in
+ * the file. Entries are not checked against the current state of the files.
+ * @param  cb  The callback object
+ */
+void TagIndex::getTags(Core::Callback<const Core::Location&>& cb) const
+{
+	for (uint i = 0; i < fileCount_; i++) {
+		Core::LocationList tags;
+		if (!readTags(i, tags)) {
+			discard();
+			return;
+		}
+
+		foreach (const Core::Location& loc, tags)
+			cb.call(loc);
+	}
+}
+
+/**
+ * Writes a database file.
+ * The file is written under a temporary name, and then replaces the current
+ * one, so that readers holding a mapping of the old file are not affected.
+ * @param  path      The path of the database file
+ * @param  fileTags  Maps absolute file paths to their tags
+ * @return true if successful, false otherwise
+ */
+bool TagIndex::write(const QString& path,
+                     const QMap<QString, FileTags>& fileTags)
+{
+	// Sort by the encoded paths, which is the order used for lookups.
+	QMap<QByteArray, const FileTags*> sorted;
+	QMap<QString, FileTags>::ConstIterator itr;
+	for (itr = fileTags.begin(); itr != fileTags.end(); ++itr)
+		sorted.insert(QFile::encodeName(itr.key()), &(*itr));
+
+	QByteArray data;
+	QByteArray table;
+
+	// Reserve room for the header.
+	data.fill(0, HeaderSize);
+
+	QMap<QByteArray, const FileTags*>::ConstIterator sitr;
+	for (sitr = sorted.begin(); sitr != sorted.end(); ++sitr) {
+		const FileTags* ft = *sitr;
+		uchar entry[EntrySize];
+
+		qToLittleEndian(quint32(data.size()), entry);
+		qToLittleEndian(quint32(sitr.key().size()), entry + 4);
+		qToLittleEndian(quint32(ft->mtime_), entry + 8);
+		data.append(sitr.key());
+
+		qToLittleEndian(quint32(data.size()), entry + 12);
+		qToLittleEndian(quint32(ft->tags_.size()), entry + 16);
+		foreach (const Core::Location& loc, ft->tags_) {
+			writeVarint(loc.line_, data);
+			data.append(char(loc.tag_.type_));
+			writeString(loc.tag_.name_, data);
+			writeString(loc.tag_.scope_, data);
+		}
+
+		table.append(reinterpret_cast<char*>(entry), EntrySize);
+	}
+
+	// Fill in the header.
+	uchar* header = reinterpret_cast<uchar*>(data.data());
+	memcpy(header, Magic, sizeof(Magic));
+	qToLittleEndian(Version, header + 4);
+	qToLittleEndian(quint32(sorted.size()), header + 8);
+	qToLittleEndian(quint32(data.size()), header + 12);
+	data.append(table);
+
+	// Write to a temporary file.
+	QString tmpPath = path + ".tmp";
+	QFile file(tmpPath);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	if (file.write(data) != data.size()) {
+		file.remove();
+		return false;
+	}
+
+	file.close();
+
+	// Replace the current file.
+	QFile::remove(path);
+	return file.rename(path);
+}
+
+/**
+ * Finds the entry of a file in the file table.
+ * @param  key  The encoded absolute path of the file
+ * @return The index of the entry, -1 if the file is not in the database
+ */
+int TagIndex::find(const QByteArray& key) const
+{
+	uint low = 0, high = fileCount_;
+	while (low < high) {
+		uint mid = (low + high) / 2;
+		QByteArray path = entryPath(mid);
+
+		if (path == key)
+			return mid;
+
+		if (key < path)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+
+	return -1;
+}
+
+/**
+ * @param  entry  The index of an entry in the file table
+ * @return The encoded path of the entry's file
+ */
+QByteArray TagIndex::entryPath(uint entry) const
+{
+	const uchar* pos = table_ + (entry * EntrySize);
+	quint32 offset = qFromLittleEndian<quint32>(pos);
+	quint32 len = qFromLittleEndian<quint32>(pos + 4);
+
+	// The data is not copied, as the mapping outlives the array.
+	return QByteArray::fromRawData(reinterpret_cast<const char*>(base_)
+	                               + offset, len);
+}
+
+/**
+ * Decodes the tags of a file.
+ * The tags are bounded by the start of the file table, which ends the data.
+ * @param  entry  The index of the file's entry in the file table
+ * @param  tags   The list to append the tags to
+ * @return true if successful, false if the tags overrun the data
+ */
+bool TagIndex::readTags(uint entry, Core::LocationList& tags) const
+{
+	const uchar* pos = table_ + (entry * EntrySize);
+	QString file = QFile::decodeName(entryPath(entry));
+	quint32 count = qFromLittleEndian<quint32>(pos + 16);
+	pos = base_ + qFromLittleEndian<quint32>(pos + 12);
+
+	for (quint32 i = 0; i < count; i++) {
+		Core::Location loc;
+		if (!readVarint(pos, table_, loc.line_) || (pos >= table_))
+			return false;
+
+		loc.file_ = file;
+		loc.column_ = 0;
+		loc.tag_.type_ = static_cast<Core::Tag::Type>(*pos++);
+		if (!readString(pos, table_, loc.tag_.name_)
+		    || !readString(pos, table_, loc.tag_.scope_)) {
+			return false;
+		}
+
+		tags.append(loc);
+	}
+
+	return true;
+}
+
+/**
+ * Closes a database found to be corrupt while decoding it.
+ * Later lookups fail, so that the tags are taken from Ctags until the
+ * database is rebuilt.
+ * The object is never declared const, which makes it safe to close the
+ * database from lookup methods.
+ */
+void TagIndex::discard() const
+{
+	qDebug() << "Corrupt tag index" << file_.fileName();
+	const_cast<TagIndex*>(this)->close();
+}
+
+/**
+ * Class constructor.
+ * @param  conn     The connection waiting for the results
+ * @param  results  The query results
+ */
+IndexedQuery::IndexedQuery(Core::Engine::Connection* conn,
+                           const Core::LocationList& results)
+	: QObject(), conn_(conn), results_(results), stopped_(false)
+{
+	conn_->setCtrlObject(this);
+	QTimer::singleShot(0, this, SLOT(deliver()));
+}
+
+/**
+ * Discards the results.
+ * Termination is still reported from the event loop.
+ */
+void IndexedQuery::stop()
+{
+	stopped_ = true;
+}
+
+/**
+ * Passes the results to the connection, and deletes the object.
+ */
+void IndexedQuery::deliver()
+{
+	Core::QueryStats* stats = conn_->stats();
+	if (stats) {
+		stats->mark(Core::QueryStats::SearchDone);
+		stats->mark(Core::QueryStats::Exited);
+		stats->linesParsed_ += results_.size();
+		stats->aborted_ = stopped_;
+	}
+
+	conn_->setCtrlObject(NULL);
+	if (stopped_) {
+		conn_->onAborted();
+	}
+	else {
+		if (!results_.isEmpty())
+			conn_->onDataReady(results_);
+
+		conn_->onFinished();
+	}
+
+	deleteLater();
+}
+
+} // namespace Cscope
+
+} // namespace KScope
@@ -0,0 +1,155 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CSCOPE_TAGINDEX_H__
+#define __CSCOPE_TAGINDEX_H__
+
+#include <QFile>
+#include <QMap>
+#include <core/globals.h>
+#include <core/engine.h>
+
+namespace KScope
+{
+
+namespace Cscope
+{
+
+/**
+ * A project-wide database of tags, as produced by Ctags, keyed by file.
+ * The database is kept in a single memory-mapped file, holding a sorted table
+ * of files, with the modification time of each file at the time its tags were
+ * generated. A lookup runs a binary search over the table, and only decodes
+ * the tags of the requested file. Files modified since the database was
+ * written are reported as missing, so that the caller can fall back to
+ * running Ctags on the file.
+ * The database is written by a TagBuilder object.
+ * @author Elad Lahav
+ */
+class TagIndex
+{
+public:
+	TagIndex();
+	~TagIndex();
+
+	/**
+	 * The tags of a single file.
+	 */
+	struct FileTags
+	{
+		FileTags() : mtime_(0) {}
+
+		/**
+		 * The modification time of the file when the tags were generated.
+		 */
+		uint mtime_;
+
+		/**
+		 * The tags, in the order of appearance in the file.
+		 */
+		Core::LocationList tags_;
+	};
+
+	bool open(const QString&);
+	void close();
+	bool lookup(const QString&, Core::LocationList&) const;
+	bool lookup(const QString&, uint, Core::LocationList&) const;
+	void getTags(Core::Callback<const Core::Location&>&) const;
+
+	/**
+	 * @return The number of files in the database
+	 */
+	uint count() const { return fileCount_; }
+
+	static bool write(const QString&, const QMap<QString, FileTags>&);
+
+private:
+	/**
+	 * The database file.
+	 */
+	QFile file_;
+
+	/**
+	 * Mapped contents of the file (NULL if there is no database).
+	 */
+	const uchar* base_;
+
+	/**
+	 * The size of the mapped file.
+	 */
+	qint64 size_;
+
+	/**
+	 * Number of files in the database.
+	 */
+	uint fileCount_;
+
+	/**
+	 * Location of the file table.
+	 */
+	const uchar* table_;
+
+	int find(const QByteArray&) const;
+	QByteArray entryPath(uint) const;
+	bool readTags(uint, Core::LocationList&) const;
+	void discard() const;
+};
+
+/**
+ * Answers a query from results computed in-process, e.g., local tags taken
+ * from a TagIndex, or files found in a Core::PathIndex.
+ * The results are delivered from the event loop, so that the operation
+ * executes asynchronously like one run by a process.
+ * @author Elad Lahav
+ */
+class IndexedQuery : public QObject, public Core::Engine::Controlled
+{
+	Q_OBJECT
+
+public:
+	IndexedQuery(Core::Engine::Connection*, const Core::LocationList&);
+
+	void stop();
+
+private:
+	/**
+	 * The connection waiting for the results.
+	 */
+	Core::Engine::Connection* conn_;
+
+	/**
+	 * The query results.
+	 */
+	Core::LocationList results_;
+
+	/**
+	 * Whether the query was stopped before the results were delivered.
+	 */
+	bool stopped_;
+
+private slots:
+	void deliver();
+};
+
+} // namespace Cscope
+
+} // namespace KScope
+
+#endif // __CSCOPE_TAGINDEX_H__
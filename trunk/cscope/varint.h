@@ -0,0 +1,80 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2009 by Elad Lahav
+ *   elad_lahav@users.sourceforge.net
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ ***************************************************************************/
+
+#ifndef __CSCOPE_VARINT_H__
+#define __CSCOPE_VARINT_H__
+
+#include <QByteArray>
+
+namespace KScope
+{
+
+namespace Cscope
+{
+
+/**
+ * Decodes a variable-length (LEB128) integer.
+ * The data comes from files that may be truncated or corrupt, so the integer
+ * is never read past the given end.
+ * @param  pos  The position to read from, advanced past the integer
+ * @param  end  The end of the data
+ * @param  val  Holds the decoded value, upon successful return
+ * @return true if successful, false if the integer runs past the end of the
+ *         data, or does not fit in 32 bits
+ */
+inline bool readVarint(const uchar*& pos, const uchar* end, quint32& val)
+{
+	val = 0;
+	for (int shift = 0; shift < 32; shift += 7) {
+		if (pos >= end)
+			return false;
+
+		uchar c = *pos++;
+		if ((shift == 28) && (c & 0xf0))
+			return false;
+
+		val |= quint32(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Encodes a variable-length (LEB128) integer.
+ * @param  val  The value to encode
+ * @param  buf  The buffer to append to
+ */
+inline void writeVarint(quint32 val, QByteArray& buf)
+{
+	while (val >= 0x80) {
+		buf.append(char((val & 0x7f) | 0x80));
+		val >>= 7;
+	}
+
+	buf.append(char(val));
+}
+
+} // namespace Cscope
+
+} // namespace KScope
+
+#endif // __CSCOPE_VARINT_H__